@@ -0,0 +1,326 @@
+/*
+ * Bytes on air per sensor sample, one uplink per period versus batches.
+ *
+ * A day of simulated temperature and GPS samples, one of each per period,
+ * goes to the sample batching of lora/batch.c. Each period is sent in its
+ * own uplink, then batch windows of several periods in DR0 or DR5
+ * uplinks. Every batch is decoded as a network server would and its
+ * samples checked.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lora/batch.h"
+
+#define BENCH_PERIOD		10	/* s */
+#define BENCH_PERIODS		8640	/* a day */
+#define BENCH_OVERHEAD		13	/* MHDR, FHDR, FPort and MIC */
+#define BENCH_DR0		51	/* EU868 payload at SF12 */
+#define BENCH_DR5		242	/* EU868 payload at SF7 */
+
+/* The section headers of lora/proto.c */
+#define LEN_MASK		0x0f
+#define LONG_LEN_MASK		0x3f
+#define LEN_LEN(len)		(1 + ((len) >= LEN_MASK))
+
+/* The sensors of a SOM 1.2: a PCT2075 and a GPS */
+#define TYPE_GPS		1
+#define TYPE_TEMP		2
+#define TEMP_FIELDS		BATCH_FIELDS(BATCH_BE | 2, 0, 0, 0)
+#define GPS_FIELDS		BATCH_FIELDS(1, 4, 4, 2)
+#define TEMP_LEN		3
+#define GPS_LEN			12
+
+struct sensors {
+	int16_t		temp;		/* 1/256 C, 11 bits */
+	int32_t		lat, lon;	/* 1/10000 minute */
+	int16_t		alt;		/* dm */
+	int32_t		speed;		/* 1/10000 minute per period */
+};
+
+/* The samples in the order they were taken, to check the decoding */
+static struct {
+	uint8_t		data[BATCH_SAMPLE_LEN];
+	uint8_t		len;
+	uint32_t	time;
+	bool		decoded;
+} taken[BENCH_PERIODS * 2];
+static unsigned int ntaken;
+
+struct result {
+	unsigned long	frames;
+	unsigned long	payload;
+	double		sf12, sf7;	/* s on air */
+};
+
+static uint32_t
+lcg(void)
+{
+	static uint32_t	state = 1733;
+
+	state = state * 1103515245 + 12345;
+	return state >> 16;
+}
+
+static int
+jitter(int n)
+{
+	return (int)(lcg() % (2 * n + 1)) - n;
+}
+
+/* Time on air of SX1276GetTimeOnAir, 125 kHz, CR 4/5, CRC, explicit header */
+static double
+toa(unsigned int sf, unsigned int len)
+{
+	double	ts = (double)(1 << sf) / 125000;
+	int	num, den, npayload = 8;
+
+	num = 8 * len - 4 * sf + 28 + 16;
+	den = 4 * (sf - (sf >= 11 ? 2 : 0));
+	if (num > 0)
+		npayload += (num + den - 1) / den * 5;
+	return (8 + 4.25 + npayload) * ts;
+}
+
+static void
+frame(struct result *r, unsigned int len)
+{
+	r->frames++;
+	r->payload += len;
+	r->sf12 += toa(12, len + BENCH_OVERHEAD);
+	r->sf7 += toa(7, len + BENCH_OVERHEAD);
+}
+
+static void
+sample(struct sensors *s, uint8_t *temp, uint8_t *gps)
+{
+	uint16_t	raw;
+
+	s->temp += jitter(1) * 32;
+	raw = s->temp;
+	temp[0] = TYPE_TEMP;
+	temp[1] = raw >> 8;
+	temp[2] = raw;
+	s->lat += s->speed + jitter(20);
+	s->lon += s->speed / 2 + jitter(20);
+	s->alt += jitter(3);
+	gps[0] = TYPE_GPS;
+	gps[1] = 1;
+	memcpy(gps + 2, &s->lat, 4);
+	memcpy(gps + 6, &s->lon, 4);
+	memcpy(gps + 10, &s->alt, 2);
+}
+
+static void
+take(uint32_t time, const uint8_t *data, uint8_t len)
+{
+	memcpy(taken[ntaken].data, data, len);
+	taken[ntaken].len = len;
+	taken[ntaken].time = time;
+	taken[ntaken++].decoded = false;
+}
+
+static uint32_t
+get_varint(const uint8_t **p)
+{
+	uint32_t	v = 0;
+	int		shift = 0;
+
+	do {
+		v |= (uint32_t)(**p & 0x7f) << shift;
+		shift += 7;
+	} while (*(*p)++ & 0x80);
+	return v;
+}
+
+/* Marks the next sample of the sensor taken at time with these data */
+static int
+check(uint32_t time, const uint8_t *data, uint8_t len)
+{
+	unsigned int	i;
+
+	for (i = 0; i < ntaken; i++) {
+		if (taken[i].decoded || taken[i].data[0] != data[0])
+			continue;
+		if (taken[i].len != len || taken[i].time != time ||
+		    memcmp(taken[i].data, data, len) != 0)
+			break;
+		taken[i].decoded = true;
+		return 0;
+	}
+	fprintf(stderr, "batchbench: run decoded wrong at %u s\n", time);
+	return -1;
+}
+
+/* Decodes a run the way a network server would and checks its samples */
+static int
+decode(uint32_t now, const uint8_t *p, uint8_t len)
+{
+	const uint8_t	*end = p + len;
+	uint8_t		 data[BATCH_SAMPLE_LEN], w;
+	uint16_t	 fields;
+	uint32_t	 time, d, v, mask;
+	int		 off, i, shift;
+	bool		 bytes;
+
+	data[0] = *p++;
+	len = 1 + *p++;
+	fields = data[0] == TYPE_GPS ? GPS_FIELDS : TEMP_FIELDS;
+	bytes = len != (data[0] == TYPE_GPS ? GPS_LEN : TEMP_LEN);
+	time = now - get_varint(&p);
+	memcpy(data + 1, p, len - 1);
+	p += len - 1;
+	if (check(time, data, len) != 0)
+		return -1;
+	while (p < end) {
+		time += get_varint(&p);
+		for (off = 1, i = 0; off < len; off += w, i++) {
+			uint8_t field = bytes ? 1 : fields >> (4 * i) & 0xf;
+
+			w = field & ~BATCH_BE;
+			d = get_varint(&p);
+			d = d >> 1 ^ -(d & 1);
+			for (v = 0, shift = 0; shift < w; shift++)
+				v |= (uint32_t)data[off + (field & BATCH_BE ?
+				    w - 1 - shift : shift)] << (8 * shift);
+			mask = w == 4 ? UINT32_MAX : (1UL << (8 * w)) - 1;
+			v = (v + d) & mask;
+			for (shift = 0; shift < w; shift++)
+				data[off + (field & BATCH_BE ?
+				    w - 1 - shift : shift)] = v >> (8 * shift);
+		}
+		if (check(time, data, len) != 0)
+			return -1;
+	}
+	return 0;
+}
+
+/* One uplink per period, a section per sensor */
+static void
+unbatched(struct sensors s, struct result *r)
+{
+	uint8_t	temp[TEMP_LEN], gps[GPS_LEN];
+	int	n;
+
+	for (n = 0; n < BENCH_PERIODS; n++) {
+		sample(&s, temp, gps);
+		frame(r, LEN_LEN(TEMP_LEN) + TEMP_LEN +
+		    LEN_LEN(GPS_LEN) + GPS_LEN);
+	}
+}
+
+/* The room of tx_room() in lora/proto.c */
+static uint8_t
+room(uint8_t dlen, uint8_t maxlen)
+{
+	int	room = maxlen - dlen - 1;
+
+	if (room < LEN_MASK)
+		return room < 0 ? 0 : room;
+	if (room == LEN_MASK)
+		return LEN_MASK - 1;
+	return room - 1 < LONG_LEN_MASK ? room - 1 : LONG_LEN_MASK;
+}
+
+static int
+batched(struct sensors s, int window, uint8_t maxlen, struct result *r)
+{
+	static struct batch	b;
+	uint8_t			temp[TEMP_LEN], gps[GPS_LEN], buf[256];
+	uint8_t			len, rlen;
+	uint32_t		now;
+	int			n, periods = 0;
+	unsigned int		i;
+
+	memset(&b, 0, sizeof(b));
+	ntaken = 0;
+	for (n = 0; n < BENCH_PERIODS; n++) {
+		now = n * BENCH_PERIOD;
+		sample(&s, temp, gps);
+		batch_add(&b, now, TEMP_FIELDS, temp, sizeof(temp));
+		batch_add(&b, now, GPS_FIELDS, gps, sizeof(gps));
+		take(now, temp, sizeof(temp));
+		take(now, gps, sizeof(gps));
+		if (++periods < window && b.count <= BATCH_SAMPLES - 4)
+			continue;
+		for (len = 0; (rlen = batch_encode(&b, now, buf + len + 1,
+		    room(len, maxlen))) != 0; len += LEN_LEN(rlen) + rlen) {
+			if (decode(now, buf + len + 1, rlen) != 0)
+				return -1;
+		}
+		batch_commit(&b);
+		if (b.count == 0)
+			periods = 0;
+		frame(r, len);
+	}
+	for (i = 0, n = 0; i < ntaken; i++)
+		n += !taken[i].decoded;
+	if (n != b.count) {
+		fprintf(stderr, "batchbench: %d samples lost\n", n - b.count);
+		return -1;
+	}
+	return 0;
+}
+
+static void
+report(const char *name, const struct result *r)
+{
+	double	samples = 2.0 * BENCH_PERIODS;
+
+	printf("%-16s %5lu frames, %5.2f payload and %5.2f PHY bytes "
+	    "per sample, %6.1f ms SF12 and %5.2f ms SF7 per sample\n", name,
+	    r->frames, r->payload / samples,
+	    (r->payload + r->frames * BENCH_OVERHEAD) / samples,
+	    r->sf12 * 1000 / samples, r->sf7 * 1000 / samples);
+}
+
+int
+main(void)
+{
+	static const int	windows[] = { 2, 4, 8, 11 };
+	static const struct {
+		const char	*name;
+		int32_t		 speed;
+	} scenes[] = {
+		{ "static", 0 },
+		{ "walking", 80 },	/* 1.5 m/s */
+	};
+	struct sensors	s;
+	struct result	r;
+	char		name[32];
+	size_t		i, j;
+
+	printf("%d periods of %d s, a temperature and a GPS sample each\n",
+	    BENCH_PERIODS, BENCH_PERIOD);
+	for (i = 0; i < sizeof(scenes) / sizeof(scenes[0]); i++) {
+		printf("%s\n", scenes[i].name);
+		memset(&s, 0, sizeof(s));
+		s.temp = 22 * 256;
+		s.lat = 3 * 600000;
+		s.lon = 103 * 600000;
+		s.alt = 150;
+		s.speed = scenes[i].speed;
+		memset(&r, 0, sizeof(r));
+		unbatched(s, &r);
+		report("  tlv", &r);
+		for (j = 0; j < sizeof(windows) / sizeof(windows[0]); j++) {
+			memset(&r, 0, sizeof(r));
+			if (batched(s, windows[j], BENCH_DR0, &r) != 0)
+				return 1;
+			snprintf(name, sizeof(name), "  batch %2d DR0",
+			    windows[j]);
+			report(name, &r);
+			memset(&r, 0, sizeof(r));
+			if (batched(s, windows[j], BENCH_DR5, &r) != 0)
+				return 1;
+			snprintf(name, sizeof(name), "  batch %2d DR5",
+			    windows[j]);
+			report(name, &r);
+		}
+	}
+	return 0;
+}
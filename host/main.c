@@ -0,0 +1,606 @@
+/*
+ * LoRaMac stack on the host, over a simulated radio and virtual time.
+ *
+ * The uplink payloads are built in the MAC frame buffer from
+ * LoRaMacGetPayloadBuffer() as the firmware does, or with -c in a buffer
+ * of their own that the MAC copies in. The report gives the mean and
+ * minimum time of the LoRaMacMcpsRequest calls, which serialize, encrypt
+ * and sign the frame and load the radio, in time stamp counter cycles on
+ * x86, so both paths can be compared.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+#include "lora/frag.h"
+#include "lora/boards/board.h"
+#include "lora/boards/host/host-board.h"
+#include "lora/mac/LoRaMac.h"
+#include "lora/mac/LoRaMacTest.h"
+#include "lora/radio/host/radio-host.h"
+#include "host/ns.h"
+
+#define HOST_UPLINKS		100
+#define HOST_TX_PERIOD		60		/* s */
+#define HOST_TX_RETRY		1		/* s */
+#define HOST_JOIN_RETRY		15		/* s */
+#define HOST_PAYLOAD_LEN	12
+#define HOST_MAX_PAYLOAD_LEN	51		/* at all EU868 data rates */
+#define HOST_APP_PORT		2		/* port of the server downlinks */
+#define HOST_SUPPLY		3.3		/* V */
+
+static uint8_t DevEui[] = { 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x17, 0x33 };
+static uint8_t JoinEui[] = { 0x70, 0xB3, 0xD5, 0x7E, 0xD0, 0x00, 0x00, 0x01 };
+static uint8_t NwkKey[] = { 0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6,
+			    0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C };
+static uint8_t AppKey[] = { 0x3C, 0x4F, 0xCF, 0x09, 0x88, 0x15, 0xF7, 0xAB,
+			    0xA6, 0xD2, 0xAE, 0x28, 0x16, 0x15, 0x7E, 0x2B };
+
+#define HOST_DEV_ADDR		0x26011234
+#define HOST_NET_ID		0x000013
+
+static struct {
+  uint32_t	uplinks;	/* uplinks to send */
+  uint32_t	period;		/* s between uplinks */
+  bool		confirmed;
+  bool		abp;
+  bool		joined;
+  uint8_t	join_dr;
+  uint32_t	join_attempts;
+  uint64_t	join_time;
+  uint32_t	requested;
+  uint32_t	confirms;
+  uint32_t	acks;
+  uint32_t	retries;
+  uint32_t	rx1;		/* downlinks received in RX1 */
+  uint32_t	rx2;
+  uint32_t	app_received;	/* server application downlinks */
+  uint32_t	app_next;	/* next expected sequence number */
+  uint32_t	app_lost;
+  uint8_t	dr;
+  uint32_t	dr_changes;
+  uint32_t	dr_uplinks;	/* uplinks until the last data rate change */
+  bool		pending;	/* server has more downlinks */
+  bool		busy;		/* uplink in progress */
+  bool		tx;		/* uplink or join due */
+  HostEvent_t	tx_event;
+  uint8_t	frag_len;	/* payload split in fragments */
+  uint8_t	frag_parity;
+  uint32_t	frag_payloads;
+  struct frag	frag;
+  uint8_t	len;		/* payload bytes */
+  bool		copy;		/* payload copied into the MAC */
+  uint32_t	mcps_calls;	/* LoRaMacMcpsRequest accepted */
+  uint32_t	mcps_bytes;
+  uint64_t	mcps_ns;
+  uint64_t	mcps_cycles;
+  uint64_t	mcps_min;	/* cycles of the fastest, or ns */
+} host;
+
+static uint64_t
+now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Time stamp counter, 0 where there is none */
+static uint64_t
+cycles(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+static void
+tx_event_cb(void *context)
+{
+  (void)context;
+  host.tx = true;
+}
+
+static void
+schedule_tx(uint32_t s)
+{
+  HostEventSchedule(&host.tx_event, HostGetTime() + s * 1000000ULL,
+      tx_event_cb, NULL);
+}
+
+static void
+join(void)
+{
+  MlmeReq_t mlmeReq;
+
+  mlmeReq.Type = MLME_JOIN;
+  mlmeReq.Req.Join.Datarate = host.join_dr;
+  if (LoRaMacMlmeRequest(&mlmeReq) == LORAMAC_STATUS_OK) {
+    host.join_attempts++;
+    host.busy = true;
+  } else {
+    schedule_tx(HOST_JOIN_RETRY);
+  }
+}
+
+/* The next fragment of a payload, ns.c checks the reassembly */
+static uint8_t
+fragment(uint8_t *payload, uint8_t room)
+{
+  uint8_t len, i;
+
+  if (!frag_pending(&host.frag)) {
+    for (i = 0; i < host.frag_len; i++)
+      payload[i] = host.frag_payloads + i;
+    if (frag_start(&host.frag, payload, host.frag_len, room,
+        host.frag_parity) != 0)
+      return 0;
+    host.frag_payloads++;
+  }
+  if ((len = frag_encode(&host.frag, payload, room)) == 0 &&
+      frag_split(&host.frag, room) == 0)
+    len = frag_encode(&host.frag, payload, room);
+  return len;
+}
+
+static void
+send(void)
+{
+  static uint8_t buf[UINT8_MAX];
+  McpsReq_t mcpsReq;
+  LoRaMacStatus_t status;
+  LoRaMacTxInfo_t txInfo;
+  uint8_t *payload, size, len = host.len, port = 1;
+  uint64_t ns, tsc;
+
+  /* The payload is built in the MAC frame buffer */
+  if ((payload = LoRaMacGetPayloadBuffer(&size)) == NULL) {
+    host.retries++;
+    schedule_tx(HOST_TX_RETRY);
+    return;
+  }
+  /* or in a buffer of its own, which the MAC copies */
+  if (host.copy)
+    payload = buf;
+  if (host.frag_len > 0) {
+    txInfo.MaxPossibleApplicationDataSize = 0;
+    LoRaMacQueryTxPossible(0, &txInfo);
+    len = fragment(payload, txInfo.MaxPossibleApplicationDataSize);
+    port = FRAG_PORT;
+  } else {
+    memset(payload, 0, len);
+    payload[0] = host.requested;
+  }
+  if (host.confirmed) {
+    mcpsReq.Type = MCPS_CONFIRMED;
+    mcpsReq.Req.Confirmed.fPort = port;
+    mcpsReq.Req.Confirmed.fBuffer = payload;
+    mcpsReq.Req.Confirmed.fBufferSize = len;
+    mcpsReq.Req.Confirmed.NbTrials = 8;
+    mcpsReq.Req.Confirmed.Datarate = DR_5;
+  } else {
+    mcpsReq.Type = MCPS_UNCONFIRMED;
+    mcpsReq.Req.Unconfirmed.fPort = port;
+    mcpsReq.Req.Unconfirmed.fBuffer = payload;
+    mcpsReq.Req.Unconfirmed.fBufferSize = len;
+    mcpsReq.Req.Unconfirmed.Datarate = DR_5;
+  }
+
+  ns = now_ns();
+  tsc = cycles();
+  status = LoRaMacMcpsRequest(&mcpsReq);
+  tsc = cycles() - tsc;
+  ns = now_ns() - ns;
+  if (status == LORAMAC_STATUS_OK) {
+    host.mcps_calls++;
+    host.mcps_bytes += len;
+    host.mcps_ns += ns;
+    host.mcps_cycles += tsc;
+    if (tsc == 0)
+      tsc = ns;
+    if (host.mcps_min == 0 || tsc < host.mcps_min)
+      host.mcps_min = tsc;
+    if (len > 0 && port == FRAG_PORT)
+      frag_commit(&host.frag);
+    host.requested++;
+    host.busy = true;
+  } else {
+    /* duty cycle or MAC busy */
+    host.retries++;
+    schedule_tx(HOST_TX_RETRY);
+  }
+}
+
+static void
+McpsConfirm(McpsConfirm_t *mcpsConfirm)
+{
+  host.busy = false;
+  if (mcpsConfirm->Status == LORAMAC_EVENT_INFO_STATUS_OK)
+    host.confirms++;
+  if (mcpsConfirm->AckReceived)
+    host.acks++;
+  if (mcpsConfirm->Datarate != host.dr) {
+    host.dr = mcpsConfirm->Datarate;
+    host.dr_changes++;
+    host.dr_uplinks = host.requested;
+  }
+  /* The fragments of a payload follow as the duty cycle allows */
+  if (host.requested < host.uplinks)
+    schedule_tx(host.pending || frag_pending(&host.frag) ?
+        HOST_TX_RETRY : host.period);
+  host.pending = false;
+}
+
+static void
+McpsIndication(McpsIndication_t *mcpsIndication)
+{
+  uint32_t seq;
+
+  if (mcpsIndication->Status != LORAMAC_EVENT_INFO_STATUS_OK)
+    return;
+  if (mcpsIndication->RxSlot == RX_SLOT_WIN_1)
+    host.rx1++;
+  else if (mcpsIndication->RxSlot == RX_SLOT_WIN_2)
+    host.rx2++;
+  host.pending = mcpsIndication->FramePending;
+  if (mcpsIndication->RxData && mcpsIndication->Port == HOST_APP_PORT &&
+      mcpsIndication->BufferSize == 4) {
+    seq = mcpsIndication->Buffer[0] | mcpsIndication->Buffer[1] << 8 |
+        mcpsIndication->Buffer[2] << 16 |
+        (uint32_t)mcpsIndication->Buffer[3] << 24;
+    if (seq >= host.app_next) {
+      host.app_lost += seq - host.app_next;
+      host.app_next = seq + 1;
+      host.app_received++;
+    }
+  }
+}
+
+static void
+MlmeConfirm(MlmeConfirm_t *mlmeConfirm)
+{
+  if (mlmeConfirm->MlmeRequest != MLME_JOIN)
+    return;
+  host.busy = false;
+  if (mlmeConfirm->Status == LORAMAC_EVENT_INFO_STATUS_OK) {
+    host.joined = true;
+    host.join_time = HostGetTime();
+    host.dr = host.join_dr;
+    host.tx = true;
+  } else {
+    /* Try a more robust data rate next time */
+    if (host.join_dr > DR_0)
+      host.join_dr--;
+    schedule_tx(HOST_JOIN_RETRY);
+  }
+}
+
+static void
+MlmeIndication(MlmeIndication_t *mlmeIndication)
+{
+  (void)mlmeIndication;
+}
+
+static void
+OnMacProcessNotify(void)
+{
+}
+
+static void
+activate(void)
+{
+  MibRequestConfirm_t mibReq;
+
+  mibReq.Type = MIB_DEV_EUI;
+  mibReq.Param.DevEui = DevEui;
+  LoRaMacMibSetRequestConfirm(&mibReq);
+
+  mibReq.Type = MIB_JOIN_EUI;
+  mibReq.Param.JoinEui = JoinEui;
+  LoRaMacMibSetRequestConfirm(&mibReq);
+
+  mibReq.Type = MIB_APP_KEY;
+  mibReq.Param.AppKey = NwkKey;
+  LoRaMacMibSetRequestConfirm(&mibReq);
+
+  mibReq.Type = MIB_NWK_KEY;
+  mibReq.Param.NwkKey = NwkKey;
+  LoRaMacMibSetRequestConfirm(&mibReq);
+
+  if (!host.abp)
+    return;
+
+  mibReq.Type = MIB_NET_ID;
+  mibReq.Param.NetID = HOST_NET_ID;
+  LoRaMacMibSetRequestConfirm(&mibReq);
+
+  mibReq.Type = MIB_DEV_ADDR;
+  mibReq.Param.DevAddr = HOST_DEV_ADDR;
+  LoRaMacMibSetRequestConfirm(&mibReq);
+
+  mibReq.Type = MIB_F_NWK_S_INT_KEY;
+  mibReq.Param.FNwkSIntKey = NwkKey;
+  LoRaMacMibSetRequestConfirm(&mibReq);
+
+  mibReq.Type = MIB_S_NWK_S_INT_KEY;
+  mibReq.Param.SNwkSIntKey = NwkKey;
+  LoRaMacMibSetRequestConfirm(&mibReq);
+
+  mibReq.Type = MIB_NWK_S_ENC_KEY;
+  mibReq.Param.NwkSEncKey = NwkKey;
+  LoRaMacMibSetRequestConfirm(&mibReq);
+
+  mibReq.Type = MIB_APP_S_KEY;
+  mibReq.Param.AppSKey = AppKey;
+  LoRaMacMibSetRequestConfirm(&mibReq);
+
+  mibReq.Type = MIB_ABP_LORAWAN_VERSION;
+  mibReq.Param.AbpLrWanVersion.Value = 0x01000300;
+  LoRaMacMibSetRequestConfirm(&mibReq);
+
+  mibReq.Type = MIB_NETWORK_ACTIVATION;
+  mibReq.Param.NetworkActivation = ACTIVATION_TYPE_ABP;
+  LoRaMacMibSetRequestConfirm(&mibReq);
+  host.joined = true;
+}
+
+static double
+percent(uint32_t n, uint32_t total)
+{
+  return total > 0 ? 100.0 * n / total : 0;
+}
+
+static void
+report(double wall)
+{
+  const HostRadioStats_t *radio = HostRadioGetStats();
+  const struct ns_stats *ns = ns_get_stats();
+  const LoRaMacRxTiming_t *timing;
+  MibRequestConfirm_t mibReq;
+  double virt = HostGetTime() / 1e6;
+  double tx_mj = radio->TxCharge / 1e9 * HOST_SUPPLY;
+  double rx_mj = radio->RxCharge / 1e9 * HOST_SUPPLY;
+
+  if (!host.abp)
+    printf("join         %u attempts, %u accepted, joined after %.1f s\n",
+        host.join_attempts, ns->joins, host.join_time / 1e6);
+  printf("uplinks      %u sent, %u heard (%.1f%%), %u below floor, "
+      "%u mic errors\n", host.requested, ns->unique,
+      percent(ns->unique, host.requested), ns->missed, ns->mic_errors);
+  if (host.confirmed)
+    printf("acks         %u of %u (%.1f%%)\n", host.acks, host.requested,
+        percent(host.acks, host.requested));
+  printf("downlinks    %u sent (%u rx1, %u rx2, %u faded), %u received "
+      "(%u rx1, %u rx2)\n", ns->rx1 + ns->rx2 + ns->faded, ns->rx1, ns->rx2,
+      ns->faded, host.rx1 + host.rx2, host.rx1, host.rx2);
+  printf("             rx1 hits %.1f%%, rx2 hits %.1f%%, %u with "
+      "FPending\n", percent(host.rx1, ns->rx1), percent(host.rx2, ns->rx2),
+      ns->pending);
+  printf("app data     %u queued, %u sent, %u received (%.1f%%), %u lost\n",
+      ns->app_queued, ns->app_sent, host.app_received,
+      percent(host.app_received, ns->app_sent), host.app_lost);
+  if (host.frag_len > 0)
+    printf("fragments    %u payloads of %u bytes, %u reassembled (%.1f%%), "
+        "%u rebuilt from parity, %u corrupt\n", host.frag_payloads,
+        host.frag_len, ns->frag_payloads,
+        percent(ns->frag_payloads, host.frag_payloads), ns->frag_rebuilt,
+        ns->frag_corrupt);
+  printf("mac          LinkADRReq %u (%u ok), NewChannelReq %u (%u ok), "
+      "DevStatusReq %u (%u answered)\n", ns->link_adr, ns->link_adr_ok,
+      ns->new_channel, ns->new_channel_ok, ns->dev_status,
+      ns->dev_status_ans);
+  printf("adr          DR%u, tx power %u, settled after %u uplinks "
+      "(%.1f h), %u data rate changes\n", ns->dr, ns->tx_power,
+      ns->adr_uplinks, ns->adr_time / 3600e6, host.dr_changes);
+  printf("airtime      %.3f s tx (%u frames, %u retries), %.3f s rx "
+      "(%u windows)\n", radio->TxTime / 1e6, radio->TxCount, host.retries,
+      radio->RxTime / 1e6, radio->RxWindows);
+  mibReq.Type = MIB_RX_TIMING;
+  LoRaMacMibGetRequestConfirm(&mibReq);
+  timing = mibReq.Param.RxTiming;
+  printf("rx timing    %u windows, error %d..%d us, timer latency %u us, "
+      "irq latency %u us\n", timing->Windows, timing->ErrorMin,
+      timing->ErrorMax, timing->TimerLatency, timing->IrqLatency);
+  printf("             %u downlinks measured, drift %d ppm, deviation %u us, "
+      "window error %u us\n", timing->Downlinks, timing->Drift,
+      timing->Deviation, timing->RxError);
+  if (host.mcps_calls > 0)
+    printf("mcps request %u uplinks of %.0f bytes %s, mean %.0f ns %.0f "
+        "cycles, min %llu %s\n", host.mcps_calls,
+        (double)host.mcps_bytes / host.mcps_calls,
+        host.copy ? "copied" : "in place",
+        (double)host.mcps_ns / host.mcps_calls,
+        (double)host.mcps_cycles / host.mcps_calls,
+        (unsigned long long)host.mcps_min,
+        host.mcps_cycles > 0 ? "cycles" : "ns");
+  printf("energy       %.3f J tx, %.3f J rx, %.3f mJ per uplink\n",
+      tx_mj / 1e3, rx_mj / 1e3,
+      host.requested > 0 ? (tx_mj + rx_mj) / host.requested : 0);
+  printf("time         %.3f days virtual, %.3f s wall (x%.0f)\n",
+      virt / 86400, wall, wall > 0 ? virt / wall : 0);
+}
+
+static void
+usage(void)
+{
+  fprintf(stderr, "usage: mx1733-host [-aCcu] [-n uplinks] [-p period] "
+      "[-s seed]\n"
+      "\t[-B len] [-F fraglen] [-P parity]\n"
+      "\t[-L pathloss] [-r rx2] [-q dlperiod] [-Q dlcount] "
+      "[-S statusperiod]\n"
+      "\t[-l rxloss] [-e rxerror] [-t txtimeout] [-D txdonedelay]\n"
+      "\t[-i irqlatency] [-d drift] [-E maxrxerror]\n");
+  exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char *argv[])
+{
+  LoRaMacPrimitives_t LoRaMacPrimitives;
+  LoRaMacCallback_t LoRaMacCallbacks;
+  MibRequestConfirm_t mibReq;
+  HostRadioFaults_t faults = { 0 };
+  struct ns_config ns = {
+    .nwk_key = NwkKey,
+    .app_key = AppKey,
+    .net_id = HOST_NET_ID,
+    .dev_addr = HOST_DEV_ADDR,
+    .path_loss = 120,
+    .dl_count = 1,
+    .status_period = 100,
+  };
+  bool dutycycle = true;
+  struct timespec start, end;
+  uint32_t seed = 1;
+  uint32_t max_rx_error = 10;
+  int ch;
+
+  host.uplinks = HOST_UPLINKS;
+  host.period = HOST_TX_PERIOD;
+  host.join_dr = DR_5;
+  host.len = HOST_PAYLOAD_LEN;
+  while ((ch = getopt(argc, argv, "aB:CcD:d:E:e:F:i:L:l:n:P:p:Q:q:r:S:s:t:u")) != -1) {
+    switch (ch) {
+    case 'a':
+      host.abp = true;
+      break;
+    case 'B':
+      host.len = strtoul(optarg, NULL, 0);
+      if (host.len == 0 || host.len > HOST_MAX_PAYLOAD_LEN)
+        usage();
+      break;
+    case 'C':
+      host.confirmed = true;
+      break;
+    case 'c':
+      host.copy = true;
+      break;
+    case 'D':
+      faults.TxDoneDelay = strtoul(optarg, NULL, 0);
+      break;
+    case 'd':
+      HostSetRtcDrift(strtol(optarg, NULL, 0));
+      break;
+    case 'E':
+      max_rx_error = strtoul(optarg, NULL, 0);
+      break;
+    case 'e':
+      faults.RxError = strtoul(optarg, NULL, 0);
+      break;
+    case 'F':
+      host.frag_len = strtoul(optarg, NULL, 0);
+      if (host.frag_len > FRAG_MAX_LEN)
+        usage();
+      break;
+    case 'i':
+      HostSetIrqLatency(strtoul(optarg, NULL, 0));
+      break;
+    case 'L':
+      ns.path_loss = strtoul(optarg, NULL, 0);
+      break;
+    case 'l':
+      faults.RxLoss = strtoul(optarg, NULL, 0);
+      break;
+    case 'n':
+      host.uplinks = strtoul(optarg, NULL, 0);
+      break;
+    case 'P':
+      host.frag_parity = strtoul(optarg, NULL, 0);
+      break;
+    case 'p':
+      host.period = strtoul(optarg, NULL, 0);
+      break;
+    case 'Q':
+      ns.dl_count = strtoul(optarg, NULL, 0);
+      break;
+    case 'q':
+      ns.dl_period = strtoul(optarg, NULL, 0);
+      break;
+    case 'r':
+      ns.rx2 = strtoul(optarg, NULL, 0);
+      break;
+    case 'S':
+      ns.status_period = strtoul(optarg, NULL, 0);
+      break;
+    case 's':
+      seed = strtoul(optarg, NULL, 0);
+      break;
+    case 't':
+      faults.TxTimeout = strtoul(optarg, NULL, 0);
+      break;
+    case 'u':
+      dutycycle = false;
+      break;
+    default:
+      usage();
+    }
+  }
+  if (optind != argc)
+    usage();
+
+  HostSetSeed(seed);
+  srand(seed);
+  srand1(seed);
+  HostRadioSetFaults(&faults);
+  ns.abp = host.abp;
+  ns_init(&ns);
+  BoardInitMcu();
+
+  LoRaMacPrimitives.MacMcpsConfirm = McpsConfirm;
+  LoRaMacPrimitives.MacMcpsIndication = McpsIndication;
+  LoRaMacPrimitives.MacMlmeConfirm = MlmeConfirm;
+  LoRaMacPrimitives.MacMlmeIndication = MlmeIndication;
+  LoRaMacCallbacks.GetBatteryLevel = NULL;
+  LoRaMacCallbacks.GetTemperatureLevel = NULL;
+  LoRaMacCallbacks.NvmContextChange = NULL;
+  LoRaMacCallbacks.MacProcessNotify = OnMacProcessNotify;
+  if (LoRaMacInitialization(&LoRaMacPrimitives, &LoRaMacCallbacks,
+      LORAMAC_REGION_EU868) != LORAMAC_STATUS_OK) {
+    fprintf(stderr, "LoRaMacInitialization failed\n");
+    return EXIT_FAILURE;
+  }
+
+  mibReq.Type = MIB_ADR;
+  mibReq.Param.AdrEnable = true;
+  LoRaMacMibSetRequestConfirm(&mibReq);
+  mibReq.Type = MIB_SYSTEM_MAX_RX_ERROR;
+  mibReq.Param.SystemMaxRxError = max_rx_error;
+  LoRaMacMibSetRequestConfirm(&mibReq);
+  LoRaMacTestSetDutyCycleOn(dutycycle);
+  activate();
+  LoRaMacStart();
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  host.tx = host.uplinks > 0;
+  for (;;) {
+    LoRaMacProcess();
+    if (host.tx) {
+      host.tx = false;
+      if (host.joined)
+        send();
+      else
+        join();
+    }
+    if (host.requested == host.uplinks && !host.busy)
+      break;
+    if (!HostRunNext(UINT64_MAX)) {
+      fprintf(stderr, "stalled at %llu us\n",
+          (unsigned long long)HostGetTime());
+      return EXIT_FAILURE;
+    }
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  report((end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+  return EXIT_SUCCESS;
+}
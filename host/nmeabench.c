@@ -0,0 +1,511 @@
+/*
+ * NMEA parsing of a GPS log, line buffer versus the incremental parser.
+ *
+ * host/gps.nmea holds two minutes of receiver output from a cold start
+ * to a fix. Both parsers are timed per byte, and the LoRa task wake-ups
+ * for the sentences compared with those of the former 10 ms polling
+ * timer. On randomly corrupted parts of the log every sentence the
+ * parser takes must be valid, and it must take all those the line buffer
+ * takes except the ones that break NMEA 0183.
+ *
+ * Before the log, nmea_near() of the stationary node test must take
+ * positions NEAR_IN times the motion threshold apart north-south or
+ * east-west as near and NEAR_OUT times apart as far, up to NEAR_MAX_LAT.
+ *
+ * Each log given on the command line is then parsed, and its time to
+ * fix printed. Logs of one cold and one aided acquisition each measure
+ * the aiding of gps.c.
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sensor/nmea.h"
+
+#define BENCH_BYTES		(64 * 1024 * 1024)	/* parsed per run */
+#define BENCH_TIMER_HZ		100	/* wake-ups of the 10 ms timer */
+#define FUZZ_RUNS		20000
+#define FUZZ_LEN		1024	/* bytes of the log per run */
+#define FUZZ_EDITS		8
+#define LOG_SENTENCES		4096	/* kept of a log */
+#define FIX_MIN_SATS		4	/* GPS quality defaults of gps.c */
+#define FIX_MAX_HDOP		5.0
+#define NEAR_MAX_LAT		75	/* degrees, the table is coarser above */
+#define NEAR_IN			0.7	/* of the threshold, near */
+#define NEAR_OUT		1.5	/* far */
+
+/* The sentences parsed from a stream, type and fields */
+struct parsed {
+	uint8_t	type;
+	uint8_t	fields;
+	bool	strict;		/* within NMEA 0183 */
+	char	data[NMEA_LEN];	/* fields separated by NULs */
+	uint8_t	len;
+};
+
+struct result {
+	struct parsed	p[LOG_SENTENCES];
+	int		n;
+};
+
+/*
+ * The parser of sensor/gps.c before, a line buffer of 128 bytes checked
+ * and split at the "\n".
+ */
+#define REF_FIELDS	20
+
+static const char	hex[] = "0123456789ABCDEF";
+
+struct ref {
+	char	buf[128];
+	int	len;
+};
+
+static bool
+valid_crc(char *msg, int len)
+{
+	char	*p;
+	int	 ccrc, icrc;
+
+	if (*msg != '$')
+		return false;
+	p = memchr(msg, '*', len);
+	if (p != msg + len - 5)
+		return false;
+	if (memcmp(msg + len - 2, "\r\n", 2) != 0)
+		return false;
+	if ((p = memchr(hex, msg[len - 4], 16)) == NULL)
+		return false;
+	icrc = (p - hex) << 4;
+	if ((p = memchr(hex, msg[len - 3], 16)) == NULL)
+		return false;
+	icrc |= p - hex;
+	ccrc = 0;
+	for (p = msg + 1; p < msg + len - 5; p++)
+		ccrc ^= *p;
+	return ccrc == icrc;
+}
+
+/*
+ * The line buffer also takes sentences with a "$" or characters outside
+ * printable ASCII inside and sentences longer than NMEA 0183 allows, the
+ * parser drops them.
+ */
+static bool
+strict(const char *msg, int len)
+{
+	int	i;
+
+	if (len - 6 >= NMEA_LEN)
+		return false;
+	for (i = 1; i < len - 5; i++) {
+		if (msg[i] == '$' || msg[i] < ' ' || msg[i] > '~')
+			return false;
+	}
+	return true;
+}
+
+static uint8_t
+ref_msgproc(char *msg, int len, char **data, int *fields, bool *strictp)
+{
+	char	*s, *p;
+	int	 i;
+
+	if (!valid_crc(msg, len))
+		return NMEA_NONE;
+	*strictp = strict(msg, len);
+	msg[len - 5] = '\0';
+	i = 0;
+	for (s = msg; *s != '\0'; s = p + 1) {
+		data[i++] = s;
+		if (i == REF_FIELDS || (p = strchr(s, ',')) == NULL)
+			break;
+		*p = '\0';
+	}
+	*fields = i;
+	if (i == 0)
+		return NMEA_NONE;
+	if (strcmp(data[0], "$GPGGA") == 0)
+		return NMEA_GGA;
+	if (strcmp(data[0], "$GPGSV") == 0)
+		return NMEA_GSV;
+	return NMEA_NONE;
+}
+
+/* Keeps the fields of a sentence, without the trailing empty ones */
+static void
+keep(struct result *r, uint8_t type, char **data, int fields, bool strict)
+{
+	struct parsed	*p;
+	int		 i, n;
+
+	if (r == NULL || r->n == LOG_SENTENCES)
+		return;
+	while (fields > 1 && *data[fields - 1] == '\0')
+		fields--;
+	p = &r->p[r->n++];
+	p->type = type;
+	p->fields = fields;
+	p->strict = strict;
+	for (i = 1, p->len = 0; i < fields; i++) {
+		n = strlen(data[i]) + 1;
+		memcpy(p->data + p->len, data[i], n);
+		p->len += n;
+	}
+}
+
+static unsigned long
+ref_parse(const char *log, size_t len, struct result *r)
+{
+	static struct ref	 ref;
+	char			*data[REF_FIELDS];
+	unsigned long		 sentences = 0;
+	uint8_t			 type;
+	int			 fields;
+	bool			 strict;
+	size_t			 i;
+
+	ref.len = 0;
+	for (i = 0; i < len; i++) {
+		if (ref.len >= (int)sizeof(ref.buf)) {
+			ref.len = 0;
+			continue;
+		}
+		if ((ref.buf[ref.len++] = log[i]) != '\n')
+			continue;
+		type = ref_msgproc(ref.buf, ref.len, data, &fields, &strict);
+		if (type != NMEA_NONE) {
+			sentences++;
+			keep(r, type, data, fields, strict);
+		}
+		ref.len = 0;
+	}
+	return sentences;
+}
+
+static unsigned long
+nmea_parse(const char *log, size_t len, struct result *r)
+{
+	static struct nmea		n;
+	static struct nmea_sentence	s;
+	char				*data[NMEA_FIELDS];
+	uint8_t				 type;
+	size_t				 i;
+	int				 f;
+
+	nmea_init(&n, &s);
+	for (i = 0; i < len; i++) {
+		if ((type = nmea_feed(&n, log[i])) == NMEA_NONE || r == NULL)
+			continue;
+		for (f = 0; f < s.fields; f++)
+			data[f] = nmea_field(&s, f);
+		keep(r, type, data, s.fields, true);
+	}
+	return n.sentences;
+}
+
+static bool
+same(const struct parsed *a, const struct parsed *b)
+{
+	return a->type == b->type && a->fields == b->fields &&
+	    a->len == b->len && memcmp(a->data, b->data, a->len) == 0;
+}
+
+/* Rebuilds a sentence from its fields and has the line buffer check it */
+static bool
+reparse(const struct parsed *p)
+{
+	static const char	*ids[] = {
+		[NMEA_GGA]	= "GPGGA",
+		[NMEA_GSV]	= "GPGSV",
+	};
+	struct result	r;
+	char		line[256];
+	const char	*f;
+	int		i, len, crc = 0;
+
+	len = snprintf(line, sizeof(line), "$%s", ids[p->type]);
+	for (i = 1, f = p->data; i < p->fields; i++, f += strlen(f) + 1)
+		len += snprintf(line + len, sizeof(line) - len, ",%s", f);
+	for (i = 1; i < len; i++)
+		crc ^= line[i];
+	len += snprintf(line + len, sizeof(line) - len, "*%02X\r\n", crc);
+	r.n = 0;
+	ref_parse(line, len, &r);
+	return r.n == 1 && same(&r.p[0], p);
+}
+
+static uint32_t
+lcg(void)
+{
+	static uint32_t	state = 1733;
+
+	state = state * 1103515245 + 12345;
+	return state >> 16;
+}
+
+static void
+mutate(char *buf, size_t *len)
+{
+	static const char	special[] = "$*,\r\n0A";
+	size_t			pos;
+	int			i;
+
+	for (i = lcg() % (FUZZ_EDITS + 1); i > 0 && *len > 1; i--) {
+		pos = lcg() % *len;
+		switch (lcg() % 4) {
+		case 0:		/* flip a bit */
+			buf[pos] ^= 1 << (lcg() % 8);
+			break;
+		case 1:		/* lose a byte */
+			memmove(buf + pos, buf + pos + 1, *len - pos - 1);
+			(*len)--;
+			break;
+		case 2:		/* a byte NMEA cares about */
+			buf[pos] = special[lcg() % (sizeof(special) - 1)];
+			break;
+		default:	/* noise */
+			memmove(buf + pos + 1, buf + pos, *len - pos);
+			buf[pos] = lcg();
+			(*len)++;
+			break;
+		}
+	}
+}
+
+/*
+ * Every sentence the line buffer takes, the parser takes too unless it
+ * breaks NMEA 0183, and every sentence the parser takes is valid.
+ */
+static int
+fuzz(const char *log, size_t len)
+{
+	static struct result	ref, got;
+	static char		buf[FUZZ_LEN + FUZZ_EDITS + 1];
+	size_t			blen, start;
+	int			run, j, k;
+
+	for (run = 0; run < FUZZ_RUNS; run++) {
+		blen = len < FUZZ_LEN ? len : FUZZ_LEN;
+		start = lcg() % (len - blen + 1);
+		memcpy(buf, log + start, blen);
+		mutate(buf, &blen);
+		ref.n = got.n = 0;
+		ref_parse(buf, blen, &ref);
+		nmea_parse(buf, blen, &got);
+		for (j = 0; j < got.n; j++) {
+			if (!reparse(&got.p[j])) {
+				fprintf(stderr, "nmeabench: run %d took an "
+				    "invalid sentence\n", run);
+				return -1;
+			}
+		}
+		for (j = 0, k = 0; j < ref.n; j++) {
+			if (!ref.p[j].strict)
+				continue;
+			while (k < got.n && !same(&got.p[k], &ref.p[j]))
+				k++;
+			if (k++ == got.n) {
+				fprintf(stderr, "nmeabench: run %d lost a "
+				    "sentence\n", run);
+				return -1;
+			}
+		}
+	}
+	return 0;
+}
+
+/* Field i of a parsed sentence, empty when it has fewer */
+static const char *
+field(const struct parsed *p, int i)
+{
+	const char	*f = p->data;
+
+	if (i >= p->fields)
+		return "";
+	while (--i > 0)
+		f += strlen(f) + 1;
+	return f;
+}
+
+/* UTC time of day of a GGA sentence in s, -1 if absent */
+static long
+gga_time(const struct parsed *p)
+{
+	const char	*t = field(p, 1);
+
+	if (strlen(t) < 6)
+		return -1;
+	return ((t[0] - '0') * 10 + t[1] - '0') * 3600 +
+	    ((t[2] - '0') * 10 + t[3] - '0') * 60 + (t[4] - '0') * 10 +
+	    t[5] - '0';
+}
+
+/*
+ * The time to fix of a log of one acquisition, from its first GGA
+ * sentence to the first one with a fix of the quality gps.c asks for by
+ * default. The log of an aided acquisition starts after the aiding.
+ */
+static long
+ttff(const struct result *r, const struct parsed **fix)
+{
+	const struct parsed	*p;
+	long			 start = -1, t;
+	int			 i;
+
+	for (i = 0; i < r->n; i++) {
+		p = &r->p[i];
+		if (p->type != NMEA_GGA || (t = gga_time(p)) < 0)
+			continue;
+		if (start < 0)
+			start = t;
+		if (atoi(field(p, 6)) != 0 &&
+		    atoi(field(p, 7)) >= FIX_MIN_SATS &&
+		    *field(p, 8) != '\0' && atof(field(p, 8)) <= FIX_MAX_HDOP) {
+			*fix = p;
+			return (t - start + 24 * 60 * 60) % (24 * 60 * 60);
+		}
+	}
+	return -1;
+}
+
+static char *
+load(const char *path, size_t *len)
+{
+	FILE	*f;
+	char	*log;
+	long	 size;
+
+	if ((f = fopen(path, "rb")) == NULL || fseek(f, 0, SEEK_END) != 0 ||
+	    (size = ftell(f)) <= 0 || fseek(f, 0, SEEK_SET) != 0) {
+		perror(path);
+		exit(1);
+	}
+	if ((log = malloc(size)) == NULL ||
+	    fread(log, 1, size, f) != (size_t)size) {
+		perror(path);
+		exit(1);
+	}
+	fclose(f);
+	*len = size;
+	return log;
+}
+
+static double
+now(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Nanoseconds per byte of the log */
+static double
+bench(unsigned long (*parse)(const char *, size_t, struct result *),
+    const char *log, size_t len, unsigned long *sentences)
+{
+	double	start = now();
+	size_t	done;
+
+	*sentences = 0;
+	for (done = 0; done < BENCH_BYTES; done += len)
+		*sentences += parse(log, len, NULL);
+	return (now() - start) * 1e9 / done;
+}
+
+/*
+ * The stationary node test of gps.c: positions moved by a share of the
+ * threshold north or east, at latitudes north and south, in 1/10000
+ * minute.
+ */
+static int
+near(void)
+{
+	static const uint8_t	ths[] = { 10, 50, 255 };
+	double			m, dlon;
+	int32_t			lat, lon = 13 * 600000, d;
+	int			i, deg, n = 0;
+
+	for (i = 0; i < (int)(sizeof(ths) / sizeof(*ths)); i++)
+		for (deg = -NEAR_MAX_LAT; deg <= NEAR_MAX_LAT; deg += 5) {
+			lat = deg * 600000;
+			m = ths[i] / 0.1852;
+			dlon = m / cos(deg * M_PI / 180);
+			d = NEAR_IN * m;
+			if (!nmea_near(lat + d, lon, lat, lon, ths[i]) ||
+			    !nmea_near(lat, lon + NEAR_IN * dlon, lat, lon,
+			    ths[i]))
+				goto fail;
+			d = NEAR_OUT * m;
+			if (nmea_near(lat - d, lon, lat, lon, ths[i]) ||
+			    nmea_near(lat, lon - NEAR_OUT * dlon, lat, lon,
+			    ths[i]))
+				goto fail;
+			n++;
+		}
+	printf("%d near position checks\n", n);
+	return 0;
+fail:
+	fprintf(stderr, "nmeabench: %d m at latitude %d taken wrong\n",
+	    ths[i], deg);
+	return 1;
+}
+
+int
+main(int argc, char *argv[])
+{
+	static struct result	r;
+	const struct parsed	*fix;
+	unsigned long		nref, nnew;
+	long			t;
+	double			tref, tnew;
+	size_t			len;
+	char			*log;
+	int			i, j, gga;
+
+	if (argc < 2) {
+		fprintf(stderr, "usage: nmeabench log.nmea ...\n");
+		return 1;
+	}
+	if (near() != 0)
+		return 1;
+	for (i = 1; i < argc; i++) {
+		log = load(argv[i], &len);
+		r.n = 0;
+		nmea_parse(log, len, &r);
+		for (j = 0, gga = 0; j < r.n; j++)
+			gga += r.p[j].type == NMEA_GGA;
+		printf("%s: %zu bytes, %d GGA and %d GSV sentences\n",
+		    argv[i], len, gga, r.n - gga);
+		if ((t = ttff(&r, &fix)) >= 0)
+			printf("  time to fix %ld s, %s satellites, HDOP %s\n",
+			    t, field(fix, 7), field(fix, 8));
+		else
+			printf("  no fix\n");
+		tref = bench(ref_parse, log, len, &nref);
+		tnew = bench(nmea_parse, log, len, &nnew);
+		if (nref != nnew) {
+			fprintf(stderr, "nmeabench: %lu sentences parsed, "
+			    "%lu before\n", nnew, nref);
+			return 1;
+		}
+		printf("  line buffer %6.2f ns per byte\n", tref);
+		printf("  incremental %6.2f ns per byte\n", tnew);
+		/* At 1 Hz the log lasts as many seconds as it has GGA */
+		if (gga != 0)
+			printf("  task wake-ups per second: %d with the timer, "
+			    "%.2f for GGA, %.2f for GGA and GSV\n",
+			    BENCH_TIMER_HZ, 1.0, (double)r.n / gga);
+		if (fuzz(log, len) != 0)
+			return 1;
+		printf("  %d fuzzed runs agree\n", FUZZ_RUNS);
+		free(log);
+	}
+	return 0;
+}
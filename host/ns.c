@@ -0,0 +1,678 @@
+/* Network server stand-in of the host build */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lora/frag.h"
+#include "lora/boards/host/host-board.h"
+#include "lora/radio/host/radio-host.h"
+#include "lora/system/soft-se/aes.h"
+#include "lora/system/soft-se/cmac.h"
+#include "host/ns.h"
+
+/*
+ * A single EU868 gateway and network server serving a single device,
+ * LoRaWAN 1.0.x. Uplinks are heard when their SNR over the configured
+ * path loss clears the demodulation floor of their spreading factor,
+ * and are answered in RX1 or RX2 when an ACK, MAC commands or queued
+ * application data are pending. After a join the server adds the
+ * five common EU868 channels with NewChannelReq, and it steers data
+ * rate and TX power with LinkADRReq like the usual "SNR margin" ADR.
+ */
+#define NS_RX1_DELAY		1000000		/* us */
+#define NS_JOIN_RX1_DELAY	5000000		/* us */
+#define NS_RX2_FREQ		869525000
+#define NS_RX1_POWER		14		/* dBm */
+#define NS_RX2_POWER		27		/* dBm */
+#define NS_NOISE_FIGURE		6		/* dB */
+#define NS_FADING		30		/* +/- 0.1 dB */
+#define NS_FOPTS_MAX		15
+#define NS_CMD_MAX		64
+#define NS_APP_PORT		2
+
+#define NS_ADR_HISTORY		20
+#define NS_ADR_MARGIN		10		/* dB, installation margin */
+#define NS_ADR_DR_MAX		5
+#define NS_ADR_POWER_MAX	7		/* lowest TX power index */
+
+#define NS_CHANNELS		8
+#define NS_CHANNELS_DEFAULT	0x07
+
+/* MHDR message types */
+#define NS_JOIN_REQUEST		0x00
+#define NS_JOIN_ACCEPT		0x20
+#define NS_UNCONFIRMED_UP	0x40
+#define NS_UNCONFIRMED_DOWN	0x60
+#define NS_CONFIRMED_UP		0x80
+
+/* FCtrl bits */
+#define NS_FCTRL_ADR		0x80
+#define NS_FCTRL_ADRACKREQ	0x40
+#define NS_FCTRL_ACK		0x20
+#define NS_FCTRL_FPENDING	0x10
+#define NS_FCTRL_FOPTSLEN	0x0f
+
+/* MAC command identifiers */
+#define NS_LINK_CHECK		0x02
+#define NS_LINK_ADR		0x03
+#define NS_DUTY_CYCLE		0x04
+#define NS_RX_PARAM_SETUP	0x05
+#define NS_DEV_STATUS		0x06
+#define NS_NEW_CHANNEL		0x07
+#define NS_RX_TIMING_SETUP	0x08
+#define NS_TX_PARAM_SETUP	0x09
+#define NS_DL_CHANNEL		0x0a
+#define NS_DEVICE_TIME		0x0d
+
+static const uint32_t ns_channel_freq[NS_CHANNELS] = {
+  868100000, 868300000, 868500000,
+  867100000, 867300000, 867500000, 867700000, 867900000,
+};
+
+static struct {
+  struct ns_config config;
+  struct ns_stats stats;
+
+  /* session */
+  bool		joined;
+  uint32_t	join_nonce;
+  uint8_t	nwk_s_key[16];
+  uint8_t	app_s_key[16];
+  bool		have_up;
+  uint32_t	fcnt_up;
+  uint32_t	fcnt_down;
+
+  /* MAC commands for the next downlink */
+  uint8_t	cmd[NS_CMD_MAX];
+  uint8_t	cmd_len;
+  uint8_t	channels;	/* channels the device accepted */
+  uint8_t	channels_sent;	/* NewChannelReq awaiting an answer */
+  bool		link_adr_sent;
+  uint8_t	link_adr_dr;
+  uint8_t	link_adr_power;
+
+  /* ADR */
+  int16_t	snr[NS_ADR_HISTORY];	/* 0.1 dB */
+  uint8_t	snr_count;
+  uint8_t	snr_next;
+
+  /* application downlinks */
+  uint32_t	app_seq;
+  uint32_t	app_queued;
+
+  /* fragmented uplinks */
+  struct frag_rx frag;
+} ns;
+
+static void
+ns_aes(const uint8_t *key, const uint8_t in[16], uint8_t out[16])
+{
+  aes_context ctx;
+
+  aes_set_key(key, 16, &ctx);
+  aes_encrypt(in, out, &ctx);
+}
+
+static void
+ns_cmac(const uint8_t *key, const uint8_t *b0, const uint8_t *buf,
+    uint32_t len, uint8_t mic[4])
+{
+  AES_CMAC_CTX ctx;
+  uint8_t digest[AES_CMAC_DIGEST_LENGTH];
+
+  AES_CMAC_Init(&ctx);
+  AES_CMAC_SetKey(&ctx, key);
+  if (b0 != NULL)
+    AES_CMAC_Update(&ctx, b0, 16);
+  AES_CMAC_Update(&ctx, buf, len);
+  AES_CMAC_Final(digest, &ctx);
+  memcpy(mic, digest, 4);
+}
+
+/* B0 (MIC) and Ai (encryption) blocks */
+static void
+ns_block(uint8_t b[16], uint8_t type, uint8_t dir, uint32_t fcnt,
+    uint8_t last)
+{
+  uint32_t addr = ns.config.dev_addr;
+
+  memset(b, 0, 16);
+  b[0] = type;
+  b[5] = dir;
+  b[6] = addr;
+  b[7] = addr >> 8;
+  b[8] = addr >> 16;
+  b[9] = addr >> 24;
+  b[10] = fcnt;
+  b[11] = fcnt >> 8;
+  b[12] = fcnt >> 16;
+  b[13] = fcnt >> 24;
+  b[15] = last;
+}
+
+static void
+ns_mic(uint8_t dir, uint32_t fcnt, const uint8_t *buf, uint8_t len,
+    uint8_t mic[4])
+{
+  uint8_t b0[16];
+
+  ns_block(b0, 0x49, dir, fcnt, len);
+  ns_cmac(ns.nwk_s_key, b0, buf, len, mic);
+}
+
+static void
+ns_crypt(const uint8_t *key, uint8_t dir, uint32_t fcnt, uint8_t *buf,
+    uint8_t len)
+{
+  uint8_t a[16], s[16];
+  uint8_t i;
+
+  for (i = 0; i < len; i++) {
+    if (i % 16 == 0) {
+      ns_block(a, 0x01, dir, fcnt, i / 16 + 1);
+      ns_aes(key, a, s);
+    }
+    buf[i] ^= s[i % 16];
+  }
+}
+
+/* SNR in 0.1 dB a gateway or the device sees at the given power */
+static int16_t
+ns_snr(int8_t power, uint32_t bandwidth)
+{
+  static const uint32_t bw[] = { 125000, 250000, 500000 };
+  double noise;
+
+  noise = -174 + 10 * log10(bw[bandwidth < 3 ? bandwidth : 0]) +
+      NS_NOISE_FIGURE;
+  return (int16_t)lround((power - ns.config.path_loss - noise) * 10) +
+      rand() % (2 * NS_FADING + 1) - NS_FADING;
+}
+
+/* Demodulation floor in 0.1 dB */
+static int16_t
+ns_floor(uint8_t sf)
+{
+  return -200 + 25 * (12 - sf);
+}
+
+static uint8_t
+ns_dr(const HostRadioFrame_t *f)
+{
+  if (f->Modem != MODEM_LORA)
+    return 7;
+  if (f->Bandwidth == 1)
+    return 6;
+  return 12 - f->Datarate;
+}
+
+/* Returns whether the command fits in the next downlink */
+static bool
+ns_cmd(const uint8_t *cmd, uint8_t len)
+{
+  if (ns.cmd_len + len > sizeof(ns.cmd))
+    return false;
+  memcpy(ns.cmd + ns.cmd_len, cmd, len);
+  ns.cmd_len += len;
+  return true;
+}
+
+static void
+ns_new_channels(void)
+{
+  uint8_t cmd[6];
+  uint8_t i;
+  uint32_t f;
+
+  for (i = 0; i < NS_CHANNELS; i++) {
+    if (ns.channels & (1 << i) || ns.channels_sent & (1 << i))
+      continue;
+    f = ns_channel_freq[i] / 100;
+    cmd[0] = NS_NEW_CHANNEL;
+    cmd[1] = i;
+    cmd[2] = f;
+    cmd[3] = f >> 8;
+    cmd[4] = f >> 16;
+    cmd[5] = 0x50;	/* DR0 to DR5 */
+    if (!ns_cmd(cmd, sizeof(cmd)))
+      break;
+    ns.channels_sent |= 1 << i;
+    ns.stats.new_channel++;
+  }
+}
+
+static void
+ns_session_reset(void)
+{
+  ns.have_up = false;
+  ns.fcnt_up = 0;
+  ns.fcnt_down = 0;
+  ns.cmd_len = 0;
+  ns.channels = NS_CHANNELS_DEFAULT;
+  ns.channels_sent = 0;
+  ns.link_adr_sent = false;
+  ns.snr_count = 0;
+  ns.snr_next = 0;
+  ns.stats.tx_power = 0;
+}
+
+/*
+ * Puts a downlink on the air in RX1 or RX2 of an uplink, returns the
+ * window or 0 if the device cannot hear it
+ */
+static uint8_t
+ns_send(const HostRadioFrame_t *up, uint32_t rx1_delay, const uint8_t *buf,
+    uint8_t len)
+{
+  HostRadioFrame_t f;
+  int16_t snr;
+  uint8_t rx;
+
+  memset(&f, 0, sizeof(f));
+  f.Modem = MODEM_LORA;
+  f.Coderate = 1;
+  f.PreambleLen = 8;
+  f.CrcOn = false;
+  f.IqInverted = true;
+  f.Time = up->Time + HostRadioFrameTimeOnAir(up) + rx1_delay;
+  if (rand() % 1000 < ns.config.rx2) {
+    f.Time += 1000000;
+    f.Frequency = NS_RX2_FREQ;
+    f.Bandwidth = 0;
+    f.Datarate = 12;
+    f.Power = NS_RX2_POWER;
+    rx = 2;
+  } else {
+    f.Frequency = up->Frequency;
+    f.Bandwidth = up->Bandwidth;
+    f.Datarate = up->Datarate;
+    f.Power = NS_RX1_POWER;
+    rx = 1;
+  }
+  snr = ns_snr(f.Power, f.Bandwidth);
+  if (snr < ns_floor(f.Datarate))
+    return 0;
+  f.Rssi = f.Power - ns.config.path_loss;
+  f.Snr = snr / 10;
+  f.Size = len;
+  memcpy(f.Payload, buf, len);
+  HostRadioDeliver(&f);
+  return rx;
+}
+
+static void
+ns_join(const HostRadioFrame_t *up)
+{
+  const uint8_t *req = up->Payload;
+  uint8_t mic[4], buf[17], block[16];
+  uint8_t i;
+
+  if (up->Size != 23)
+    return;
+  ns_cmac(ns.config.nwk_key, NULL, req, 19, mic);
+  if (memcmp(mic, req + 19, 4) != 0) {
+    ns.stats.mic_errors++;
+    return;
+  }
+  ns.stats.joins++;
+
+  /* JoinNonce | NetID | DevAddr | DLSettings | RxDelay */
+  ns.join_nonce++;
+  buf[0] = NS_JOIN_ACCEPT;
+  buf[1] = ns.join_nonce;
+  buf[2] = ns.join_nonce >> 8;
+  buf[3] = ns.join_nonce >> 16;
+  buf[4] = ns.config.net_id;
+  buf[5] = ns.config.net_id >> 8;
+  buf[6] = ns.config.net_id >> 16;
+  buf[7] = ns.config.dev_addr;
+  buf[8] = ns.config.dev_addr >> 8;
+  buf[9] = ns.config.dev_addr >> 16;
+  buf[10] = ns.config.dev_addr >> 24;
+  buf[11] = 0;			/* RX1DROffset 0, RX2 DR0 */
+  buf[12] = NS_RX1_DELAY / 1000000;
+  ns_cmac(ns.config.nwk_key, NULL, buf, 13, buf + 13);
+
+  /* NwkSKey and AppSKey from JoinNonce | NetID | DevNonce */
+  memset(block, 0, sizeof(block));
+  memcpy(block + 1, buf + 1, 6);
+  memcpy(block + 7, req + 17, 2);
+  block[0] = 0x01;
+  ns_aes(ns.config.nwk_key, block, ns.nwk_s_key);
+  block[0] = 0x02;
+  ns_aes(ns.config.nwk_key, block, ns.app_s_key);
+
+  /* The device encrypts to decrypt the join-accept */
+  {
+    aes_context ctx;
+
+    aes_set_key(ns.config.nwk_key, 16, &ctx);
+    aes_decrypt(buf + 1, block, &ctx);
+    for (i = 0; i < 16; i++)
+      buf[i + 1] = block[i];
+  }
+
+  ns.joined = true;
+  ns_session_reset();
+  ns_send(up, NS_JOIN_RX1_DELAY, buf, sizeof(buf));
+}
+
+static void
+ns_adr(uint8_t dr, bool force)
+{
+  int16_t max;
+  int nstep;
+  uint8_t power = ns.stats.tx_power;
+  uint8_t i;
+  uint8_t cmd[5];
+  uint16_t mask;
+
+  if (ns.link_adr_sent || (ns.snr_count < NS_ADR_HISTORY && !force) ||
+      ns.snr_count == 0 || dr > NS_ADR_DR_MAX)
+    return;
+  for (max = ns.snr[0], i = 1; i < ns.snr_count; i++)
+    if (ns.snr[i] > max)
+      max = ns.snr[i];
+  nstep = (int)floor((max - ns_floor(12 - dr) - NS_ADR_MARGIN * 10) / 30.0);
+  for (; nstep > 0; nstep--) {
+    if (dr < NS_ADR_DR_MAX)
+      dr++;
+    else if (power < NS_ADR_POWER_MAX)
+      power++;
+  }
+  for (; nstep < 0 && power > 0; nstep++)
+    power--;
+  if (dr == ns.stats.dr && power == ns.stats.tx_power && !force)
+    return;
+
+  mask = ns.channels;
+  cmd[0] = NS_LINK_ADR;
+  cmd[1] = dr << 4 | power;
+  cmd[2] = mask;
+  cmd[3] = mask >> 8;
+  cmd[4] = 0x01;	/* ChMaskCntl 0, NbTrans 1 */
+  ns_cmd(cmd, sizeof(cmd));
+  ns.link_adr_sent = true;
+  ns.link_adr_dr = dr;
+  ns.link_adr_power = power;
+  ns.stats.link_adr++;
+}
+
+/* Handles the MAC commands of an uplink, returns false on a malformed one */
+static bool
+ns_answers(const uint8_t *p, uint8_t len, const HostRadioFrame_t *up,
+    int16_t snr)
+{
+  uint8_t cmd[6];
+  uint8_t i = 0, ch;
+  uint64_t t;
+
+  while (i < len) {
+    switch (p[i++]) {
+    case NS_LINK_CHECK:
+      cmd[0] = NS_LINK_CHECK;
+      cmd[1] = (snr - ns_floor(up->Datarate)) / 10;
+      cmd[2] = 1;
+      ns_cmd(cmd, 3);
+      break;
+    case NS_LINK_ADR:
+      if (i + 1 > len)
+        return false;
+      if ((p[i] & 0x07) == 0x07 && ns.link_adr_sent) {
+        ns.stats.dr = ns.link_adr_dr;
+        ns.stats.tx_power = ns.link_adr_power;
+        ns.stats.link_adr_ok++;
+        ns.stats.adr_uplinks = ns.stats.unique;
+        ns.stats.adr_time = HostGetTime();
+        ns.snr_count = 0;
+        ns.snr_next = 0;
+      }
+      ns.link_adr_sent = false;
+      i += 1;
+      break;
+    case NS_DEV_STATUS:
+      if (i + 2 > len)
+        return false;
+      ns.stats.dev_status_ans++;
+      i += 2;
+      break;
+    case NS_NEW_CHANNEL:
+      if (i + 1 > len)
+        return false;
+      /* Answers come in the order of the requests */
+      for (ch = 0; ch < NS_CHANNELS; ch++)
+        if (ns.channels_sent & (1 << ch))
+          break;
+      if (ch < NS_CHANNELS) {
+        ns.channels_sent &= ~(1 << ch);
+        if ((p[i] & 0x03) == 0x03) {
+          ns.channels |= 1 << ch;
+          ns.stats.new_channel_ok++;
+        }
+      }
+      i += 1;
+      break;
+    case NS_DEVICE_TIME:
+      /* Seconds and 1/256 s since the start of the simulation */
+      t = up->Time + HostRadioFrameTimeOnAir(up);
+      cmd[0] = NS_DEVICE_TIME;
+      cmd[1] = t / 1000000;
+      cmd[2] = t / 1000000 >> 8;
+      cmd[3] = t / 1000000 >> 16;
+      cmd[4] = t / 1000000 >> 24;
+      cmd[5] = t % 1000000 * 256 / 1000000;
+      ns_cmd(cmd, 6);
+      break;
+    case NS_RX_PARAM_SETUP:
+    case NS_DL_CHANNEL:
+      i += 1;
+      break;
+    case NS_DUTY_CYCLE:
+    case NS_RX_TIMING_SETUP:
+    case NS_TX_PARAM_SETUP:
+      break;
+    default:
+      return false;
+    }
+  }
+  return i == len;
+}
+
+/* The host sends payloads of bytes counting up from the payload number */
+static void
+ns_frag(const uint8_t *payload, uint8_t len)
+{
+  int n, i;
+
+  if ((n = frag_decode(&ns.frag, payload, len)) <= 0)
+    return;
+  ns.stats.frag_payloads++;
+  ns.stats.frag_rebuilt += ns.frag.recovered;
+  for (i = 1; i < n; i++) {
+    if (ns.frag.data[i] != (uint8_t)(ns.frag.data[0] + i)) {
+      ns.stats.frag_corrupt++;
+      break;
+    }
+  }
+}
+
+static void
+ns_data(const HostRadioFrame_t *up, int16_t snr)
+{
+  const uint8_t *p = up->Payload;
+  uint8_t len = up->Size;
+  uint8_t fctrl, fopts_len, port = 0, plen = 0;
+  uint8_t buf[64], mic[4], payload[255];
+  uint8_t n, dl_fctrl, fopts;
+  uint32_t addr, fcnt;
+  bool dup;
+
+  if (len < 12 || !ns.joined)
+    return;
+  addr = p[1] | p[2] << 8 | p[3] << 16 | (uint32_t)p[4] << 24;
+  if (addr != ns.config.dev_addr)
+    return;
+  fctrl = p[5];
+  fopts_len = fctrl & NS_FCTRL_FOPTSLEN;
+  if (8 + fopts_len + 4 > len)
+    return;
+
+  /* Extend the 16 bit FCnt to the one closest above the last */
+  fcnt = (ns.fcnt_up & 0xffff0000) | p[6] | p[7] << 8;
+  if (ns.have_up && fcnt < ns.fcnt_up)
+    fcnt += 0x10000;
+  ns_mic(0, fcnt, p, len - 4, mic);
+  if (memcmp(mic, p + len - 4, 4) != 0) {
+    ns.stats.mic_errors++;
+    return;
+  }
+  ns.stats.uplinks++;
+  dup = ns.have_up && fcnt == ns.fcnt_up;
+  if (!dup) {
+    if (ns.have_up)
+      ns.stats.lost += fcnt - ns.fcnt_up - 1;
+    ns.stats.unique++;
+  }
+  ns.have_up = true;
+  ns.fcnt_up = fcnt;
+
+  if (8 + fopts_len + 4 < len) {
+    port = p[8 + fopts_len];
+    plen = len - 8 - fopts_len - 1 - 4;
+    memcpy(payload, p + 8 + fopts_len + 1, plen);
+    ns_crypt(port == 0 ? ns.nwk_s_key : ns.app_s_key, 0, fcnt, payload,
+        plen);
+  }
+
+  if (!dup) {
+    ns.stats.dr = ns_dr(up);
+    ns.snr[ns.snr_next] = snr;
+    ns.snr_next = (ns.snr_next + 1) % NS_ADR_HISTORY;
+    if (ns.snr_count < NS_ADR_HISTORY)
+      ns.snr_count++;
+
+    /* Requests the device did not answer are sent again */
+    ns.cmd_len = 0;
+    ns_answers(p + 8, fopts_len, up, snr);
+    if (port == 0 && plen > 0)
+      ns_answers(payload, plen, up, snr);
+    if (port == FRAG_PORT && plen > 0)
+      ns_frag(payload, plen);
+    ns.link_adr_sent = false;
+    ns.channels_sent = 0;
+    ns_new_channels();
+    if (fctrl & NS_FCTRL_ADR)
+      ns_adr(ns.stats.dr, fctrl & NS_FCTRL_ADRACKREQ);
+    if (ns.config.status_period > 0 &&
+        ns.stats.unique % ns.config.status_period == 0) {
+      buf[0] = NS_DEV_STATUS;
+      ns_cmd(buf, 1);
+      ns.stats.dev_status++;
+    }
+    if (ns.config.dl_period > 0 &&
+        ns.stats.unique % ns.config.dl_period == 0) {
+      ns.app_queued += ns.config.dl_count;
+      ns.stats.app_queued += ns.config.dl_count;
+    }
+  }
+
+  if ((p[0] & 0xe0) != NS_CONFIRMED_UP && ns.cmd_len == 0 &&
+      ns.app_queued == 0 && !(fctrl & NS_FCTRL_ADRACKREQ))
+    return;
+
+  /* MHDR | DevAddr | FCtrl | FCnt | FOpts | FPort | FRMPayload | MIC */
+  dl_fctrl = NS_FCTRL_ADR;
+  if ((p[0] & 0xe0) == NS_CONFIRMED_UP) {
+    dl_fctrl |= NS_FCTRL_ACK;
+    ns.stats.acks++;
+  }
+  fopts = ns.cmd_len <= NS_FOPTS_MAX ? ns.cmd_len : 0;
+  buf[0] = NS_UNCONFIRMED_DOWN;
+  memcpy(buf + 1, p + 1, 4);
+  buf[6] = ns.fcnt_down;
+  buf[7] = ns.fcnt_down >> 8;
+  memcpy(buf + 8, ns.cmd, fopts);
+  n = 8 + fopts;
+  if (ns.cmd_len > NS_FOPTS_MAX) {
+    /* Too many commands for FOpts, send them on port 0 */
+    buf[n++] = 0;
+    memcpy(buf + n, ns.cmd, ns.cmd_len);
+    ns_crypt(ns.nwk_s_key, 1, ns.fcnt_down, buf + n, ns.cmd_len);
+    n += ns.cmd_len;
+  } else if (ns.app_queued > 0) {
+    buf[n++] = NS_APP_PORT;
+    buf[n++] = ns.app_seq;
+    buf[n++] = ns.app_seq >> 8;
+    buf[n++] = ns.app_seq >> 16;
+    buf[n++] = ns.app_seq >> 24;
+    ns_crypt(ns.app_s_key, 1, ns.fcnt_down, buf + n - 4, 4);
+    ns.app_seq++;
+    ns.app_queued--;
+    ns.stats.app_sent++;
+  }
+  ns.cmd_len = 0;
+  if (ns.app_queued > 0) {
+    dl_fctrl |= NS_FCTRL_FPENDING;
+    ns.stats.pending++;
+  }
+  buf[5] = dl_fctrl | fopts;
+  ns_mic(1, ns.fcnt_down, buf, n, buf + n);
+  n += 4;
+  ns.fcnt_down++;
+  switch (ns_send(up, NS_RX1_DELAY, buf, n)) {
+  case 0:
+    ns.stats.faded++;
+    break;
+  case 1:
+    ns.stats.rx1++;
+    break;
+  case 2:
+    ns.stats.rx2++;
+    break;
+  }
+}
+
+static void
+ns_uplink(const HostRadioFrame_t *up)
+{
+  int16_t snr;
+
+  snr = ns_snr(up->Power, up->Bandwidth);
+  if (up->Modem == MODEM_LORA && snr < ns_floor(up->Datarate)) {
+    ns.stats.missed++;
+    return;
+  }
+  if (up->Size < 1)
+    return;
+  switch (up->Payload[0] & 0xe0) {
+  case NS_JOIN_REQUEST:
+    ns_join(up);
+    break;
+  case NS_UNCONFIRMED_UP:
+  case NS_CONFIRMED_UP:
+    ns_data(up, snr);
+    break;
+  }
+}
+
+void
+ns_init(const struct ns_config *config)
+{
+  memset(&ns, 0, sizeof(ns));
+  ns.config = *config;
+  if (config->abp) {
+    memcpy(ns.nwk_s_key, config->nwk_key, sizeof(ns.nwk_s_key));
+    memcpy(ns.app_s_key, config->app_key, sizeof(ns.app_s_key));
+    ns.joined = true;
+    ns_session_reset();
+  }
+  HostRadioSetTxHandler(ns_uplink);
+}
+
+const struct ns_stats *
+ns_get_stats(void)
+{
+  return &ns.stats;
+}
@@ -0,0 +1,52 @@
+#ifndef __NS_H__
+#define __NS_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct ns_config {
+  const uint8_t	*nwk_key;
+  const uint8_t	*app_key;	/* ABP AppSKey */
+  uint32_t	net_id;
+  uint32_t	dev_addr;
+  bool		abp;		/* session keys are nwk_key and app_key */
+  uint8_t	path_loss;	/* dB, both ways */
+  uint16_t	rx2;		/* permille of downlinks sent in RX2 */
+  uint32_t	dl_period;	/* queue downlinks every dl_period uplinks */
+  uint8_t	dl_count;	/* downlinks queued each time */
+  uint32_t	status_period;	/* DevStatusReq every status_period uplinks */
+};
+
+struct ns_stats {
+  uint32_t	joins;
+  uint32_t	uplinks;	/* uplinks with a valid MIC, repetitions too */
+  uint32_t	unique;		/* different uplinks */
+  uint32_t	missed;		/* uplinks below the demodulation floor */
+  uint32_t	mic_errors;
+  uint32_t	lost;		/* gaps in FCntUp */
+  uint32_t	rx1;		/* data downlinks sent in RX1 */
+  uint32_t	rx2;		/* data downlinks sent in RX2 */
+  uint32_t	faded;		/* data downlinks below the demodulation floor */
+  uint32_t	acks;
+  uint32_t	pending;	/* downlinks sent with FPending */
+  uint32_t	app_queued;
+  uint32_t	app_sent;
+  uint32_t	link_adr;	/* LinkADRReq sent */
+  uint32_t	link_adr_ok;	/* LinkADRAns accepting all changes */
+  uint32_t	dev_status;	/* DevStatusReq sent */
+  uint32_t	dev_status_ans;
+  uint32_t	new_channel;	/* NewChannelReq sent */
+  uint32_t	new_channel_ok;
+  uint8_t	dr;		/* data rate assigned by ADR */
+  uint8_t	tx_power;	/* TX power index assigned by ADR */
+  uint32_t	adr_uplinks;	/* uplinks until the last accepted change */
+  uint64_t	adr_time;	/* virtual time of the last accepted change */
+  uint32_t	frag_payloads;	/* payloads reassembled from fragments */
+  uint32_t	frag_rebuilt;	/* fragments rebuilt from parity */
+  uint32_t	frag_corrupt;	/* reassembled payloads not as sent */
+};
+
+void	ns_init(const struct ns_config *config);
+const struct ns_stats *ns_get_stats(void);
+
+#endif /* __NS_H__ */
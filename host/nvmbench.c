@@ -0,0 +1,291 @@
+/*
+ * The LoRaMac context journal of lora/nvmctx.c under power cuts, over a
+ * mock of the SDK flash storage.
+ *
+ * Each commit changes the frame counter and a few other bytes, now and
+ * then all contexts as on a join. A power cut stops a flash write and
+ * leaves a random byte behind; the contexts restored on the next boot
+ * must then be those of the commit before or of the commit cut, never a
+ * mix, and a reboot without a cut must restore the last commit.
+ */
+
+#include <setjmp.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* The statics of nvmctx.c are reset on each simulated reboot */
+#define printf(...)	((void)0)	/* the DEBUG output of nvmctx.c */
+#include "lora/nvmctx.c"
+#undef printf
+
+#define BENCH_COMMITS		200000
+#define BENCH_CUT		4	/* a power cut in one of this many commits */
+#define BENCH_JOIN		256	/* all contexts change, as on a join */
+#define BENCH_REBOOT		64	/* a reboot without a cut */
+#define FLASH_SIZE		(8 * 1024)
+
+/* Contexts of about the size of the EU868 ones, class B unused */
+static uint8_t	mac_ctx[520], region_ctx[400], crypto_ctx[64],
+		se_ctx[470], commands_ctx[24], queue_ctx[20];
+
+static LoRaMacCtxs_t	bench_ctxs = {
+	.MacNvmCtx = mac_ctx,
+	.MacNvmCtxSize = sizeof(mac_ctx),
+	.RegionNvmCtx = region_ctx,
+	.RegionNvmCtxSize = sizeof(region_ctx),
+	.CryptoNvmCtx = crypto_ctx,
+	.CryptoNvmCtxSize = sizeof(crypto_ctx),
+	.SecureElementNvmCtx = se_ctx,
+	.SecureElementNvmCtxSize = sizeof(se_ctx),
+	.CommandsNvmCtx = commands_ctx,
+	.CommandsNvmCtxSize = sizeof(commands_ctx),
+	.ConfirmQueueNvmCtx = queue_ctx,
+	.ConfirmQueueNvmCtxSize = sizeof(queue_ctx),
+};
+
+/* The flash of the generic partition, erased */
+static uint8_t		flash[FLASH_SIZE];
+static long		cut = -1;	/* bytes written until the cut */
+static jmp_buf		power_loss;
+
+static struct {
+	unsigned long	commits;
+	unsigned long	compactions;
+	unsigned long	cuts;
+	unsigned long	old;		/* restored without the cut commit */
+	unsigned long	new;		/* restored with it */
+	unsigned long	reboots;
+	unsigned long	bytes;
+} st;
+
+nvms_t
+ad_nvms_open(nvms_partition_id_t id)
+{
+	(void)id;
+	return (nvms_t)flash;
+}
+
+size_t
+ad_nvms_get_size(nvms_t handle)
+{
+	(void)handle;
+	return sizeof(flash);
+}
+
+int
+ad_nvms_read(nvms_t handle, uint32_t addr, uint8_t *buf, uint32_t len)
+{
+	(void)handle;
+	if (addr + len > sizeof(flash))
+		abort();
+	memcpy(buf, flash + addr, len);
+	return len;
+}
+
+/* A power cut stops the write after cut bytes and tears the next one */
+int
+ad_nvms_write(nvms_t handle, uint32_t addr, const uint8_t *buf,
+    uint32_t size)
+{
+	(void)handle;
+	if (addr + size > sizeof(flash))
+		abort();
+	if (cut >= 0 && size > cut) {
+		memcpy(flash + addr, buf, cut);
+		flash[addr + cut] = random();
+		cut = -1;
+		longjmp(power_loss, 1);
+	}
+	memcpy(flash + addr, buf, size);
+	if (cut >= 0)
+		cut -= size;
+	st.bytes += size;
+	if (addr == slot_off(0) || addr == slot_off(1))
+		st.compactions++;
+	return size;
+}
+
+LoRaMacStatus_t
+LoRaMacMibGetRequestConfirm(MibRequestConfirm_t *mibGet)
+{
+	mibGet->Param.Contexts = &bench_ctxs;
+	return LORAMAC_STATUS_OK;
+}
+
+LoRaMacStatus_t
+LoRaMacMibSetRequestConfirm(MibRequestConfirm_t *mibSet)
+{
+	(void)mibSet;
+	return LORAMAC_STATUS_OK;
+}
+
+uint8_t *
+param_get_addr(int idx)
+{
+	static uint8_t	param[PARAM_MAX_LEN];
+
+	(void)idx;
+	return param;
+}
+
+void
+lora_task_notify_event(uint32_t event, void *cb)
+{
+	(void)event;
+	(void)cb;
+}
+
+static void
+scramble(uint8_t *p, size_t len)
+{
+	while (len--)
+		*p++ = random();
+}
+
+/* The contexts, saved and compared */
+static void
+save(uint8_t *buf)
+{
+	int	i;
+
+	for (i = 0; i < NVMCTX_MODULES; i++)
+		if (mods[i].len != 0)
+			memcpy(buf + mods[i].offset, mods[i].mem, mods[i].len);
+}
+
+static bool
+same(const uint8_t *buf)
+{
+	int	i;
+
+	for (i = 0; i < NVMCTX_MODULES; i++)
+		if (mods[i].len != 0 &&
+		    memcmp(buf + mods[i].offset, mods[i].mem, mods[i].len) != 0)
+			return false;
+	return true;
+}
+
+/* RAM is lost, the flash stays */
+static bool
+reboot(void)
+{
+	int	i;
+
+	free(shadow);
+	shadow = NULL;
+	ctxs = NULL;
+	disabled = false;
+	dirty = 0;
+	for (i = 0; i < NVMCTX_MODULES; i++)
+		if (mods[i].mem != NULL)
+			scramble(mods[i].mem, mods[i].len);
+	memset(mods, 0, sizeof(mods));
+	memset(&hdr, 0, sizeof(hdr));
+	return nvmctx_restore();
+}
+
+/*
+ * The changes of an uplink: the frame counter, a few bytes of the other
+ * contexts, and now and then all of them.
+ */
+static void
+change(void)
+{
+	uint32_t	fcnt;
+	int		i, n, m;
+
+	memcpy(&fcnt, crypto_ctx, sizeof(fcnt));
+	fcnt++;
+	memcpy(crypto_ctx, &fcnt, sizeof(fcnt));
+	nvmctx_changed(LORAMAC_NVMCTXMODULE_CRYPTO);
+	if (random() % BENCH_JOIN == 0) {
+		for (i = 0; i < NVMCTX_MODULES; i++) {
+			if (mods[i].len == 0)
+				continue;
+			scramble(mods[i].mem, mods[i].len);
+			nvmctx_changed(i);
+		}
+		return;
+	}
+	for (n = random() % 3; n > 0; n--) {
+		do
+			i = random() % NVMCTX_MODULES;
+		while (mods[i].len == 0);
+		for (m = 1 + random() % 8; m > 0; m--)
+			mods[i].mem[random() % mods[i].len] = random();
+		nvmctx_changed(i);
+	}
+}
+
+int
+main(void)
+{
+	static uint8_t	old[FLASH_SIZE], new[FLASH_SIZE];
+	volatile int	i;
+
+	srandom(1);
+	memset(flash, 0xff, sizeof(flash));
+	if (reboot()) {
+		fprintf(stderr, "nvmbench: restored from erased flash\n");
+		return 1;
+	}
+	for (i = 0; i < NVMCTX_MODULES; i++)
+		if (mods[i].len != 0) {
+			scramble(mods[i].mem, mods[i].len);
+			nvmctx_changed(i);
+		}
+	nvmctx_commit();
+	save(old);
+
+	for (i = 0; i < BENCH_COMMITS; i++) {
+		change();
+		save(new);
+		if (random() % BENCH_CUT == 0) {
+			/* Most commits write a few dozen bytes */
+			cut = random() % (random() % 8 == 0 ? ctx_len : 64);
+		}
+		if (setjmp(power_loss) == 0) {
+			nvmctx_commit();
+			cut = -1;
+			st.commits++;
+			memcpy(old, new, ctx_len);
+			if (random() % BENCH_REBOOT != 0)
+				continue;
+			st.reboots++;
+			if (!reboot() || !same(old)) {
+				fprintf(stderr, "nvmbench: commit %d lost on "
+				    "a reboot\n", i);
+				return 1;
+			}
+			continue;
+		}
+		st.cuts++;
+		if (!reboot()) {
+			fprintf(stderr, "nvmbench: no context after the "
+			    "power cut in commit %d\n", i);
+			return 1;
+		}
+		if (same(new)) {
+			st.new++;
+			memcpy(old, new, ctx_len);
+		} else if (same(old)) {
+			st.old++;
+		} else {
+			fprintf(stderr, "nvmbench: power cut in commit %d "
+			    "restored a mix of two commits\n", i);
+			return 1;
+		}
+	}
+	printf("%u context bytes, %d byte journal\n", ctx_len,
+	    NVMCTX_JOURNAL_LEN);
+	printf("%lu commits, %lu compactions, %.1f bytes written per "
+	    "commit\n", st.commits, st.compactions,
+	    (double)st.bytes / st.commits);
+	printf("%lu power cuts: %lu restored the commit before, %lu the "
+	    "commit cut\n", st.cuts, st.old, st.new);
+	printf("%lu reboots restored the last commit\n", st.reboots);
+	return 0;
+}
@@ -0,0 +1,22 @@
+/* The NVMS adapter of the Dialog SDK, over a flash image of the bench */
+
+#ifndef __HOST_AD_NVMS_H__
+#define __HOST_AD_NVMS_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+	NVMS_GENERIC_PART,
+} nvms_partition_id_t;
+
+typedef struct nvms	*nvms_t;
+
+nvms_t	ad_nvms_open(nvms_partition_id_t id);
+size_t	ad_nvms_get_size(nvms_t handle);
+int	ad_nvms_read(nvms_t handle, uint32_t addr, uint8_t *buf,
+	    uint32_t len);
+int	ad_nvms_write(nvms_t handle, uint32_t addr, const uint8_t *buf,
+	    uint32_t size);
+
+#endif /* __HOST_AD_NVMS_H__ */
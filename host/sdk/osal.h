@@ -0,0 +1,30 @@
+/* The OS abstraction of the Dialog SDK, as far as host benches use it */
+
+#ifndef __HOST_OSAL_H__
+#define __HOST_OSAL_H__
+
+#include <assert.h>
+#include <stdlib.h>
+
+#define PRIVILEGED_DATA
+
+typedef void			*OS_TIMER;
+typedef void			*OS_TASK;
+typedef unsigned long		TickType_t;
+
+#define OS_TIMER_FOREVER	0
+#define OS_TIMER_FAIL		0
+#define OS_MS_2_TICKS(ms)	(ms)
+#define OS_ASSERT(x)		assert(x)
+#define OS_MALLOC(size)		malloc(size)
+#define OS_FREE(p)		free(p)
+#define OS_GET_TICK_COUNT()	0
+#define OS_GET_CURRENT_TASK()	NULL
+
+/* No timer ever runs: the benches call the deferred work themselves */
+#define OS_TIMER_CREATE(name, period, reload, id, cb)	((void)(cb), NULL)
+#define OS_TIMER_START(timer, timeout)			((void)0)
+#define OS_TIMER_STOP(timer, timeout)			((void)0)
+#define OS_TIMER_IS_ACTIVE(timer)			0
+
+#endif /* __HOST_OSAL_H__ */
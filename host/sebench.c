@@ -0,0 +1,484 @@
+/*
+ * The soft secure element: AES, CMAC, uplink encryption and key schedule
+ * cache, built once with each AES backend.
+ *
+ * Checks that the initialization clears the zero key and no other, AES
+ * against the FIPS-197 test vector and the CMAC against the RFC 4493
+ * ones: with the subkeys derived on each CMAC, with precomputed subkeys,
+ * and through the secure element for a derived session key (subkeys
+ * precomputed on the derivation) and a set one (subkeys computed on the
+ * first MIC). Then secures random uplinks with the single pass payload
+ * encryption and MIC of LoRaMacCrypto.c and with the former encryption,
+ * serialization and MIC, which must give bit exact frames.
+ *
+ * Prints the time per byte of AES and CMAC, in time stamp counter cycles
+ * on x86, the RAM of the key schedule cache and the time of the uplink
+ * encryption and MIC with and without it, which must give the same MICs.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+/* The statics of the secure element and the crypto are measured and checked */
+#include "lora/system/soft-se/soft-se.c"
+#define DummyCB		CryptoDummyCB
+#include "lora/mac/LoRaMacCrypto.c"
+#undef DummyCB
+
+#define BENCH_UPLINKS		200000
+#define BENCH_BLOCKS		1000000	/* to time one AES block */
+#define BENCH_PAYLOAD		16	/* bytes, one AES block */
+#define BENCH_FRAME		(13 + BENCH_PAYLOAD)	/* MHDR to FPort, MIC */
+#define BENCH_BYTES		(16 * 1024 * 1024)	/* per throughput run */
+#define BENCH_BUF		256
+#define COMPARE_FRAMES		20000
+#define COMPARE_KEYS		16	/* new keys once in this many frames */
+#define COMPARE_BUF		255	/* the largest BufSize */
+
+/* FIPS-197 appendix C.1 AES-128 test vector */
+static const char	fips197_key[] = "000102030405060708090a0b0c0d0e0f";
+static const char	fips197_pt[] = "00112233445566778899aabbccddeeff";
+static const char	fips197_ct[] = "69c4e0d86a7b0430d8cdb78070b4c55a";
+
+static uint32_t
+bench_random(void)
+{
+	return random();
+}
+
+const struct Radio_s Radio = {
+	.Random = bench_random,
+};
+
+/* RFC 4493 AES-CMAC test vectors */
+static const char	rfc4493_key[] = "2b7e151628aed2a6abf7158809cf4f3c";
+static const char	rfc4493_k1[] = "fbeed618357133667c85e08f7236a8de";
+static const char	rfc4493_k2[] = "f7ddac306ae266ccf90bc11ee46d513b";
+static const char	rfc4493_msg[] =
+	"6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51"
+	"30c81c46a35ce411e5fbc1191a0a52eff69f2445df4f9b17ad2b417be66c3710";
+static const struct {
+	int		len;
+	const char	*mac;
+} rfc4493[] = {
+	{ 0, "bb1d6929e95937287fa37d129b756746" },
+	{ 16, "070a16b46b4d4144f79bdd9dd04a287c" },
+	{ 40, "dfa66747de9ae63030ca32611497c827" },
+	{ 64, "51f0bebf7e3b9d92fc49741779363cfe" },
+};
+
+static void
+unhex(const char *hex, uint8_t *buf)
+{
+	unsigned int	b;
+
+	for (; hex[0] != '\0'; hex += 2) {
+		sscanf(hex, "%2x", &b);
+		*buf++ = b;
+	}
+}
+
+static double
+now(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Time stamp counter, 0 where there is none */
+static uint64_t
+cycles(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+static void
+set_keys(void)
+{
+	static const KeyIdentifier_t	ids[] = {
+		NWK_S_ENC_KEY, F_NWK_S_INT_KEY, S_NWK_S_INT_KEY, APP_S_KEY,
+	};
+	uint8_t				key[16];
+	unsigned int			i, j;
+
+	for (i = 0; i < sizeof(ids) / sizeof(ids[0]); i++) {
+		for (j = 0; j < sizeof(key); j++)
+			key[j] = random();
+		SecureElementSetKey(ids[i], key);
+	}
+}
+
+/*
+ * The secure element work of a LoRaWAN 1.0 uplink: the payload encryption
+ * with the AppSKey and the MIC with the FNwkSIntKey. Without the cache the
+ * schedules are dropped before each call, as the keys were expanded on
+ * every call before.
+ */
+static double
+bench_uplinks(bool cached, uint32_t *mics)
+{
+	uint8_t		b0[16], frame[BENCH_FRAME], a[16], s[16];
+	uint32_t	mic = 0;
+	double		start;
+	int		i;
+
+	memset(b0, 0x49, sizeof(b0));
+	memset(frame, 0x40, sizeof(frame));
+	memset(a, 0x01, sizeof(a));
+	*mics = 0;
+	start = now();
+	for (i = 0; i < BENCH_UPLINKS; i++) {
+		frame[6] = b0[10] = a[10] = i;	/* FCnt */
+		if (!cached)
+			InvalidateKeySchedule(NO_KEY);
+		SecureElementAesEncrypt(a, 16, APP_S_KEY, s);
+		frame[9] ^= s[0];
+		if (!cached)
+			InvalidateKeySchedule(NO_KEY);
+		SecureElementComputeAesCmac(b0, frame, BENCH_FRAME - 4,
+		    F_NWK_S_INT_KEY, &mic);
+		*mics += mic;
+	}
+	return (now() - start) * 1e9 / BENCH_UPLINKS;
+}
+
+/* Nanoseconds of a key expansion and of an AES block */
+static void
+bench_aes(double *expand, double *block)
+{
+	aes_context	ctx;
+	uint8_t		key[16] = { 0 }, buf[16] = { 0 };
+	double		start;
+	int		i;
+
+	start = now();
+	for (i = 0; i < BENCH_BLOCKS; i++) {
+		key[0] = i;
+		aes_set_key(key, 16, &ctx);
+	}
+	*expand = (now() - start) * 1e9 / BENCH_BLOCKS;
+	start = now();
+	for (i = 0; i < BENCH_BLOCKS; i++)
+		aes_encrypt(buf, buf, &ctx);
+	*block = (now() - start) * 1e9 / BENCH_BLOCKS;
+}
+
+/* SecureElementInit() clears the zero key and leaves the other keys alone */
+static int
+init(void)
+{
+	Key_t	*zero, *key;
+	int	 i;
+
+	memset(&SeNvmCtx, 0xff, sizeof(SeNvmCtx));
+	SecureElementInit(NULL);
+	if (GetKeyByID(SLOT_RAND_ZERO_KEY, &zero) != SECURE_ELEMENT_SUCCESS) {
+		fprintf(stderr, "sebench: no zero key\n");
+		return 1;
+	}
+	for (key = SeNvmCtx.KeyList; key < SeNvmCtx.KeyList + NUM_OF_KEYS;
+	    key++)
+		for (i = 0; i < KEY_SIZE; i++)
+			if (key->KeyValue[i] != (key == zero ? 0 : 0xff)) {
+				fprintf(stderr, "sebench: key %d %s by "
+				    "SecureElementInit()\n", key->KeyID,
+				    key == zero ? "not cleared" : "changed");
+				return 1;
+			}
+	return 0;
+}
+
+static int
+aes_kat(void)
+{
+	aes_context	ctx;
+	uint8_t		key[16], pt[16], ct[16], buf[16];
+
+	unhex(fips197_key, key);
+	unhex(fips197_pt, pt);
+	unhex(fips197_ct, ct);
+	aes_set_key(key, 16, &ctx);
+	aes_encrypt(pt, buf, &ctx);
+	if (memcmp(buf, ct, 16) != 0) {
+		fprintf(stderr, "sebench: aes_encrypt() fails FIPS-197\n");
+		return 1;
+	}
+	aes_decrypt(ct, buf, &ctx);
+	if (memcmp(buf, pt, 16) != 0) {
+		fprintf(stderr, "sebench: aes_decrypt() fails FIPS-197\n");
+		return 1;
+	}
+	return 0;
+}
+
+static int
+cmac_kat(const char *what, int len, const uint8_t *mac, size_t n,
+    const char *want)
+{
+	uint8_t	buf[16];
+
+	unhex(want, buf);
+	if (memcmp(mac, buf, n) == 0)
+		return 0;
+	fprintf(stderr, "sebench: %s of %d bytes fails RFC 4493\n", what, len);
+	return 1;
+}
+
+/*
+ * The CMAC of the frame MIC: AES_CMAC_Final(), AES_CMAC_FinalSubkeys() and
+ * the secure element with subkeys precomputed on the key derivation, as
+ * for OTAA, and computed on the first use of a key that was set, as for
+ * ABP. The secure element returns the first 4 bytes of the CMAC.
+ */
+static int
+kats(void)
+{
+	static const Version_t	v11 = { .Fields.Minor = 1 };
+	AES_CMAC_CTX		ctx;
+	aes_context		aes;
+	CmacSubkeys_t		*subkeys;
+	uint8_t			key[16], k1[16], k2[16], msg[64], mac[16];
+	uint8_t			root[16], input[16];
+	uint32_t		mic = 0;
+	unsigned int		i, j;
+	int			err = 0;
+
+	unhex(rfc4493_key, key);
+	unhex(rfc4493_msg, msg);
+	AES_CMAC_Init(&ctx);
+	AES_CMAC_SetKey(&ctx, key);
+	AES_CMAC_Subkeys(&ctx, k1, k2);
+	err |= cmac_kat("K1", 0, k1, 16, rfc4493_k1);
+	err |= cmac_kat("K2", 0, k2, 16, rfc4493_k2);
+
+	/* The session key derived from the root key is the RFC 4493 key */
+	SecureElementInit(NULL);
+	memset(root, 0x5a, sizeof(root));
+	SecureElementSetKey(NWK_KEY, root);
+	aes_set_key(root, 16, &aes);
+	aes_decrypt(key, input, &aes);
+	SecureElementDeriveAndStoreKey(v11, input, NWK_KEY, F_NWK_S_INT_KEY);
+	SecureElementSetKey(S_NWK_S_INT_KEY, key);
+	subkeys = GetCmacSubkeys(F_NWK_S_INT_KEY);
+	if (!subkeys->IsValid) {
+		fprintf(stderr, "sebench: no subkeys after the key "
+		    "derivation\n");
+		return 1;
+	}
+	err |= cmac_kat("derived K1", 0, subkeys->K1, 16, rfc4493_k1);
+	err |= cmac_kat("derived K2", 0, subkeys->K2, 16, rfc4493_k2);
+
+	for (i = 0; i < sizeof(rfc4493) / sizeof(rfc4493[0]); i++) {
+		AES_CMAC_Init(&ctx);
+		AES_CMAC_Update(&ctx, msg, rfc4493[i].len);
+		AES_CMAC_Final(mac, &ctx);
+		err |= cmac_kat("AES_CMAC_Final", rfc4493[i].len, mac, 16,
+		    rfc4493[i].mac);
+
+		AES_CMAC_Init(&ctx);
+		AES_CMAC_Update(&ctx, msg, rfc4493[i].len);
+		AES_CMAC_FinalSubkeys(mac, &ctx, k1, k2);
+		err |= cmac_kat("AES_CMAC_FinalSubkeys", rfc4493[i].len, mac,
+		    16, rfc4493[i].mac);
+
+		SecureElementComputeAesCmac(NULL, msg, rfc4493[i].len,
+		    F_NWK_S_INT_KEY, &mic);
+		for (j = 0; j < 4; j++)
+			mac[j] = mic >> (8 * j);
+		err |= cmac_kat("derived key MIC", rfc4493[i].len, mac, 4,
+		    rfc4493[i].mac);
+
+		SecureElementComputeAesCmac(NULL, msg, rfc4493[i].len,
+		    S_NWK_S_INT_KEY, &mic);
+		for (j = 0; j < 4; j++)
+			mac[j] = mic >> (8 * j);
+		err |= cmac_kat("set key MIC", rfc4493[i].len, mac, 4,
+		    rfc4493[i].mac);
+	}
+	if (!GetCmacSubkeys(S_NWK_S_INT_KEY)->IsValid) {
+		fprintf(stderr, "sebench: no subkeys after the first MIC\n");
+		return 1;
+	}
+	return err;
+}
+
+/* AES and CMAC per byte, in nanoseconds and time stamp counter cycles */
+static void
+throughput(void)
+{
+	AES_CMAC_CTX	ctx;
+	uint8_t		key[16] = { 0 }, buf[BENCH_BUF] = { 0 }, mac[16];
+	uint64_t	c;
+	double		t;
+	int		done, i;
+
+	AES_CMAC_Init(&ctx);
+	AES_CMAC_SetKey(&ctx, key);
+	t = now();
+	c = cycles();
+	for (done = 0; done < BENCH_BYTES; done += BENCH_BUF)
+		for (i = 0; i < BENCH_BUF; i += 16)
+			aes_encrypt(buf + i, buf + i, &ctx.rijndael);
+	c = cycles() - c;
+	t = now() - t;
+	printf("  AES  %6.2f ns per byte", t * 1e9 / BENCH_BYTES);
+	if (c != 0)
+		printf(", %6.2f cycles per byte", (double)c / BENCH_BYTES);
+	printf("\n");
+
+	t = now();
+	c = cycles();
+	for (done = 0; done < BENCH_BYTES; done += BENCH_BUF) {
+		AES_CMAC_Init(&ctx);
+		AES_CMAC_Update(&ctx, buf, BENCH_BUF);
+		AES_CMAC_Final(mac, &ctx);
+		buf[0] = mac[0];
+	}
+	c = cycles() - c;
+	t = now() - t;
+	printf("  CMAC %6.2f ns per byte", t * 1e9 / BENCH_BYTES);
+	if (c != 0)
+		printf(", %6.2f cycles per byte", (double)c / BENCH_BYTES);
+	printf(" (%d byte messages)\n", BENCH_BUF);
+}
+
+/*
+ * Uplinks of random keys, header, FOpts and payload secured with the single
+ * pass of PayloadEncryptComputeCmacB0() and with the payload encryption,
+ * serialization and MIC of the two pass path must be bit exact.
+ */
+static int
+compare(void)
+{
+	LoRaMacMessageData_t	msg, fused, twopass;
+	KeyIdentifier_t		key;
+	uint8_t			payload[COMPARE_BUF];
+	uint8_t			pfused[COMPARE_BUF];
+	uint8_t			ptwopass[COMPARE_BUF];
+	uint8_t			bfused[COMPARE_BUF];
+	uint8_t			btwopass[COMPARE_BUF];
+	uint32_t		fcnt;
+	int			i, j;
+
+	SecureElementInit(NULL);
+	for (i = 0; i < COMPARE_FRAMES; i++) {
+		if (i % COMPARE_KEYS == 0)
+			set_keys();
+		memset(&msg, 0, sizeof(msg));
+		msg.MHDR.Bits.MType = FRAME_TYPE_DATA_UNCONFIRMED_UP +
+		    2 * (random() & 1);
+		msg.FHDR.DevAddr = random();
+		msg.FHDR.FCtrl.Value = random() & 0xf0;
+		msg.FHDR.FCtrl.Bits.FOptsLen = random() % 16;
+		for (j = 0; j < msg.FHDR.FCtrl.Bits.FOptsLen; j++)
+			msg.FHDR.FOpts[j] = random();
+		fcnt = random();
+		msg.FHDR.FCnt = fcnt;
+		msg.FPort = random() % 224;
+		msg.FRMPayloadSize = random() %
+		    (243 - msg.FHDR.FCtrl.Bits.FOptsLen);
+		for (j = 0; j < msg.FRMPayloadSize; j++)
+			payload[j] = random();
+		key = msg.FPort == 0 ? NWK_S_ENC_KEY : APP_S_KEY;
+
+		fused = msg;
+		fused.Buffer = bfused;
+		fused.BufSize = sizeof(bfused);
+		fused.FRMPayload = pfused;
+		memcpy(pfused, payload, msg.FRMPayloadSize);
+		if (LoRaMacSerializerData(&fused) != LORAMAC_SERIALIZER_SUCCESS ||
+		    PayloadEncryptComputeCmacB0(key, fcnt, &fused) !=
+		    LORAMAC_CRYPTO_SUCCESS) {
+			fprintf(stderr, "sebench: frame %d fails single pass\n",
+			    i);
+			return 1;
+		}
+
+		twopass = msg;
+		twopass.Buffer = btwopass;
+		twopass.BufSize = sizeof(btwopass);
+		twopass.FRMPayload = ptwopass;
+		memcpy(ptwopass, payload, msg.FRMPayloadSize);
+		if (PayloadEncrypt(ptwopass, msg.FRMPayloadSize, key,
+		    msg.FHDR.DevAddr, UPLINK, fcnt) != LORAMAC_CRYPTO_SUCCESS ||
+		    LoRaMacSerializerData(&twopass) !=
+		    LORAMAC_SERIALIZER_SUCCESS ||
+		    ComputeCmacB0(btwopass, twopass.BufSize -
+		    LORAMAC_MIC_FIELD_SIZE, NWK_S_ENC_KEY, false, UPLINK,
+		    msg.FHDR.DevAddr, fcnt, &twopass.MIC) !=
+		    LORAMAC_CRYPTO_SUCCESS ||
+		    LoRaMacSerializerData(&twopass) !=
+		    LORAMAC_SERIALIZER_SUCCESS) {
+			fprintf(stderr, "sebench: frame %d fails two pass\n",
+			    i);
+			return 1;
+		}
+
+		if (fused.BufSize != twopass.BufSize ||
+		    fused.MIC != twopass.MIC ||
+		    memcmp(bfused, btwopass, fused.BufSize) != 0 ||
+		    memcmp(pfused, ptwopass, msg.FRMPayloadSize) != 0) {
+			fprintf(stderr, "sebench: frame %d of %d bytes differs "
+			    "between single and two pass\n", i,
+			    twopass.BufSize);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int
+cache(void)
+{
+	uint32_t	mics, mics_nocache;
+	double		t, t_nocache, expand, block;
+
+	SecureElementInit(NULL);
+	set_keys();
+	t_nocache = bench_uplinks(false, &mics_nocache);
+	t = bench_uplinks(true, &mics);
+	if (mics != mics_nocache) {
+		fprintf(stderr, "sebench: MICs differ with the key schedule "
+		    "cache\n");
+		return 1;
+	}
+	bench_aes(&expand, &block);
+	printf("key schedule cache: %d entries, %zu bytes of RAM "
+	    "(%zu per entry)\n", NUM_OF_KEY_SCHEDULES, sizeof(KeySchedules),
+	    sizeof(KeySchedules[0]));
+	printf("  uplink with %d byte payload: %6.1f ns expanding the keys, "
+	    "%6.1f ns cached\n", BENCH_PAYLOAD, t_nocache, t);
+	printf("  saves 2 key expansions per uplink, each %.1f ns or the time "
+	    "of %.2f AES blocks\n", expand, expand / block);
+	return 0;
+}
+
+int
+main(void)
+{
+	srandom(1);
+	if (init() != 0 || aes_kat() != 0 || kats() != 0)
+		return 1;
+	printf("FIPS-197 and RFC 4493 test vectors pass\n");
+	if (compare() != 0)
+		return 1;
+	printf("%d random uplinks secured in a single pass match the two "
+	    "pass path\n", COMPARE_FRAMES);
+	throughput();
+	if (cache() != 0)
+		return 1;
+	return 0;
+}
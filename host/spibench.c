@@ -0,0 +1,272 @@
+/* SX1276 driver over a mock SPI bus, counting the bus transactions */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lora/boards/sx1276-board.h"
+#include "lora/radio/sx1276/sx1276.h"
+
+#define BENCH_FREQ		868100000
+#define BENCH_UPLINK		64	/* 51 byte payload and MAC overhead */
+#define BENCH_DOWNLINK		64
+#define BENCH_RX2_FREQ		869525000
+
+/*
+ * The mock radio holds the register file and the 256 byte LoRa FIFO.
+ * Each frame of NSS carries an address byte followed by data bytes,
+ * with the address incremented after each byte except for the FIFO.
+ */
+static struct {
+  uint8_t	regs[128];
+  uint8_t	fifo[256];
+  bool		selected;
+  bool		addressed;
+  bool		write;
+  uint8_t	addr;
+} radio;
+
+static struct spi_stats {
+  uint32_t	frames;		/* NSS low to high */
+  uint32_t	inout;		/* SpiInOut calls */
+  uint32_t	transfers;	/* SpiTransfer calls */
+  uint32_t	bytes;
+  uint32_t	fifo_bytes;
+} stats;
+
+static DioIrqHandler **dio;
+static bool tx_done;
+static uint8_t rx_buf[256];
+static uint16_t rx_size;
+
+static uint8_t
+radio_byte(uint8_t out)
+{
+  uint8_t in = 0;
+
+  stats.bytes++;
+  if (!radio.addressed) {
+    radio.addressed = true;
+    radio.write = (out & 0x80) != 0;
+    radio.addr = out & 0x7F;
+    return 0;
+  }
+  if (radio.addr == REG_LR_FIFO) {
+    stats.fifo_bytes++;
+    if (radio.write)
+      radio.fifo[radio.regs[REG_LR_FIFOADDRPTR]] = out;
+    else
+      in = radio.fifo[radio.regs[REG_LR_FIFOADDRPTR]];
+    radio.regs[REG_LR_FIFOADDRPTR]++;
+    return in;
+  }
+  if (radio.write) {
+    if (radio.addr == REG_LR_IRQFLAGS &&
+        (radio.regs[REG_OPMODE] & RFLR_OPMODE_LONGRANGEMODE_ON))
+      radio.regs[radio.addr] &= ~out;
+    else
+      radio.regs[radio.addr] = out;
+  } else
+    in = radio.regs[radio.addr];
+  radio.addr = (radio.addr + 1) & 0x7F;
+  return in;
+}
+
+void
+GpioWrite(Gpio_t *obj, uint32_t value)
+{
+  if (value == 0) {
+    radio.selected = true;
+    radio.addressed = false;
+  } else if (radio.selected) {
+    radio.selected = false;
+    stats.frames++;
+  }
+}
+
+uint16_t
+SpiInOut(Spi_t *obj, uint16_t outData)
+{
+  stats.inout++;
+  return radio_byte(outData);
+}
+
+void
+SpiTransfer(Spi_t *obj, const uint8_t *out, uint8_t *in, uint16_t size)
+{
+  uint16_t i;
+  uint8_t b;
+
+  stats.transfers++;
+  for (i = 0; i < size; i++) {
+    b = radio_byte(out != NULL ? out[i] : 0);
+    if (in != NULL)
+      in[i] = b;
+  }
+}
+
+void
+SX1276IoIrqInit(DioIrqHandler **irqHandlers)
+{
+  dio = irqHandlers;
+}
+
+void
+SX1276Reset(void)
+{
+  memset(radio.regs, 0, sizeof(radio.regs));
+}
+
+void
+SX1276SetRfTxPower(int8_t power)
+{
+}
+
+void
+SX1276SetAntSwLowPower(bool status)
+{
+}
+
+void
+SX1276SetAntSw(uint8_t opMode)
+{
+}
+
+bool
+SX1276CheckRfFrequency(uint32_t frequency)
+{
+  return true;
+}
+
+void
+SX1276SetBoardTcxo(uint8_t state)
+{
+}
+
+uint32_t
+SX1276GetBoardTcxoWakeupTime(void)
+{
+  return 0;
+}
+
+static void
+on_tx_done(void)
+{
+  tx_done = true;
+}
+
+static void
+on_rx_done(uint8_t *payload, uint16_t size, int16_t rssi, int8_t snr)
+{
+  memcpy(rx_buf, payload, size);
+  rx_size = size;
+}
+
+/*
+ * Before SpiTransfer the driver called SpiInOut once per bus byte, and
+ * SpiInOut waits for the bus twice.
+ */
+static void
+report(const char *name)
+{
+  printf("%-6s %2u transactions, %3u bytes (%2u FIFO), "
+      "%2u calls (%u SpiInOut, %u SpiTransfer)\n",
+      name, stats.frames, stats.bytes, stats.fifo_bytes,
+      stats.inout + stats.transfers, stats.inout, stats.transfers);
+  memset(&stats, 0, sizeof(stats));
+}
+
+/* Uplink at DR5, from the configuration to TxDone */
+static int
+uplink(void)
+{
+  uint8_t payload[BENCH_UPLINK];
+  uint8_t i;
+
+  for (i = 0; i < sizeof(payload); i++)
+    payload[i] = i;
+  tx_done = false;
+  SX1276SetChannel(BENCH_FREQ);
+  SX1276SetTxConfig(MODEM_LORA, 14, 0, 0, 7, 1, 8, false, true, 0, 0,
+      false, 4000);
+  SX1276SetMaxPayloadLength(MODEM_LORA, sizeof(payload));
+  SX1276Send(payload, sizeof(payload));
+  radio.regs[REG_LR_IRQFLAGS] |= RFLR_IRQFLAGS_TXDONE;
+  dio[0](NULL);
+  if (!tx_done || memcmp(radio.fifo, payload, sizeof(payload)) != 0) {
+    fprintf(stderr, "spibench: uplink not loaded\n");
+    return -1;
+  }
+  return 0;
+}
+
+/* Receive window, from the RX timer to the radio listening */
+static void
+window(uint32_t freq, uint32_t sf, uint16_t symbols)
+{
+  SX1276SetChannel(freq);
+  SX1276SetRxConfig(MODEM_LORA, 0, sf, 1, 0, 8, symbols, false, 0, false,
+      0, 0, true, false);
+  SX1276SetMaxPayloadLength(MODEM_LORA, 255);
+  SX1276SetRx(3000);
+}
+
+/* A window times out, the radio going back to standby by itself */
+static void
+timeout(void)
+{
+  radio.regs[REG_LR_IRQFLAGS] |= RFLR_IRQFLAGS_RXTIMEOUT;
+  dio[1](NULL);
+}
+
+/* Downlink received, from RxDone to the payload read */
+static int
+downlink(void)
+{
+  uint8_t i;
+
+  for (i = 0; i < BENCH_DOWNLINK; i++)
+    radio.fifo[i] = ~i;
+  radio.regs[REG_LR_FIFORXCURRENTADDR] = 0;
+  radio.regs[REG_LR_RXNBBYTES] = BENCH_DOWNLINK;
+  radio.regs[REG_LR_IRQFLAGS] |= RFLR_IRQFLAGS_RXDONE;
+  rx_size = 0;
+  dio[0](NULL);
+  if (rx_size != BENCH_DOWNLINK ||
+      memcmp(rx_buf, radio.fifo, BENCH_DOWNLINK) != 0) {
+    fprintf(stderr, "spibench: downlink not read\n");
+    return -1;
+  }
+  return 0;
+}
+
+int
+main(void)
+{
+  static RadioEvents_t events;
+  int n;
+
+  events.TxDone = on_tx_done;
+  events.RxDone = on_rx_done;
+  SX1276Init(&events);
+  report("init");
+
+  /* The second cycle shows the steady state */
+  for (n = 0; n < 2; n++) {
+    printf("cycle %d\n", n + 1);
+    if (uplink() != 0)
+      return 1;
+    report("tx");
+    window(BENCH_FREQ, 7, 8);
+    report("rx1");
+    timeout();
+    report("rx1 to");
+    window(BENCH_RX2_FREQ, 12, 8);
+    report("rx2");
+    if (downlink() != 0)
+      return 1;
+    report("rxdone");
+  }
+  return 0;
+}
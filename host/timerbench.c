@@ -0,0 +1,209 @@
+/*
+ * Random starts, stops and expiries of the timer queue of lora/system,
+ * over the virtual RTC of the host board.
+ *
+ * After each operation and expiry the heap must be in order, each timer
+ * at its position, the started timers those queued, the head the one
+ * armed and no timer overdue. Each timer expires in order, not early and
+ * once, unless stopped.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "lora/boards/host/host-board.h"
+
+/* The queue is checked through the statics of timer.c */
+#include "lora/system/timer.c"
+
+#define BENCH_OPS		10000
+#define BENCH_TIMERS		TIMER_QUEUE_SIZE
+#define BENCH_MAX_MS		5000
+#define BENCH_RESTART		4	/* a callback restarts one in this many */
+
+static struct bench_timer {
+	TimerEvent_t	ev;
+	uint32_t	due;		/* RTC ticks */
+	bool		expect;		/* started and not stopped */
+} timers[BENCH_TIMERS];
+
+static struct {
+	unsigned long	starts;
+	unsigned long	stops;
+	unsigned long	runs;
+	unsigned long	expiries;
+	unsigned long	restarts;
+	unsigned long	full;		/* operations with all timers queued */
+	uint32_t	late;		/* most ticks an expiry was late */
+} st;
+
+static uint32_t	last_due;
+static bool	failed;
+
+static void	start(struct bench_timer *);
+
+static int
+which(const TimerEvent_t *ev)
+{
+	return (struct bench_timer *)ev->Context - timers;
+}
+
+static void
+fail(const char *what, int i)
+{
+	if (!failed)
+		fprintf(stderr, "timerbench: timer %d: %s\n", i, what);
+	failed = true;
+}
+
+static void
+expired(void *context)
+{
+	struct bench_timer	*t = context;
+	int			 i = t - timers;
+	uint32_t		 now = RtcGetTimerValue();
+
+	if (!t->expect)
+		fail("expired while stopped", i);
+	else if ((int32_t)(now - t->due) < 0)
+		fail("expired early", i);
+	else if ((int32_t)(t->due - last_due) < 0)
+		fail("expired out of order", i);
+	t->expect = false;
+	last_due = t->due;
+	if (now - t->due > st.late)
+		st.late = now - t->due;
+	st.expiries++;
+
+	/* As the MAC does, start a timer again from its callback */
+	if (random() % BENCH_RESTART == 0) {
+		t = &timers[random() % BENCH_TIMERS];
+		if (!t->ev.IsStarted) {
+			start(t);
+			st.restarts++;
+		}
+	}
+}
+
+static void
+start(struct bench_timer *t)
+{
+	TimerSetValue(&t->ev, 1 + random() % BENCH_MAX_MS);
+	TimerStart(&t->ev);
+	t->due = t->ev.Timestamp;
+	t->expect = true;
+}
+
+/* The heap order, the positions and the armed head */
+static bool
+check(void)
+{
+	uint32_t	now = RtcGetTimerValue();
+	int		i, n = 0;
+
+	for (i = 0; i < TimerQueueLength; i++) {
+		if (TimerQueue[i]->Index != i) {
+			fail("index not its position", which(TimerQueue[i]));
+			return false;
+		}
+		if (i > 0 && TimerIsBefore(TimerQueue[i],
+		    TimerQueue[(i - 1) / 2])) {
+			fail("before its parent", which(TimerQueue[i]));
+			return false;
+		}
+	}
+	for (i = 0; i < BENCH_TIMERS; i++) {
+		if (timers[i].ev.IsStarted != timers[i].expect) {
+			fail(timers[i].expect ? "lost" : "started twice", i);
+			return false;
+		}
+		if (!timers[i].ev.IsStarted)
+			continue;
+		n++;
+		if (TimerQueue[timers[i].ev.Index] != &timers[i].ev) {
+			fail("started and not queued", i);
+			return false;
+		}
+		/* The alarm is set at least the minimum timeout ahead */
+		if ((int32_t)(now - timers[i].due) > (int32_t)
+		    RtcGetMinimumTimeout()) {
+			fail("not expired", i);
+			return false;
+		}
+	}
+	if (n != TimerQueueLength) {
+		fail("queue length", n);
+		return false;
+	}
+	if (n > 0 && TimerArmed != TimerQueue[0]) {
+		fail("head not armed", which(TimerQueue[0]));
+		return false;
+	}
+	if (n == BENCH_TIMERS)
+		st.full++;
+	return !failed;
+}
+
+int
+main(void)
+{
+	struct bench_timer	*t;
+	uint64_t		 limit;
+	int			 i;
+
+	srandom(1);
+	RtcInit();
+	for (i = 0; i < BENCH_TIMERS; i++) {
+		TimerInit(&timers[i].ev, expired);
+		TimerSetContext(&timers[i].ev, &timers[i]);
+	}
+
+	for (i = 0; i < BENCH_OPS; i++) {
+		t = &timers[random() % BENCH_TIMERS];
+		switch (random() % 5) {
+		case 0:
+		case 1:
+		case 2:
+			/* Start, or restart with a new value */
+			start(t);
+			st.starts++;
+			break;
+		case 3:
+			TimerStop(&t->ev);
+			t->expect = false;
+			st.stops++;
+			break;
+		case 4:
+			/* Run the expiries of up to a second */
+			limit = HostGetTime() + random() % 1000000;
+			while (HostRunNext(limit))
+				if (!check())
+					return 1;
+			st.runs++;
+			break;
+		}
+		if (!check())
+			return 1;
+	}
+
+	/* Every timer left expires once */
+	while (HostRunNext(HostGetTime() + BENCH_MAX_MS * 1000))
+		if (!check())
+			return 1;
+	for (i = 0; i < BENCH_TIMERS; i++)
+		if (timers[i].expect) {
+			fail("never expired", i);
+			return 1;
+		}
+	if (failed)
+		return 1;
+
+	printf("%d timers, %d operations: %lu starts, %lu stops, %lu runs\n",
+	    BENCH_TIMERS, BENCH_OPS, st.starts, st.stops, st.runs);
+	printf("%lu expiries in order, %lu restarts from a callback, "
+	    "at most %u ticks late\n", st.expiries, st.restarts, st.late);
+	printf("%lu operations with a full queue\n", st.full);
+	return 0;
+}
@@ -12,7 +12,11 @@
 #include "lora/ad_lora.h"
 #include "lora/lora.h"
 #include "lora/param.h"
+#include "lora/upgrade.h"
 #include "lora/util.h"
+#include "lora/boards/rtc-board.h"
+#include "lora/mac/LoRaMac.h"
+#include "sensor/gps.h"
 #include "sensor/sensor.h"
 
 #define CONSOLE_INPUT
@@ -121,6 +125,22 @@ cmd_param(int argc, char **argv)
 	}
 }
 
+static void
+cmd_nvm(int argc, char **argv)
+{
+	const struct param_stats	*st = param_stats();
+
+	(void)argc;
+	(void)argv;
+	printf("%lu param commits, %lu params in %lu flash writes\r\n",
+	    st->transactions, st->params, st->flash_writes);
+	if (st->transactions == 0)
+		return;
+	printf("write last %lu ms, latency last %lu max %lu mean %lu ms\r\n",
+	    st->write, st->latency, st->latency_max,
+	    st->latency_sum / st->transactions);
+}
+
 static void
 cmd_sense(int argc, char **argv)
 {
@@ -148,7 +168,83 @@ cmd_reset(int argc, char **argv)
 	(void)argv;
 	(void)argc;
 	printf("Rebooting...\r\n");
-	hw_cpm_reboot_system();
+	upgrade_reboot_now();
+}
+
+/* Wake-ups spent on the MAC timers and lateness of their alarms */
+static void
+cmd_timer(int argc, char **argv)
+{
+	RtcAlarmStats_t	 st;
+	MibRequestConfirm_t mib;
+	const LoRaMacRxTiming_t *rx;
+	uint32_t	 elapsed, hz;
+
+	(void)argc;
+	(void)argv;
+	mib.Type = MIB_RX_TIMING;
+	if (LoRaMacMibGetRequestConfirm(&mib) == LORAMAC_STATUS_OK &&
+	    mib.Param.RxTiming->Windows > 0) {
+		rx = mib.Param.RxTiming;
+		printf("%lu rx windows, error %ld..%ld us, latency timer %lu "
+		    "irq %lu us\r\n", rx->Windows, rx->ErrorMin, rx->ErrorMax,
+		    rx->TimerLatency, rx->IrqLatency);
+	}
+	RtcGetAlarmStats(&st);
+	elapsed = RtcGetTimerValue() - st.Since;
+	hz = RtcMs2Tick(1000);
+	printf("%lu wakeups in %lu s, %lu/h\r\n", st.Wakeups, elapsed / hz,
+	    elapsed == 0 ? 0 :
+	    (uint32_t)((uint64_t)st.Wakeups * 3600 * hz / elapsed));
+	if (st.Alarms == 0)
+		return;
+	printf("%lu alarms, late min %ld max %ld mean %ld us\r\n", st.Alarms,
+	    (int32_t)((int64_t)st.LateMin * 1000000 / hz),
+	    (int32_t)((int64_t)st.LateMax * 1000000 / hz),
+	    (int32_t)((int64_t)st.LateSum * 1000000 / hz / st.Alarms));
+}
+
+#ifdef FEATURE_SENSOR_GPS
+static void
+cmd_gps(int argc, char **argv)
+{
+	const struct gps_stats	*st = gps_stats();
+
+	(void)argc;
+	(void)argv;
+	printf("%lu acquisitions, %lu fixes, %lu timeouts, on %lu ms, "
+	    "%lu skipped still\r\n", st->acquisitions, st->fixes,
+	    st->timeouts, st->on, st->skipped);
+	if (st->fixes == 0)
+		return;
+	printf("time to fix last %lu min %lu max %lu mean %lu ms\r\n",
+	    st->ttff, st->ttff_min, st->ttff_max, st->ttff_sum / st->fixes);
+	printf("%lu aided, mean time to fix %lu ms cold, %lu ms aided\r\n",
+	    st->aided, st->fixes == st->fixes_aided ? 0 :
+	    (st->ttff_sum - st->ttff_aided_sum) /
+	    (st->fixes - st->fixes_aided), st->fixes_aided == 0 ? 0 :
+	    st->ttff_aided_sum / st->fixes_aided);
+}
+#endif
+
+static void
+cmd_txq(int argc, char **argv)
+{
+	static const char	*const name[LORA_TX_CLASSES] = {
+		[LORA_TX_CONTROL]	= "control",
+		[LORA_TX_ALARM]		= "alarm",
+		[LORA_TX_DATA]		= "data",
+	};
+	const struct lora_txq_stats	*st;
+	uint8_t	 cls;
+
+	(void)argc;
+	(void)argv;
+	for (cls = 0; cls < LORA_TX_CLASSES; cls++) {
+		st = lora_txq_stats(cls);
+		printf("%-8s %lu queued, %lu sent, %lu dropped\r\n", name[cls],
+		    st->queued, st->sent, st->dropped);
+	}
 }
 
 struct command {
@@ -158,9 +254,15 @@ struct command {
 };
 
 static const struct command	cmd[] = {
+#ifdef FEATURE_SENSOR_GPS
+	{ "gps", 1, 1, cmd_gps },
+#endif
+	{ "nvm", 1, 1, cmd_nvm },
 	{ "param", 2, 3, cmd_param },
 	{ "reset", 1, 1, cmd_reset },
 	{ "sense", 1, 1, cmd_sense },
+	{ "timer", 1, 1, cmd_timer },
+	{ "txq", 1, 1, cmd_txq },
 };
 
 static int
@@ -47,6 +47,10 @@
 // uncomment below define if you want to use grove digital light sensor.
 //#define FEATURE_SENSOR_LIGHT
 
+// uncomment below define if an LIS3DH accelerometer, powered at all
+// times, tells the GPS when the node moves.
+//#define FEATURE_SENSOR_MOTION
+
 // define initial sleep mode according to your power needs.
 #define INITIAL_SLEEP_MODE	      pm_mode_extended_sleep
 
@@ -86,6 +90,7 @@
 #define HW_IOX_I2C_ADDR		              0x20
 #define HW_SENSOR_TEMP_I2C_ADDR	        0x49
 #define HW_SENSOR_GROVE_LIGHT_I2C_ADDR	0x29
+#define HW_SENSOR_MOTION_I2C_ADDR	      0x18
 #define HW_I2C_SCL_PORT		        HW_GPIO_PORT_4
 #define HW_I2C_SCL_PIN		        HW_GPIO_PIN_3
 #define HW_I2C_SDA_PORT		        HW_GPIO_PORT_4
@@ -1,15 +1,23 @@
 #include <FreeRTOS.h>
 #include <hw_gpio.h>
 
+#include "osal.h"
+
 #include "hw.h"
 #include "power.h"
 
+/*
+ * The sensors are off until the next sampling once their data is read,
+ * even while the system is awake for the uplink.
+ */
+PRIVILEGED_DATA static bool	sensors_off;
+
 void
 power_init()
 {
 #ifdef FEATURE_POWER_SUPPLY
 	hw_gpio_configure_pin(HW_PS_EN_PORT, HW_PS_EN_PIN,
-	  HW_GPIO_MODE_OUTPUT, HW_GPIO_FUNC_GPIO, true);
+	  HW_GPIO_MODE_OUTPUT, HW_GPIO_FUNC_GPIO, !sensors_off);
 #endif /* FEATURE_POWER_SUPPLY */
 }
 
@@ -18,8 +26,13 @@ power(bool on)
 {
 #ifdef FEATURE_POWER_SUPPLY
   hw_gpio_configure_pin(HW_PS_EN_PORT, HW_PS_EN_PIN,
-    HW_GPIO_MODE_OUTPUT, HW_GPIO_FUNC_GPIO, on);
+    HW_GPIO_MODE_OUTPUT, HW_GPIO_FUNC_GPIO, on && !sensors_off);
 #endif /* FEATURE_POWER_SUPPLY */
 }
 
-
+void
+power_sensors(bool on)
+{
+	sensors_off = !on;
+	power(on);
+}
@@ -4,5 +4,6 @@
 void	power_init(void);
 
 void	power(bool);
+void	power_sensors(bool);
 
 #endif /* __POWER_H__ */
@@ -0,0 +1,169 @@
+/* Sensor sample batching with a delta encoding */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "lora/batch.h"
+
+/*
+ * A run holds the samples of one sensor with the same length, oldest
+ * first:
+ *
+ *	sensor type, sample length
+ *	age of the first sample at the encoding (s)
+ *	first sample
+ *	for each next sample:
+ *	    time since the previous sample (s)
+ *	    difference to the previous sample of each field
+ *
+ * Times and differences are LEB128 varints, the differences zigzag
+ * encoded and wrapping at the field width. A sample that does not match
+ * the layout of its sensor is sent as one byte fields.
+ */
+#define VARINT_MAX	5
+#define SAMPLE_MAX	(VARINT_MAX + 2 * (BATCH_SAMPLE_LEN - 1))
+
+static uint8_t
+put_varint(uint8_t *buf, uint32_t v)
+{
+	uint8_t	n = 0;
+
+	while (v >= 0x80) {
+		buf[n++] = v | 0x80;
+		v >>= 7;
+	}
+	buf[n++] = v;
+	return n;
+}
+
+static uint32_t
+get_field(const uint8_t *p, uint8_t field)
+{
+	uint32_t	v = 0;
+	uint8_t		i, w = field & ~BATCH_BE;
+
+	for (i = 0; i < w; i++)
+		v |= (uint32_t)p[field & BATCH_BE ? w - 1 - i : i] << (8 * i);
+	return v;
+}
+
+static bool
+layout_matches(uint16_t fields, uint8_t len)
+{
+	uint8_t	sum = 0;
+
+	for (; fields != 0; fields >>= 4)
+		sum += fields & 0xf & ~BATCH_BE;
+	return sum == len;
+}
+
+/* Time and field differences of a sample to the previous one of its run */
+static uint8_t
+put_delta(uint8_t *buf, const struct batch_sample *prev,
+    const struct batch_sample *s)
+{
+	uint16_t	fields = s->fields;
+	uint8_t		n, off, field, shift;
+	bool		bytes;
+	int32_t		d;
+
+	n = put_varint(buf, s->time - prev->time);
+	bytes = !layout_matches(fields, s->len - 1);
+	for (off = 1; off < s->len; off += field & ~BATCH_BE) {
+		field = bytes ? 1 : fields & 0xf;
+		fields >>= 4;
+		shift = 32 - 8 * (field & ~BATCH_BE);
+		d = (int32_t)((get_field(s->data + off, field) -
+		    get_field(prev->data + off, field)) << shift) >> shift;
+		n += put_varint(buf + n, (uint32_t)d << 1 ^ (uint32_t)(d >> 31));
+	}
+	return n;
+}
+
+void
+batch_add(struct batch *b, uint32_t time, uint16_t fields,
+    const uint8_t *data, uint8_t len)
+{
+	struct batch_sample	*s;
+
+	if (len == 0 || len > BATCH_SAMPLE_LEN)
+		return;
+	if (b->count == BATCH_SAMPLES) {
+		memmove(b->samples, b->samples + 1,
+		    (BATCH_SAMPLES - 1) * sizeof(*s));
+		b->count--;
+	}
+	s = &b->samples[b->count++];
+	s->time = time;
+	s->fields = fields;
+	s->len = len;
+	s->encoded = 0;
+	memcpy(s->data, data, len);
+}
+
+/*
+ * Encodes the run of the oldest sample not encoded yet, with as many of
+ * the next samples of its sensor as fit in maxlen bytes. Returns the
+ * length of the run, 0 if there is none or it does not fit.
+ */
+uint8_t
+batch_encode(struct batch *b, uint32_t now, uint8_t *buf, uint8_t maxlen)
+{
+	struct batch_sample	*first, *prev, *s;
+	uint8_t			 tmp[SAMPLE_MAX];
+	uint8_t			 i, len, n;
+
+	for (i = 0; i < b->count && b->samples[i].encoded; i++)
+		;
+	if (i == b->count)
+		return 0;
+	first = prev = &b->samples[i];
+	tmp[0] = first->data[0];
+	tmp[1] = first->len - 1;
+	len = 2 + put_varint(tmp + 2, now - first->time);
+	if (len + first->len - 1 > maxlen)
+		return 0;
+	memcpy(buf, tmp, len);
+	memcpy(buf + len, first->data + 1, first->len - 1);
+	len += first->len - 1;
+	first->encoded = 1;
+
+	for (i++; i < b->count; i++) {
+		s = &b->samples[i];
+		if (s->encoded || s->data[0] != first->data[0] ||
+		    s->len != first->len)
+			continue;
+		n = put_delta(tmp, prev, s);
+		if (len + n > maxlen)
+			break;
+		memcpy(buf + len, tmp, n);
+		len += n;
+		s->encoded = 1;
+		prev = s;
+	}
+	return len;
+}
+
+/* Drops the samples encoded since the last commit or rewind */
+void
+batch_commit(struct batch *b)
+{
+	uint8_t	i, n;
+
+	for (i = 0, n = 0; i < b->count; i++) {
+		if (!b->samples[i].encoded)
+			b->samples[n++] = b->samples[i];
+	}
+	b->count = n;
+}
+
+/* Keeps the samples encoded since the last commit or rewind */
+void
+batch_rewind(struct batch *b)
+{
+	uint8_t	i;
+
+	for (i = 0; i < b->count; i++)
+		b->samples[i].encoded = 0;
+}
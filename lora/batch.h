@@ -0,0 +1,40 @@
+#ifndef __BATCH_H__
+#define __BATCH_H__
+
+#include <stdint.h>
+
+#define BATCH_SAMPLES		24
+#define BATCH_SAMPLE_LEN	12	/* sensor type and a GPS fix */
+
+/*
+ * Layout of the integer fields of a sensor sample after its type byte,
+ * one nibble per field from the first: the width in bytes, with
+ * BATCH_BE for big-endian fields. Consecutive samples of a sensor are
+ * sent as the deltas of these fields.
+ */
+#define BATCH_BE		0x8
+#define BATCH_FIELDS(a, b, c, d)	\
+	((a) | (b) << 4 | (c) << 8 | (d) << 12)
+
+struct batch_sample {
+	uint32_t	time;		/* s */
+	uint16_t	fields;
+	uint8_t		len;
+	uint8_t		encoded;
+	uint8_t		data[BATCH_SAMPLE_LEN];
+};
+
+/* Samples in time order, the oldest dropped when full */
+struct batch {
+	struct batch_sample	samples[BATCH_SAMPLES];
+	uint8_t			count;
+};
+
+void	batch_add(struct batch *b, uint32_t time, uint16_t fields,
+	    const uint8_t *data, uint8_t len);
+uint8_t	batch_encode(struct batch *b, uint32_t now, uint8_t *buf,
+	    uint8_t maxlen);
+void	batch_commit(struct batch *b);
+void	batch_rewind(struct batch *b);
+
+#endif /* __BATCH_H__ */
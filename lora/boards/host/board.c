@@ -0,0 +1,185 @@
+/*!
+ * \file      board.c
+ *
+ * \brief     Host (POSIX) board general functions and virtual time
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "utilities.h"
+#include "rtc-board.h"
+#include "board.h"
+#include "host-board.h"
+
+/*!
+ * Virtual time in microseconds
+ */
+static uint64_t HostTime;
+
+/*!
+ * Events sorted by due time
+ */
+static HostEvent_t* HostEventList;
+
+static int32_t HostRtcDrift;
+static uint32_t HostIrqLatency;
+static uint32_t HostSeed = 1;
+
+uint64_t HostGetTime( void )
+{
+    return HostTime;
+}
+
+void HostEventSchedule( HostEvent_t* event, uint64_t time, HostEventCallback_t* callback, void* context )
+{
+    HostEvent_t** cur;
+
+    HostEventCancel( event );
+    event->Time = time;
+    event->Callback = callback;
+    event->Context = context;
+    event->IsPending = true;
+
+    // Events due at the same time run in the order they were queued
+    for( cur = &HostEventList; *cur != NULL && ( *cur )->Time <= time; cur = &( *cur )->Next )
+    {
+    }
+    event->Next = *cur;
+    *cur = event;
+}
+
+void HostEventCancel( HostEvent_t* event )
+{
+    HostEvent_t** cur;
+
+    if( event->IsPending == false )
+    {
+        return;
+    }
+    for( cur = &HostEventList; *cur != NULL; cur = &( *cur )->Next )
+    {
+        if( *cur == event )
+        {
+            *cur = event->Next;
+            break;
+        }
+    }
+    event->IsPending = false;
+}
+
+bool HostRunNext( uint64_t limit )
+{
+    HostEvent_t* event = HostEventList;
+
+    if( ( event == NULL ) || ( event->Time > limit ) )
+    {
+        if( limit > HostTime )
+        {
+            HostTime = limit;
+        }
+        return false;
+    }
+    HostEventList = event->Next;
+    event->IsPending = false;
+    if( event->Time > HostTime )
+    {
+        HostTime = event->Time;
+    }
+    event->Callback( event->Context );
+    return true;
+}
+
+void HostAdvance( uint64_t us )
+{
+    HostTime += us;
+}
+
+void HostSetRtcDrift( int32_t ppm )
+{
+    HostRtcDrift = ppm;
+}
+
+int32_t HostGetRtcDrift( void )
+{
+    return HostRtcDrift;
+}
+
+void HostSetIrqLatency( uint32_t us )
+{
+    HostIrqLatency = us;
+}
+
+uint32_t HostGetIrqLatency( void )
+{
+    return HostIrqLatency;
+}
+
+void HostSetSeed( uint32_t seed )
+{
+    HostSeed = seed;
+}
+
+bool HostRandomEvent( uint16_t permille )
+{
+    if( permille == 0 )
+    {
+        return false;
+    }
+    HostSeed = HostSeed * 1103515245UL + 12345UL;
+    return ( ( HostSeed >> 16 ) % 1000 ) < permille;
+}
+
+void BoardCriticalSectionBegin( uint32_t *mask )
+{
+    // Single threaded, interrupts are dispatched by HostRunNext
+    *mask = 0;
+}
+
+void BoardCriticalSectionEnd( uint32_t *mask )
+{
+    ( void )mask;
+}
+
+void BoardInitPeriph( void )
+{
+
+}
+
+void BoardInitMcu( void )
+{
+    RtcInit( );
+}
+
+void BoardResetMcu( void )
+{
+    exit( EXIT_FAILURE );
+}
+
+void BoardDeInitMcu( void )
+{
+
+}
+
+uint32_t BoardGetBatteryVoltage( void )
+{
+    return 3300;
+}
+
+uint8_t BoardGetBatteryLevel( void )
+{
+    // 0: external power source
+    return 0;
+}
+
+uint32_t BoardGetRandomSeed( void )
+{
+    return HostSeed;
+}
+
+void BoardGetUniqueId( uint8_t *id )
+{
+    for( uint8_t i = 0; i < 8; i++ )
+    {
+        id[i] = i;
+    }
+}
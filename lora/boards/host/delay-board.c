@@ -0,0 +1,12 @@
+/*!
+ * \file      delay-board.c
+ *
+ * \brief     Host (POSIX) board delay implementation on virtual time
+ */
+#include "delay-board.h"
+#include "host-board.h"
+
+void DelayMsMcu( uint32_t ms )
+{
+    HostAdvance( ( uint64_t )ms * 1000 );
+}
@@ -0,0 +1,139 @@
+/*!
+ * \file      host-board.h
+ *
+ * \brief     Virtual time and event scheduling of the host (POSIX) board
+ *
+ * \remark    The whole stack runs in a single thread on virtual time. Radio
+ *            and RTC events are queued with their due time and dispatched by
+ *            \ref HostRunNext, which advances the virtual clock to the event.
+ */
+#ifndef __HOST_BOARD_H__
+#define __HOST_BOARD_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*!
+ * Virtual time resolution, in ticks per second
+ */
+#define HOST_TIME_TICKS_PER_SEC                     1000000ULL
+
+/*!
+ * Host event callback
+ */
+typedef void ( HostEventCallback_t )( void* context );
+
+/*!
+ * Host event
+ */
+typedef struct sHostEvent
+{
+    /*!
+     * Due time in microseconds
+     */
+    uint64_t Time;
+    /*!
+     * Function called when the event is due
+     */
+    HostEventCallback_t* Callback;
+    /*!
+     * Argument of the callback
+     */
+    void* Context;
+    /*!
+     * Set while the event is queued
+     */
+    bool IsPending;
+    /*!
+     * Next event in the queue
+     */
+    struct sHostEvent* Next;
+}HostEvent_t;
+
+/*!
+ * \brief Returns the virtual time
+ *
+ * \retval time Virtual time in microseconds
+ */
+uint64_t HostGetTime( void );
+
+/*!
+ * \brief Queues an event, replacing it if already queued
+ *
+ * \param [IN] event    Event to queue
+ * \param [IN] time     Due time in microseconds
+ * \param [IN] callback Function called when the event is due
+ * \param [IN] context  Argument of the callback
+ */
+void HostEventSchedule( HostEvent_t* event, uint64_t time, HostEventCallback_t* callback, void* context );
+
+/*!
+ * \brief Removes an event from the queue
+ *
+ * \param [IN] event    Event to remove
+ */
+void HostEventCancel( HostEvent_t* event );
+
+/*!
+ * \brief Advances the virtual time to the next event and dispatches it
+ *
+ * \param [IN] limit    Time after which no event is dispatched
+ *
+ * \retval dispatched   False if no event was due until limit. The virtual
+ *                      time is then set to limit.
+ */
+bool HostRunNext( uint64_t limit );
+
+/*!
+ * \brief Advances the virtual time without dispatching events, used for
+ *        blocking delays. Events which became due are dispatched late.
+ *
+ * \param [IN] us       Delay in microseconds
+ */
+void HostAdvance( uint64_t us );
+
+/*!
+ * \brief Sets the frequency error of the RTC
+ *
+ * \param [IN] ppm      Error in parts per million, positive when fast
+ */
+void HostSetRtcDrift( int32_t ppm );
+
+/*!
+ * \brief Returns the frequency error of the RTC
+ *
+ * \retval ppm          Error in parts per million
+ */
+int32_t HostGetRtcDrift( void );
+
+/*!
+ * \brief Sets the delay between an interrupt source firing and its handler
+ *        running, applied to RTC alarms and radio interrupts
+ *
+ * \param [IN] us       Latency in microseconds
+ */
+void HostSetIrqLatency( uint32_t us );
+
+/*!
+ * \brief Returns the interrupt latency
+ *
+ * \retval us           Latency in microseconds
+ */
+uint32_t HostGetIrqLatency( void );
+
+/*!
+ * \brief Returns true with the given probability, from the board random
+ *        generator used for fault injection
+ *
+ * \param [IN] permille Probability in 1/1000
+ */
+bool HostRandomEvent( uint16_t permille );
+
+/*!
+ * \brief Seeds the board random generator
+ *
+ * \param [IN] seed     Seed
+ */
+void HostSetSeed( uint32_t seed );
+
+#endif // __HOST_BOARD_H__
@@ -0,0 +1,173 @@
+/*!
+ * \file      rtc-board.c
+ *
+ * \brief     Host (POSIX) board RTC timer running on virtual time
+ *
+ * \remark    The RTC runs at the rate of the MX1733 RTC and can be given a
+ *            frequency error with \ref HostSetRtcDrift. Alarms are queued as
+ *            host events and reach TimerIrqHandler after the configured
+ *            interrupt latency.
+ */
+#include <stdint.h>
+
+#include "utilities.h"
+#include "timer.h"
+#include "rtc-board.h"
+#include "host-board.h"
+
+// MCU Wake Up Time
+#define MIN_ALARM_DELAY     3 // in ticks
+
+#define RTC_TICKS_IN_SEC    32768
+
+/*!
+ * RTC timer context
+ */
+typedef struct
+{
+    uint32_t    Time;   // Reference time
+    HostEvent_t Alarm;  // Pending alarm
+}RtcTimerContext_t;
+
+static RtcTimerContext_t RtcTimerContext;
+
+static uint32_t RtcBkupData0;
+static uint32_t RtcBkupData1;
+
+/*!
+ * \brief Converts virtual time to RTC ticks, applying the RTC drift
+ */
+static uint64_t RtcTimeToTicks( uint64_t us )
+{
+    unsigned __int128 ticks = ( unsigned __int128 )us * RTC_TICKS_IN_SEC *
+                              ( uint64_t )( 1000000 + HostGetRtcDrift( ) );
+
+    return ( uint64_t )( ticks / 1000000000000ULL );
+}
+
+/*!
+ * \brief Converts RTC ticks to the virtual time they are reached at
+ */
+static uint64_t RtcTicksToTime( uint64_t ticks )
+{
+    unsigned __int128 den = ( unsigned __int128 )RTC_TICKS_IN_SEC *
+                            ( uint64_t )( 1000000 + HostGetRtcDrift( ) );
+
+    return ( uint64_t )( ( ( unsigned __int128 )ticks * 1000000000000ULL + den - 1 ) / den );
+}
+
+static void RtcAlarmIrq( void* context )
+{
+    ( void )context;
+    TimerIrqHandler( );
+}
+
+void RtcInit( void )
+{
+    RtcTimerContext.Time = 0;
+    HostEventCancel( &RtcTimerContext.Alarm );
+}
+
+uint32_t RtcSetTimerContext( void )
+{
+    RtcTimerContext.Time = RtcGetTimerValue( );
+    return RtcTimerContext.Time;
+}
+
+uint32_t RtcGetTimerContext( void )
+{
+    return RtcTimerContext.Time;
+}
+
+uint32_t RtcGetMinimumTimeout( void )
+{
+    return MIN_ALARM_DELAY;
+}
+
+uint32_t RtcMs2Tick( TimerTime_t milliseconds )
+{
+    return ( uint32_t )( ( ( uint64_t )milliseconds * RTC_TICKS_IN_SEC ) / 1000 );
+}
+
+TimerTime_t RtcTick2Ms( uint32_t tick )
+{
+    return ( TimerTime_t )( ( ( uint64_t )tick * 1000 ) / RTC_TICKS_IN_SEC );
+}
+
+void RtcDelayMs( TimerTime_t milliseconds )
+{
+    HostAdvance( ( uint64_t )milliseconds * 1000 );
+}
+
+void RtcSetMcuWakeUpTime( void )
+{
+}
+
+int16_t RtcGetMcuWakeUpTime( void )
+{
+    return 0;
+}
+
+void RtcSetAlarm( uint32_t timeout )
+{
+    RtcStartAlarm( timeout );
+}
+
+void RtcStopAlarm( void )
+{
+    HostEventCancel( &RtcTimerContext.Alarm );
+}
+
+void RtcStartAlarm( uint32_t timeout )
+{
+    uint64_t now = RtcTimeToTicks( HostGetTime( ) );
+    // The alarm is relative to the timer context
+    int32_t delta = ( int32_t )( RtcTimerContext.Time + timeout - ( uint32_t )now );
+
+    if( delta < 0 )
+    {
+        delta = 0;
+    }
+    HostEventSchedule( &RtcTimerContext.Alarm, RtcTicksToTime( now + delta ) + HostGetIrqLatency( ),
+                       RtcAlarmIrq, NULL );
+}
+
+uint32_t RtcGetTimerValue( void )
+{
+    return ( uint32_t )RtcTimeToTicks( HostGetTime( ) );
+}
+
+uint32_t RtcGetTimerElapsedTime( void )
+{
+    return( ( uint32_t )( RtcGetTimerValue( ) - RtcTimerContext.Time ) );
+}
+
+uint32_t RtcGetCalendarTime( uint16_t *milliseconds )
+{
+    uint64_t ticks = RtcTimeToTicks( HostGetTime( ) );
+
+    *milliseconds = ( uint16_t )( ( ticks * 1000 / RTC_TICKS_IN_SEC ) % 1000 );
+    return ( uint32_t )( ticks / RTC_TICKS_IN_SEC );
+}
+
+void RtcBkupWrite( uint32_t data0, uint32_t data1 )
+{
+    RtcBkupData0 = data0;
+    RtcBkupData1 = data1;
+}
+
+void RtcBkupRead( uint32_t *data0, uint32_t *data1 )
+{
+    *data0 = RtcBkupData0;
+    *data1 = RtcBkupData1;
+}
+
+void RtcProcess( void )
+{
+}
+
+TimerTime_t RtcTempCompensation( TimerTime_t period, float temperature )
+{
+    ( void )temperature;
+    return period;
+}
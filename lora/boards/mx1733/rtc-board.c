@@ -3,6 +3,12 @@
  *
  * \brief     Target board RTC timer and low power modes management with FreeRTOS on MX1733 DevKit
  *
+ * \remark    By default (TIMER_BACKEND_RTC) the alarm is a FreeRTOS timer,
+ *            and the timer task wakes the LoRa task when it expires. With
+ *            TIMER_BACKEND_OS the LoRa task waits for its notifications
+ *            with the time left until the alarm as timeout and runs the
+ *            timers itself.
+ *
  * \author    Ogulcan Bal ( MatchX )
  *
  */
@@ -33,7 +39,13 @@
 typedef struct
 {
   uint32_t  Time;         // Reference time
+  uint32_t  Alarm;        // RTC time of the alarm
+#if defined( TIMER_BACKEND_OS )
+  bool      AlarmSet;     // Is the alarm pending
+  OS_TASK   Task;         // LoRa task, which waits for the alarm
+#else
   OS_TIMER  timer_handle; // FreeRTOS timer handle
+#endif
 }RtcTimerContext_t;
 
 /*!
@@ -43,16 +55,70 @@ typedef struct
  */
 static RtcTimerContext_t RtcTimerContext;
 
+/*!
+ * RTC alarm statistics
+ */
+static RtcAlarmStats_t RtcAlarmStats;
+
+/*!
+ * Offset of the system time to the calendar time, set by SysTimeSet from
+ * the network time of DeviceTimeAns. Kept in retention RAM across sleep.
+ */
+PRIVILEGED_DATA static uint32_t RtcBkupData0;
+PRIVILEGED_DATA static uint32_t RtcBkupData1;
+
+/*!
+ * \brief Converts RTC ticks to OS ticks, rounding up
+ *
+ * \param[IN] tick Time in RTC ticks
+ * \retval returns time in OS ticks
+ */
+static TickType_t RtcTick2OsTick( uint32_t tick )
+{
+  return ( TickType_t )( ( ( uint64_t )tick * configTICK_RATE_HZ + \
+    RTC_TICKS_IN_SEC - 1 ) / RTC_TICKS_IN_SEC );
+}
+
+/*!
+ * \brief Runs the timers of the alarm in the LoRa task
+ */
+static void RtcAlarmIrq( void )
+{
+  int32_t late = ( int32_t )( RtcGetTimerValue( ) - RtcTimerContext.Alarm );
+
+  if( ( RtcAlarmStats.Alarms == 0 ) || ( late < RtcAlarmStats.LateMin ) )
+  {
+    RtcAlarmStats.LateMin = late;
+  }
+  if( ( RtcAlarmStats.Alarms == 0 ) || ( late > RtcAlarmStats.LateMax ) )
+  {
+    RtcAlarmStats.LateMax = late;
+  }
+  RtcAlarmStats.LateSum += late;
+  RtcAlarmStats.Alarms++;
+
+  TimerIrqHandler( );
+}
+
+#if !defined( TIMER_BACKEND_OS )
 /*!
  * \brief Function executed on rtc_timer_cb Timeout event
  */
 static void rtc_timer_cb(OS_TIMER timer)
 {
-  lora_task_notify_event(EVENT_NOTIF_LORAMAC, TimerIrqHandler);
+  // The LoRa task counts its own wake-up for EVENT_NOTIF_TIMER
+  RtcCountWakeup( );
+  lora_task_notify_event(EVENT_NOTIF_LORAMAC | EVENT_NOTIF_TIMER, RtcAlarmIrq);
 }
+#endif
 
 void RtcInit( void )
 {
+  RtcAlarmStats.Since = RtcGetTimerValue( );
+#if defined( TIMER_BACKEND_OS )
+  // Called from the LoRa task
+  RtcTimerContext.Task = OS_GET_CURRENT_TASK( );
+#else
   if(RtcTimerContext.timer_handle == NULL)
   {
     RtcTimerContext.timer_handle = OS_TIMER_CREATE("rtctimer", \
@@ -60,6 +126,7 @@ void RtcInit( void )
       (void *) OS_GET_CURRENT_TASK(), rtc_timer_cb);
     OS_ASSERT(RtcTimerContext.timer_handle);
   }
+#endif
 }
 
 /*!
@@ -138,11 +205,66 @@ void RtcDelayMs( uint32_t delay )
 
 void RtcSetAlarm( uint32_t timeout )
 {
-  OS_ASSERT(RtcTimerContext.timer_handle);
-
   RtcStartAlarm( timeout );
 }
 
+#if defined( TIMER_BACKEND_OS )
+/*
+ * The alarm is the timeout of the LoRa task wait for notifications, so
+ * the timers run in the LoRa task without the timer task and without a
+ * notification.
+ */
+void RtcStopAlarm( void )
+{
+  RtcTimerContext.AlarmSet = false;
+}
+
+void RtcStartAlarm( uint32_t timeout )
+{
+  RtcTimerContext.Alarm = RtcTimerContext.Time + timeout;
+  RtcTimerContext.AlarmSet = true;
+
+  // Have the LoRa task wait again if it waits for an older alarm. Started
+  // from the LoRa task itself, it computes the new timeout before its
+  // next wait, and a notification would only wake it for nothing.
+  if( OS_GET_CURRENT_TASK( ) != RtcTimerContext.Task )
+  {
+    lora_task_notify_event(EVENT_NOTIF_TIMER, NULL);
+  }
+}
+
+uint32_t RtcGetAlarmTimeout( void )
+{
+  int32_t remaining;
+
+  if( RtcTimerContext.AlarmSet == false )
+  {
+    return OS_TASK_NOTIFY_FOREVER;
+  }
+  remaining = ( int32_t )( RtcTimerContext.Alarm - RtcGetTimerValue( ) );
+  if( remaining < ( int32_t )MIN_ALARM_DELAY )
+  {
+    return 0;
+  }
+  return RtcTick2OsTick( remaining );
+}
+
+void RtcProcess( void )
+{
+  int32_t remaining;
+
+  if( RtcTimerContext.AlarmSet == false )
+  {
+    return;
+  }
+  remaining = ( int32_t )( RtcTimerContext.Alarm - RtcGetTimerValue( ) );
+  if( remaining < ( int32_t )MIN_ALARM_DELAY )
+  {
+    RtcTimerContext.AlarmSet = false;
+    RtcAlarmIrq( );
+  }
+}
+#else
 void RtcStopAlarm( void )
 {
   OS_ASSERT(RtcTimerContext.timer_handle);
@@ -154,7 +276,9 @@ void RtcStartAlarm( uint32_t timeout )
 {
   OS_ASSERT(RtcTimerContext.timer_handle);
 
-  uint32_t period = OS_MS_2_TICKS(RtcTick2Ms(timeout));
+  TickType_t period = RtcTick2OsTick( timeout );
+
+  RtcTimerContext.Alarm = RtcTimerContext.Time + timeout;
 
   OS_TIMER_CHANGE_PERIOD(RtcTimerContext.timer_handle, \
     period, OS_TIMER_FOREVER);
@@ -166,6 +290,26 @@ void RtcStartAlarm( uint32_t timeout )
 #endif
 }
 
+void RtcProcess( void )
+{
+}
+#endif
+
+void RtcCountWakeup( void )
+{
+  // The timer task and the LoRa task both count
+  CRITICAL_SECTION_BEGIN( );
+  RtcAlarmStats.Wakeups++;
+  CRITICAL_SECTION_END( );
+}
+
+void RtcGetAlarmStats( RtcAlarmStats_t *stats )
+{
+  CRITICAL_SECTION_BEGIN( );
+  *stats = RtcAlarmStats;
+  CRITICAL_SECTION_END( );
+}
+
 uint32_t RtcGetTimerValue( void )
 {
   return (rtc_get() & 0xFFFFFFFF);
@@ -178,17 +322,20 @@ uint32_t RtcGetTimerElapsedTime( void )
 
 uint32_t RtcGetCalendarTime( uint16_t *milliseconds )
 {
-  uint32_t ticks = RtcGetTimerValue();
-  *milliseconds = RtcTick2Ms( ticks ) % 1000;
-  return (RtcTick2Ms(ticks) / 1000);
+  // The full RTC count, the 32 bit timer value in ms wraps in 131 s
+  uint64_t ticks = rtc_get();
+  *milliseconds = ( ticks % RTC_TICKS_IN_SEC ) * 1000 / RTC_TICKS_IN_SEC;
+  return ( uint32_t )( ticks / RTC_TICKS_IN_SEC );
 }
 
 void RtcBkupWrite( uint32_t data0, uint32_t data1 )
 {
-  // Not used on this platform.
+  RtcBkupData0 = data0;
+  RtcBkupData1 = data1;
 }
 
 void RtcBkupRead( uint32_t *data0, uint32_t *data1 )
 {
-  // Not used on this platform.
+  *data0 = RtcBkupData0;
+  *data1 = RtcBkupData1;
 }
@@ -45,3 +45,37 @@ uint16_t SpiInOut( Spi_t *obj, uint16_t outData )
   return( rxData );
 }
 
+void SpiTransfer( Spi_t *obj, const uint8_t *out, uint8_t *in, uint16_t size )
+{
+  if( size == 0 )
+  {
+    return;
+  }
+
+  // A single register access does not pay for the block setup
+  if( size == 1 )
+  {
+    uint8_t rxData = SpiInOut( obj, ( out != NULL ) ? out[0] : 0 );
+
+    if( in != NULL )
+    {
+      in[0] = rxData;
+    }
+    return;
+  }
+
+  // The SDK keeps the FIFO full for the whole block and waits once,
+  // instead of twice per byte as SpiInOut does
+  if( ( out != NULL ) && ( in != NULL ) )
+  {
+    hw_spi_writeread_buf(HW_LORA_SPI, out, in, size, NULL, NULL);
+  }
+  else if( out != NULL )
+  {
+    hw_spi_write_buf(HW_LORA_SPI, out, size, NULL, NULL);
+  }
+  else
+  {
+    hw_spi_read_buf(HW_LORA_SPI, in, size, NULL, NULL);
+  }
+}
@@ -47,6 +47,19 @@
  */
 #define RTC_TEMP_DEV_TURNOVER                           ( 5.0 )
 
+/*!
+ * \brief RTC alarm statistics
+ */
+typedef struct RtcAlarmStats_s
+{
+    uint32_t Since;                      //! RTC time the statistics start at
+    uint32_t Wakeups;                    //! LoRa task and timer task wake-ups for the alarm
+    uint32_t Alarms;                     //! Alarms served
+    int32_t LateMin;                     //! Smallest delay from the alarm time to its timers, in ticks
+    int32_t LateMax;                     //! Largest delay from the alarm time to its timers, in ticks
+    int32_t LateSum;                     //! Sum of the delays, in ticks
+}RtcAlarmStats_t;
+
 /*!
  * \brief Initializes the RTC timer
  *
@@ -189,4 +202,34 @@ void RtcProcess( void );
  */
 TimerTime_t RtcTempCompensation( TimerTime_t period, float temperature );
 
+/*!
+ * \brief Counts a task wake-up for the alarm
+ *
+ * \remark Called by the timer task callback of the alarm and by the LoRa
+ *         task when its wait returns for the alarm, on a timeout or on
+ *         the alarm notification, possibly together with other events.
+ *         The timer task also wakes up for the start and stop commands of
+ *         the FreeRTOS timer, which are not counted.
+ */
+void RtcCountWakeup( void );
+
+/*!
+ * \brief Reads the alarm statistics
+ *
+ * \param [OUT] stats Alarm statistics since RtcInit
+ */
+void RtcGetAlarmStats( RtcAlarmStats_t *stats );
+
+#if defined( TIMER_BACKEND_OS )
+/*!
+ * \brief Returns the time left until the alarm
+ *
+ * \remark The task running \ref RtcProcess waits for at most this time.
+ *
+ * \retval timeout Time in OS ticks, 0 when the alarm is due or the OS wait
+ *                 forever value without alarm
+ */
+uint32_t RtcGetAlarmTimeout( void );
+#endif
+
 #endif // __RTC_BOARD_H__
@@ -0,0 +1,251 @@
+/* Uplink fragmentation with XOR parity */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "lora/frag.h"
+
+/*
+ * A payload longer than the room of an uplink is split in fragments
+ * of the same size but the last, sent on FRAG_PORT one per uplink:
+ *
+ *	session (4 bits), data fragments - 1 (4 bits)
+ *	parity fragments (3 bits), fragment index (5 bits)
+ *	data
+ *
+ * The data fragments come first. Parity fragment j is the XOR of the
+ * data fragments i with i % parity == j, zero padded to the fragment
+ * size, after the length of the last data fragment. It rebuilds one
+ * lost data fragment of its group. The session changes with each split
+ * so the receiver drops the fragments of an older one.
+ */
+#define FRAG_SESSION_SHIFT	4
+#define FRAG_SESSION_MASK	0x0f
+#define FRAG_COUNT_MASK		0x0f
+#define FRAG_PARITY_SHIFT	5
+#define FRAG_INDEX_MASK		0x1f
+
+/* Length of data fragment i */
+static uint8_t
+frag_len(const struct frag *f, uint8_t i)
+{
+	int	left = f->len - i * f->size;
+
+	return left < f->size ? left : f->size;
+}
+
+static void
+xor(uint8_t *dest, const uint8_t *src, uint8_t len)
+{
+	while (len--)
+		*dest++ ^= *src++;
+}
+
+/* Takes a copy of the payload, then splits it for the room */
+int
+frag_start(struct frag *f, const uint8_t *data, uint8_t len, uint8_t room,
+    uint8_t parity)
+{
+	if (len == 0 || len > FRAG_MAX_LEN)
+		return -1;
+	memcpy(f->data, data, len);
+	f->len = len;
+	f->parity = parity < FRAG_PARITY_MAX ? parity : FRAG_PARITY_MAX;
+	f->count = 0;
+	return frag_split(f, room);
+}
+
+/*
+ * Splits the payload again, in a new session, for fragments that fit
+ * in room bytes. Fails when that takes more than FRAG_MAX fragments,
+ * and once the data fragments are out, as only parity is left.
+ */
+int
+frag_split(struct frag *f, uint8_t room)
+{
+	uint8_t	hdr = FRAG_HDR_LEN + (f->parity != 0);
+
+	if (f->count != 0 && f->next >= f->count)
+		room = 0;
+	f->count = 0;
+	if (room <= hdr || (f->len + room - hdr - 1) / (room - hdr) > FRAG_MAX)
+		return -1;
+	f->size = room - hdr < f->len ? room - hdr : f->len;
+	f->count = (f->len + f->size - 1) / f->size;
+	if (f->parity > f->count)
+		f->parity = f->count;
+	f->next = 0;
+	f->session = (f->session + 1) & FRAG_SESSION_MASK;
+	return 0;
+}
+
+bool
+frag_pending(const struct frag *f)
+{
+	return f->next < f->count + f->parity && f->count != 0;
+}
+
+/*
+ * Writes the next fragment to buf. Returns its length, 0 if there is
+ * none or it does not fit in maxlen bytes.
+ */
+uint8_t
+frag_encode(const struct frag *f, uint8_t *buf, uint8_t maxlen)
+{
+	uint8_t	k = f->next, i, n;
+
+	if (!frag_pending(f))
+		return 0;
+	n = k < f->count ? frag_len(f, k) : 1 + f->size;
+	if (FRAG_HDR_LEN + n > maxlen)
+		return 0;
+	buf[0] = f->session << FRAG_SESSION_SHIFT | (f->count - 1);
+	buf[1] = f->parity << FRAG_PARITY_SHIFT | k;
+	if (k < f->count) {
+		memcpy(buf + FRAG_HDR_LEN, f->data + k * f->size, n);
+		return FRAG_HDR_LEN + n;
+	}
+	buf[FRAG_HDR_LEN] = frag_len(f, f->count - 1);
+	memset(buf + FRAG_HDR_LEN + 1, 0, f->size);
+	for (i = k - f->count; i < f->count; i += f->parity)
+		xor(buf + FRAG_HDR_LEN + 1, f->data + i * f->size,
+		    frag_len(f, i));
+	return FRAG_HDR_LEN + n;
+}
+
+/* The fragment encoded last was sent */
+void
+frag_commit(struct frag *f)
+{
+	if (frag_pending(f) && ++f->next == f->count + f->parity)
+		frag_abort(f);
+}
+
+void
+frag_abort(struct frag *f)
+{
+	f->count = 0;
+	f->parity = 0;
+	f->next = 0;
+}
+
+/* Data fragment i of a receive, zero padded to the fragment size */
+static void
+frag_rx_xor(const struct frag_rx *r, uint8_t *dest, uint8_t i)
+{
+	if (i < r->count - 1)
+		xor(dest, r->data + i * r->size, r->size);
+	else
+		xor(dest, r->tail, r->last);
+}
+
+/* Rebuilds the lost data fragments, 0 when some cannot be rebuilt yet */
+static int
+frag_rx_recover(struct frag_rx *r)
+{
+	uint8_t	tmp[FRAG_MAX_LEN];
+	uint8_t	step = r->nparity != 0 ? r->nparity : 1;
+	uint8_t	i, j, lost, nlost;
+
+	for (j = 0; j < step; j++) {
+		for (i = j, nlost = 0; i < r->count; i += step) {
+			if (!(r->have & 1 << i))
+				nlost++;
+		}
+		if (nlost > 1 ||
+		    (nlost == 1 && !(r->have_parity & 1 << j)))
+			return 0;
+	}
+	for (j = 0; j < r->nparity; j++) {
+		memcpy(tmp, r->parity[j], r->size);
+		for (i = j, lost = r->count; i < r->count; i += step) {
+			if (r->have & 1 << i)
+				frag_rx_xor(r, tmp, i);
+			else
+				lost = i;
+		}
+		if (lost == r->count)
+			continue;
+		if (lost < r->count - 1)
+			memcpy(r->data + lost * r->size, tmp, r->size);
+		else
+			memcpy(r->tail, tmp, r->last);
+		r->have |= 1 << lost;
+		r->recovered++;
+	}
+	return 1;
+}
+
+/*
+ * Adds a fragment received on FRAG_PORT. Returns the length of the
+ * payload in r->data once it is complete, 0 until then and for the
+ * fragments after, -1 for a fragment that does not fit its session.
+ */
+int
+frag_decode(struct frag_rx *r, const uint8_t *buf, uint8_t len)
+{
+	uint8_t	session, count, nparity, k, n, size = 0, last = 0;
+	const uint8_t	*p = buf + FRAG_HDR_LEN;
+
+	if (len <= FRAG_HDR_LEN)
+		return -1;
+	session = buf[0] >> FRAG_SESSION_SHIFT;
+	count = (buf[0] & FRAG_COUNT_MASK) + 1;
+	nparity = buf[1] >> FRAG_PARITY_SHIFT;
+	k = buf[1] & FRAG_INDEX_MASK;
+	n = len - FRAG_HDR_LEN;
+	if (nparity > FRAG_PARITY_MAX || nparity > count ||
+	    k >= count + nparity)
+		return -1;
+	if (!r->active || session != r->session || count != r->count ||
+	    nparity != r->nparity) {
+		memset(r, 0, sizeof(*r));
+		r->active = true;
+		r->session = session;
+		r->count = count;
+		r->nparity = nparity;
+	}
+	if (r->done)
+		return 0;
+
+	if (k < count - 1)
+		size = n;
+	else if (k == count - 1)
+		last = n;
+	else {
+		last = *p++;
+		size = --n;
+	}
+	if (n == 0 || n > FRAG_MAX_LEN || (k >= count && last == 0) ||
+	    (size != 0 && r->size != 0 && size != r->size) ||
+	    (last != 0 && r->last != 0 && last != r->last))
+		return -1;
+	if (size != 0)
+		r->size = size;
+	if (last != 0)
+		r->last = last;
+	if (k < count - 1 && (k + 1) * r->size > FRAG_MAX_LEN)
+		return -1;
+	if (k < count - 1)
+		memcpy(r->data + k * r->size, p, n);
+	else if (k == count - 1)
+		memcpy(r->tail, p, n);
+	else
+		memcpy(r->parity[k - count], p, n);
+	if (k < count)
+		r->have |= 1 << k;
+	else
+		r->have_parity |= 1 << (k - count);
+
+	if (r->last == 0 || (count > 1 && r->size == 0))
+		return 0;
+	if ((count > 1 && r->last > r->size) ||
+	    (count - 1) * r->size + r->last > FRAG_MAX_LEN)
+		return -1;
+	if (!frag_rx_recover(r))
+		return 0;
+	memcpy(r->data + (count - 1) * r->size, r->tail, r->last);
+	r->done = true;
+	return (count - 1) * r->size + r->last;
+}
@@ -0,0 +1,50 @@
+#ifndef __FRAG_H__
+#define __FRAG_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define FRAG_PORT		0x03
+#define FRAG_MAX_LEN		242	/* largest uplink payload */
+#define FRAG_MAX		16	/* data fragments of a payload */
+#define FRAG_PARITY_MAX		4
+#define FRAG_HDR_LEN		2
+
+/* A payload split in fragments, sent one per uplink */
+struct frag {
+	uint8_t		data[FRAG_MAX_LEN];
+	uint8_t		len;
+	uint8_t		size;		/* payload bytes of each fragment */
+	uint8_t		count;		/* data fragments */
+	uint8_t		parity;		/* parity fragments */
+	uint8_t		next;		/* fragment to send next */
+	uint8_t		session;
+};
+
+/* The fragments of a payload received so far */
+struct frag_rx {
+	uint8_t		data[FRAG_MAX_LEN];
+	uint8_t		tail[FRAG_MAX_LEN];	/* last data fragment */
+	uint8_t		parity[FRAG_PARITY_MAX][FRAG_MAX_LEN];
+	uint16_t	have;		/* data fragments received */
+	uint8_t		have_parity;
+	uint8_t		session;
+	uint8_t		count;
+	uint8_t		nparity;
+	uint8_t		size;		/* 0 until known */
+	uint8_t		last;		/* length of the tail, 0 until known */
+	bool		active;
+	bool		done;
+	uint8_t		recovered;	/* fragments rebuilt from parity */
+};
+
+int	frag_start(struct frag *f, const uint8_t *data, uint8_t len,
+	    uint8_t room, uint8_t parity);
+int	frag_split(struct frag *f, uint8_t room);
+bool	frag_pending(const struct frag *f);
+uint8_t	frag_encode(const struct frag *f, uint8_t *buf, uint8_t maxlen);
+void	frag_commit(struct frag *f);
+void	frag_abort(struct frag *f);
+int	frag_decode(struct frag_rx *r, const uint8_t *buf, uint8_t len);
+
+#endif /* __FRAG_H__ */
@@ -2,6 +2,7 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "osal.h"
 #include "sys_watchdog.h"
@@ -14,15 +15,19 @@
 #include "hw/hw.h"
 #include "hw/iox.h"
 #include "hw/led.h"
+#include "hw/power.h"
 #include "lora/ad_lora.h"
 #include "lora/lora.h"
+#include "lora/nvmctx.h"
 #include "lora/param.h"
 #include "lora/proto.h"
 #include "lora/upgrade.h"
 #include "lora/util.h"
 #include "lora/boards/board.h"
+#include "lora/boards/rtc-board.h"
 #include "lora/boards/sx1276-board.h"
 #include "lora/mac/LoRaMac.h"
+#include "lora/system/timer.h"
 #include "sensor/sensor.h"
 #include "sensor/bat.h"
 #include "sensor/gps.h"
@@ -32,7 +37,8 @@
 //#define DEBUG_STATE
 //#define BLE_ALWAYS_ON
 
-#define MAX_SENSOR_SAMPLE_TIME	OS_MS_2_TICKS(2 * 1000)
+/* A guard only, the GPS ends its acquisition within its time budget */
+#define MAX_SENSOR_SAMPLE_TIME	OS_MS_2_TICKS(256 * 1000)
 PRIVILEGED_DATA static TickType_t	sampling_since;
 
 #define JOIN_TIMEOUT		  OS_MS_2_TICKS(2 * 60 * 60 * 1000)
@@ -63,6 +69,12 @@ PRIVILEGED_DATA static TickType_t	sampling_since;
  */
 #define APP_TX_DUTYCYCLE_RND                        1000
 
+/*!
+ * Timing error of the receive windows, value in [ms]. The MAC opens
+ * them from the captured radio interrupt and learns the latencies.
+ */
+#define LORAWAN_MAX_RX_ERROR                        5
+
 /*!
  * Default datarate
  */
@@ -107,6 +119,7 @@ PRIVILEGED_DATA static enum eDevicState
     DEVICE_STATE_JOIN,
     DEVICE_STATE_PREPARE_TX,
     DEVICE_STATE_SEND,
+    DEVICE_STATE_SEND_NEXT,
     DEVICE_STATE_CYCLE,
     DEVICE_STATE_SLEEP,
 }DeviceState;
@@ -134,6 +147,7 @@ PRIVILEGED_DATA static loramac_cb_t *gp_loramac_cb;
 PRIVILEGED_DATA static OS_TASK lora_task_handle;
 PRIVILEGED_DATA static OS_TIMER next_tx_timer;
 PRIVILEGED_DATA static OS_TIMER prepare_tx_timer;
+PRIVILEGED_DATA static OS_TIMER send_retry_timer;
 
 PRIVILEGED_DATA static DioIrqHandler **gp_irqHandlers;
 
@@ -142,6 +156,71 @@ PRIVILEGED_DATA static DioIrqHandler **gp_irqHandlers;
  */
 INITIALISED_PRIVILEGED_DATA static bool NextTx = true;
 
+/*
+ * Uplink queue. The frames wait by class until an uplink has room for
+ * them, the highest class and the oldest first, and leave once the MAC
+ * confirmed the uplink that carried them. A full queue pushes out the
+ * oldest frame of its lowest class, unless that is above the new one.
+ * A frame whose uplinks failed TXQ_TRIES times is dropped, so a radio
+ * that keeps failing does not send it back to back forever.
+ */
+#define TXQ_LEN 8
+#define TXQ_TRIES 3
+
+enum txq_state {
+  TXQ_FREE,
+  TXQ_QUEUED,
+  TXQ_FILLED,		/* in the uplink being built */
+  TXQ_INFLIGHT,		/* in the uplink being sent */
+};
+
+struct txq_frame {
+  uint8_t state;
+  uint8_t cls;
+  uint8_t port;
+  uint8_t len;
+  uint8_t tries;		/* uplinks that failed */
+  uint32_t seq;
+  uint8_t data[LORA_TXQ_FRAME_MAX];
+};
+
+PRIVILEGED_DATA static struct txq_frame txq[TXQ_LEN];
+PRIVILEGED_DATA static uint32_t txq_seq;
+PRIVILEGED_DATA static struct lora_txq_stats txq_stats[LORA_TX_CLASSES];
+
+/* Moves the frames in one state to another */
+static void
+txq_settle(uint8_t from, uint8_t to)
+{
+  int i;
+
+  for (i = 0; i < TXQ_LEN; i++) {
+    if (txq[i].state != from)
+      continue;
+    txq[i].state = to;
+    if (to == TXQ_FREE)
+      txq_stats[txq[i].cls].sent++;
+  }
+}
+
+/* Queues the frames of a failed uplink again, or drops them */
+static void
+txq_failed(void)
+{
+  int i;
+
+  for (i = 0; i < TXQ_LEN; i++) {
+    if (txq[i].state != TXQ_INFLIGHT)
+      continue;
+    if (++txq[i].tries < TXQ_TRIES) {
+      txq[i].state = TXQ_QUEUED;
+      continue;
+    }
+    txq[i].state = TXQ_FREE;
+    txq_stats[txq[i].cls].dropped++;
+  }
+}
+
 #ifdef DEBUG
 
 #ifdef DEBUG_STATE
@@ -196,13 +275,63 @@ static void JoinNetwork( void )
   }
 }
 
-void
-lora_send(uint8_t *data, size_t len)
+#ifdef FEATURE_SENSOR_GPS
+/*!
+ * Asks the network time with the next uplink, to aid the GPS receiver
+ */
+static void DeviceTimeReq( void )
+{
+  LoRaMacStatus_t status;
+  MlmeReq_t mlmeReq;
+  mlmeReq.Type = MLME_DEVICE_TIME;
+
+  status = LoRaMacMlmeRequest( &mlmeReq );
+#ifdef DEBUG
+  debug_time();
+  printf( "MLME-Request - MLME_DEVICE_TIME: %d\r\n", status );
+#else
+  (void)status;
+#endif
+}
+#endif
+
+/*
+ * Returns the MAC frame buffer to build the next uplink in, its size in len
+ * and in room the part left at the data rate of the uplink by the pending
+ * MAC commands. While the MAC is busy the uplink is retried on the next
+ * cycle, as for a failed send.
+ */
+uint8_t *
+lora_tx_buffer(size_t *len, size_t *room)
+{
+  LoRaMacTxInfo_t txInfo;
+  uint8_t *buf, size;
+
+  if ((buf = LoRaMacGetPayloadBuffer(&size)) == NULL) {
+    NextTx = true;
+    return NULL;
+  }
+  txInfo.MaxPossibleApplicationDataSize = 0;
+  LoRaMacQueryTxPossible(0, &txInfo);
+  *len = size;
+  *room = size < txInfo.MaxPossibleApplicationDataSize ? size :
+      txInfo.MaxPossibleApplicationDataSize;
+  return buf;
+}
+
+/*
+ * Returns 0 when the data went out. Data that does not fit is not sent,
+ * an empty uplink flushes the MAC commands that took its room instead.
+ */
+int
+lora_send(uint8_t port, uint8_t *data, size_t len)
 {
   McpsReq_t mcpsReq;
   LoRaMacTxInfo_t txInfo;
+  bool fits;
 
-  if(LoRaMacQueryTxPossible(len, &txInfo) != LORAMAC_STATUS_OK)
+  fits = LoRaMacQueryTxPossible(len, &txInfo) == LORAMAC_STATUS_OK;
+  if(!fits)
   {
     // Send empty frame in order to flush MAC commands
     mcpsReq.Type = MCPS_UNCONFIRMED;
@@ -215,7 +344,7 @@ lora_send(uint8_t *data, size_t len)
     if( ComplianceTest.IsTxConfirmed == false )
     {
       mcpsReq.Type = MCPS_UNCONFIRMED;
-      mcpsReq.Req.Unconfirmed.fPort = 1;
+      mcpsReq.Req.Unconfirmed.fPort = port;
       mcpsReq.Req.Unconfirmed.fBuffer = data;
       mcpsReq.Req.Unconfirmed.fBufferSize = len;
       mcpsReq.Req.Unconfirmed.Datarate = DR_0;
@@ -223,7 +352,7 @@ lora_send(uint8_t *data, size_t len)
     else
     {
       mcpsReq.Type = MCPS_CONFIRMED;
-      mcpsReq.Req.Confirmed.fPort = 1;
+      mcpsReq.Req.Confirmed.fPort = port;
       mcpsReq.Req.Confirmed.fBuffer = data;
       mcpsReq.Req.Confirmed.fBufferSize = len;
       mcpsReq.Req.Confirmed.NbTrials = 8;
@@ -237,6 +366,117 @@ lora_send(uint8_t *data, size_t len)
   }else{
     NextTx = true;
   }
+  if (NextTx || !fits || len == 0) {
+    txq_settle(TXQ_FILLED, TXQ_QUEUED);
+    return len != 0 || NextTx ? -1 : 0;
+  }
+  txq_settle(TXQ_FILLED, TXQ_INFLIGHT);
+  return 0;
+}
+
+/*
+ * Queues a frame of the class for the next uplinks on the port. Returns
+ * -1 when it is dropped.
+ */
+int
+lora_enqueue(uint8_t cls, uint8_t port, const uint8_t *data, size_t len)
+{
+  struct txq_frame *f = NULL, *victim = NULL;
+  int i;
+
+  if (cls >= LORA_TX_CLASSES)
+    return -1;
+  if (len == 0 || len > LORA_TXQ_FRAME_MAX) {
+    txq_stats[cls].dropped++;
+    return -1;
+  }
+  for (i = 0; i < TXQ_LEN && f == NULL; i++) {
+    if (txq[i].state == TXQ_FREE)
+      f = &txq[i];
+    else if (txq[i].state == TXQ_QUEUED && (victim == NULL ||
+        txq[i].cls > victim->cls ||
+        (txq[i].cls == victim->cls && txq[i].seq < victim->seq)))
+      victim = &txq[i];
+  }
+  if (f == NULL) {
+    if (victim == NULL || victim->cls < cls) {
+      txq_stats[cls].dropped++;
+      return -1;
+    }
+    txq_stats[victim->cls].dropped++;
+    f = victim;
+  }
+  f->state = TXQ_QUEUED;
+  f->cls = cls;
+  f->port = port;
+  f->len = len;
+  f->tries = 0;
+  f->seq = txq_seq++;
+  memcpy(f->data, data, len);
+  txq_stats[cls].queued++;
+  return 0;
+}
+
+/* The queued frame of the port to send next that fits in room bytes */
+static struct txq_frame *
+txq_next(uint8_t port, size_t room)
+{
+  struct txq_frame *next = NULL;
+  int i;
+
+  for (i = 0; i < TXQ_LEN; i++) {
+    if (txq[i].state != TXQ_QUEUED || txq[i].port != port ||
+        txq[i].len > room)
+      continue;
+    if (next == NULL || txq[i].cls < next->cls ||
+        (txq[i].cls == next->cls && txq[i].seq < next->seq))
+      next = &txq[i];
+  }
+  return next;
+}
+
+/*
+ * Coalesces the queued frames of the port that fit in maxlen bytes into
+ * buf, by class. lora_send() then keeps them until the MAC confirmed
+ * the uplink, or queues them again when it could not send it.
+ */
+size_t
+lora_txq_fill(uint8_t port, uint8_t *buf, size_t maxlen)
+{
+  struct txq_frame *f;
+  size_t len = 0;
+
+  while ((f = txq_next(port, maxlen - len)) != NULL) {
+    memcpy(buf + len, f->data, f->len);
+    len += f->len;
+    f->state = TXQ_FILLED;
+  }
+  return len;
+}
+
+/* The frames filled last are sent in other ways, as fragments */
+void
+lora_txq_commit(void)
+{
+  txq_settle(TXQ_FILLED, TXQ_FREE);
+}
+
+bool
+lora_txq_pending(void)
+{
+  int i;
+
+  for (i = 0; i < TXQ_LEN; i++) {
+    if (txq[i].state == TXQ_QUEUED)
+      return true;
+  }
+  return false;
+}
+
+const struct lora_txq_stats *
+lora_txq_stats(uint8_t cls)
+{
+  return cls < LORA_TX_CLASSES ? &txq_stats[cls] : NULL;
 }
 
 /*!
@@ -284,6 +524,16 @@ static void lora_tx_ready_cb(OS_TIMER timer)
   lora_task_notify_event(EVENT_NOTIF_LORAMAC, NULL);
 }
 
+/*!
+ * \brief Function executed on send_retry_timer Timeout event
+ */
+static void send_retry_cb(OS_TIMER timer)
+{
+  if (DeviceState == DEVICE_STATE_SLEEP)
+    DeviceState = DEVICE_STATE_SEND_NEXT;
+  lora_task_notify_event(EVENT_NOTIF_LORAMAC, NULL);
+}
+
 /*!
  * \brief   MCPS-Confirm event function
  *
@@ -318,7 +568,17 @@ static void McpsConfirm( McpsConfirm_t *mcpsConfirm )
         break;
     }
   }
+  // The frames of the uplink are out, or wait for the next one
+  if (mcpsConfirm->Status == LORAMAC_EVENT_INFO_STATUS_OK)
+    txq_settle(TXQ_INFLIGHT, TXQ_FREE);
+  else
+    txq_failed();
   NextTx = true;
+  // The frame counter is saved once the receive windows are over
+  nvmctx_txdone();
+  // The fragments of a split uplink and the queued frames follow
+  if (DeviceState == DEVICE_STATE_SLEEP && proto_tx_more())
+    DeviceState = DEVICE_STATE_SEND_NEXT;
   lora_task_notify_event(EVENT_NOTIF_LORAMAC, NULL);
 }
 
@@ -363,8 +623,9 @@ static void McpsIndication( McpsIndication_t *mcpsIndication )
   if( mcpsIndication->FramePending == true )
   {
       // The server signals that it has pending data to be sent.
-      // We schedule an uplink as soon as possible to flush the server.
-      proto_send_data();
+      // We schedule an uplink as soon as possible to flush the server,
+      // without reading the sensors, they are off until the next cycle.
+      proto_send_flush();
   }
   // Check Buffer
   // Check BufferSize
@@ -376,6 +637,12 @@ static void McpsIndication( McpsIndication_t *mcpsIndication )
   {
       ComplianceTest.DownLinkCounter++;
   }
+#ifdef FEATURE_SENSOR_GPS
+  if( mcpsIndication->DeviceTimeAnsReceived == true )
+  {
+    gps_time_sync( );
+  }
+#endif
 
   if( mcpsIndication->RxData == true )
   {
@@ -397,6 +664,8 @@ static void McpsIndication( McpsIndication_t *mcpsIndication )
  */
 static void MlmeConfirm( MlmeConfirm_t *mlmeConfirm )
 {
+  // The DevNonce of a join request is saved once it is answered or not
+  nvmctx_txdone();
   if( mlmeConfirm->Status == LORAMAC_EVENT_INFO_STATUS_OK )
   {
     switch( mlmeConfirm->MlmeRequest )
@@ -430,7 +699,7 @@ static void MlmeConfirm( MlmeConfirm_t *mlmeConfirm )
       default:
         break;
     }
-  }else{
+  }else if( mlmeConfirm->MlmeRequest == MLME_JOIN ){
     // Join was not successful. Try to join again
     JoinNetwork( );
   }
@@ -462,8 +731,9 @@ static void MlmeIndication( MlmeIndication_t *mlmeIndication )
   {
     case MLME_SCHEDULE_UPLINK:
     {
-      // The MAC signals that we shall provide an uplink as soon as possible
-      proto_send_data( );
+      // The MAC signals that we shall provide an uplink as soon as possible,
+      // the sensors are off until the next cycle
+      proto_send_flush( );
       break;
     }
     default:
@@ -479,6 +749,10 @@ void OnMacProcessNotify( void )
 static void
 lora_wkup_int_cb(void)
 {
+  /* TxDone, RxDone and RxTimeout, timed for the receive windows */
+  if (hw_gpio_get_pin_status(HW_LORA_DIO0_PORT, HW_LORA_DIO0_PIN) ||
+      hw_gpio_get_pin_status(HW_LORA_DIO1_PORT, HW_LORA_DIO1_PIN))
+    TimerCapture();
   if (hw_gpio_get_pin_status(HW_LORA_DIO0_PORT, HW_LORA_DIO0_PIN))
   {
     lora_task_notify_event(EVENT_NOTIF_LORA_DIO0, NULL);
@@ -548,6 +822,7 @@ lora_task_func(void *param)
 	lora_task_handle = OS_GET_CURRENT_TASK();
 	// check if the suota upgrade bit was set before reboot.
 	upgrade_init();
+	nvmctx_init();
 #ifdef BLE_ALWAYS_ON
 	ble_on();
 #endif
@@ -586,13 +861,16 @@ lora_task_func(void *param)
         LoRaMacPrimitives.MacMlmeIndication = MlmeIndication;
         LoRaMacCallbacks.GetBatteryLevel = NULL;
         LoRaMacCallbacks.GetTemperatureLevel = NULL;
-        LoRaMacCallbacks.NvmContextChange = NULL;
+        LoRaMacCallbacks.NvmContextChange = nvmctx_changed;
         LoRaMacCallbacks.MacProcessNotify = OnMacProcessNotify;
         status = LoRaMacInitialization( &LoRaMacPrimitives, &LoRaMacCallbacks, ACTIVE_REGION );
 
 #ifdef DEBUG_STATE
         printf("LoRaMacInitialization status: %d\r\n", status);
 #endif
+        // Resume the previous session, if any, instead of joining again
+        nvmctx_restore();
+
         mibReq.Type = MIB_DEV_EUI;
         mibReq.Param.DevEui = param_get_addr(PARAM_DEV_EUI);
         LoRaMacMibSetRequestConfirm( &mibReq );
@@ -623,6 +901,13 @@ lora_task_func(void *param)
           OS_ASSERT(prepare_tx_timer);
         }
 
+        if(send_retry_timer == NULL){
+          send_retry_timer = OS_TIMER_CREATE("sendretry", SEND_RETRY_TIME, \
+            OS_TIMER_FAIL, (void *) OS_GET_CURRENT_TASK(), send_retry_cb);
+
+          OS_ASSERT(send_retry_timer);
+        }
+
         mibReq.Type = MIB_PUBLIC_NETWORK;
         mibReq.Param.EnablePublicNetwork = LORAWAN_PUBLIC_NETWORK;
         LoRaMacMibSetRequestConfirm( &mibReq );
@@ -636,7 +921,7 @@ lora_task_func(void *param)
 #endif
 
         mibReq.Type = MIB_SYSTEM_MAX_RX_ERROR;
-        mibReq.Param.SystemMaxRxError = 20;
+        mibReq.Param.SystemMaxRxError = LORAWAN_MAX_RX_ERROR;
         LoRaMacMibSetRequestConfirm( &mibReq );
 
         LoRaMacStart( );
@@ -694,6 +979,7 @@ lora_task_func(void *param)
         proto_txstart();
         sampling_since = OS_GET_TICK_COUNT();
         led_notify(LED_STATE_SAMPLING_SENSOR);
+        power_sensors(true);
         sensor_prepare();
         OS_TIMER_START(prepare_tx_timer, OS_TIMER_FOREVER);
         DeviceState = DEVICE_STATE_SLEEP;
@@ -707,12 +993,39 @@ lora_task_func(void *param)
           debug_time();
 #endif
           led_notify(LED_STATE_SENDING);
+#ifdef FEATURE_SENSOR_GPS
+          if( gps_time_wanted( ) )
+          {
+            DeviceTimeReq( );
+          }
+#endif
           proto_send_data();
         }
+        // The sensors are read, keep them off during the uplink
+        power_sensors(false);
+        // Frames held back by the duty cycle go out later
+        if( NextTx == true && proto_tx_more() )
+        {
+          OS_TIMER_START(send_retry_timer, OS_TIMER_FOREVER);
+        }
 
         DeviceState = DEVICE_STATE_CYCLE;
         break;
       }
+      case DEVICE_STATE_SEND_NEXT:
+      {
+        if( NextTx == true )
+        {
+          proto_send_next();
+        }
+        if( NextTx == true && proto_tx_more() )
+        {
+          OS_TIMER_START(send_retry_timer, OS_TIMER_FOREVER);
+        }
+
+        DeviceState = DEVICE_STATE_SLEEP;
+        break;
+      }
       case DEVICE_STATE_CYCLE:
       {
         DeviceState = DEVICE_STATE_SLEEP;
@@ -735,9 +1048,19 @@ lora_task_func(void *param)
         /*
          * Wait on any of the notification bits, then clear them all
          */
+#if defined(TIMER_BACKEND_OS)
+        /* Wake up for the MAC timers too, TimerProcess() runs them */
+        ret = OS_TASK_NOTIFY_WAIT(0, OS_TASK_NOTIFY_ALL_BITS, &notif, RtcGetAlarmTimeout());
+        if (ret != OS_OK)
+          notif = 0;
+#else
         ret = OS_TASK_NOTIFY_WAIT(0, OS_TASK_NOTIFY_ALL_BITS, &notif, OS_TASK_NOTIFY_FOREVER);
         /* Blocks forever waiting for task notification. The return value must be OS_OK */
         OS_ASSERT(ret == OS_OK);
+#endif
+        /* A wait that times out or gets the alarm woke for the MAC timers */
+        if (ret != OS_OK || (notif & EVENT_NOTIF_TIMER))
+          RtcCountWakeup();
 
         /* resume watchdog */
         sys_watchdog_notify_and_resume(wdog_id);
@@ -776,6 +1099,20 @@ lora_task_func(void *param)
 #endif
     }
 
+    if (notif & EVENT_NOTIF_NVMCTX) {
+      nvmctx_commit();
+    }
+
+    if (notif & EVENT_NOTIF_PARAM) {
+      param_commit();
+    }
+
+    if (notif & EVENT_NOTIF_REBOOT) {
+      upgrade_reboot_now();
+    }
+
+    TimerProcess();
+
     if (notif & EVENT_NOTIF_LORAMAC) {
       if(gp_loramac_cb != NULL){
         gp_loramac_cb();
@@ -785,8 +1122,12 @@ lora_task_func(void *param)
 
 #ifdef DEBUG_STATE
     if(pre_state != DeviceState){
+      uint8_t opmode;
+
+      /* SX1276Read() returns the shadow, the radio changes the mode itself */
+      SX1276ReadBuffer(REG_OPMODE, &opmode, 1);
       debug_time();
-      printf("state: %d, SX1276: %d, LR_CONF: %d\r\n", DeviceState, SX1276Read( REG_OPMODE ), SX1276Read(REG_LR_PACONFIG));
+      printf("state: %d, SX1276: %d, LR_CONF: %d\r\n", DeviceState, opmode, SX1276Read(REG_LR_PACONFIG));
       pre_state = DeviceState;
     }
 #endif
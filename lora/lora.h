@@ -23,10 +23,36 @@
 #define EVENT_NOTIF_CONS_RX   (1 << 9)
 #define EVENT_NOTIF_GPS_RX    (1 << 10)
 #define EVENT_NOTIF_LORAMAC   (1 << 11)
+#define EVENT_NOTIF_NVMCTX    (1 << 12)
+#define EVENT_NOTIF_PARAM     (1 << 13)
+#define EVENT_NOTIF_REBOOT    (1 << 14)
+#define EVENT_NOTIF_TIMER     (1 << 15)
+
+/* Uplink queue classes, highest priority first */
+enum lora_tx_class {
+  LORA_TX_CONTROL,	/* replies to the server */
+  LORA_TX_ALARM,
+  LORA_TX_DATA,		/* periodic sensor data */
+  LORA_TX_CLASSES,
+};
+
+#define LORA_TXQ_FRAME_MAX 24
+
+struct lora_txq_stats {
+  uint32_t queued;
+  uint32_t sent;	/* confirmed by the MAC, or split in fragments */
+  uint32_t dropped;	/* too long, pushed out of a full queue, or failed */
+};
 
 void lora_hw_init(void *irq);
 void lora_task_func(void *param);
 void lora_task_notify_event(uint32_t event, void *cb);
-void lora_send(uint8_t *data, size_t len);
+uint8_t *lora_tx_buffer(size_t *len, size_t *room);
+int lora_send(uint8_t port, uint8_t *data, size_t len);
+int lora_enqueue(uint8_t cls, uint8_t port, const uint8_t *data, size_t len);
+size_t lora_txq_fill(uint8_t port, uint8_t *buf, size_t maxlen);
+void lora_txq_commit(void);
+bool lora_txq_pending(void);
+const struct lora_txq_stats *lora_txq_stats(uint8_t cls);
 
 #endif /* __LORA_H__ */
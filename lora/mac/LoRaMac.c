@@ -61,6 +61,12 @@
  */
 #define LORA_MAC_COMMAND_MAX_FOPTS_LENGTH           15
 
+/*!
+ * Offset of the FRMPayload in PktBuffer. The frame header is serialized
+ * in front of it, so that the payload never moves whatever the FOpts length.
+ */
+#define LORAMAC_FRMPAYLOAD_OFFSET                   ( LORAMAC_MHDR_FIELD_SIZE + LORAMAC_FHDR_MAX_FIELD_SIZE + LORAMAC_F_PORT_FIELD_SIZE )
+
 /*!
  * LoRaMac duty cycle for the back-off procedure during the first hour.
  */
@@ -76,6 +82,29 @@
  */
 #define BACKOFF_DC_24_HOURS                         10000
 
+/*!
+ * Largest plausible radio interrupt latency in microseconds. Longer
+ * measurements are discarded.
+ */
+#define MAX_IRQ_LATENCY                             20000
+
+/*!
+ * Largest plausible window timer latency in microseconds. Windows
+ * opening further off schedule are not used to adjust it.
+ */
+#define MAX_TIMER_LATENCY                           50000
+
+/*!
+ * Smallest receive window timing error in microseconds
+ */
+#define MIN_RX_ERROR                                500
+
+/*!
+ * Growth of the receive window timing error for each uplink without a
+ * measured downlink, in microseconds
+ */
+#define RX_ERROR_AGING                              10
+
 /*!
  * LoRaMac internal states
  */
@@ -206,19 +235,20 @@ typedef struct sLoRaMacCtx
     */
     uint16_t PktBufferLen;
     /*
-    * Buffer containing the data to be sent or received.
+    * Buffer containing the data to be sent. The application payload is
+    * written at LORAMAC_FRMPAYLOAD_OFFSET, then encrypted in place.
+    */
+    uint8_t PktBuffer[LORAMAC_PHY_MAXPAYLOAD + LORA_MAC_COMMAND_MAX_FOPTS_LENGTH];
+    /*
+    * Start of the frame in PktBuffer
     */
-    uint8_t PktBuffer[LORAMAC_PHY_MAXPAYLOAD];
+    uint8_t* PktFrame;
     /*!
     * Current processed transmit message
     */
     LoRaMacMessage_t TxMsg;
-    /*!
-    * Buffer containing the data received by the application.
-    */
-    uint8_t AppData[LORAMAC_PHY_MAXPAYLOAD];
     /*
-    * Size of buffer containing the application data.
+    * Size of the application payload.
     */
     uint8_t AppDataSize;
     /*
@@ -252,13 +282,49 @@ typedef struct sLoRaMacCtx
     TimerEvent_t RxWindowTimer1;
     TimerEvent_t RxWindowTimer2;
     /*
-    * LoRaMac reception windows delay
+    * LoRaMac reception windows delay in microseconds
     * \remark normal frame: RxWindowXDelay = ReceiveDelayX - RADIO_WAKEUP_TIME
     *         join frame  : RxWindowXDelay = JoinAcceptDelayX - RADIO_WAKEUP_TIME
     */
     uint32_t RxWindow1Delay;
     uint32_t RxWindow2Delay;
     /*
+    * LoRaMac reception windows receive delay in milliseconds
+    * \remark normal frame: ReceiveDelayX
+    *         join frame  : JoinAcceptDelayX
+    */
+    uint32_t RxWindow1Nominal;
+    uint32_t RxWindow2Nominal;
+    /*
+    * End of the last transmission in microseconds, the reference of the
+    * reception windows
+    */
+    uint32_t TxDoneTime;
+    /*
+    * Time of the last radio interrupt in microseconds
+    */
+    uint32_t RadioIrqTime;
+    /*
+    * Indicates if the board captured the time of the last RxDone
+    */
+    bool RxDoneCaptured;
+    /*
+    * Time the last reception window opened and its symbol timeout
+    * expires, in microseconds
+    */
+    uint32_t RxWindowOpenTime;
+    uint32_t RxWindowEndTime;
+    /*
+    * Receive delay of the last reception window in milliseconds and the
+    * time a downlink would start in it, in microseconds
+    */
+    uint32_t RxWindowNominal;
+    uint32_t RxWindowNominalTime;
+    /*
+    * Reception windows timing
+    */
+    LoRaMacRxTiming_t RxTiming;
+    /*
     * LoRaMac Rx windows configuration
     */
     RxConfigParams_t RxWindow1Config;
@@ -608,6 +674,43 @@ static void ResetMacParameters( void );
  */
 static void RxWindowSetup( TimerEvent_t* rxTimer, RxConfigParams_t* rxConfig );
 
+/*!
+ * \brief Measures the opening of a reception window against its schedule
+ *
+ * \param [IN] rxConfig Window parameters
+ */
+static void RxWindowMeasure( RxConfigParams_t* rxConfig );
+
+/*!
+ * \brief Computes the parameters of a reception window, moved by the
+ *        learnt clock drift and narrowed from the downlinks measured
+ *
+ * \param [IN] datarate  Window datarate
+ * \param [IN] delay     Receive delay in ms
+ * \param [OUT] rxConfig Window parameters
+ *
+ * \retval Window opening after the end of the transmission in us
+ */
+static uint32_t ComputeRxWindowParameters( int8_t datarate, uint32_t delay, RxConfigParams_t* rxConfig );
+
+/*!
+ * \brief Computes the time on air of a LoRa downlink
+ *
+ * \param [IN] rxConfig Parameters of the window it was received in
+ * \param [IN] size     PHY payload size
+ *
+ * \retval Time on air in us, 0 for FSK
+ */
+static uint32_t RxTimeOnAir( RxConfigParams_t* rxConfig, uint16_t size );
+
+/*!
+ * \brief Updates the clock drift estimate from the start of the downlink
+ *        just received in RX1 or RX2
+ *
+ * \param [IN] size PHY payload size
+ */
+static void RxTimingUpdate( uint16_t size );
+
 /*!
  * \brief Opens up a continuous RX C window. This is used for
  *        class c devices.
@@ -792,6 +895,16 @@ struct
 
 static void OnRadioTxDone( void )
 {
+    // The windows are timed from the radio interrupt when the board
+    // captured its time, as the MAC may run much later
+    if( TimerGetCapture( &MacCtx.RadioIrqTime ) == true )
+    {
+        MacCtx.TxDoneTime = MacCtx.RadioIrqTime - MacCtx.RxTiming.IrqLatency;
+    }
+    else
+    {
+        MacCtx.TxDoneTime = TimerGetCurrentTimeUs( );
+    }
     TxDoneParams.CurTime = TimerGetCurrentTime( );
     MacCtx.LastTxSysTime = SysTimeGet( );
 
@@ -805,6 +918,7 @@ static void OnRadioTxDone( void )
 
 static void OnRadioRxDone( uint8_t *payload, uint16_t size, int16_t rssi, int8_t snr )
 {
+    MacCtx.RxDoneCaptured = TimerGetCapture( &MacCtx.RadioIrqTime );
     RxDoneParams.LastRxDone = TimerGetCurrentTime( );
 #ifdef DEBUG
     printf("RxDone:%d\r\n", RxDoneParams.LastRxDone);
@@ -824,6 +938,7 @@ static void OnRadioRxDone( uint8_t *payload, uint16_t size, int16_t rssi, int8_t
 
 static void OnRadioTxTimeout( void )
 {
+    TimerGetCapture( &MacCtx.RadioIrqTime );
     LoRaMacRadioEvents.Events.TxTimeout = 1;
 
     if( ( MacCtx.MacCallbacks != NULL ) && ( MacCtx.MacCallbacks->MacProcessNotify != NULL ) )
@@ -834,6 +949,7 @@ static void OnRadioTxTimeout( void )
 
 static void OnRadioRxError( void )
 {
+    TimerGetCapture( &MacCtx.RadioIrqTime );
     LoRaMacRadioEvents.Events.RxError = 1;
 
     if( ( MacCtx.MacCallbacks != NULL ) && ( MacCtx.MacCallbacks->MacProcessNotify != NULL ) )
@@ -844,6 +960,21 @@ static void OnRadioRxError( void )
 
 static void OnRadioRxTimeout( void )
 {
+    int32_t latency;
+
+    // The radio raises the timeout when the window symbol timeout
+    // expires, a known time after the window opened. The delay of the
+    // captured interrupt past it is the interrupt latency.
+    if( ( TimerGetCapture( &MacCtx.RadioIrqTime ) == true ) &&
+        ( ( MacCtx.RxSlot == RX_SLOT_WIN_1 ) || ( MacCtx.RxSlot == RX_SLOT_WIN_2 ) ) &&
+        ( ( int32_t )( MacCtx.RadioIrqTime - MacCtx.RxWindowOpenTime ) > 0 ) )
+    {
+        latency = ( int32_t )( MacCtx.RadioIrqTime - MacCtx.RxWindowEndTime );
+        if( ( latency >= 0 ) && ( latency <= MAX_IRQ_LATENCY ) )
+        {
+            MacCtx.RxTiming.IrqLatency += ( latency - ( int32_t )MacCtx.RxTiming.IrqLatency ) / 4;
+        }
+    }
     LoRaMacRadioEvents.Events.RxTimeout = 1;
 #ifdef DEBUG
     printf("RxTimeout:%d\r\n",TimerGetCurrentTime());
@@ -866,6 +997,31 @@ static void UpdateRxSlotIdleState( void )
     }
 }
 
+/*!
+ * \brief Starts a reception window timer
+ *
+ * \param [IN] rxTimer Window timer
+ * \param [IN] delay   Window opening after the end of the transmission in us
+ */
+static void RxWindowTimerStart( TimerEvent_t* rxTimer, uint32_t delay )
+{
+    int32_t timeout;
+
+    timeout = ( int32_t )( MacCtx.TxDoneTime + delay - TimerGetCurrentTimeUs( ) );
+    timeout -= ( int32_t )MacCtx.RxTiming.TimerLatency;
+    if( timeout < 0 )
+    {
+        timeout = 0;
+    }
+    else if( timeout > ( int32_t )delay )
+    {
+        // The microsecond time jumped at the RTC wrap
+        timeout = delay;
+    }
+    TimerSetValueUs( rxTimer, timeout );
+    TimerStart( rxTimer );
+}
+
 static void ProcessRadioTxDone( void )
 {
     GetPhyParams_t getPhy;
@@ -877,16 +1033,15 @@ static void ProcessRadioTxDone( void )
         Radio.Sleep( );
     }
     // Setup timers
-    TimerSetValue( &MacCtx.RxWindowTimer1, MacCtx.RxWindow1Delay );
-    TimerStart( &MacCtx.RxWindowTimer1 );
-    TimerSetValue( &MacCtx.RxWindowTimer2, MacCtx.RxWindow2Delay );
-    TimerStart( &MacCtx.RxWindowTimer2 );
+    RxWindowTimerStart( &MacCtx.RxWindowTimer1, MacCtx.RxWindow1Delay );
+    RxWindowTimerStart( &MacCtx.RxWindowTimer2, MacCtx.RxWindow2Delay );
+    MacCtx.RxTiming.UplinksSinceDownlink++;
 
     if( ( MacCtx.NvmCtx->DeviceClass == CLASS_C ) || ( MacCtx.NodeAckRequested == true ) )
     {
         getPhy.Attribute = PHY_ACK_TIMEOUT;
         phyParam = RegionGetPhyParam( MacCtx.NvmCtx->Region, &getPhy );
-        TimerSetValue( &MacCtx.AckTimeoutTimer, MacCtx.RxWindow2Delay + phyParam.Value );
+        TimerSetValue( &MacCtx.AckTimeoutTimer, MacCtx.RxWindow2Delay / 1000 + phyParam.Value );
         TimerStart( &MacCtx.AckTimeoutTimer );
     }
 
@@ -1037,6 +1192,8 @@ static void ProcessRadioRxDone( void )
 
                 MacCtx.NvmCtx->Version.Fields.Minor = 0;
 
+                RxTimingUpdate( size );
+
                 // Apply CF list
                 applyCFList.Payload = macMsgJoinAccept.CFList;
                 // Size of the regular payload is 12. Plus 1 byte MHDR and 4 bytes MIC
@@ -1191,6 +1348,7 @@ static void ProcessRadioRxDone( void )
                 ( MacCtx.McpsIndication.RxSlot == RX_SLOT_WIN_2 ) )
             {
                 MacCtx.NvmCtx->AdrAckCounter = 0;
+                RxTimingUpdate( size );
             }
 
             // MCPS Indication and ack requested handling
@@ -1454,6 +1612,16 @@ bool LoRaMacIsBusy( void )
     return true;
 }
 
+uint8_t* LoRaMacGetPayloadBuffer( uint8_t* size )
+{
+    if( LoRaMacIsBusy( ) == true )
+    {
+        return NULL;
+    }
+    *size = LORAMAC_PHY_MAXPAYLOAD - LORA_MAC_FRMPAYLOAD_OVERHEAD;
+    return MacCtx.PktBuffer + LORAMAC_FRMPAYLOAD_OFFSET;
+}
+
 
 static void LoRaMacEnableRequests( LoRaMacRequestHandling_t requestState )
 {
@@ -1858,7 +2026,7 @@ static LoRaMacStatus_t SwitchClass( DeviceClass_t deviceClass )
                 RegionComputeRxWindowParameters( MacCtx.NvmCtx->Region,
                                                  MacCtx.NvmCtx->MacParams.RxCChannel.Datarate,
                                                  MacCtx.NvmCtx->MacParams.MinRxSymbols,
-                                                 MacCtx.NvmCtx->MacParams.SystemMaxRxError,
+                                                 MacCtx.NvmCtx->MacParams.SystemMaxRxError * 1000,
                                                  &MacCtx.RxWindowCConfig );
                 OpenContinuousRxCWindow( );
 
@@ -2411,23 +2579,10 @@ static LoRaMacStatus_t ScheduleTx( bool allowDelayedTx )
         }
     }
 
-    // Compute Rx1 windows parameters
-    RegionComputeRxWindowParameters( MacCtx.NvmCtx->Region,
-                                     RegionApplyDrOffset( MacCtx.NvmCtx->Region, MacCtx.NvmCtx->MacParams.DownlinkDwellTime, MacCtx.NvmCtx->MacParams.ChannelsDatarate, MacCtx.NvmCtx->MacParams.Rx1DrOffset ),
-                                     MacCtx.NvmCtx->MacParams.MinRxSymbols,
-                                     MacCtx.NvmCtx->MacParams.SystemMaxRxError,
-                                     &MacCtx.RxWindow1Config );
-    // Compute Rx2 windows parameters
-    RegionComputeRxWindowParameters( MacCtx.NvmCtx->Region,
-                                     MacCtx.NvmCtx->MacParams.Rx2Channel.Datarate,
-                                     MacCtx.NvmCtx->MacParams.MinRxSymbols,
-                                     MacCtx.NvmCtx->MacParams.SystemMaxRxError,
-                                     &MacCtx.RxWindow2Config );
-
     if( MacCtx.NvmCtx->NetworkActivation == ACTIVATION_TYPE_NONE )
     {
-        MacCtx.RxWindow1Delay = MacCtx.NvmCtx->MacParams.JoinAcceptDelay1 + MacCtx.RxWindow1Config.WindowOffset;
-        MacCtx.RxWindow2Delay = MacCtx.NvmCtx->MacParams.JoinAcceptDelay2 + MacCtx.RxWindow2Config.WindowOffset;
+        MacCtx.RxWindow1Nominal = MacCtx.NvmCtx->MacParams.JoinAcceptDelay1;
+        MacCtx.RxWindow2Nominal = MacCtx.NvmCtx->MacParams.JoinAcceptDelay2;
     }
     else
     {
@@ -2440,10 +2595,17 @@ static LoRaMacStatus_t ScheduleTx( bool allowDelayedTx )
         {
             return LORAMAC_STATUS_LENGTH_ERROR;
         }
-        MacCtx.RxWindow1Delay = MacCtx.NvmCtx->MacParams.ReceiveDelay1 + MacCtx.RxWindow1Config.WindowOffset;
-        MacCtx.RxWindow2Delay = MacCtx.NvmCtx->MacParams.ReceiveDelay2 + MacCtx.RxWindow2Config.WindowOffset;
+        MacCtx.RxWindow1Nominal = MacCtx.NvmCtx->MacParams.ReceiveDelay1;
+        MacCtx.RxWindow2Nominal = MacCtx.NvmCtx->MacParams.ReceiveDelay2;
     }
 
+    // Compute Rx1 windows parameters
+    MacCtx.RxWindow1Delay = ComputeRxWindowParameters( RegionApplyDrOffset( MacCtx.NvmCtx->Region, MacCtx.NvmCtx->MacParams.DownlinkDwellTime, MacCtx.NvmCtx->MacParams.ChannelsDatarate, MacCtx.NvmCtx->MacParams.Rx1DrOffset ),
+                                                       MacCtx.RxWindow1Nominal, &MacCtx.RxWindow1Config );
+    // Compute Rx2 windows parameters
+    MacCtx.RxWindow2Delay = ComputeRxWindowParameters( MacCtx.NvmCtx->MacParams.Rx2Channel.Datarate,
+                                                       MacCtx.RxWindow2Nominal, &MacCtx.RxWindow2Config );
+
     // Secure frame
     LoRaMacStatus_t retval = SecureFrame( MacCtx.NvmCtx->MacParams.ChannelsDatarate, MacCtx.Channel );
     if( retval != LORAMAC_STATUS_OK )
@@ -2459,6 +2621,7 @@ static LoRaMacStatus_t SecureFrame( uint8_t txDr, uint8_t txCh )
 {
     LoRaMacCryptoStatus_t macCryptoStatus = LORAMAC_CRYPTO_ERROR;
     uint32_t fCntUp = 0;
+    uint8_t frameOffset = 0;
 
     switch( MacCtx.TxMsg.Type )
     {
@@ -2469,6 +2632,7 @@ static LoRaMacStatus_t SecureFrame( uint8_t txDr, uint8_t txCh )
                 return LORAMAC_STATUS_CRYPTO_ERROR;
             }
             MacCtx.PktBufferLen = MacCtx.TxMsg.Message.JoinReq.BufSize;
+            MacCtx.PktFrame = MacCtx.PktBuffer;
             break;
         case LORAMAC_MSG_TYPE_DATA:
 
@@ -2482,12 +2646,24 @@ static LoRaMacStatus_t SecureFrame( uint8_t txDr, uint8_t txCh )
                 fCntUp -= 1;
             }
 
+            // Serialize the header backwards from the payload
+            frameOffset = LORAMAC_FRMPAYLOAD_OFFSET - LORAMAC_MHDR_FIELD_SIZE - LORAMAC_FHDR_DEV_ADD_FIELD_SIZE -
+                          LORAMAC_FHDR_F_CTRL_FIELD_SIZE - LORAMAC_FHDR_F_CNT_FIELD_SIZE -
+                          MacCtx.TxMsg.Message.Data.FHDR.FCtrl.Bits.FOptsLen;
+            if( MacCtx.TxMsg.Message.Data.FRMPayloadSize > 0 )
+            {
+                frameOffset -= LORAMAC_F_PORT_FIELD_SIZE;
+            }
+            MacCtx.TxMsg.Message.Data.Buffer = MacCtx.PktBuffer + frameOffset;
+            MacCtx.TxMsg.Message.Data.BufSize = MIN( sizeof( MacCtx.PktBuffer ) - frameOffset, LORAMAC_PHY_MAXPAYLOAD );
+
             macCryptoStatus = LoRaMacCryptoSecureMessage( fCntUp, txDr, txCh, &MacCtx.TxMsg.Message.Data );
             if( LORAMAC_CRYPTO_SUCCESS != macCryptoStatus )
             {
                 return LORAMAC_STATUS_CRYPTO_ERROR;
             }
             MacCtx.PktBufferLen = MacCtx.TxMsg.Message.Data.BufSize;
+            MacCtx.PktFrame = MacCtx.TxMsg.Message.Data.Buffer;
             break;
         case LORAMAC_MSG_TYPE_JOIN_ACCEPT:
         case LORAMAC_MSG_TYPE_UNDEF:
@@ -2615,7 +2791,168 @@ static void RxWindowSetup( TimerEvent_t* rxTimer, RxConfigParams_t* rxConfig )
 #endif
         Radio.Rx( MacCtx.NvmCtx->MacParams.MaxRxWindow );
         MacCtx.RxSlot = rxConfig->RxSlot;
+        RxWindowMeasure( rxConfig );
+    }
+}
+
+static void RxWindowMeasure( RxConfigParams_t* rxConfig )
+{
+    uint32_t delay;
+    int32_t error;
+    int32_t latency;
+
+    MacCtx.RxWindowOpenTime = TimerGetCurrentTimeUs( );
+    MacCtx.RxWindowEndTime = MacCtx.RxWindowOpenTime + rxConfig->WindowTimeout * rxConfig->SymbolTime;
+
+    if( rxConfig->RxSlot == RX_SLOT_WIN_1 )
+    {
+        delay = MacCtx.RxWindow1Delay;
+        MacCtx.RxWindowNominal = MacCtx.RxWindow1Nominal;
+    }
+    else if( rxConfig->RxSlot == RX_SLOT_WIN_2 )
+    {
+        delay = MacCtx.RxWindow2Delay;
+        MacCtx.RxWindowNominal = MacCtx.RxWindow2Nominal;
+    }
+    else
+    {
+        return;
+    }
+    MacCtx.RxWindowNominalTime = MacCtx.TxDoneTime + MacCtx.RxWindowNominal * 1000;
+    error = ( int32_t )( MacCtx.RxWindowOpenTime - ( MacCtx.TxDoneTime + delay ) );
+    if( ( error < -MAX_TIMER_LATENCY ) || ( error > MAX_TIMER_LATENCY ) )
+    {
+        return;
     }
+
+    if( ( MacCtx.RxTiming.Windows == 0 ) || ( error < MacCtx.RxTiming.ErrorMin ) )
+    {
+        MacCtx.RxTiming.ErrorMin = error;
+    }
+    if( ( MacCtx.RxTiming.Windows == 0 ) || ( error > MacCtx.RxTiming.ErrorMax ) )
+    {
+        MacCtx.RxTiming.ErrorMax = error;
+    }
+    MacCtx.RxTiming.Windows++;
+
+    // Start the next windows earlier by part of the error
+    latency = ( int32_t )MacCtx.RxTiming.TimerLatency + error / 4;
+    if( latency < 0 )
+    {
+        latency = 0;
+    }
+    else if( latency > MAX_TIMER_LATENCY )
+    {
+        latency = MAX_TIMER_LATENCY;
+    }
+    MacCtx.RxTiming.TimerLatency = latency;
+}
+
+static uint32_t ComputeRxWindowParameters( int8_t datarate, uint32_t delay, RxConfigParams_t* rxConfig )
+{
+    LoRaMacRxTiming_t* timing = &MacCtx.RxTiming;
+    uint32_t rxError = MacCtx.NvmCtx->MacParams.SystemMaxRxError * 1000;
+    uint32_t error;
+
+    if( timing->Downlinks > 0 )
+    {
+        error = MIN_RX_ERROR + 4 * timing->Deviation + timing->UplinksSinceDownlink * RX_ERROR_AGING;
+        rxError = MIN( error, rxError );
+    }
+    timing->RxError = rxError;
+
+    RegionComputeRxWindowParameters( MacCtx.NvmCtx->Region, datarate, MacCtx.NvmCtx->MacParams.MinRxSymbols, rxError, rxConfig );
+    // Center the window on the downlink start expected from the drift
+    rxConfig->WindowOffset += timing->Drift * ( int32_t )delay / 1000;
+
+    return delay * 1000 + rxConfig->WindowOffset;
+}
+
+static uint32_t RxTimeOnAir( RxConfigParams_t* rxConfig, uint16_t size )
+{
+    static const uint32_t bandwidths[] = { 125000, 250000, 500000 };
+    uint32_t ts = rxConfig->SymbolTime;
+    int32_t sf;
+    int32_t num;
+    int32_t den;
+    uint32_t symbols;
+
+    if( rxConfig->Bandwidth >= sizeof( bandwidths ) / sizeof( bandwidths[0] ) )
+    {
+        return 0;
+    }
+    for( sf = 6; sf <= 12; sf++ )
+    {
+        if( ( ( ( uint32_t )1 << sf ) * 1000000UL ) / bandwidths[rxConfig->Bandwidth] == ts )
+        {
+            break;
+        }
+    }
+    if( sf > 12 )
+    {
+        // FSK
+        return 0;
+    }
+
+    // 8 symbols preamble, explicit header, coding rate 4/5 and no CRC,
+    // low datarate optimization from 16 ms symbols
+    num = 8 * ( int32_t )size - 4 * sf + 28;
+    den = 4 * ( sf - ( ( ts >= 16384 ) ? 2 : 0 ) );
+    symbols = 8;
+    if( num > 0 )
+    {
+        symbols += ( ( num + den - 1 ) / den ) * 5;
+    }
+    return ( ( 8 * 4 + 17 ) * ts ) / 4 + symbols * ts;
+}
+
+static void RxTimingUpdate( uint16_t size )
+{
+    LoRaMacRxTiming_t* timing = &MacCtx.RxTiming;
+    RxConfigParams_t* rxConfig;
+    uint32_t timeOnAir;
+    int32_t offset;
+    int32_t drift;
+    int32_t residual;
+    int32_t maxError = ( int32_t )MacCtx.NvmCtx->MacParams.SystemMaxRxError * 1000;
+
+    if( MacCtx.RxDoneCaptured == false )
+    {
+        return;
+    }
+    rxConfig = ( MacCtx.McpsIndication.RxSlot == RX_SLOT_WIN_1 ) ? &MacCtx.RxWindow1Config : &MacCtx.RxWindow2Config;
+    timeOnAir = RxTimeOnAir( rxConfig, size );
+    if( ( timeOnAir == 0 ) || ( MacCtx.RxWindowNominal == 0 ) )
+    {
+        return;
+    }
+
+    // Start of the downlink against the receive delay
+    offset = ( int32_t )( MacCtx.RadioIrqTime - MacCtx.RxTiming.IrqLatency - timeOnAir - MacCtx.RxWindowNominalTime );
+    if( ( offset < -maxError ) || ( offset > maxError ) )
+    {
+        return;
+    }
+    drift = offset * 1000 / ( int32_t )MacCtx.RxWindowNominal;
+
+    if( timing->Downlinks == 0 )
+    {
+        // Start from the configured error
+        timing->Drift = drift;
+        timing->Deviation = maxError / 4;
+    }
+    else
+    {
+        residual = offset - timing->Drift * ( int32_t )MacCtx.RxWindowNominal / 1000;
+        if( residual < 0 )
+        {
+            residual = -residual;
+        }
+        timing->Drift += ( drift - timing->Drift ) / 4;
+        timing->Deviation += ( residual - ( int32_t )timing->Deviation ) / 4;
+    }
+    timing->Downlinks++;
+    timing->UplinksSinceDownlink = 0;
 }
 
 static void OpenContinuousRxCWindow( void )
@@ -2646,9 +2983,9 @@ LoRaMacStatus_t PrepareFrame( LoRaMacHeader_t* macHdr, LoRaMacFrameCtrl_t* fCtrl
         fBufferSize = 0;
     }
 
-    memcpy1( MacCtx.AppData, ( uint8_t* ) fBuffer, fBufferSize );
     MacCtx.AppDataSize = fBufferSize;
     MacCtx.PktBuffer[0] = macHdr->Value;
+    MacCtx.PktFrame = MacCtx.PktBuffer;
 
     switch( macHdr->Bits.MType )
     {
@@ -2656,15 +2993,19 @@ LoRaMacStatus_t PrepareFrame( LoRaMacHeader_t* macHdr, LoRaMacFrameCtrl_t* fCtrl
             MacCtx.NodeAckRequested = true;
             // Intentional fall through
         case FRAME_TYPE_DATA_UNCONFIRMED_UP:
+            // Payloads built in place by LoRaMacGetPayloadBuffer are not copied
+            if( ( uint8_t* )fBuffer != MacCtx.PktBuffer + LORAMAC_FRMPAYLOAD_OFFSET )
+            {
+                memcpy1( MacCtx.PktBuffer + LORAMAC_FRMPAYLOAD_OFFSET, ( uint8_t* ) fBuffer, fBufferSize );
+            }
+
             MacCtx.TxMsg.Type = LORAMAC_MSG_TYPE_DATA;
-            MacCtx.TxMsg.Message.Data.Buffer = MacCtx.PktBuffer;
-            MacCtx.TxMsg.Message.Data.BufSize = LORAMAC_PHY_MAXPAYLOAD;
             MacCtx.TxMsg.Message.Data.MHDR.Value = macHdr->Value;
             MacCtx.TxMsg.Message.Data.FPort = fPort;
             MacCtx.TxMsg.Message.Data.FHDR.DevAddr = MacCtx.NvmCtx->DevAddr;
             MacCtx.TxMsg.Message.Data.FHDR.FCtrl.Value = fCtrl->Value;
             MacCtx.TxMsg.Message.Data.FRMPayloadSize = MacCtx.AppDataSize;
-            MacCtx.TxMsg.Message.Data.FRMPayload = MacCtx.AppData;
+            MacCtx.TxMsg.Message.Data.FRMPayload = MacCtx.PktBuffer + LORAMAC_FRMPAYLOAD_OFFSET;
 
             if( LORAMAC_CRYPTO_SUCCESS != LoRaMacCryptoGetFCntUp( &fCntUp ) )
             {
@@ -2803,7 +3144,7 @@ LoRaMacStatus_t SendFrameOnChannel( uint8_t channel )
     }
 
     // Send now
-    Radio.Send( MacCtx.PktBuffer, MacCtx.PktBufferLen );
+    Radio.Send( MacCtx.PktFrame, MacCtx.PktBufferLen );
 #ifdef DEBUG
     printf("Radio.Send:%d\r\n",TimerGetCurrentTime());
 #endif
@@ -3252,7 +3593,7 @@ LoRaMacStatus_t LoRaMacInitialization( LoRaMacPrimitives_t* primitives, LoRaMacC
     MacCtx.NvmCtx->LastTxDoneTime = 0;
     MacCtx.NvmCtx->AggregatedTimeOff = 0;
 
-    // Initialize timers
+    // Initialize timers, counted in TIMER_QUEUE_SIZE
     TimerInit( &MacCtx.TxDelayedTimer, OnTxDelayedTimerEvent );
     TimerInit( &MacCtx.RxWindowTimer1, OnRxWindow1TimerEvent );
     TimerInit( &MacCtx.RxWindowTimer2, OnRxWindow2TimerEvent );
@@ -3571,6 +3912,11 @@ LoRaMacStatus_t LoRaMacMibGetRequestConfirm( MibRequestConfirm_t* mibGet )
             mibGet->Param.MinRxSymbols = MacCtx.NvmCtx->MacParams.MinRxSymbols;
             break;
         }
+        case MIB_RX_TIMING:
+        {
+            mibGet->Param.RxTiming = &MacCtx.RxTiming;
+            break;
+        }
         case MIB_ANTENNA_GAIN:
         {
             mibGet->Param.AntennaGain = MacCtx.NvmCtx->MacParams.AntennaGain;
@@ -4051,7 +4397,7 @@ LoRaMacStatus_t LoRaMacMibSetRequestConfirm( MibRequestConfirm_t* mibSet )
                     RegionComputeRxWindowParameters( MacCtx.NvmCtx->Region,
                                                      MacCtx.NvmCtx->MacParams.RxCChannel.Datarate,
                                                      MacCtx.NvmCtx->MacParams.MinRxSymbols,
-                                                     MacCtx.NvmCtx->MacParams.SystemMaxRxError,
+                                                     MacCtx.NvmCtx->MacParams.SystemMaxRxError * 1000,
                                                      &MacCtx.RxWindowCConfig );
                     OpenContinuousRxCWindow( );
                 }
@@ -364,6 +364,64 @@ typedef struct sLoRaMacCtxs
     size_t ConfirmQueueNvmCtxSize;
 }LoRaMacCtxs_t;
 
+/*!
+ * LoRaMAC receive window timing
+ *
+ * The MAC opens the receive windows from the time the radio signalled
+ * the end of the uplink, and measures how late each window opens
+ * against the time it was scheduled for. It also measures when the
+ * downlinks start against the receive delays, to learn the clock drift
+ * and narrow the windows below \ref MIB_SYSTEM_MAX_RX_ERROR.
+ */
+typedef struct sLoRaMacRxTiming
+{
+    /*!
+     * Number of receive windows measured
+     */
+    uint32_t Windows;
+    /*!
+     * Earliest window opening, relative to the schedule, in microseconds
+     */
+    int32_t ErrorMin;
+    /*!
+     * Latest window opening, relative to the schedule, in microseconds
+     */
+    int32_t ErrorMax;
+    /*!
+     * Time between the window timer alarm and the radio listening, in
+     * microseconds. Window timers are started that much earlier.
+     */
+    uint32_t TimerLatency;
+    /*!
+     * Time between a radio interrupt and its capture, in microseconds.
+     * Subtracted from the captured end of the uplink.
+     */
+    uint32_t IrqLatency;
+    /*!
+     * Number of downlinks whose start was measured
+     */
+    uint32_t Downlinks;
+    /*!
+     * Clock drift against the network in ppm, positive when the
+     * downlinks start late on the local clock. The windows are moved by
+     * the drift over the receive delay.
+     */
+    int32_t Drift;
+    /*!
+     * Mean deviation of the downlink start from the drift estimate, in
+     * microseconds
+     */
+    uint32_t Deviation;
+    /*!
+     * Number of uplinks since the last measured downlink
+     */
+    uint32_t UplinksSinceDownlink;
+    /*!
+     * Timing error of the last receive windows, in microseconds
+     */
+    uint32_t RxError;
+}LoRaMacRxTiming_t;
+
 /*!
  * Global MAC layer parameters
  */
@@ -1258,6 +1316,7 @@ typedef struct sMlmeIndication
  * \ref MIB_CHANNELS_DEFAULT_TX_POWER            | YES | YES
  * \ref MIB_SYSTEM_MAX_RX_ERROR                  | YES | YES
  * \ref MIB_MIN_RX_SYMBOLS                       | YES | YES
+ * \ref MIB_RX_TIMING                            | YES | NO
  * \ref MIB_BEACON_INTERVAL                      | YES | YES
  * \ref MIB_BEACON_RESERVED                      | YES | YES
  * \ref MIB_BEACON_GUARD                         | YES | YES
@@ -1593,6 +1652,9 @@ typedef enum eMib
      * System overall timing error in milliseconds.
      * [-SystemMaxRxError : +SystemMaxRxError]
      * Default: +/-10 ms
+     *
+     * \remark The MAC uses smaller errors once it measured downlinks,
+     *         see \ref LoRaMacRxTiming_t.
      */
     MIB_SYSTEM_MAX_RX_ERROR,
     /*!
@@ -1600,6 +1662,10 @@ typedef enum eMib
      * Default: 6 symbols
      */
     MIB_MIN_RX_SYMBOLS,
+    /*!
+     * Receive window timing measured by the MAC
+     */
+    MIB_RX_TIMING,
     /*!
      * Antenna gain of the node. Default value is region specific.
      * The antenna gain is used to calculate the TX power of the node.
@@ -2001,6 +2067,12 @@ typedef union uMibParam
      * Related MIB type: \ref MIB_MIN_RX_SYMBOLS
      */
     uint8_t MinRxSymbols;
+    /*!
+     * Receive window timing
+     *
+     * Related MIB type: \ref MIB_RX_TIMING
+     */
+    const LoRaMacRxTiming_t* RxTiming;
     /*!
      * Antenna gain
      *
@@ -2449,6 +2521,19 @@ LoRaMacStatus_t LoRaMacStop( void );
  */
 bool LoRaMacIsBusy( void );
 
+/*!
+ * \brief Returns the FRMPayload location of the MAC frame buffer, so that
+ *        the application builds its payload in place. Passing it as the
+ *        fBuffer of the next MCPS request sends it without a copy.
+ *
+ * \remark The buffer holds the frame until the MAC is idle again.
+ *
+ * \param   [OUT] size - Size of the buffer.
+ *
+ * \retval  Pointer to the buffer, NULL while the MAC is busy.
+ */
+uint8_t* LoRaMacGetPayloadBuffer( uint8_t* size );
+
 /*!
  * Processes the LoRaMac events.
  *
@@ -336,7 +336,7 @@ static void RxBeaconSetup( TimerTime_t rxTime, bool activateDefaultChannel )
         RegionComputeRxWindowParameters( *Ctx.LoRaMacClassBParams.LoRaMacRegion,
                                         ( int8_t )phyParam.Value, // datarate
                                         Ctx.LoRaMacClassBParams.LoRaMacParams->MinRxSymbols,
-                                        Ctx.LoRaMacClassBParams.LoRaMacParams->SystemMaxRxError,
+                                        Ctx.LoRaMacClassBParams.LoRaMacParams->SystemMaxRxError * 1000,
                                         &beaconRxConfig );
         windowTimeout = beaconRxConfig.WindowTimeout;
     }
@@ -586,6 +586,23 @@ static uint16_t CalcPingPeriod( uint8_t pingNb )
     return CLASSB_BEACON_WINDOW_SLOTS / pingNb;
 }
 
+/*!
+ * \brief Converts an RX window offset to milliseconds, rounding up
+ *
+ * \param [IN] windowOffset RX window offset in microseconds
+ *
+ * \retval RX window offset in milliseconds
+ */
+static int32_t WindowOffsetMs( int32_t windowOffset )
+{
+    if( windowOffset > 0 )
+    {
+        return ( windowOffset + 999 ) / 1000;
+    }
+    // Division truncates towards zero
+    return windowOffset / 1000;
+}
+
 /*
  * Dummy callback in case if the user provides NULL function pointer
  */
@@ -614,7 +631,7 @@ void LoRaMacClassBInit( LoRaMacClassBParams_t *classBParams, LoRaMacClassBCallba
     // Assign callback
     Ctx.LoRaMacClassBNvmEvent = classBNvmCtxChanged;
 
-    // Initialize timers
+    // Initialize timers, counted in TIMER_QUEUE_SIZE
     TimerInit( &Ctx.BeaconTimer, LoRaMacClassBBeaconTimerEvent );
     TimerInit( &Ctx.PingSlotTimer, LoRaMacClassBPingSlotTimerEvent );
     TimerInit( &Ctx.MulticastSlotTimer, LoRaMacClassBMulticastSlotTimerEvent );
@@ -996,13 +1013,13 @@ static void LoRaMacClassBProcessPingSlot( void )
                     RegionComputeRxWindowParameters( *Ctx.LoRaMacClassBParams.LoRaMacRegion,
                                                      Ctx.NvmCtx->PingSlotCtx.Datarate,
                                                      Ctx.LoRaMacClassBParams.LoRaMacParams->MinRxSymbols,
-                                                     Ctx.LoRaMacClassBParams.LoRaMacParams->SystemMaxRxError,
+                                                     Ctx.LoRaMacClassBParams.LoRaMacParams->SystemMaxRxError * 1000,
                                                      &pingSlotRxConfig );
                     Ctx.PingSlotCtx.SymbolTimeout = pingSlotRxConfig.WindowTimeout;
 
-                    if( ( int32_t )pingSlotTime > pingSlotRxConfig.WindowOffset )
+                    if( ( int32_t )pingSlotTime > WindowOffsetMs( pingSlotRxConfig.WindowOffset ) )
                     {// Apply the window offset
-                        pingSlotTime += pingSlotRxConfig.WindowOffset;
+                        pingSlotTime += WindowOffsetMs( pingSlotRxConfig.WindowOffset );
                     }
                 }
 
@@ -1142,14 +1159,14 @@ static void LoRaMacClassBProcessMulticastSlot( void )
                     RegionComputeRxWindowParameters( *Ctx.LoRaMacClassBParams.LoRaMacRegion,
                                                     Ctx.NvmCtx->PingSlotCtx.Datarate,
                                                     Ctx.LoRaMacClassBParams.LoRaMacParams->MinRxSymbols,
-                                                    Ctx.LoRaMacClassBParams.LoRaMacParams->SystemMaxRxError,
+                                                    Ctx.LoRaMacClassBParams.LoRaMacParams->SystemMaxRxError * 1000,
                                                     &multicastSlotRxConfig );
                     Ctx.PingSlotCtx.SymbolTimeout = multicastSlotRxConfig.WindowTimeout;
                 }
 
-                if( ( int32_t )multicastSlotTime > multicastSlotRxConfig.WindowOffset )
+                if( ( int32_t )multicastSlotTime > WindowOffsetMs( multicastSlotRxConfig.WindowOffset ) )
                 {// Apply the window offset
-                    multicastSlotTime += multicastSlotRxConfig.WindowOffset;
+                    multicastSlotTime += WindowOffsetMs( multicastSlotRxConfig.WindowOffset );
                 }
 
                 // Start the timer if the ping slot time is in range
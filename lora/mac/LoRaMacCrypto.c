@@ -96,6 +96,15 @@
  */
 #define CRYPTO_NVM_CTX_SIZE             sizeof( LoRaMacCryptoNvmCtx_t )
 
+/*
+ * Number of uplinks between two context change notifications caused by
+ * the uplink frame counter. When the context is restored the counter is
+ * advanced past the uplinks which may not have been stored.
+ */
+#ifndef CRYPTO_FCNT_UP_NVM_STRIDE
+#define CRYPTO_FCNT_UP_NVM_STRIDE       1
+#endif
+
 /*
  * Maximum size of the message that can be handled by the crypto operations
  */
@@ -494,6 +503,72 @@ static LoRaMacCryptoStatus_t ComputeCmacB0( uint8_t* msg, uint16_t len, KeyIdent
     return LORAMAC_CRYPTO_SUCCESS;
 }
 
+/*
+ * Encrypts the FRMPayload of a serialized uplink frame and computes the
+ * LoRaWAN 1.0.x MIC over the frame in a single pass. The encrypted payload
+ * is written to the frame buffer and back to macMsg->FRMPayload, unless
+ * the payload already lives in the frame buffer.
+ *
+ *  MIC = aes128_cmac(NwkSEncKey, B0 | MHDR | FHDR | FPort | aes128_ctr(keyID, FRMPayload))
+ *
+ * \param[IN]  keyID            - Key identifier of the payload encryption key
+ * \param[IN]  fCntUp           - Uplink frame counter
+ * \param[IN/OUT] macMsg        - Serialized data message
+ * \retval                      - Status of the operation
+ */
+static LoRaMacCryptoStatus_t PayloadEncryptComputeCmacB0( KeyIdentifier_t keyID, uint32_t fCntUp, LoRaMacMessageData_t* macMsg )
+{
+    uint16_t micOffset = macMsg->BufSize - LORAMAC_MIC_FIELD_SIZE;
+    uint16_t payloadOffset = micOffset - macMsg->FRMPayloadSize;
+
+    if( micOffset > CRYPTO_MAXMESSAGE_SIZE )
+    {
+        return LORAMAC_CRYPTO_ERROR_BUF_SIZE;
+    }
+
+    uint8_t micBuff[MIC_BLOCK_BX_SIZE];
+    uint8_t aBlock[16] = { 0 };
+
+    // The IsAck parameter is every time false since the ConfFCnt field is not used in legacy mode.
+    PrepareB0( micOffset, NWK_S_ENC_KEY, false, UPLINK, macMsg->FHDR.DevAddr, fCntUp, micBuff );
+
+    aBlock[0] = 0x01;
+
+    aBlock[5] = UPLINK;
+
+    aBlock[6] = macMsg->FHDR.DevAddr & 0xFF;
+    aBlock[7] = ( macMsg->FHDR.DevAddr >> 8 ) & 0xFF;
+    aBlock[8] = ( macMsg->FHDR.DevAddr >> 16 ) & 0xFF;
+    aBlock[9] = ( macMsg->FHDR.DevAddr >> 24 ) & 0xFF;
+
+    aBlock[10] = fCntUp & 0xFF;
+    aBlock[11] = ( fCntUp >> 8 ) & 0xFF;
+    aBlock[12] = ( fCntUp >> 16 ) & 0xFF;
+    aBlock[13] = ( fCntUp >> 24 ) & 0xFF;
+
+    aBlock[15] = 1;
+
+    if( SecureElementAesCtrEncryptCmac( micBuff, macMsg->Buffer, payloadOffset, aBlock,
+                                        &macMsg->Buffer[payloadOffset], macMsg->FRMPayloadSize, keyID,
+                                        NWK_S_ENC_KEY, &macMsg->Buffer[payloadOffset], &macMsg->MIC ) != SECURE_ELEMENT_SUCCESS )
+    {
+        return LORAMAC_CRYPTO_ERROR_SECURE_ELEMENT_FUNC;
+    }
+
+    // Retransmissions serialize the already encrypted payload again
+    if( macMsg->FRMPayload != &macMsg->Buffer[payloadOffset] )
+    {
+        memcpy1( macMsg->FRMPayload, &macMsg->Buffer[payloadOffset], macMsg->FRMPayloadSize );
+    }
+
+    macMsg->Buffer[micOffset++] = macMsg->MIC & 0xFF;
+    macMsg->Buffer[micOffset++] = ( macMsg->MIC >> 8 ) & 0xFF;
+    macMsg->Buffer[micOffset++] = ( macMsg->MIC >> 16 ) & 0xFF;
+    macMsg->Buffer[micOffset++] = ( macMsg->MIC >> 24 ) & 0xFF;
+
+    return LORAMAC_CRYPTO_SUCCESS;
+}
+
 /*!
  * Verifies cmac with adding B0 block in front.
  *
@@ -905,6 +980,23 @@ static void UpdateFCntDown( FCntIdentifier_t fCntID, uint32_t currentDown )
     CryptoCtx.EventCryptoNvmCtxChanged( );
 }
 
+/*!
+ * Sets the uplink frame counter. The context change is only notified when
+ * the counter enters a new block of CRYPTO_FCNT_UP_NVM_STRIDE uplinks.
+ *
+ * \param[IN]     fCntUp         - Uplink frame counter
+ */
+static void UpdateFCntUp( uint32_t fCntUp )
+{
+    uint32_t prevFCntUp = CryptoCtx.NvmCtx->FCntList.FCntUp;
+
+    CryptoCtx.NvmCtx->FCntList.FCntUp = fCntUp;
+    if( ( fCntUp / CRYPTO_FCNT_UP_NVM_STRIDE ) != ( prevFCntUp / CRYPTO_FCNT_UP_NVM_STRIDE ) )
+    {
+        CryptoCtx.EventCryptoNvmCtxChanged( );
+    }
+}
+
 /*!
  * Resets the frame counters
  */
@@ -979,6 +1071,12 @@ LoRaMacCryptoStatus_t LoRaMacCryptoRestoreNvmCtx( void* cryptoNvmCtx )
     if( cryptoNvmCtx != 0 )
     {
         memcpy1( ( uint8_t* ) &NvmCryptoCtx, ( uint8_t* ) cryptoNvmCtx, CRYPTO_NVM_CTX_SIZE );
+#if( CRYPTO_FCNT_UP_NVM_STRIDE > 1 )
+        // The stored counter may lag behind by the rest of its block, plus the
+        // block whose notification had not been stored yet
+        NvmCryptoCtx.FCntList.FCntUp = ( ( NvmCryptoCtx.FCntList.FCntUp / CRYPTO_FCNT_UP_NVM_STRIDE ) + 2 ) *
+                                       CRYPTO_FCNT_UP_NVM_STRIDE - 1;
+#endif
         return LORAMAC_CRYPTO_SUCCESS;
     }
     else
@@ -1457,15 +1555,15 @@ LoRaMacCryptoStatus_t LoRaMacCryptoSecureMessage( uint32_t fCntUp, uint8_t txDr,
 
     if( fCntUp > CryptoCtx.NvmCtx->FCntList.FCntUp )
     {
-        retval = PayloadEncrypt( macMsg->FRMPayload, macMsg->FRMPayloadSize, payloadDecryptionKeyID, macMsg->FHDR.DevAddr, UPLINK, fCntUp );
-        if( retval != LORAMAC_CRYPTO_SUCCESS )
-        {
-            return retval;
-        }
-
 #if( USE_LRWAN_1_1_X_CRYPTO == 1 )
         if( CryptoCtx.NvmCtx->LrWanVersion.Fields.Minor == 1 )
         {
+            retval = PayloadEncrypt( macMsg->FRMPayload, macMsg->FRMPayloadSize, payloadDecryptionKeyID, macMsg->FHDR.DevAddr, UPLINK, fCntUp );
+            if( retval != LORAMAC_CRYPTO_SUCCESS )
+            {
+                return retval;
+            }
+
             // Encrypt FOpts
             retval = FOptsEncrypt( macMsg->FHDR.FCtrl.Bits.FOptsLen, macMsg->FHDR.DevAddr, UPLINK, FCNT_UP, fCntUp, macMsg->FHDR.FOpts );
             if( retval != LORAMAC_CRYPTO_SUCCESS )
@@ -1473,10 +1571,28 @@ LoRaMacCryptoStatus_t LoRaMacCryptoSecureMessage( uint32_t fCntUp, uint8_t txDr,
                 return retval;
             }
         }
+        else
 #endif
+        {
+            // Serialize the plain message, then encrypt the payload and compute
+            // the mic in a single pass over the frame buffer
+            if( LoRaMacSerializerData( macMsg ) != LORAMAC_SERIALIZER_SUCCESS )
+            {
+                return LORAMAC_CRYPTO_ERROR_SERIALIZER;
+            }
+
+            retval = PayloadEncryptComputeCmacB0( payloadDecryptionKeyID, fCntUp, macMsg );
+            if( retval != LORAMAC_CRYPTO_SUCCESS )
+            {
+                return retval;
+            }
+
+            UpdateFCntUp( fCntUp );
+
+            return LORAMAC_CRYPTO_SUCCESS;
+        }
     }
-    CryptoCtx.NvmCtx->FCntList.FCntUp = fCntUp;
-    CryptoCtx.EventCryptoNvmCtxChanged( );
+    UpdateFCntUp( fCntUp );
 
     // Serialize message
     if( LoRaMacSerializerData( macMsg ) != LORAMAC_SERIALIZER_SUCCESS )
@@ -169,7 +169,11 @@ LoRaMacSerializerStatus_t LoRaMacSerializerData( LoRaMacMessageData_t* macMsg )
         macMsg->Buffer[bufItr++] = macMsg->FPort;
     }
 
-    memcpy1( &macMsg->Buffer[bufItr], macMsg->FRMPayload, macMsg->FRMPayloadSize );
+    // The payload may already be in place in the frame buffer
+    if( macMsg->FRMPayload != &macMsg->Buffer[bufItr] )
+    {
+        memcpy1( &macMsg->Buffer[bufItr], macMsg->FRMPayload, macMsg->FRMPayloadSize );
+    }
     bufItr = bufItr + macMsg->FRMPayloadSize;
 
     macMsg->Buffer[bufItr++] = macMsg->MIC & 0xFF;
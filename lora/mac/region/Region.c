@@ -45,6 +45,7 @@
 #define AS923_COMPUTE_RX_WINDOW_PARAMETERS( )      AS923_CASE { RegionAS923ComputeRxWindowParameters( datarate, minRxSymbols, rxError, rxConfigParams ); break; }
 #define AS923_RX_CONFIG( )                         AS923_CASE { return RegionAS923RxConfig( rxConfig, datarate ); }
 #define AS923_TX_CONFIG( )                         AS923_CASE { return RegionAS923TxConfig( txConfig, txPower, txTimeOnAir ); }
+#define AS923_GET_TIME_ON_AIR( )                   AS923_CASE { return RegionAS923GetTimeOnAir( datarate, pktLen ); }
 #define AS923_LINK_ADR_REQ( )                      AS923_CASE { return RegionAS923LinkAdrReq( linkAdrReq, drOut, txPowOut, nbRepOut, nbBytesParsed ); }
 #define AS923_RX_PARAM_SETUP_REQ( )                AS923_CASE { return RegionAS923RxParamSetupReq( rxParamSetupReq ); }
 #define AS923_NEW_CHANNEL_REQ( )                   AS923_CASE { return RegionAS923NewChannelReq( newChannelReq ); }
@@ -70,6 +71,7 @@
 #define AS923_COMPUTE_RX_WINDOW_PARAMETERS( )
 #define AS923_RX_CONFIG( )
 #define AS923_TX_CONFIG( )
+#define AS923_GET_TIME_ON_AIR( )
 #define AS923_LINK_ADR_REQ( )
 #define AS923_RX_PARAM_SETUP_REQ( )
 #define AS923_NEW_CHANNEL_REQ( )
@@ -99,6 +101,7 @@
 #define AU915_COMPUTE_RX_WINDOW_PARAMETERS( )      AU915_CASE { RegionAU915ComputeRxWindowParameters( datarate, minRxSymbols, rxError, rxConfigParams ); break; }
 #define AU915_RX_CONFIG( )                         AU915_CASE { return RegionAU915RxConfig( rxConfig, datarate ); }
 #define AU915_TX_CONFIG( )                         AU915_CASE { return RegionAU915TxConfig( txConfig, txPower, txTimeOnAir ); }
+#define AU915_GET_TIME_ON_AIR( )                   AU915_CASE { return RegionAU915GetTimeOnAir( datarate, pktLen ); }
 #define AU915_LINK_ADR_REQ( )                      AU915_CASE { return RegionAU915LinkAdrReq( linkAdrReq, drOut, txPowOut, nbRepOut, nbBytesParsed ); }
 #define AU915_RX_PARAM_SETUP_REQ( )                AU915_CASE { return RegionAU915RxParamSetupReq( rxParamSetupReq ); }
 #define AU915_NEW_CHANNEL_REQ( )                   AU915_CASE { return RegionAU915NewChannelReq( newChannelReq ); }
@@ -124,6 +127,7 @@
 #define AU915_COMPUTE_RX_WINDOW_PARAMETERS( )
 #define AU915_RX_CONFIG( )
 #define AU915_TX_CONFIG( )
+#define AU915_GET_TIME_ON_AIR( )
 #define AU915_LINK_ADR_REQ( )
 #define AU915_RX_PARAM_SETUP_REQ( )
 #define AU915_NEW_CHANNEL_REQ( )
@@ -153,6 +157,7 @@
 #define CN470_COMPUTE_RX_WINDOW_PARAMETERS( )      CN470_CASE { RegionCN470ComputeRxWindowParameters( datarate, minRxSymbols, rxError, rxConfigParams ); break; }
 #define CN470_RX_CONFIG( )                         CN470_CASE { return RegionCN470RxConfig( rxConfig, datarate ); }
 #define CN470_TX_CONFIG( )                         CN470_CASE { return RegionCN470TxConfig( txConfig, txPower, txTimeOnAir ); }
+#define CN470_GET_TIME_ON_AIR( )                   CN470_CASE { return RegionCN470GetTimeOnAir( datarate, pktLen ); }
 #define CN470_LINK_ADR_REQ( )                      CN470_CASE { return RegionCN470LinkAdrReq( linkAdrReq, drOut, txPowOut, nbRepOut, nbBytesParsed ); }
 #define CN470_RX_PARAM_SETUP_REQ( )                CN470_CASE { return RegionCN470RxParamSetupReq( rxParamSetupReq ); }
 #define CN470_NEW_CHANNEL_REQ( )                   CN470_CASE { return RegionCN470NewChannelReq( newChannelReq ); }
@@ -178,6 +183,7 @@
 #define CN470_COMPUTE_RX_WINDOW_PARAMETERS( )
 #define CN470_RX_CONFIG( )
 #define CN470_TX_CONFIG( )
+#define CN470_GET_TIME_ON_AIR( )
 #define CN470_LINK_ADR_REQ( )
 #define CN470_RX_PARAM_SETUP_REQ( )
 #define CN470_NEW_CHANNEL_REQ( )
@@ -207,6 +213,7 @@
 #define CN779_COMPUTE_RX_WINDOW_PARAMETERS( )      CN779_CASE { RegionCN779ComputeRxWindowParameters( datarate, minRxSymbols, rxError, rxConfigParams ); break; }
 #define CN779_RX_CONFIG( )                         CN779_CASE { return RegionCN779RxConfig( rxConfig, datarate ); }
 #define CN779_TX_CONFIG( )                         CN779_CASE { return RegionCN779TxConfig( txConfig, txPower, txTimeOnAir ); }
+#define CN779_GET_TIME_ON_AIR( )                   CN779_CASE { return RegionCN779GetTimeOnAir( datarate, pktLen ); }
 #define CN779_LINK_ADR_REQ( )                      CN779_CASE { return RegionCN779LinkAdrReq( linkAdrReq, drOut, txPowOut, nbRepOut, nbBytesParsed ); }
 #define CN779_RX_PARAM_SETUP_REQ( )                CN779_CASE { return RegionCN779RxParamSetupReq( rxParamSetupReq ); }
 #define CN779_NEW_CHANNEL_REQ( )                   CN779_CASE { return RegionCN779NewChannelReq( newChannelReq ); }
@@ -232,6 +239,7 @@
 #define CN779_COMPUTE_RX_WINDOW_PARAMETERS( )
 #define CN779_RX_CONFIG( )
 #define CN779_TX_CONFIG( )
+#define CN779_GET_TIME_ON_AIR( )
 #define CN779_LINK_ADR_REQ( )
 #define CN779_RX_PARAM_SETUP_REQ( )
 #define CN779_NEW_CHANNEL_REQ( )
@@ -261,6 +269,7 @@
 #define EU433_COMPUTE_RX_WINDOW_PARAMETERS( )      EU433_CASE { RegionEU433ComputeRxWindowParameters( datarate, minRxSymbols, rxError, rxConfigParams ); break; }
 #define EU433_RX_CONFIG( )                         EU433_CASE { return RegionEU433RxConfig( rxConfig, datarate ); }
 #define EU433_TX_CONFIG( )                         EU433_CASE { return RegionEU433TxConfig( txConfig, txPower, txTimeOnAir ); }
+#define EU433_GET_TIME_ON_AIR( )                   EU433_CASE { return RegionEU433GetTimeOnAir( datarate, pktLen ); }
 #define EU433_LINK_ADR_REQ( )                      EU433_CASE { return RegionEU433LinkAdrReq( linkAdrReq, drOut, txPowOut, nbRepOut, nbBytesParsed ); }
 #define EU433_RX_PARAM_SETUP_REQ( )                EU433_CASE { return RegionEU433RxParamSetupReq( rxParamSetupReq ); }
 #define EU433_NEW_CHANNEL_REQ( )                   EU433_CASE { return RegionEU433NewChannelReq( newChannelReq ); }
@@ -286,6 +295,7 @@
 #define EU433_COMPUTE_RX_WINDOW_PARAMETERS( )
 #define EU433_RX_CONFIG( )
 #define EU433_TX_CONFIG( )
+#define EU433_GET_TIME_ON_AIR( )
 #define EU433_LINK_ADR_REQ( )
 #define EU433_RX_PARAM_SETUP_REQ( )
 #define EU433_NEW_CHANNEL_REQ( )
@@ -315,6 +325,7 @@
 #define EU868_COMPUTE_RX_WINDOW_PARAMETERS( )      EU868_CASE { RegionEU868ComputeRxWindowParameters( datarate, minRxSymbols, rxError, rxConfigParams ); break; }
 #define EU868_RX_CONFIG( )                         EU868_CASE { return RegionEU868RxConfig( rxConfig, datarate ); }
 #define EU868_TX_CONFIG( )                         EU868_CASE { return RegionEU868TxConfig( txConfig, txPower, txTimeOnAir ); }
+#define EU868_GET_TIME_ON_AIR( )                   EU868_CASE { return RegionEU868GetTimeOnAir( datarate, pktLen ); }
 #define EU868_LINK_ADR_REQ( )                      EU868_CASE { return RegionEU868LinkAdrReq( linkAdrReq, drOut, txPowOut, nbRepOut, nbBytesParsed ); }
 #define EU868_RX_PARAM_SETUP_REQ( )                EU868_CASE { return RegionEU868RxParamSetupReq( rxParamSetupReq ); }
 #define EU868_NEW_CHANNEL_REQ( )                   EU868_CASE { return RegionEU868NewChannelReq( newChannelReq ); }
@@ -340,6 +351,7 @@
 #define EU868_COMPUTE_RX_WINDOW_PARAMETERS( )
 #define EU868_RX_CONFIG( )
 #define EU868_TX_CONFIG( )
+#define EU868_GET_TIME_ON_AIR( )
 #define EU868_LINK_ADR_REQ( )
 #define EU868_RX_PARAM_SETUP_REQ( )
 #define EU868_NEW_CHANNEL_REQ( )
@@ -369,6 +381,7 @@
 #define KR920_COMPUTE_RX_WINDOW_PARAMETERS( )      KR920_CASE { RegionKR920ComputeRxWindowParameters( datarate, minRxSymbols, rxError, rxConfigParams ); break; }
 #define KR920_RX_CONFIG( )                         KR920_CASE { return RegionKR920RxConfig( rxConfig, datarate ); }
 #define KR920_TX_CONFIG( )                         KR920_CASE { return RegionKR920TxConfig( txConfig, txPower, txTimeOnAir ); }
+#define KR920_GET_TIME_ON_AIR( )                   KR920_CASE { return RegionKR920GetTimeOnAir( datarate, pktLen ); }
 #define KR920_LINK_ADR_REQ( )                      KR920_CASE { return RegionKR920LinkAdrReq( linkAdrReq, drOut, txPowOut, nbRepOut, nbBytesParsed ); }
 #define KR920_RX_PARAM_SETUP_REQ( )                KR920_CASE { return RegionKR920RxParamSetupReq( rxParamSetupReq ); }
 #define KR920_NEW_CHANNEL_REQ( )                   KR920_CASE { return RegionKR920NewChannelReq( newChannelReq ); }
@@ -394,6 +407,7 @@
 #define KR920_COMPUTE_RX_WINDOW_PARAMETERS( )
 #define KR920_RX_CONFIG( )
 #define KR920_TX_CONFIG( )
+#define KR920_GET_TIME_ON_AIR( )
 #define KR920_LINK_ADR_REQ( )
 #define KR920_RX_PARAM_SETUP_REQ( )
 #define KR920_NEW_CHANNEL_REQ( )
@@ -423,6 +437,7 @@
 #define IN865_COMPUTE_RX_WINDOW_PARAMETERS( )      IN865_CASE { RegionIN865ComputeRxWindowParameters( datarate, minRxSymbols, rxError, rxConfigParams ); break; }
 #define IN865_RX_CONFIG( )                         IN865_CASE { return RegionIN865RxConfig( rxConfig, datarate ); }
 #define IN865_TX_CONFIG( )                         IN865_CASE { return RegionIN865TxConfig( txConfig, txPower, txTimeOnAir ); }
+#define IN865_GET_TIME_ON_AIR( )                   IN865_CASE { return RegionIN865GetTimeOnAir( datarate, pktLen ); }
 #define IN865_LINK_ADR_REQ( )                      IN865_CASE { return RegionIN865LinkAdrReq( linkAdrReq, drOut, txPowOut, nbRepOut, nbBytesParsed ); }
 #define IN865_RX_PARAM_SETUP_REQ( )                IN865_CASE { return RegionIN865RxParamSetupReq( rxParamSetupReq ); }
 #define IN865_NEW_CHANNEL_REQ( )                   IN865_CASE { return RegionIN865NewChannelReq( newChannelReq ); }
@@ -448,6 +463,7 @@
 #define IN865_COMPUTE_RX_WINDOW_PARAMETERS( )
 #define IN865_RX_CONFIG( )
 #define IN865_TX_CONFIG( )
+#define IN865_GET_TIME_ON_AIR( )
 #define IN865_LINK_ADR_REQ( )
 #define IN865_RX_PARAM_SETUP_REQ( )
 #define IN865_NEW_CHANNEL_REQ( )
@@ -477,6 +493,7 @@
 #define US915_COMPUTE_RX_WINDOW_PARAMETERS( )      US915_CASE { RegionUS915ComputeRxWindowParameters( datarate, minRxSymbols, rxError, rxConfigParams ); break; }
 #define US915_RX_CONFIG( )                         US915_CASE { return RegionUS915RxConfig( rxConfig, datarate ); }
 #define US915_TX_CONFIG( )                         US915_CASE { return RegionUS915TxConfig( txConfig, txPower, txTimeOnAir ); }
+#define US915_GET_TIME_ON_AIR( )                   US915_CASE { return RegionUS915GetTimeOnAir( datarate, pktLen ); }
 #define US915_LINK_ADR_REQ( )                      US915_CASE { return RegionUS915LinkAdrReq( linkAdrReq, drOut, txPowOut, nbRepOut, nbBytesParsed ); }
 #define US915_RX_PARAM_SETUP_REQ( )                US915_CASE { return RegionUS915RxParamSetupReq( rxParamSetupReq ); }
 #define US915_NEW_CHANNEL_REQ( )                   US915_CASE { return RegionUS915NewChannelReq( newChannelReq ); }
@@ -502,6 +519,7 @@
 #define US915_COMPUTE_RX_WINDOW_PARAMETERS( )
 #define US915_RX_CONFIG( )
 #define US915_TX_CONFIG( )
+#define US915_GET_TIME_ON_AIR( )
 #define US915_LINK_ADR_REQ( )
 #define US915_RX_PARAM_SETUP_REQ( )
 #define US915_NEW_CHANNEL_REQ( )
@@ -531,6 +549,7 @@
 #define RU864_COMPUTE_RX_WINDOW_PARAMETERS( )      RU864_CASE { RegionRU864ComputeRxWindowParameters( datarate, minRxSymbols, rxError, rxConfigParams ); break; }
 #define RU864_RX_CONFIG( )                         RU864_CASE { return RegionRU864RxConfig( rxConfig, datarate ); }
 #define RU864_TX_CONFIG( )                         RU864_CASE { return RegionRU864TxConfig( txConfig, txPower, txTimeOnAir ); }
+#define RU864_GET_TIME_ON_AIR( )                   RU864_CASE { return RegionRU864GetTimeOnAir( datarate, pktLen ); }
 #define RU864_LINK_ADR_REQ( )                      RU864_CASE { return RegionRU864LinkAdrReq( linkAdrReq, drOut, txPowOut, nbRepOut, nbBytesParsed ); }
 #define RU864_RX_PARAM_SETUP_REQ( )                RU864_CASE { return RegionRU864RxParamSetupReq( rxParamSetupReq ); }
 #define RU864_NEW_CHANNEL_REQ( )                   RU864_CASE { return RegionRU864NewChannelReq( newChannelReq ); }
@@ -556,6 +575,7 @@
 #define RU864_COMPUTE_RX_WINDOW_PARAMETERS( )
 #define RU864_RX_CONFIG( )
 #define RU864_TX_CONFIG( )
+#define RU864_GET_TIME_ON_AIR( )
 #define RU864_LINK_ADR_REQ( )
 #define RU864_RX_PARAM_SETUP_REQ( )
 #define RU864_NEW_CHANNEL_REQ( )
@@ -803,6 +823,27 @@ bool RegionTxConfig( LoRaMacRegion_t region, TxConfigParams_t* txConfig, int8_t*
     }
 }
 
+TimerTime_t RegionGetTimeOnAir( LoRaMacRegion_t region, int8_t datarate, uint8_t pktLen )
+{
+    switch( region )
+    {
+        AS923_GET_TIME_ON_AIR( );
+        AU915_GET_TIME_ON_AIR( );
+        CN470_GET_TIME_ON_AIR( );
+        CN779_GET_TIME_ON_AIR( );
+        EU433_GET_TIME_ON_AIR( );
+        EU868_GET_TIME_ON_AIR( );
+        KR920_GET_TIME_ON_AIR( );
+        IN865_GET_TIME_ON_AIR( );
+        US915_GET_TIME_ON_AIR( );
+        RU864_GET_TIME_ON_AIR( );
+        default:
+        {
+            return 0;
+        }
+    }
+}
+
 uint8_t RegionLinkAdrReq( LoRaMacRegion_t region, LinkAdrReqParams_t* linkAdrReq, int8_t* drOut, int8_t* txPowOut, uint8_t* nbRepOut, uint8_t* nbBytesParsed )
 {
     switch( region )
@@ -1050,9 +1050,13 @@ typedef struct sRxConfigParams
      */
      uint32_t WindowTimeout;
     /*!
-     * RX window offset
+     * RX window offset in microseconds
      */
     int32_t WindowOffset;
+    /*!
+     * RX window symbol time in microseconds
+     */
+    uint32_t SymbolTime;
     /*!
      * Downlink dwell time.
      */
@@ -1504,11 +1508,11 @@ bool RegionRxConfig( LoRaMacRegion_t region, RxConfigParams_t* rxConfig, int8_t*
  *
  * \param [IN] minRxSymbols Minimum required number of symbols to detect an Rx frame.
  *
- * \param [IN] rxError      System maximum timing error of the receiver. In milliseconds
- *                          The receiver will turn on in a [-rxError : +rxError] ms
+ * \param [IN] rxError      System maximum timing error of the receiver. In microseconds
+ *                          The receiver will turn on in a [-rxError : +rxError] us
  *                          interval around RxOffset
  *
- * \param [OUT]rxConfigParams Returns updated WindowTimeout and WindowOffset fields.
+ * \param [OUT]rxConfigParams Returns updated WindowTimeout, WindowOffset and SymbolTime fields.
  */
 void RegionComputeRxWindowParameters( LoRaMacRegion_t region, int8_t datarate, uint8_t minRxSymbols, uint32_t rxError, RxConfigParams_t *rxConfigParams );
 
@@ -1527,6 +1531,21 @@ void RegionComputeRxWindowParameters( LoRaMacRegion_t region, int8_t datarate, u
  */
 bool RegionTxConfig( LoRaMacRegion_t region, TxConfigParams_t* txConfig, int8_t* txPower, TimerTime_t* txTimeOnAir );
 
+/*!
+ * \brief Returns the time-on-air of a frame, from the table generated at
+ *        build time.
+ *
+ * \param [IN] region LoRaWAN region.
+ *
+ * \param [IN] datarate Datarate index.
+ *
+ * \param [IN] pktLen Frame length, PHY payload in bytes.
+ *
+ * \retval Returns the time-on-air in milliseconds, 0 if the frame is longer
+ *         than the maximum payload of the datarate allows.
+ */
+TimerTime_t RegionGetTimeOnAir( LoRaMacRegion_t region, int8_t datarate, uint8_t pktLen );
+
 /*!
  * \brief The function processes a Link ADR Request.
  *
@@ -38,6 +38,7 @@
 #define __REGION_AS923_H__
 
 #include "region/Region.h"
+#include "region/RegionCommon.h"
 
 /*!
  * LoRaMac maximum number of channels
@@ -320,6 +321,11 @@ static const uint8_t MaxPayloadOfDatarateDwell1DownAS923[] = { 0, 0, 11, 53, 126
  */
 static const int8_t EffectiveRx1DrOffsetAS923[] = { 0, 1, 2, 3, 4, 5, -1, -2 };
 
+/*!
+ * Time-on-air table, generated at build time
+ */
+extern const RegionCommonTimeOnAir_t TimeOnAirAS923;
+
 /*!
  * \brief The function gets a value of a specific phy attribute.
  *
@@ -387,8 +393,8 @@ bool RegionAS923ChanMaskSet( ChanMaskSetParams_t* chanMaskSet );
  *
  * \param [IN] minRxSymbols Minimum required number of symbols to detect an Rx frame.
  *
- * \param [IN] rxError      System maximum timing error of the receiver. In milliseconds
- *                          The receiver will turn on in a [-rxError : +rxError] ms
+ * \param [IN] rxError      System maximum timing error of the receiver. In microseconds
+ *                          The receiver will turn on in a [-rxError : +rxError] us
  *                          interval around RxOffset
  *
  * \param [OUT]rxConfigParams Returns updated WindowTimeout and WindowOffset fields.
@@ -419,6 +425,18 @@ bool RegionAS923RxConfig( RxConfigParams_t* rxConfig, int8_t* datarate );
  */
 bool RegionAS923TxConfig( TxConfigParams_t* txConfig, int8_t* txPower, TimerTime_t* txTimeOnAir );
 
+/*!
+ * \brief Returns the time-on-air of a frame.
+ *
+ * \param [IN] datarate Datarate index.
+ *
+ * \param [IN] pktLen Frame length, PHY payload in bytes.
+ *
+ * \retval Returns the time-on-air in milliseconds, 0 if the frame is longer
+ *         than the maximum payload of the datarate allows.
+ */
+TimerTime_t RegionAS923GetTimeOnAir( int8_t datarate, uint8_t pktLen );
+
 /*!
  * \brief The function processes a Link ADR Request.
  *
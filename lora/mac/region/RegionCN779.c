@@ -516,7 +516,7 @@ bool RegionCN779ChanMaskSet( ChanMaskSetParams_t* chanMaskSet )
 
 void RegionCN779ComputeRxWindowParameters( int8_t datarate, uint8_t minRxSymbols, uint32_t rxError, RxConfigParams_t *rxConfigParams )
 {
-    double tSymbol = 0.0;
+    uint32_t tSymbol = 0;
 
     // Get the datarate, perform a boundary check
     rxConfigParams->Datarate = MIN( datarate, CN779_RX_MAX_DATARATE );
@@ -532,6 +532,7 @@ void RegionCN779ComputeRxWindowParameters( int8_t datarate, uint8_t minRxSymbols
     }
 
     RegionCommonComputeRxWindowParameters( tSymbol, minRxSymbols, rxError, Radio.GetWakeupTime( ), &rxConfigParams->WindowTimeout, &rxConfigParams->WindowOffset );
+    rxConfigParams->SymbolTime = tSymbol;
 }
 
 bool RegionCN779RxConfig( RxConfigParams_t* rxConfig, int8_t* datarate )
@@ -616,13 +617,23 @@ bool RegionCN779TxConfig( TxConfigParams_t* txConfig, int8_t* txPower, TimerTime
 
     // Setup maximum payload lenght of the radio driver
     Radio.SetMaxPayloadLength( modem, txConfig->PktLen );
-    // Get the time-on-air of the next tx frame
-    *txTimeOnAir = Radio.TimeOnAir( modem, txConfig->PktLen );
+    // Get the time-on-air of the next tx frame, from the radio if it is
+    // longer than the datarate allows
+    *txTimeOnAir = RegionCN779GetTimeOnAir( txConfig->Datarate, txConfig->PktLen );
+    if( *txTimeOnAir == 0 )
+    {
+        *txTimeOnAir = Radio.TimeOnAir( modem, txConfig->PktLen );
+    }
 
     *txPower = txPowerLimited;
     return true;
 }
 
+TimerTime_t RegionCN779GetTimeOnAir( int8_t datarate, uint8_t pktLen )
+{
+    return RegionCommonGetTimeOnAir( &TimeOnAirCN779, datarate, pktLen );
+}
+
 uint8_t RegionCN779LinkAdrReq( LinkAdrReqParams_t* linkAdrReq, int8_t* drOut, int8_t* txPowOut, uint8_t* nbRepOut, uint8_t* nbBytesParsed )
 {
     uint8_t status = 0x07;
@@ -38,6 +38,7 @@
 #define __REGION_CN779_H__
 
 #include "region/Region.h"
+#include "region/RegionCommon.h"
 
 /*!
  * LoRaMac maximum number of channels
@@ -282,6 +283,11 @@ static const uint8_t MaxPayloadOfDatarateCN779[] = { 51, 51, 51, 115, 242, 242,
  */
 static const uint8_t MaxPayloadOfDatarateRepeaterCN779[] = { 51, 51, 51, 115, 222, 222, 222, 222 };
 
+/*!
+ * Time-on-air table, generated at build time
+ */
+extern const RegionCommonTimeOnAir_t TimeOnAirCN779;
+
 /*!
  * \brief The function gets a value of a specific phy attribute.
  *
@@ -349,8 +355,8 @@ bool RegionCN779ChanMaskSet( ChanMaskSetParams_t* chanMaskSet );
  *
  * \param [IN] minRxSymbols Minimum required number of symbols to detect an Rx frame.
  *
- * \param [IN] rxError      System maximum timing error of the receiver. In milliseconds
- *                          The receiver will turn on in a [-rxError : +rxError] ms
+ * \param [IN] rxError      System maximum timing error of the receiver. In microseconds
+ *                          The receiver will turn on in a [-rxError : +rxError] us
  *                          interval around RxOffset
  *
  * \param [OUT]rxConfigParams Returns updated WindowTimeout and WindowOffset fields.
@@ -381,6 +387,18 @@ bool RegionCN779RxConfig( RxConfigParams_t* rxConfig, int8_t* datarate );
  */
 bool RegionCN779TxConfig( TxConfigParams_t* txConfig, int8_t* txPower, TimerTime_t* txTimeOnAir );
 
+/*!
+ * \brief Returns the time-on-air of a frame.
+ *
+ * \param [IN] datarate Datarate index.
+ *
+ * \param [IN] pktLen Frame length, PHY payload in bytes.
+ *
+ * \retval Returns the time-on-air in milliseconds, 0 if the frame is longer
+ *         than the maximum payload of the datarate allows.
+ */
+TimerTime_t RegionCN779GetTimeOnAir( int8_t datarate, uint8_t pktLen );
+
 /*!
  * \brief The function processes a Link ADR Request.
  *
@@ -28,7 +28,6 @@
  *
  * \author    Daniel Jaeckle ( STACKFORCE )
  */
-#include <math.h>
 #include "radio.h"
 #include "utilities.h"
 #include "RegionCommon.h"
@@ -289,31 +288,70 @@ uint8_t RegionCommonLinkAdrReqVerifyParams( RegionCommonLinkAdrReqVerifyParams_t
     return status;
 }
 
-double RegionCommonComputeSymbolTimeLoRa( uint8_t phyDr, uint32_t bandwidth )
+/*!
+ * \brief Divides and rounds towards plus infinity
+ *
+ * \param [IN] num Dividend
+ *
+ * \param [IN] den Divisor, must be positive
+ *
+ * \retval Returns ceil( num / den )
+ */
+static int32_t DivCeil( int32_t num, int32_t den )
+{
+    if( num >= 0 )
+    {
+        return ( num + den - 1 ) / den;
+    }
+    return -( -num / den );
+}
+
+uint32_t RegionCommonComputeSymbolTimeLoRa( uint8_t phyDr, uint32_t bandwidth )
 {
-    return ( ( double )( 1 << phyDr ) / ( double )bandwidth ) * 1000;
+    return ( ( ( uint32_t )1 << phyDr ) * 1000000UL ) / bandwidth;
 }
 
-double RegionCommonComputeSymbolTimeFsk( uint8_t phyDr )
+uint32_t RegionCommonComputeSymbolTimeFsk( uint8_t phyDr )
 {
-    return ( 8.0 / ( double )phyDr ); // 1 symbol equals 1 byte
+    return ( 8000UL / phyDr ); // 1 symbol equals 1 byte
 }
 
-void RegionCommonComputeRxWindowParameters( double tSymbol, uint8_t minRxSymbols, uint32_t rxError, uint32_t wakeUpTime, uint32_t* windowTimeout, int32_t* windowOffset )
+void RegionCommonComputeRxWindowParameters( uint32_t tSymbol, uint8_t minRxSymbols, uint32_t rxError, uint32_t wakeUpTime, uint32_t* windowTimeout, int32_t* windowOffset )
 {
-    *windowTimeout = MAX( ( uint32_t )ceil( ( ( 2 * minRxSymbols - 8 ) * tSymbol + 2 * rxError ) / tSymbol ), minRxSymbols ); // Computed number of symbols
-    *windowOffset = ( int32_t )ceil( ( 4.0 * tSymbol ) - ( ( *windowTimeout * tSymbol ) / 2.0 ) - wakeUpTime );
+    int32_t ts = ( int32_t )tSymbol;
+    int32_t timeout = DivCeil( ( 2 * minRxSymbols - 8 ) * ts + 2 * ( int32_t )rxError, ts ); // Computed number of symbols
+
+    *windowTimeout = MAX( timeout, ( int32_t )minRxSymbols );
+    // Symbol times are even, the half window is exact
+    *windowOffset = 4 * ts - ( ( int32_t )*windowTimeout * ts ) / 2 - ( int32_t )wakeUpTime * 1000;
 }
 
 int8_t RegionCommonComputeTxPower( int8_t txPowerIndex, float maxEirp, float antennaGain )
 {
-    int8_t phyTxPower = 0;
-
-    phyTxPower = ( int8_t )floor( ( maxEirp - ( txPowerIndex * 2U ) ) - antennaGain );
+    float txPower = ( maxEirp - ( txPowerIndex * 2U ) ) - antennaGain;
+    int8_t phyTxPower = ( int8_t )txPower;
 
+    // Round towards minus infinity
+    if( phyTxPower > txPower )
+    {
+        phyTxPower--;
+    }
     return phyTxPower;
 }
 
+TimerTime_t RegionCommonGetTimeOnAir( const RegionCommonTimeOnAir_t* timeOnAir, int8_t datarate, uint8_t pktLen )
+{
+    if( ( datarate < 0 ) || ( datarate >= timeOnAir->Datarates ) )
+    {
+        return 0;
+    }
+    if( ( timeOnAir->Offset[datarate] + pktLen ) >= timeOnAir->Offset[datarate + 1] )
+    {
+        return 0;
+    }
+    return timeOnAir->Airtime[timeOnAir->Offset[datarate] + pktLen];
+}
+
 void RegionCommonCalcBackOff( RegionCommonCalcBackOffParams_t* calcBackOffParams )
 {
     uint8_t bandIdx = calcBackOffParams->Channels[calcBackOffParams->Channel].Band;
@@ -200,6 +200,28 @@ typedef struct sRegionCommonRxBeaconSetupParams
     uint16_t SymbolTimeout;
 }RegionCommonRxBeaconSetupParams_t;
 
+/*!
+ * Time-on-air table of a region, generated at build time by tools/toagen.c
+ * for the radio settings of the region TxConfig function.
+ */
+typedef struct sRegionCommonTimeOnAir
+{
+    /*!
+     * Number of datarates in the table.
+     */
+    uint8_t Datarates;
+    /*!
+     * Index in Airtime of the first entry of each datarate, followed by the
+     * total number of entries. Datarate dr has one entry for each frame
+     * length from 0 up to Offset[dr + 1] - Offset[dr] - 1 bytes.
+     */
+    const uint16_t* Offset;
+    /*!
+     * Time-on-air in milliseconds.
+     */
+    const uint16_t* Airtime;
+}RegionCommonTimeOnAir_t;
+
 /*!
  * \brief Calculates the join duty cycle.
  *        This is a generic function and valid for all regions.
@@ -350,9 +372,9 @@ uint8_t RegionCommonLinkAdrReqVerifyParams( RegionCommonLinkAdrReqVerifyParams_t
  *
  * \param [IN] bandwidth Bandwidth to use.
  *
- * \retval Returns the symbol time.
+ * \retval Returns the symbol time in microseconds.
  */
-double RegionCommonComputeSymbolTimeLoRa( uint8_t phyDr, uint32_t bandwidth );
+uint32_t RegionCommonComputeSymbolTimeLoRa( uint8_t phyDr, uint32_t bandwidth );
 
 /*!
  * \brief Computes the symbol time for FSK modulation.
@@ -361,27 +383,27 @@ double RegionCommonComputeSymbolTimeLoRa( uint8_t phyDr, uint32_t bandwidth );
  *
  * \param [IN] bandwidth Bandwidth to use.
  *
- * \retval Returns the symbol time.
+ * \retval Returns the symbol time in microseconds.
  */
-double RegionCommonComputeSymbolTimeFsk( uint8_t phyDr );
+uint32_t RegionCommonComputeSymbolTimeFsk( uint8_t phyDr );
 
 /*!
  * \brief Computes the RX window timeout and the RX window offset.
  *
- * \param [IN] tSymbol Symbol timeout.
+ * \param [IN] tSymbol Symbol time in microseconds.
  *
  * \param [IN] minRxSymbols Minimum required number of symbols to detect an Rx frame.
  *
- * \param [IN] rxError System maximum timing error of the receiver. In milliseconds
- *                     The receiver will turn on in a [-rxError : +rxError] ms interval around RxOffset.
+ * \param [IN] rxError System maximum timing error of the receiver. In microseconds
+ *                     The receiver will turn on in a [-rxError : +rxError] us interval around RxOffset.
  *
  * \param [IN] wakeUpTime Wakeup time of the system.
  *
  * \param [OUT] windowTimeout RX window timeout.
  *
- * \param [OUT] windowOffset RX window time offset to be applied to the RX delay.
+ * \param [OUT] windowOffset RX window time offset to be applied to the RX delay, in microseconds.
  */
-void RegionCommonComputeRxWindowParameters( double tSymbol, uint8_t minRxSymbols, uint32_t rxError, uint32_t wakeUpTime, uint32_t* windowTimeout, int32_t* windowOffset );
+void RegionCommonComputeRxWindowParameters( uint32_t tSymbol, uint8_t minRxSymbols, uint32_t rxError, uint32_t wakeUpTime, uint32_t* windowTimeout, int32_t* windowOffset );
 
 /*!
  * \brief Computes the txPower, based on the max EIRP and the antenna gain.
@@ -400,6 +422,21 @@ void RegionCommonComputeRxWindowParameters( double tSymbol, uint8_t minRxSymbols
  */
 int8_t RegionCommonComputeTxPower( int8_t txPowerIndex, float maxEirp, float antennaGain );
 
+/*!
+ * \brief Looks up the time-on-air of a frame.
+ *
+ * \param [IN] timeOnAir Time-on-air table of the region.
+ *
+ * \param [IN] datarate Datarate index.
+ *
+ * \param [IN] pktLen Frame length, PHY payload in bytes.
+ *
+ * \retval Returns the time-on-air in milliseconds, 0 if the table does not
+ *         hold the datarate or if the frame is longer than the maximum
+ *         payload of the datarate allows.
+ */
+TimerTime_t RegionCommonGetTimeOnAir( const RegionCommonTimeOnAir_t* timeOnAir, int8_t datarate, uint8_t pktLen );
+
 /*!
  * \brief Calculates the duty cycle for the current band.
  *
@@ -153,6 +153,29 @@ SecureElementStatus_t SecureElementVerifyAesCmac( uint8_t* buffer, uint16_t size
  */
 SecureElementStatus_t SecureElementAesEncrypt( uint8_t* buffer, uint16_t size, KeyIdentifier_t keyID, uint8_t* encBuffer );
 
+/*!
+ * Encrypts a buffer in AES-CTR mode and computes the CMAC over a message ending
+ * with the encrypted buffer, in a single pass over the data
+ *
+ *  encBuffer = aes128_ctr(encKeyID, aBlock, buffer)
+ *  cmac = aes128_cmac(micKeyID, micBxBuffer | hdr | encBuffer)
+ *
+ * \param[IN]  micBxBuffer    - Buffer containing the initial Bx block
+ * \param[IN]  hdr            - Message data in front of the encrypted buffer
+ * \param[IN]  hdrSize        - Message data size
+ * \param[IN]  aBlock         - Initial counter block. The last byte is incremented for each block
+ * \param[IN]  buffer         - Data buffer
+ * \param[IN]  size           - Data buffer size
+ * \param[IN]  encKeyID       - Key identifier to determine the AES key to be used for the encryption
+ * \param[IN]  micKeyID       - Key identifier to determine the AES key to be used for the cmac
+ * \param[OUT] encBuffer      - Encrypted buffer, may be the same as buffer
+ * \param[OUT] cmac           - Computed cmac
+ * \retval                    - Status of the operation
+ */
+SecureElementStatus_t SecureElementAesCtrEncryptCmac( uint8_t* micBxBuffer, uint8_t* hdr, uint16_t hdrSize, uint8_t* aBlock,
+                                                      uint8_t* buffer, uint16_t size, KeyIdentifier_t encKeyID,
+                                                      KeyIdentifier_t micKeyID, uint8_t* encBuffer, uint32_t* cmac );
+
 /*!
  * Derives and store a key
  *
@@ -0,0 +1,488 @@
+/* LoRaMac context persistence */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <osal.h>
+#include <ad_nvms.h>
+
+#include "lora/lora.h"
+#include "lora/nvmctx.h"
+#include "lora/param.h"
+#include "lora/util.h"
+
+#define DEBUG
+
+/*
+ * The contexts live in the generic (VES) partition behind the area
+ * used by param.c:
+ *
+ *   slot 0: header, contexts in LoRaMacNvmCtxModule_t order
+ *   slot 1: header, contexts in LoRaMacNvmCtxModule_t order
+ *   journal: records of changed bytes since the newest slot was written
+ *
+ * Changes are appended to the journal as records holding only the
+ * bytes that differ from the stored state, and each commit ends with
+ * an empty marker record: records not followed by a marker are not
+ * applied, so a restore sees either all or none of a commit. When the
+ * journal is full the current state is compacted into the older slot,
+ * whose header is written last and carries a higher generation. Records
+ * are protected by a CRC seeded with the generation of the slot they
+ * apply to, so the records of previous generations and a record torn
+ * by a power loss both end the journal.
+ */
+#define NVMCTX_OFF		0x100
+#define NVMCTX_MAGIC		0x3258434d	/* "MCX2" */
+#define NVMCTX_MODULES		(LORAMAC_NVMCTXMODULE_CONFIRM_QUEUE + 1)
+#define NVMCTX_SLOTS		2
+#define NVMCTX_JOURNAL_LEN	1024
+#define NVMCTX_REC_MAX		32	/* Max. data bytes per record */
+#define NVMCTX_REC_GAP		(sizeof(struct nvmctx_rec) + 2)
+#define NVMCTX_REC_COMMIT	0x80	/* Module of the commit marker */
+
+/*
+ * The MAC reports context changes piecewise while it processes an
+ * uplink and its receive windows. Wait this long after the first
+ * change so they all end up in a single commit.
+ */
+#define NVMCTX_COMMIT_DELAY	OS_MS_2_TICKS(10 * 1000)
+
+struct nvmctx_hdr {
+  uint32_t	magic;
+  uint32_t	gen;			/* Generation, newest slot wins */
+  uint16_t	layout;			/* CRC of context addresses and sizes */
+  uint16_t	ident;			/* CRC of EUIs and root key */
+  uint16_t	crc[NVMCTX_MODULES];	/* CRC of each context */
+  uint16_t	hcrc;			/* CRC of the fields above */
+};
+
+/* Journal record, followed by len bytes of data and a CRC */
+struct nvmctx_rec {
+  uint8_t	module;
+  uint8_t	len;
+  uint16_t	offset;
+};
+
+struct nvmctx_mod {
+  uint8_t	*mem;		/* Location in memory */
+  uint16_t	 offset;	/* Location in slot and shadow */
+  uint16_t	 len;		/* Length */
+};
+
+PRIVILEGED_DATA static struct nvmctx_mod	mods[NVMCTX_MODULES];
+PRIVILEGED_DATA static struct nvmctx_hdr	hdr;	/* Header of active slot */
+PRIVILEGED_DATA static LoRaMacCtxs_t		*ctxs;
+PRIVILEGED_DATA static uint8_t			*shadow;	/* Stored state */
+PRIVILEGED_DATA static uint16_t			ctx_len;	/* Contexts per slot */
+PRIVILEGED_DATA static uint16_t			jpos;	/* Journal append offset */
+PRIVILEGED_DATA static int8_t			slot;	/* Active slot, -1 if none */
+PRIVILEGED_DATA static OS_TIMER			commit_timer;
+PRIVILEGED_DATA static uint8_t			dirty;
+PRIVILEGED_DATA static bool			disabled;
+
+/* CRC-16/CCITT */
+static uint16_t
+crc16(uint16_t crc, const void *data, size_t len)
+{
+  const uint8_t	*p = data;
+  int		 i;
+
+  while (len--) {
+    crc ^= (uint16_t)*p++ << 8;
+    for (i = 0; i < 8; i++)
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
+
+static uint16_t
+ident_crc(void)
+{
+  uint16_t	crc = 0xffff;
+
+  crc = crc16(crc, param_get_addr(PARAM_DEV_EUI), 8);
+  crc = crc16(crc, param_get_addr(PARAM_APP_EUI), 8);
+  crc = crc16(crc, param_get_addr(PARAM_DEV_KEY), PARAM_MAX_LEN);
+  return crc;
+}
+
+static inline uint32_t
+slot_off(int s)
+{
+  return NVMCTX_OFF + s * (sizeof(struct nvmctx_hdr) + ctx_len);
+}
+
+static inline uint32_t
+journal_off(void)
+{
+  return slot_off(NVMCTX_SLOTS);
+}
+
+/* Fetch context locations from the MAC. Must run after LoRaMacInitialization(). */
+static bool
+load_layout(void)
+{
+  MibRequestConfirm_t	mibReq;
+  nvms_t		nvms;
+  int			i;
+
+  if (ctxs != NULL)
+    return !disabled;
+  slot = -1;
+  mibReq.Type = MIB_NVM_CTXS;
+  if (LoRaMacMibGetRequestConfirm(&mibReq) != LORAMAC_STATUS_OK) {
+    disabled = true;
+    return false;
+  }
+  ctxs = mibReq.Param.Contexts;
+  mods[LORAMAC_NVMCTXMODULE_MAC] = (struct nvmctx_mod) {
+    ctxs->MacNvmCtx, 0, ctxs->MacNvmCtxSize };
+  mods[LORAMAC_NVMCTXMODULE_REGION] = (struct nvmctx_mod) {
+    ctxs->RegionNvmCtx, 0, ctxs->RegionNvmCtxSize };
+  mods[LORAMAC_NVMCTXMODULE_CRYPTO] = (struct nvmctx_mod) {
+    ctxs->CryptoNvmCtx, 0, ctxs->CryptoNvmCtxSize };
+  mods[LORAMAC_NVMCTXMODULE_SECURE_ELEMENT] = (struct nvmctx_mod) {
+    ctxs->SecureElementNvmCtx, 0, ctxs->SecureElementNvmCtxSize };
+  mods[LORAMAC_NVMCTXMODULE_COMMANDS] = (struct nvmctx_mod) {
+    ctxs->CommandsNvmCtx, 0, ctxs->CommandsNvmCtxSize };
+  mods[LORAMAC_NVMCTXMODULE_CLASS_B] = (struct nvmctx_mod) {
+    ctxs->ClassBNvmCtx, 0, ctxs->ClassBNvmCtxSize };
+  mods[LORAMAC_NVMCTXMODULE_CONFIRM_QUEUE] = (struct nvmctx_mod) {
+    ctxs->ConfirmQueueNvmCtx, 0, ctxs->ConfirmQueueNvmCtxSize };
+
+  /*
+   * Some contexts hold pointers into themselves, so a snapshot is
+   * only valid for the image that took it: tie it to the addresses
+   * and sizes of all contexts.
+   */
+  hdr.layout = crc16(0xffff, ctxs, sizeof(*ctxs));
+  ctx_len = 0;
+  for (i = 0; i < NVMCTX_MODULES; i++) {
+    if (mods[i].mem == NULL)
+      mods[i].len = 0;
+    mods[i].offset = ctx_len;
+    ctx_len += mods[i].len;
+  }
+  nvms = ad_nvms_open(NVMS_GENERIC_PART);
+  if (journal_off() + NVMCTX_JOURNAL_LEN > ad_nvms_get_size(nvms)) {
+#ifdef DEBUG
+    printf("nvmctx: %u bytes do not fit\r\n", ctx_len);
+#endif
+    disabled = true;
+    return false;
+  }
+  shadow = OS_MALLOC(ctx_len);
+  OS_ASSERT(shadow);
+  return true;
+}
+
+static bool
+read_hdr(nvms_t nvms, int s, struct nvmctx_hdr *h)
+{
+  ad_nvms_read(nvms, slot_off(s), (uint8_t *)h, sizeof(*h));
+  return h->magic == NVMCTX_MAGIC && h->layout == hdr.layout &&
+      h->ident == ident_crc() &&
+      h->hcrc == crc16(0xffff, h, offsetof(struct nvmctx_hdr, hcrc));
+}
+
+/* Check stored contexts against their CRCs without touching the live ones */
+static bool
+verify(nvms_t nvms, int s, const struct nvmctx_hdr *h)
+{
+  uint8_t	buf[32];
+  uint32_t	base = slot_off(s) + sizeof(*h);
+  uint16_t	off, n, c;
+  int		i;
+
+  for (i = 0; i < NVMCTX_MODULES; i++) {
+    c = 0xffff;
+    for (off = 0; off < mods[i].len; off += n) {
+      n = mods[i].len - off;
+      if (n > sizeof(buf))
+        n = sizeof(buf);
+      ad_nvms_read(nvms, base + mods[i].offset + off, buf, n);
+      c = crc16(c, buf, n);
+    }
+    if (c != h->crc[i])
+      return false;
+  }
+  return true;
+}
+
+static uint16_t
+rec_seed(void)
+{
+  return crc16(0xffff, &hdr.gen, sizeof(hdr.gen));
+}
+
+/* Read the journal record at pos, returns its size or 0 at the end */
+static uint16_t
+read_rec(nvms_t nvms, uint16_t pos, uint8_t *buf)
+{
+  struct nvmctx_rec	*rec = (struct nvmctx_rec *)buf;
+  uint16_t		 n, crc;
+
+  if (pos + sizeof(*rec) + 2 > NVMCTX_JOURNAL_LEN)
+    return 0;
+  ad_nvms_read(nvms, journal_off() + pos, buf, sizeof(*rec));
+  if (rec->module == NVMCTX_REC_COMMIT) {
+    if (rec->len != 0 || rec->offset != 0)
+      return 0;
+  } else if (rec->module >= NVMCTX_MODULES || rec->len == 0 ||
+      rec->len > NVMCTX_REC_MAX ||
+      rec->offset + rec->len > mods[rec->module].len) {
+    return 0;
+  }
+  n = sizeof(*rec) + rec->len + 2;
+  if (pos + n > NVMCTX_JOURNAL_LEN)
+    return 0;
+  ad_nvms_read(nvms, journal_off() + pos + sizeof(*rec),
+      buf + sizeof(*rec), rec->len + 2);
+  crc = crc16(rec_seed(), buf, sizeof(*rec) + rec->len);
+  if (buf[n - 2] != (crc & 0xff) || buf[n - 1] != (crc >> 8))
+    return 0;
+  return n;
+}
+
+/* Apply the committed journal of the active slot to the live contexts and the shadow */
+static void
+replay(nvms_t nvms)
+{
+  uint8_t		 buf[sizeof(struct nvmctx_rec) + NVMCTX_REC_MAX + 2];
+  struct nvmctx_rec	*rec = (struct nvmctx_rec *)buf;
+  uint16_t		 pos, n;
+
+  /* Find the end of the last complete commit */
+  jpos = 0;
+  for (pos = 0; (n = read_rec(nvms, pos, buf)) != 0; pos += n) {
+    if (rec->module == NVMCTX_REC_COMMIT)
+      jpos = pos + n;
+  }
+  for (pos = 0; pos < jpos; pos += n) {
+    n = read_rec(nvms, pos, buf);
+    if (rec->module == NVMCTX_REC_COMMIT)
+      continue;
+    memcpy(mods[rec->module].mem + rec->offset, buf + sizeof(*rec), rec->len);
+    memcpy(shadow + mods[rec->module].offset + rec->offset,
+        buf + sizeof(*rec), rec->len);
+  }
+}
+
+/* Write the whole state to the older slot and restart the journal */
+static void
+compact(nvms_t nvms)
+{
+  struct nvmctx_hdr	h;
+  int			s, i;
+
+  s = slot < 0 ? 0 : (slot + 1) % NVMCTX_SLOTS;
+  h = hdr;
+  h.magic = NVMCTX_MAGIC;
+  h.gen = hdr.gen + 1;
+  h.ident = ident_crc();
+  for (i = 0; i < NVMCTX_MODULES; i++) {
+    h.crc[i] = crc16(0xffff, mods[i].mem, mods[i].len);
+    ad_nvms_write(nvms, slot_off(s) + sizeof(h) + mods[i].offset,
+        mods[i].mem, mods[i].len);
+    memcpy(shadow + mods[i].offset, mods[i].mem, mods[i].len);
+  }
+  h.hcrc = crc16(0xffff, &h, offsetof(struct nvmctx_hdr, hcrc));
+  ad_nvms_write(nvms, slot_off(s), (uint8_t *)&h, sizeof(h));
+  hdr = h;
+  slot = s;
+  jpos = 0;
+#ifdef DEBUG
+  printf("nvmctx: slot %d gen %lu\r\n", s, (unsigned long)h.gen);
+#endif
+}
+
+/* Append a record, keeping room for the commit marker */
+static bool
+append_rec(nvms_t nvms, int i, uint16_t off, uint8_t len)
+{
+  uint8_t		 buf[sizeof(struct nvmctx_rec) + NVMCTX_REC_MAX + 2];
+  struct nvmctx_rec	*rec = (struct nvmctx_rec *)buf;
+  uint16_t		 n = sizeof(*rec) + len + 2, crc;
+
+  if (jpos + n + (i != NVMCTX_REC_COMMIT ? NVMCTX_REC_GAP : 0) >
+      NVMCTX_JOURNAL_LEN)
+    return false;
+  rec->module = i;
+  rec->len = len;
+  rec->offset = off;
+  if (len)
+    memcpy(buf + sizeof(*rec), mods[i].mem + off, len);
+  crc = crc16(rec_seed(), buf, sizeof(*rec) + len);
+  buf[n - 2] = crc & 0xff;
+  buf[n - 1] = crc >> 8;
+  ad_nvms_write(nvms, journal_off() + jpos, buf, n);
+  jpos += n;
+  return true;
+}
+
+/* Journal the bytes of a context that differ from the stored state */
+static bool
+append(nvms_t nvms, int i)
+{
+  const uint8_t	*cur = mods[i].mem, *old = shadow + mods[i].offset;
+  uint16_t	 a, b, last;
+
+  for (a = 0; a < mods[i].len; a = last + 1) {
+    if (cur[a] == old[a]) {
+      last = a;
+      continue;
+    }
+    /* Merge runs whose gap is cheaper than a new record */
+    for (b = last = a; b < mods[i].len && b - a < NVMCTX_REC_MAX; b++) {
+      if (cur[b] != old[b])
+        last = b;
+      else if ((uint16_t)(b - last) >= NVMCTX_REC_GAP)
+        break;
+    }
+    if (!append_rec(nvms, i, a, last + 1 - a))
+      return false;
+  }
+  return true;
+}
+
+/* Take a committed context over into the shadow */
+static void
+apply(int i)
+{
+  memcpy(shadow + mods[i].offset, mods[i].mem, mods[i].len);
+}
+
+static void
+commit_cb(OS_TIMER timer)
+{
+  (void)timer;
+  lora_task_notify_event(EVENT_NOTIF_NVMCTX, NULL);
+}
+
+void
+nvmctx_init(void)
+{
+  if (commit_timer == NULL) {
+    commit_timer = OS_TIMER_CREATE("nvmctx", NVMCTX_COMMIT_DELAY,
+      OS_TIMER_FAIL, (void *) OS_GET_CURRENT_TASK(), commit_cb);
+    OS_ASSERT(commit_timer);
+  }
+}
+
+/*
+ * Restore all contexts from permanent storage. Called between
+ * LoRaMacInitialization() and LoRaMacStart(). On failure the MAC is
+ * left with its defaults and the device joins as usual.
+ */
+bool
+nvmctx_restore(void)
+{
+  MibRequestConfirm_t	mibReq;
+  struct nvmctx_hdr	h[NVMCTX_SLOTS];
+  bool			valid[NVMCTX_SLOTS];
+  nvms_t		nvms;
+  int			s, i;
+
+  if (!load_layout())
+    return false;
+  nvms = ad_nvms_open(NVMS_GENERIC_PART);
+  for (s = 0; s < NVMCTX_SLOTS; s++)
+    valid[s] = read_hdr(nvms, s, h + s);
+  /* Newest slot first, fall back to the other one if it was torn */
+  s = valid[1] && (!valid[0] || (int32_t)(h[1].gen - h[0].gen) > 0);
+  for (i = 0; i < NVMCTX_SLOTS; i++, s = (s + 1) % NVMCTX_SLOTS) {
+    if (valid[s] && verify(nvms, s, h + s))
+      break;
+  }
+  if (i == NVMCTX_SLOTS)
+    goto invalid;
+  hdr = h[s];
+  slot = s;
+  for (i = 0; i < NVMCTX_MODULES; i++) {
+    ad_nvms_read(nvms, slot_off(s) + sizeof(hdr) + mods[i].offset,
+        mods[i].mem, mods[i].len);
+    memcpy(shadow + mods[i].offset, mods[i].mem, mods[i].len);
+  }
+  replay(nvms);
+  mibReq.Type = MIB_NVM_CTXS;
+  mibReq.Param.Contexts = ctxs;
+  if (LoRaMacMibSetRequestConfirm(&mibReq) != LORAMAC_STATUS_OK)
+    goto invalid;
+  dirty = 0;
+#ifdef DEBUG
+  printf("nvmctx: restored slot %d gen %lu, %u journal bytes\r\n", s,
+      (unsigned long)hdr.gen, jpos);
+#endif
+  return true;
+
+invalid:
+  /* Write a new slot on the next commit */
+  slot = -1;
+#ifdef DEBUG
+  printf("nvmctx: no valid context\r\n");
+#endif
+  return false;
+}
+
+/* LoRaMacCallback_t.NvmContextChange */
+void
+nvmctx_changed(LoRaMacNvmCtxModule_t module)
+{
+  if (module >= NVMCTX_MODULES)
+    return;
+  dirty |= 1 << module;
+  if (commit_timer != NULL && !OS_TIMER_IS_ACTIVE(commit_timer))
+    OS_TIMER_START(commit_timer, OS_TIMER_FOREVER);
+}
+
+/*
+ * The uplink and its receive windows are over. Frame counters are
+ * committed now rather than between TX and RX1: a compaction erases
+ * flash the CPU runs from and would delay the receive windows.
+ */
+void
+nvmctx_txdone(void)
+{
+  if (dirty & (1 << LORAMAC_NVMCTXMODULE_CRYPTO))
+    lora_task_notify_event(EVENT_NOTIF_NVMCTX, NULL);
+}
+
+/* Journal the changes of all contexts reported since the last commit */
+void
+nvmctx_commit(void)
+{
+  nvms_t	nvms;
+  int		i;
+
+  if (dirty == 0 || !load_layout())
+    return;
+  nvms = ad_nvms_open(NVMS_GENERIC_PART);
+  if (slot < 0 || hdr.ident != ident_crc())
+    goto compact;
+  for (i = 0; i < NVMCTX_MODULES; i++) {
+    if ((dirty & (1 << i)) && !append(nvms, i))
+      goto compact;
+  }
+  append_rec(nvms, NVMCTX_REC_COMMIT, 0, 0);
+  for (i = 0; i < NVMCTX_MODULES; i++) {
+    if (dirty & (1 << i))
+      apply(i);
+  }
+  dirty = 0;
+  return;
+
+compact:
+  compact(nvms);
+  dirty = 0;
+}
+
+/* Commit pending changes right away, e.g. before a reboot */
+void
+nvmctx_flush(void)
+{
+  if (commit_timer != NULL)
+    OS_TIMER_STOP(commit_timer, OS_TIMER_FOREVER);
+  nvmctx_commit();
+}
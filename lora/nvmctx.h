@@ -0,0 +1,15 @@
+#ifndef __NVMCTX_H__
+#define __NVMCTX_H__
+
+#include <stdbool.h>
+
+#include "lora/mac/LoRaMac.h"
+
+void	nvmctx_init(void);
+bool	nvmctx_restore(void);
+void	nvmctx_changed(LoRaMacNvmCtxModule_t module);
+void	nvmctx_commit(void);
+void	nvmctx_flush(void);
+void	nvmctx_txdone(void);
+
+#endif /* __NVMCTX_H__ */
@@ -6,6 +6,7 @@
 #include <ad_nvparam.h>
 #include <platform_nvparam.h>
 
+#include "lora/lora.h"
 #include "lora/param.h"
 #include "lora/util.h"
 
@@ -29,6 +30,11 @@ INITIALISED_PRIVILEGED_DATA static uint8_t	devkey[16] = {
   0x09, 0xed, 0xb2, 0x18, 0x5e, 0xfa, 0x4a, 0x34,
 };
 PRIVILEGED_DATA static uint8_t			suota, sensor_period, min_sf;
+PRIVILEGED_DATA static uint8_t			batch_window, frag_parity;
+/* Minimum satellites, maximum HDOP (1/10) and time budget (s) of a fix */
+PRIVILEGED_DATA static uint8_t			gps_quality[3];
+/* Motion threshold (m) and periods between acquisitions when still */
+PRIVILEGED_DATA static uint8_t			gps_motion[2];
 
 /* NVPARAM "ble_platform" */
 #define PARAM_DEV_EUI_OFF	TAG_BLE_PLATFORM_BD_ADDRESS
@@ -51,6 +57,21 @@ PRIVILEGED_DATA static uint8_t			suota, sensor_period, min_sf;
          PARAM_SENSOR_PERIOD_LEN)
 #define PARAM_MIN_SF_LEN	sizeof(min_sf)
 
+#define PARAM_BATCH_WINDOW_OFF	(PARAM_MIN_SF_OFF + PARAM_MIN_SF_LEN)
+#define PARAM_BATCH_WINDOW_LEN	sizeof(batch_window)
+
+#define PARAM_FRAG_PARITY_OFF	(PARAM_BATCH_WINDOW_OFF + \
+         PARAM_BATCH_WINDOW_LEN)
+#define PARAM_FRAG_PARITY_LEN	sizeof(frag_parity)
+
+#define PARAM_GPS_QUALITY_OFF	(PARAM_FRAG_PARITY_OFF + \
+         PARAM_FRAG_PARITY_LEN)
+#define PARAM_GPS_QUALITY_LEN	sizeof(gps_quality)
+
+#define PARAM_GPS_MOTION_OFF	(PARAM_GPS_QUALITY_OFF + \
+         PARAM_GPS_QUALITY_LEN)
+#define PARAM_GPS_MOTION_LEN	sizeof(gps_motion)
+
 #define PARAM_FLAG_BLE_NV	0x01	/* Stored in BLE NVPARAM area */
 #define PARAM_FLAG_REVERSE	0x02	/* Reversed in protocol */
 #define PARAM_FLAG_WRITE_ONLY	0x04	/* "Get param" disallowed */
@@ -95,8 +116,42 @@ static const struct param_def	params[] = {
     .offset	= PARAM_SUOTA_OFF,
     .len	= PARAM_SUOTA_LEN,
   },
+  [PARAM_BATCH_WINDOW] = {
+    .mem	= &batch_window,
+    .offset	= PARAM_BATCH_WINDOW_OFF,
+    .len	= PARAM_BATCH_WINDOW_LEN,
+  },
+  [PARAM_FRAG_PARITY] = {
+    .mem	= &frag_parity,
+    .offset	= PARAM_FRAG_PARITY_OFF,
+    .len	= PARAM_FRAG_PARITY_LEN,
+  },
+  [PARAM_GPS_QUALITY] = {
+    .mem	= gps_quality,
+    .offset	= PARAM_GPS_QUALITY_OFF,
+    .len	= PARAM_GPS_QUALITY_LEN,
+  },
+  [PARAM_GPS_MOTION] = {
+    .mem	= gps_motion,
+    .offset	= PARAM_GPS_MOTION_OFF,
+    .len	= PARAM_GPS_MOTION_LEN,
+  },
 };
 
+/*
+ * Sets are staged: a parameter changes in memory at once and is marked
+ * dirty, then param_commit() writes all the dirty ones from the LoRa
+ * task, those in the VES in a single write of the span they cover. The
+ * sets of a downlink so make one flash write, after the MAC is done
+ * with the receive. A transaction lasts from the first staged set to
+ * the end of its commit.
+ */
+#define PARAM_VES_SPAN	64	/* longest VES write */
+
+PRIVILEGED_DATA static uint32_t			dirty;
+PRIVILEGED_DATA static TickType_t		staged_since;
+PRIVILEGED_DATA static struct param_stats	stats;
+
 static inline void
 reverse_memcpy(void *dest, void *src, size_t len)
 {
@@ -151,35 +206,77 @@ read_param(const struct param_def *param)
   }
 }
 
-/* Set param in memory and write it to permanent storage */
-static void
-write_param(const struct param_def *param, void *data)
+/* Set param in memory, returns whether it changed */
+static bool
+update_param(const struct param_def *param, void *data)
 {
-  uint8_t		buf[PARAM_MAX_LEN + 1];
+  uint8_t		buf[PARAM_MAX_LEN];
 
   OS_ASSERT(param->len <= sizeof(buf));
   if (param->flags & PARAM_FLAG_REVERSE)
     reverse_memcpy(buf, data, param->len);
   else
     memcpy(buf, data, param->len);
+  if (memcmp(param->mem, buf, param->len) == 0)
+    return false;
   memcpy(param->mem, buf, param->len);
-  if (param->flags & PARAM_FLAG_BLE_NV) {
-    nvparam_t	nvparam;
-    uint16_t	param_len;
+  return true;
+}
 
-    nvparam = ad_nvparam_open("ble_platform");
-    param_len = ad_nvparam_get_length(nvparam, param->offset, NULL);
-    OS_ASSERT(param_len == param->len + 1);
-    OS_ASSERT(param_len <= sizeof(buf));
-    (void)param_len;
-    buf[param->len] = 0x00;
-    ad_nvparam_write(nvparam, param->offset, param->len + 1, buf);
-  } else {
-    nvms_t		nvms;
+/* Write a param in the BLE NV parameters from memory */
+static void
+write_param_nv(const struct param_def *param)
+{
+  uint8_t		buf[PARAM_MAX_LEN + 1];
+  nvparam_t	nvparam;
+  uint16_t	param_len;
 
-    nvms = ad_nvms_open(NVMS_GENERIC_PART);
-    ad_nvms_write(nvms, param->offset, buf, param->len);
+  nvparam = ad_nvparam_open("ble_platform");
+  param_len = ad_nvparam_get_length(nvparam, param->offset, NULL);
+  OS_ASSERT(param_len == param->len + 1);
+  OS_ASSERT(param_len <= sizeof(buf));
+  (void)param_len;
+  memcpy(buf, param->mem, param->len);
+  buf[param->len] = 0x00;
+  ad_nvparam_write(nvparam, param->offset, param->len + 1, buf);
+}
+
+/*
+ * Write the params of mask from memory to permanent storage. The VES
+ * ones go in one write, the stored bytes between them read back first.
+ */
+static int
+write_params(uint32_t mask)
+{
+  uint8_t	buf[PARAM_VES_SPAN];
+  nvms_t	nvms;
+  uint32_t	lo = UINT32_MAX, hi = 0;
+  int		i, writes = 0;
+
+  for (i = 0; i < (int)ARRAY_SIZE(params); i++) {
+    if (!(mask & 1 << i))
+      continue;
+    if (params[i].flags & PARAM_FLAG_BLE_NV) {
+      write_param_nv(params + i);
+      writes++;
+      continue;
+    }
+    if (params[i].offset < lo)
+      lo = params[i].offset;
+    if (params[i].offset + params[i].len > hi)
+      hi = params[i].offset + params[i].len;
+  }
+  if (hi == 0)
+    return writes;
+  OS_ASSERT(hi - lo <= sizeof(buf));
+  nvms = ad_nvms_open(NVMS_GENERIC_PART);
+  ad_nvms_read(nvms, lo, buf, hi - lo);
+  for (i = 0; i < (int)ARRAY_SIZE(params); i++) {
+    if ((mask & 1 << i) && !(params[i].flags & PARAM_FLAG_BLE_NV))
+      memcpy(buf + params[i].offset - lo, params[i].mem, params[i].len);
   }
+  ad_nvms_write(nvms, lo, buf, hi - lo);
+  return writes + 1;
 }
 
 int
@@ -196,12 +293,70 @@ param_get(int idx, uint8_t *data, uint8_t len)
   return params[idx].len;
 }
 
+/* Whether param_stage() takes the set */
 int
-param_set(int idx, uint8_t *data, uint8_t len)
+param_check(int idx, uint8_t len)
 {
   if (idx >= (int)ARRAY_SIZE(params) || params[idx].len != len)
     return -1;
-  write_param(params + idx, data);
+  return 0;
+}
+
+/* Set param in memory, it is written to permanent storage by the commit */
+int
+param_stage(int idx, uint8_t *data, uint8_t len)
+{
+  if (param_check(idx, len) == -1)
+    return -1;
+  if (!update_param(params + idx, data))
+    return 0;
+  if (dirty == 0)
+    staged_since = OS_GET_TICK_COUNT();
+  dirty |= 1 << idx;
+  lora_task_notify_event(EVENT_NOTIF_PARAM, NULL);
+  return 0;
+}
+
+/* Write the staged params */
+void
+param_commit(void)
+{
+  TickType_t	start = OS_GET_TICK_COUNT();
+  uint32_t	mask = dirty, ms;
+  int		i;
+
+  if (mask == 0)
+    return;
+  dirty = 0;
+  stats.flash_writes += write_params(mask);
+  stats.transactions++;
+  for (i = 0; i < (int)ARRAY_SIZE(params); i++)
+    stats.params += (mask >> i) & 1;
+  stats.write = OS_TICKS_2_MS(OS_GET_TICK_COUNT() - start);
+  ms = OS_TICKS_2_MS(OS_GET_TICK_COUNT() - staged_since);
+  stats.latency = ms;
+  if (ms > stats.latency_max)
+    stats.latency_max = ms;
+  stats.latency_sum += ms;
+#ifdef DEBUG
+  printf("param commit %04lx: write %lu ms, %lu ms after the set\r\n",
+      mask, stats.write, ms);
+#endif
+}
+
+const struct param_stats *
+param_stats(void)
+{
+  return &stats;
+}
+
+/* Set param in memory and write it to permanent storage */
+int
+param_set(int idx, uint8_t *data, uint8_t len)
+{
+  if (param_stage(idx, data, len) == -1)
+    return -1;
+  param_commit();
   return 0;
 }
 
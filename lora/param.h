@@ -7,12 +7,31 @@
 #define PARAM_SENSOR_PERIOD 3
 #define PARAM_MIN_SF        4
 #define PARAM_SUOTA         5
+#define PARAM_BATCH_WINDOW  6
+#define PARAM_FRAG_PARITY   7
+#define PARAM_GPS_QUALITY   8
+#define PARAM_GPS_MOTION    9
 
 #define PARAM_MAX_LEN	16	/* sizeof(devkey) */
 
+/* Commits of staged sets since boot, times in ms */
+struct param_stats {
+  uint32_t	transactions;
+  uint32_t	params;		/* written */
+  uint32_t	flash_writes;
+  uint32_t	write;		/* of the last commit */
+  uint32_t	latency;	/* from the first set to the end of its commit */
+  uint32_t	latency_max;
+  uint32_t	latency_sum;
+};
+
 void	param_init(void);
 int	param_get(int idx, uint8_t *data, uint8_t len);
 int	param_set(int idx, uint8_t *data, uint8_t len);
+int	param_check(int idx, uint8_t len);
+int	param_stage(int idx, uint8_t *data, uint8_t len);
+void	param_commit(void);
+const struct param_stats *param_stats(void);
 uint8_t* param_get_addr(int idx);
 
 #endif /* __PARAM_H__ */
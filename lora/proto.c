@@ -1,11 +1,14 @@
 /* LoRa MatchX protocol */
 
+#include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdint.h>
 
 #include "osal.h"
 
+#include "lora/batch.h"
+#include "lora/frag.h"
 #include "lora/lora.h"
 #include "lora/param.h"
 #include "lora/proto.h"
@@ -24,86 +27,196 @@
 
 #define LONG_LEN_MASK	0x3f
 
-#define MAX_LEN_PAYLOAD 64
-
 typedef enum {
 	INFO_PARAM		= 0x00,
 	INFO_SENSOR_DATA	= 0x10,
 	INFO_BATTERY		= 0x20,
+	INFO_SENSOR_BATCH	= 0x30,
 } uplink_info;
 
 #define STATUS_TX_PENDING	0x01
+#define STATUS_BATCH		0x08	/* batched sensor data requested */
+#define STATUS_FLUSH		0x10	/* an uplink requested, even empty */
 PRIVILEGED_DATA static uint8_t	status;
 
-#define MAX_PAYLOAD_LEN		51
-#define MAX_SENSOR_DATA_LEN	32
-#define MAX_BATTERY_DATA_LEN	2
-
-PRIVILEGED_DATA static uint8_t	pend_tx_data[MAX_PAYLOAD_LEN];
-PRIVILEGED_DATA static uint8_t	sensor_data[MAX_SENSOR_DATA_LEN];
-PRIVILEGED_DATA static uint8_t	battery_data[MAX_BATTERY_DATA_LEN];
-PRIVILEGED_DATA static uint8_t	pend_tx_len, sensor_len, battery_len;
-
 #define LEN_LEN(len)	(1 + ((len) >= LEN_MASK))
 
+/*
+ * With a batch window of more than one sensor period the samples of
+ * each period are kept, then sent as delta encoded runs every window,
+ * each in an INFO_SENSOR_BATCH section. The samples that do not fit in
+ * the uplink are sent with the next one.
+ */
+PRIVILEGED_DATA static struct batch	batch;
+PRIVILEGED_DATA static uint8_t		batch_periods;
+
+/*
+ * The uplink is built in the frame buffer of the MAC. The sections wait
+ * in the uplink queue of lora.c by class, the replies to the server
+ * first, then the battery level and the sensor data of each period.
+ */
+PRIVILEGED_DATA static uint8_t	battery_level;
+
+/*
+ * An uplink longer than the room at the data rate is split in fragments
+ * sent on FRAG_PORT, one per uplink, with the parity fragments of the
+ * frag parity parameter. Until its last fragment is out the uplinks
+ * carry its fragments only, the new sections wait.
+ */
+PRIVILEGED_DATA static struct frag	frag;
+
+/* Adds the header of the len bytes already written after one header byte */
 static void
-tx_enqueue(uint8_t *dest, uint8_t *dlen, uint8_t maxlen,
-    uint8_t cmd, int len, void *data)
+tx_commit(uint8_t *dest, uint8_t *dlen, uint8_t maxlen, uint8_t cmd, int len)
 {
-	if (*dlen + LEN_LEN(len) + len > maxlen)
+	if (len == 0 || *dlen + LEN_LEN(len) + len > maxlen)
 		return;
 	if (len < LEN_MASK)
 		dest[(*dlen)++] = cmd | len;
 	else {
+		memmove(dest + *dlen + 2, dest + *dlen + 1, len);
 		dest[(*dlen)++] = cmd | LEN_MASK;
 		dest[(*dlen)++] = len & LONG_LEN_MASK;
 	}
-	memcpy(dest + *dlen, data, len);
 	*dlen += len;
 }
 
-#define ADD_TX(x)	do {						\
-	if (total_len + x ## _len <= (int)ARRAY_SIZE(pend_tx_data)) {	\
-		memcpy(pend_tx_data + total_len, x ## _data, x ## _len);\
-		total_len += x ## _len;					\
-	}								\
-} while (0)
+static void
+tx_enqueue(uint8_t *dest, uint8_t *dlen, uint8_t maxlen,
+    uint8_t cmd, int len, void *data)
+{
+	if (*dlen + LEN_LEN(len) + len > maxlen)
+		return;
+	memcpy(dest + *dlen + 1, data, len);
+	tx_commit(dest, dlen, maxlen, cmd, len);
+}
+
+/* Queues a section in a frame of its own */
+static void
+tx_queue(uint8_t cls, uint8_t cmd, int len, void *data)
+{
+	uint8_t	frame[LORA_TXQ_FRAME_MAX];
+	uint8_t	flen = 0;
+
+	tx_enqueue(frame, &flen, sizeof(frame), cmd, len, data);
+	if (flen != 0)
+		lora_enqueue(cls, PORT, frame, flen);
+}
+
+/* Largest section data that fits after dlen with its header */
+static uint8_t
+tx_room(uint8_t dlen, uint8_t maxlen)
+{
+	int	room = maxlen - dlen - 1;
+
+	if (room < LEN_MASK)
+		return room < 0 ? 0 : room;
+	if (room == LEN_MASK)
+		return LEN_MASK - 1;
+	return room - 1 < LONG_LEN_MASK ? room - 1 : LONG_LEN_MASK;
+}
+
+static uint32_t
+uptime(void)
+{
+	return OS_GET_TICK_COUNT() / OS_MS_2_TICKS(1000);
+}
+
+static uint8_t
+frag_parity(void)
+{
+	uint8_t	parity = 0;
+
+	param_get(PARAM_FRAG_PARITY, &parity, sizeof(parity));
+	return parity;
+}
+
+static void
+send_fragment(uint8_t *buf, uint8_t room)
+{
+	uint8_t	len;
+
+	/* Split again when the data rate or MAC commands left less room */
+	if ((len = frag_encode(&frag, buf, room)) == 0 &&
+	    frag_split(&frag, room) == 0)
+		len = frag_encode(&frag, buf, room);
+	/* Dropped if it cannot be split, the empty uplink flushes the MAC */
+	if (len == 0)
+		frag_abort(&frag);
+#ifdef DEBUG
+	else
+		printf("tx fragment %d of %d\r\n", frag.next + 1,
+		    frag.count + frag.parity);
+#endif
+	if (lora_send(FRAG_PORT, buf, len) == 0) {
+		frag_commit(&frag);
+		status &= ~STATUS_FLUSH;
+	}
+	status |= STATUS_TX_PENDING;
+}
 
 static void
 set_tx_data(void)
 {
-	int	total_len = pend_tx_len;
+	uint8_t	*buf;
+	size_t	 size, room;
+	uint8_t	 maxlen, len = 0;
+	int	 i, slen;
 
-	ADD_TX(battery);
-	ADD_TX(sensor);
+	if ((buf = lora_tx_buffer(&size, &room)) == NULL)
+		return;
+	if (frag_pending(&frag)) {
+		send_fragment(buf, room);
+		return;
+	}
+	/* The queued frames that fit, by class, then the batches */
+	maxlen = size;
+	len = lora_txq_fill(PORT, buf, room);
+	/* Batches fill the room, the samples left go with the next one */
+	while (status & STATUS_BATCH) {
+		slen = batch_encode(&batch, uptime(), buf + len + 1,
+		    tx_room(len, room));
+		if (slen == 0)
+			break;
+		tx_commit(buf, &len, maxlen, INFO_SENSOR_BATCH, slen);
+	}
 #ifdef DEBUG
 	printf("set tx data:");
-	for (int i = 0; i < total_len; i++)
-		printf(" %02x", pend_tx_data[i]);
+	for (i = 0; i < len; i++)
+		printf(" %02x", buf[i]);
 	printf("\r\n");
 #endif
-	if (total_len) {
-	  lora_send(pend_tx_data, total_len);
-		status |= STATUS_TX_PENDING;
+	/* Queued frames too long for the room take the whole frame buffer */
+	if (len == 0 && lora_txq_pending())
+		len = lora_txq_fill(PORT, buf, maxlen);
+	if (len > room) {
+		if (frag_start(&frag, buf, len, room, frag_parity()) == 0) {
+			lora_txq_commit();
+			send_fragment(buf, room);
+		} else {
+			/* Too little room to split, flush the MAC commands */
+			lora_send(PORT, buf, 0);
+			status |= STATUS_TX_PENDING;
+		}
+		return;
 	}
+	/*
+	 * An empty uplink flushes the MAC commands that leave no room, or
+	 * lets the server send its pending downlinks
+	 */
+	if (len || room == 0 || (status & STATUS_FLUSH)) {
+		if (lora_send(PORT, buf, len) == 0) {
+			status &= ~STATUS_FLUSH;
+			batch_commit(&batch);
+			if (batch.count == 0)
+				batch_periods = 0;
+		} else
+			batch_rewind(&batch);
+		status |= STATUS_TX_PENDING;
+	} else
+		batch_rewind(&batch);
 }
 
-#define TX_CLEAR(x)	do {						\
-	x ## _len = 0;							\
-} while (0)
-
-#define TX_ADD(x, cmd, len, data)					\
-	tx_enqueue(x ## _data, &x ## _len, ARRAY_SIZE(x ## _data),	\
-	    cmd, len, data)
-
-#define TX_SET(x, cmd, len, data)	do {				\
-	TX_CLEAR(x);							\
-	TX_ADD(x, cmd, len, data);					\
-} while (0)
-
-#define TX_ENQUEUE(cmd, len, data)	TX_SET(pend_tx, cmd, len, data)
-
-
 static void
 handle_params(uint8_t *data, uint8_t len)
 {
@@ -118,11 +231,11 @@ handle_params(uint8_t *data, uint8_t len)
 		/* get */
 		if ((plen = param_get(idx, buf + 1, sizeof(buf) - 1)) != 0) {
 			buf[0] = idx;
-			TX_ENQUEUE(INFO_PARAM, plen + 1, buf);
+			tx_queue(LORA_TX_CONTROL, INFO_PARAM, plen + 1, buf);
 		}
 	} else {
-		/* set */
-		param_set(idx, data, len);
+		/* set, written once the downlink is handled */
+		param_stage(idx, data, len);
 	}
 }
 
@@ -151,6 +264,52 @@ static void	(* const downlink_handlers[])(uint8_t *, uint8_t) = {
 	[CMD_REBOOT_UPGRADE]	= handle_reboot_upgrade,
 };
 
+/*
+ * Splits the next command off the downlink in data, its arguments
+ * after. Returns -1 when the downlink ends in the middle of it.
+ */
+static int
+next_cmd(uint8_t **data, uint8_t *len, uint8_t *cmd, uint8_t *plen)
+{
+	if (*len == 0)
+		return -1;
+	*cmd = *(*data)++;
+	(*len)--;
+	*plen = *cmd & LEN_MASK;
+	if (*plen == 0x0f) {
+		if (*len == 0)
+			return -1;
+		*plen = *(*data)++ & LONG_LEN_MASK;
+		(*len)--;
+	}
+	if (*plen > *len)
+		return -1;
+	*cmd >>= CMD_SHIFT;
+	return 0;
+}
+
+/*
+ * A downlink is checked whole before any of its commands runs, so a
+ * truncated one or one with an invalid param set changes nothing. Its
+ * sets are staged, then written together by the LoRa task.
+ */
+static bool
+check_downlink(uint8_t *data, uint8_t len)
+{
+	uint8_t	cmd, plen;
+
+	while (len > 0) {
+		if (next_cmd(&data, &len, &cmd, &plen) == -1)
+			return false;
+		if (cmd == CMD_GET_SET_PARAMS && plen > 1 &&
+		    param_check(data[0], plen - 1) == -1)
+			return false;
+		data += plen;
+		len -= plen;
+	}
+	return true;
+}
+
 void
 proto_handle(uint8_t port, uint8_t *data, uint8_t len)
 {
@@ -164,19 +323,13 @@ proto_handle(uint8_t port, uint8_t *data, uint8_t len)
 #endif
 	if (port != PORT)
 		return;
-	while (len > 0) {
-		cmd = *data++;
-		len--;
-		plen = cmd & LEN_MASK;
-		if (plen == 0x0f) {
-			if (!len)
-				break;
-			plen = *data++ & LONG_LEN_MASK;
-			len--;
-		}
-		if (plen > len)
-			break;
-		cmd >>= CMD_SHIFT;
+	if (!check_downlink(data, len)) {
+#ifdef DEBUG
+		printf("rx: invalid downlink\r\n");
+#endif
+		len = 0;
+	}
+	while (next_cmd(&data, &len, &cmd, &plen) == 0) {
 		if (cmd < ARRAY_SIZE(downlink_handlers) &&
 		    downlink_handlers[cmd]) {
 			(*downlink_handlers[cmd])(data, plen);
@@ -187,35 +340,101 @@ proto_handle(uint8_t port, uint8_t *data, uint8_t len)
 	set_tx_data();
 }
 
+static uint8_t
+batch_window(void)
+{
+	uint8_t	periods = 0;
+
+	param_get(PARAM_BATCH_WINDOW, &periods, sizeof(periods));
+	return periods;
+}
+
+/* Keeps the samples of this period, returns whether the window is over */
+static bool
+batch_sample(void)
+{
+	uint8_t	data[BATCH_SAMPLE_LEN];
+	int	i, len;
+
+	for (i = 0; i < SENSOR_MAX; i++) {
+		len = sensor_get_data(i, (char *)data, sizeof(data));
+		batch_add(&batch, uptime(), sensor_get_fields(i), data, len);
+	}
+	if (batch_periods < UINT8_MAX)
+		batch_periods++;
+	return batch_periods >= batch_window() ||
+	    batch.count > BATCH_SAMPLES - SENSOR_MAX;
+}
+
+/* Queues the sensor data of this period, a frame per sensor */
+static void
+sensor_queue(void)
+{
+	uint8_t	frame[LORA_TXQ_FRAME_MAX];
+	uint8_t	flen;
+	int	i, slen;
+
+	for (i = 0; i < SENSOR_MAX; i++) {
+		flen = 0;
+		slen = sensor_get_data(i, (char *)frame + 1,
+		    sizeof(frame) - LEN_LEN(sizeof(frame)));
+		tx_commit(frame, &flen, sizeof(frame), INFO_SENSOR_DATA, slen);
+		if (flen != 0)
+			lora_enqueue(LORA_TX_DATA, PORT, frame, flen);
+	}
+}
+
 void
 proto_send_data(void)
 {
-	PRIVILEGED_DATA static uint8_t	last_bat_level;
-	int	i;
-	char buf[MAX_LEN_PAYLOAD];
-	size_t len;
 	uint8_t cur_bat_level;
 
+	/* A battery change goes out before the batch window is over */
 	cur_bat_level = bat_level();
-	if (cur_bat_level != last_bat_level) {
-		last_bat_level = cur_bat_level;
-		TX_SET(battery, INFO_BATTERY, 1, &cur_bat_level);
-	}
-	TX_CLEAR(sensor);
-	for (i = 0; i < SENSOR_MAX; i++) {
-		len = sensor_get_data(i, buf, sizeof(buf));
-		if (len != 0)
-			TX_ADD(sensor, INFO_SENSOR_DATA, len, buf);
+	if (cur_bat_level != battery_level) {
+		battery_level = cur_bat_level;
+		tx_queue(LORA_TX_ALARM, INFO_BATTERY, 1, &battery_level);
 	}
+	if (batch_window() > 1 || batch.count != 0) {
+		if (!batch_sample()) {
+			proto_send_next();
+			return;
+		}
+		status |= STATUS_BATCH;
+	} else
+		sensor_queue();
 	set_tx_data();
 }
 
+/* Whether fragments of an uplink, queued frames or a flush are left to send */
+bool
+proto_tx_more(void)
+{
+	return frag_pending(&frag) || lora_txq_pending() ||
+	    (status & STATUS_FLUSH);
+}
+
+void
+proto_send_next(void)
+{
+	if (proto_tx_more())
+		set_tx_data();
+}
+
+/*
+ * An uplink without sensor data, the sensors may be off: the queued
+ * frames, or an empty one.
+ */
+void
+proto_send_flush(void)
+{
+	status |= STATUS_FLUSH;
+	proto_send_next();
+}
+
 void
 proto_txstart(void)
 {
-	status &= ~STATUS_TX_PENDING;
-	TX_CLEAR(pend_tx);
-	TX_CLEAR(sensor);
-	TX_CLEAR(battery);
+	status &= ~(STATUS_TX_PENDING | STATUS_BATCH);
 	sensor_txstart();
 }
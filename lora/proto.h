@@ -4,5 +4,8 @@
 void	proto_handle(uint8_t port, uint8_t *data, uint8_t len);
 void	proto_send_data(void);
 void	proto_txstart(void);
+bool	proto_tx_more(void);
+void	proto_send_next(void);
+void	proto_send_flush(void);
 
 #endif /* __PROTO_H__ */
@@ -0,0 +1,672 @@
+/*!
+ * \file      radio-host.c
+ *
+ * \brief     Simulated radio driver of the host (POSIX) board
+ */
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utilities.h"
+#include "radio.h"
+#include "timer.h"
+#include "host-board.h"
+#include "radio-host.h"
+
+/*!
+ * Maximum number of frames on the air at once
+ */
+#define HOST_RADIO_AIR_SIZE                         8
+
+/*!
+ * Preamble symbols the LoRa demodulator needs to detect a frame
+ */
+#define HOST_RADIO_DETECT_SYMBOLS                   4
+
+/*!
+ * Radio wake up time from sleep in ms
+ */
+#define HOST_RADIO_WAKEUP_TIME                      1
+
+/*!
+ * Supply current in RX, in uA
+ */
+#define HOST_RADIO_RX_CURRENT                       11500
+
+/*!
+ * Modulation parameters shared by the TX and RX configurations
+ */
+typedef struct sHostRadioConfig
+{
+    RadioModems_t Modem;
+    uint32_t Bandwidth;
+    uint32_t Datarate;
+    uint8_t Coderate;
+    uint16_t PreambleLen;
+    bool FixLen;
+    bool CrcOn;
+    bool IqInverted;
+}HostRadioConfig_t;
+
+/*!
+ * Radio state
+ */
+typedef struct sHostRadio
+{
+    RadioEvents_t* Events;
+    RadioState_t State;
+    RadioModems_t Modem;
+    uint32_t Frequency;
+    HostRadioConfig_t TxConfig;
+    int8_t TxPower;
+    uint32_t TxTimeout;
+    HostRadioConfig_t RxConfig;
+    uint16_t RxSymbTimeout;
+    bool RxContinuous;
+    uint32_t RxTimeout;
+    /*!
+     * Start of the current TX or RX
+     */
+    uint64_t StateTime;
+    /*!
+     * Frame being transmitted
+     */
+    HostRadioFrame_t TxFrame;
+    /*!
+     * Frame being received, NULL while searching for a preamble
+     */
+    HostRadioFrame_t* RxFrame;
+    uint8_t RxBuffer[255];
+    /*!
+     * Pending interrupt
+     */
+    HostEvent_t Irq;
+    HostRadioFaults_t Faults;
+    HostRadioStats_t Stats;
+    void ( *TxHandler )( const HostRadioFrame_t* frame );
+}HostRadio_t;
+
+static HostRadio_t HostRadio;
+
+/*!
+ * Frames on the air
+ */
+static HostRadioFrame_t HostRadioAir[HOST_RADIO_AIR_SIZE];
+static bool HostRadioAirUsed[HOST_RADIO_AIR_SIZE];
+
+/*
+ * Radio driver functions prototypes
+ */
+static void HostRadioInit( RadioEvents_t *events );
+static RadioState_t HostRadioGetStatus( void );
+static void HostRadioSetModem( RadioModems_t modem );
+static void HostRadioSetChannel( uint32_t freq );
+static bool HostRadioIsChannelFree( RadioModems_t modem, uint32_t freq, int16_t rssiThresh, uint32_t maxCarrierSenseTime );
+static uint32_t HostRadioRandom( void );
+static void HostRadioSetRxConfig( RadioModems_t modem, uint32_t bandwidth, uint32_t datarate, uint8_t coderate,
+                                  uint32_t bandwidthAfc, uint16_t preambleLen, uint16_t symbTimeout, bool fixLen,
+                                  uint8_t payloadLen, bool crcOn, bool freqHopOn, uint8_t hopPeriod,
+                                  bool iqInverted, bool rxContinuous );
+static void HostRadioSetTxConfig( RadioModems_t modem, int8_t power, uint32_t fdev, uint32_t bandwidth,
+                                  uint32_t datarate, uint8_t coderate, uint16_t preambleLen, bool fixLen,
+                                  bool crcOn, bool freqHopOn, uint8_t hopPeriod, bool iqInverted, uint32_t timeout );
+static bool HostRadioCheckRfFrequency( uint32_t frequency );
+static uint32_t HostRadioTimeOnAir( RadioModems_t modem, uint8_t pktLen );
+static void HostRadioSend( uint8_t *buffer, uint8_t size );
+static void HostRadioSleep( void );
+static void HostRadioStandby( void );
+static void HostRadioRx( uint32_t timeout );
+static void HostRadioStartCad( void );
+static void HostRadioSetTxContinuousWave( uint32_t freq, int8_t power, uint16_t time );
+static int16_t HostRadioRssi( RadioModems_t modem );
+static void HostRadioWrite( uint16_t addr, uint8_t data );
+static uint8_t HostRadioRead( uint16_t addr );
+static void HostRadioWriteBuffer( uint16_t addr, uint8_t *buffer, uint8_t size );
+static void HostRadioReadBuffer( uint16_t addr, uint8_t *buffer, uint8_t size );
+static void HostRadioSetMaxPayloadLength( RadioModems_t modem, uint8_t max );
+static void HostRadioSetPublicNetwork( bool enable );
+static uint32_t HostRadioGetWakeupTime( void );
+
+const struct Radio_s Radio =
+{
+    HostRadioInit,
+    HostRadioGetStatus,
+    HostRadioSetModem,
+    HostRadioSetChannel,
+    HostRadioIsChannelFree,
+    HostRadioRandom,
+    HostRadioSetRxConfig,
+    HostRadioSetTxConfig,
+    HostRadioCheckRfFrequency,
+    HostRadioTimeOnAir,
+    HostRadioSend,
+    HostRadioSleep,
+    HostRadioStandby,
+    HostRadioRx,
+    HostRadioStartCad,
+    HostRadioSetTxContinuousWave,
+    HostRadioRssi,
+    HostRadioWrite,
+    HostRadioRead,
+    HostRadioWriteBuffer,
+    HostRadioReadBuffer,
+    HostRadioSetMaxPayloadLength,
+    HostRadioSetPublicNetwork,
+    HostRadioGetWakeupTime,
+    NULL, // void ( *IrqProcess )( void ) - interrupts are dispatched by HostRunNext
+    NULL, // void ( *RxBoosted )( uint32_t timeout ) - SX126x Only
+    NULL, // void ( *SetRxDutyCycle )( uint32_t rxTime, uint32_t sleepTime ) - SX126x Only
+};
+
+/*!
+ * \brief Returns the LoRa symbol time in microseconds
+ */
+static double HostRadioSymbolTime( uint32_t bandwidth, uint32_t datarate )
+{
+    static const double bw[] = { 125e3, 250e3, 500e3 };
+
+    return ( double )( 1 << datarate ) / bw[bandwidth < 3 ? bandwidth : 0] * 1e6;
+}
+
+/*!
+ * \brief Returns the preamble duration in microseconds
+ */
+static double HostRadioPreambleTime( const HostRadioFrame_t* frame )
+{
+    if( frame->Modem == MODEM_LORA )
+    {
+        return ( frame->PreambleLen + 4.25 ) * HostRadioSymbolTime( frame->Bandwidth, frame->Datarate );
+    }
+    return frame->PreambleLen * 8 * 1e6 / frame->Datarate;
+}
+
+uint32_t HostRadioFrameTimeOnAir( const HostRadioFrame_t* frame )
+{
+    if( frame->Modem == MODEM_LORA )
+    {
+        double ts = HostRadioSymbolTime( frame->Bandwidth, frame->Datarate );
+        bool lowDatarateOptimize = ( ( frame->Bandwidth == 0 ) && ( frame->Datarate >= 11 ) ) ||
+                                   ( ( frame->Bandwidth == 1 ) && ( frame->Datarate == 12 ) );
+        double tmp = ceil( ( 8.0 * frame->Size - 4.0 * frame->Datarate + 28 + 16 * frame->CrcOn ) /
+                           ( 4.0 * ( frame->Datarate - ( lowDatarateOptimize ? 2 : 0 ) ) ) ) *
+                     ( frame->Coderate + 4 );
+
+        return ( uint32_t )ceil( HostRadioPreambleTime( frame ) + ( 8 + ( tmp > 0 ? tmp : 0 ) ) * ts );
+    }
+    // FSK: preamble, 3 bytes sync word, length, payload, crc
+    return ( uint32_t )ceil( ( frame->PreambleLen + 3 + 1 + frame->Size + ( frame->CrcOn ? 2 : 0 ) ) * 8 * 1e6 /
+                             frame->Datarate );
+}
+
+/*!
+ * \brief Returns the supply current in TX, in uA
+ *
+ * \remark Interpolates the typical SX1276 figures of the datasheet
+ */
+static uint32_t HostRadioTxCurrent( int8_t power )
+{
+    static const struct { int8_t Power; uint32_t Current; } table[] =
+    {
+        { 7, 20000 }, { 13, 29000 }, { 17, 87000 }, { 20, 120000 },
+    };
+    uint8_t i;
+
+    if( power <= table[0].Power )
+    {
+        return table[0].Current;
+    }
+    for( i = 1; i < sizeof( table ) / sizeof( table[0] ) - 1 && power > table[i].Power; i++ )
+    {
+    }
+    if( power >= table[i].Power )
+    {
+        return table[i].Current;
+    }
+    return table[i - 1].Current + ( table[i].Current - table[i - 1].Current ) *
+           ( power - table[i - 1].Power ) / ( table[i].Power - table[i - 1].Power );
+}
+
+/*!
+ * \brief Accounts the time spent in the current state and switches state
+ */
+static void HostRadioSetState( RadioState_t state )
+{
+    uint64_t now = HostGetTime( );
+
+    if( HostRadio.State == RF_RX_RUNNING )
+    {
+        HostRadio.Stats.RxTime += now - HostRadio.StateTime;
+        HostRadio.Stats.RxCharge += ( now - HostRadio.StateTime ) * HOST_RADIO_RX_CURRENT;
+    }
+    HostRadio.State = state;
+    HostRadio.StateTime = now;
+}
+
+static void HostRadioTxDoneIrq( void* context )
+{
+    uint32_t toa = HostRadioFrameTimeOnAir( &HostRadio.TxFrame );
+
+    ( void )context;
+    TimerCapture( );
+    HostRadio.Stats.TxCount++;
+    HostRadio.Stats.TxTime += toa;
+    HostRadio.Stats.TxEnergy += ( uint64_t )( pow( 10, HostRadio.TxFrame.Power / 10.0 ) * toa );
+    HostRadio.Stats.TxCharge += ( uint64_t )HostRadioTxCurrent( HostRadio.TxFrame.Power ) * toa;
+    HostRadioSetState( RF_IDLE );
+    if( HostRadio.TxHandler != NULL )
+    {
+        HostRadio.TxHandler( &HostRadio.TxFrame );
+    }
+    if( ( HostRadio.Events != NULL ) && ( HostRadio.Events->TxDone != NULL ) )
+    {
+        HostRadio.Events->TxDone( );
+    }
+}
+
+static void HostRadioTxTimeoutIrq( void* context )
+{
+    ( void )context;
+    TimerCapture( );
+    HostRadioSetState( RF_IDLE );
+    if( ( HostRadio.Events != NULL ) && ( HostRadio.Events->TxTimeout != NULL ) )
+    {
+        HostRadio.Events->TxTimeout( );
+    }
+}
+
+static void HostRadioRxDoneIrq( void* context )
+{
+    HostRadioFrame_t* frame = HostRadio.RxFrame;
+    uint8_t size = frame->Size;
+    int16_t rssi = frame->Rssi;
+    int8_t snr = frame->Snr;
+    bool error = HostRandomEvent( HostRadio.Faults.RxError );
+
+    ( void )context;
+    TimerCapture( );
+    memcpy( HostRadio.RxBuffer, frame->Payload, size );
+    HostRadioAirUsed[frame - HostRadioAir] = false;
+    HostRadio.RxFrame = NULL;
+    if( HostRadio.RxContinuous == true )
+    {
+        HostRadioSetState( RF_RX_RUNNING );
+    }
+    else
+    {
+        HostRadioSetState( RF_IDLE );
+    }
+    if( error == true )
+    {
+        HostRadio.Stats.RxErrorCount++;
+        if( ( HostRadio.Events != NULL ) && ( HostRadio.Events->RxError != NULL ) )
+        {
+            HostRadio.Events->RxError( );
+        }
+    }
+    else
+    {
+        HostRadio.Stats.RxDoneCount++;
+        if( ( HostRadio.Events != NULL ) && ( HostRadio.Events->RxDone != NULL ) )
+        {
+            HostRadio.Events->RxDone( HostRadio.RxBuffer, size, rssi, snr );
+        }
+    }
+}
+
+static void HostRadioRxTimeoutIrq( void* context )
+{
+    ( void )context;
+    TimerCapture( );
+    HostRadio.Stats.RxTimeoutCount++;
+    HostRadioSetState( RF_IDLE );
+    if( ( HostRadio.Events != NULL ) && ( HostRadio.Events->RxTimeout != NULL ) )
+    {
+        HostRadio.Events->RxTimeout( );
+    }
+}
+
+static bool HostRadioFrameMatches( const HostRadioFrame_t* frame )
+{
+    const HostRadioConfig_t* rx = &HostRadio.RxConfig;
+
+    return ( frame->Modem == rx->Modem ) && ( frame->Frequency == HostRadio.Frequency ) &&
+           ( frame->Bandwidth == rx->Bandwidth ) && ( frame->Datarate == rx->Datarate ) &&
+           ( ( frame->Modem != MODEM_LORA ) || ( frame->IqInverted == rx->IqInverted ) );
+}
+
+/*!
+ * \brief Looks for a frame whose preamble the receiver detects and
+ *        schedules its reception, or the end of the RX window
+ */
+static void HostRadioRxSearch( void )
+{
+    uint64_t now = HostGetTime( );
+    uint64_t windowEnd = UINT64_MAX;
+    uint64_t detectTime;
+    HostRadioFrame_t* best = NULL;
+    uint64_t bestTime = UINT64_MAX;
+
+    if( HostRadio.RxContinuous == false )
+    {
+        if( HostRadio.RxConfig.Modem == MODEM_LORA )
+        {
+            windowEnd = HostRadio.StateTime + ( uint64_t )( HostRadio.RxSymbTimeout *
+                        HostRadioSymbolTime( HostRadio.RxConfig.Bandwidth, HostRadio.RxConfig.Datarate ) );
+        }
+        if( HostRadio.RxTimeout != 0 )
+        {
+            windowEnd = MIN( windowEnd, HostRadio.StateTime + HostRadio.RxTimeout * 1000ULL );
+        }
+    }
+    else if( HostRadio.RxTimeout != 0 )
+    {
+        windowEnd = HostRadio.StateTime + HostRadio.RxTimeout * 1000ULL;
+    }
+
+    for( uint8_t i = 0; i < HOST_RADIO_AIR_SIZE; i++ )
+    {
+        HostRadioFrame_t* frame = &HostRadioAir[i];
+
+        if( HostRadioAirUsed[i] == false )
+        {
+            continue;
+        }
+        if( frame->Time + HostRadioFrameTimeOnAir( frame ) < now )
+        {
+            // Over
+            HostRadioAirUsed[i] = false;
+            continue;
+        }
+        if( HostRadioFrameMatches( frame ) == false )
+        {
+            continue;
+        }
+        // The receiver must see enough of the preamble before it ends, and
+        // must detect it before the window closes
+        detectTime = MAX( frame->Time, HostRadio.StateTime );
+        if( frame->Modem == MODEM_LORA )
+        {
+            detectTime += ( uint64_t )( HOST_RADIO_DETECT_SYMBOLS *
+                          HostRadioSymbolTime( frame->Bandwidth, frame->Datarate ) );
+        }
+        if( ( detectTime > frame->Time + ( uint64_t )HostRadioPreambleTime( frame ) ) ||
+            ( MAX( frame->Time, HostRadio.StateTime ) > windowEnd ) )
+        {
+            continue;
+        }
+        if( frame->Time < bestTime )
+        {
+            best = frame;
+            bestTime = frame->Time;
+        }
+    }
+
+    if( best != NULL )
+    {
+        if( HostRandomEvent( HostRadio.Faults.RxLoss ) == true )
+        {
+            HostRadioAirUsed[best - HostRadioAir] = false;
+            HostRadioRxSearch( );
+            return;
+        }
+        HostRadio.RxFrame = best;
+        HostEventSchedule( &HostRadio.Irq, best->Time + HostRadioFrameTimeOnAir( best ) + HostGetIrqLatency( ),
+                           HostRadioRxDoneIrq, NULL );
+    }
+    else if( windowEnd != UINT64_MAX )
+    {
+        HostEventSchedule( &HostRadio.Irq, MAX( windowEnd, now ) + HostGetIrqLatency( ),
+                           HostRadioRxTimeoutIrq, NULL );
+    }
+    else
+    {
+        HostEventCancel( &HostRadio.Irq );
+    }
+}
+
+void HostRadioSetTxHandler( void ( *handler )( const HostRadioFrame_t* frame ) )
+{
+    HostRadio.TxHandler = handler;
+}
+
+bool HostRadioDeliver( const HostRadioFrame_t* frame )
+{
+    for( uint8_t i = 0; i < HOST_RADIO_AIR_SIZE; i++ )
+    {
+        if( HostRadioAirUsed[i] == false )
+        {
+            HostRadioAir[i] = *frame;
+            HostRadioAirUsed[i] = true;
+            if( ( HostRadio.State == RF_RX_RUNNING ) && ( HostRadio.RxFrame == NULL ) )
+            {
+                HostRadioRxSearch( );
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+void HostRadioSetFaults( const HostRadioFaults_t* faults )
+{
+    HostRadio.Faults = *faults;
+}
+
+const HostRadioStats_t* HostRadioGetStats( void )
+{
+    return &HostRadio.Stats;
+}
+
+static void HostRadioInit( RadioEvents_t *events )
+{
+    HostRadio.Events = events;
+    HostEventCancel( &HostRadio.Irq );
+    HostRadio.RxFrame = NULL;
+    HostRadio.State = RF_IDLE;
+    HostRadio.StateTime = HostGetTime( );
+}
+
+static RadioState_t HostRadioGetStatus( void )
+{
+    return HostRadio.State;
+}
+
+static void HostRadioSetModem( RadioModems_t modem )
+{
+    HostRadio.Modem = modem;
+}
+
+static void HostRadioSetChannel( uint32_t freq )
+{
+    HostRadio.Frequency = freq;
+}
+
+static bool HostRadioIsChannelFree( RadioModems_t modem, uint32_t freq, int16_t rssiThresh, uint32_t maxCarrierSenseTime )
+{
+    ( void )modem;
+    ( void )freq;
+    ( void )rssiThresh;
+    ( void )maxCarrierSenseTime;
+    return true;
+}
+
+static uint32_t HostRadioRandom( void )
+{
+    return ( ( uint32_t )rand( ) << 16 ) ^ ( uint32_t )rand( );
+}
+
+static void HostRadioSetRxConfig( RadioModems_t modem, uint32_t bandwidth, uint32_t datarate, uint8_t coderate,
+                                  uint32_t bandwidthAfc, uint16_t preambleLen, uint16_t symbTimeout, bool fixLen,
+                                  uint8_t payloadLen, bool crcOn, bool freqHopOn, uint8_t hopPeriod,
+                                  bool iqInverted, bool rxContinuous )
+{
+    ( void )bandwidthAfc;
+    ( void )payloadLen;
+    ( void )freqHopOn;
+    ( void )hopPeriod;
+    HostRadio.Modem = modem;
+    HostRadio.RxConfig = ( HostRadioConfig_t ){ modem, bandwidth, datarate, coderate, preambleLen, fixLen, crcOn, iqInverted };
+    HostRadio.RxSymbTimeout = symbTimeout;
+    HostRadio.RxContinuous = rxContinuous;
+}
+
+static void HostRadioSetTxConfig( RadioModems_t modem, int8_t power, uint32_t fdev, uint32_t bandwidth,
+                                  uint32_t datarate, uint8_t coderate, uint16_t preambleLen, bool fixLen,
+                                  bool crcOn, bool freqHopOn, uint8_t hopPeriod, bool iqInverted, uint32_t timeout )
+{
+    ( void )fdev;
+    ( void )freqHopOn;
+    ( void )hopPeriod;
+    HostRadio.Modem = modem;
+    HostRadio.TxConfig = ( HostRadioConfig_t ){ modem, bandwidth, datarate, coderate, preambleLen, fixLen, crcOn, iqInverted };
+    HostRadio.TxPower = power;
+    HostRadio.TxTimeout = timeout;
+}
+
+static bool HostRadioCheckRfFrequency( uint32_t frequency )
+{
+    ( void )frequency;
+    return true;
+}
+
+/*!
+ * \brief Fills the modulation parameters of a frame from the TX configuration
+ */
+static void HostRadioTxFrame( HostRadioFrame_t* frame, uint8_t size )
+{
+    const HostRadioConfig_t* tx = &HostRadio.TxConfig;
+
+    frame->Time = HostGetTime( );
+    frame->Modem = tx->Modem;
+    frame->Frequency = HostRadio.Frequency;
+    frame->Bandwidth = tx->Bandwidth;
+    frame->Datarate = tx->Datarate;
+    frame->Coderate = tx->Coderate;
+    frame->PreambleLen = tx->PreambleLen;
+    frame->CrcOn = tx->CrcOn;
+    frame->IqInverted = tx->IqInverted;
+    frame->Power = HostRadio.TxPower;
+    frame->Size = size;
+}
+
+static uint32_t HostRadioTimeOnAir( RadioModems_t modem, uint8_t pktLen )
+{
+    HostRadioFrame_t frame;
+
+    HostRadioTxFrame( &frame, pktLen );
+    frame.Modem = modem;
+    // Milliseconds, rounded up like the SX1276 driver
+    return ( HostRadioFrameTimeOnAir( &frame ) + 999 ) / 1000;
+}
+
+static void HostRadioSend( uint8_t *buffer, uint8_t size )
+{
+    HostRadioTxFrame( &HostRadio.TxFrame, size );
+    memcpy( HostRadio.TxFrame.Payload, buffer, size );
+    HostRadioSetState( RF_TX_RUNNING );
+
+    if( HostRandomEvent( HostRadio.Faults.TxTimeout ) == true )
+    {
+        HostEventSchedule( &HostRadio.Irq, HostGetTime( ) + HostRadio.TxTimeout * 1000ULL + HostGetIrqLatency( ),
+                           HostRadioTxTimeoutIrq, NULL );
+        return;
+    }
+    HostEventSchedule( &HostRadio.Irq, HostGetTime( ) + HostRadioFrameTimeOnAir( &HostRadio.TxFrame ) +
+                       HostRadio.Faults.TxDoneDelay + HostGetIrqLatency( ), HostRadioTxDoneIrq, NULL );
+}
+
+static void HostRadioSleep( void )
+{
+    HostEventCancel( &HostRadio.Irq );
+    HostRadio.RxFrame = NULL;
+    HostRadioSetState( RF_IDLE );
+}
+
+static void HostRadioStandby( void )
+{
+    HostRadioSleep( );
+}
+
+static void HostRadioRx( uint32_t timeout )
+{
+    HostEventCancel( &HostRadio.Irq );
+    HostRadio.RxFrame = NULL;
+    HostRadio.RxTimeout = timeout;
+    HostRadioSetState( RF_RX_RUNNING );
+    HostRadio.Stats.RxWindows++;
+    HostRadioRxSearch( );
+}
+
+static void HostRadioCadDoneIrq( void* context )
+{
+    ( void )context;
+    HostRadioSetState( RF_IDLE );
+    if( ( HostRadio.Events != NULL ) && ( HostRadio.Events->CadDone != NULL ) )
+    {
+        HostRadio.Events->CadDone( false );
+    }
+}
+
+static void HostRadioStartCad( void )
+{
+    HostRadioSetState( RF_CAD );
+    HostEventSchedule( &HostRadio.Irq, HostGetTime( ) +
+                       ( uint64_t )( 2 * HostRadioSymbolTime( HostRadio.RxConfig.Bandwidth, HostRadio.RxConfig.Datarate ) ) +
+                       HostGetIrqLatency( ), HostRadioCadDoneIrq, NULL );
+}
+
+static void HostRadioSetTxContinuousWave( uint32_t freq, int8_t power, uint16_t time )
+{
+    HostRadio.Frequency = freq;
+    HostRadio.TxPower = power;
+    HostRadioSetState( RF_TX_RUNNING );
+    HostEventSchedule( &HostRadio.Irq, HostGetTime( ) + time * 1000000ULL + HostGetIrqLatency( ),
+                       HostRadioTxTimeoutIrq, NULL );
+}
+
+static int16_t HostRadioRssi( RadioModems_t modem )
+{
+    ( void )modem;
+    return -120;
+}
+
+static void HostRadioWrite( uint16_t addr, uint8_t data )
+{
+    ( void )addr;
+    ( void )data;
+}
+
+static uint8_t HostRadioRead( uint16_t addr )
+{
+    ( void )addr;
+    return 0;
+}
+
+static void HostRadioWriteBuffer( uint16_t addr, uint8_t *buffer, uint8_t size )
+{
+    ( void )addr;
+    ( void )buffer;
+    ( void )size;
+}
+
+static void HostRadioReadBuffer( uint16_t addr, uint8_t *buffer, uint8_t size )
+{
+    ( void )addr;
+    memset( buffer, 0, size );
+}
+
+static void HostRadioSetMaxPayloadLength( RadioModems_t modem, uint8_t max )
+{
+    ( void )modem;
+    ( void )max;
+}
+
+static void HostRadioSetPublicNetwork( bool enable )
+{
+    ( void )enable;
+}
+
+static uint32_t HostRadioGetWakeupTime( void )
+{
+    return HOST_RADIO_WAKEUP_TIME;
+}
@@ -0,0 +1,139 @@
+/*!
+ * \file      radio-host.h
+ *
+ * \brief     Simulated radio driver of the host (POSIX) board
+ *
+ * \remark    Frames sent by the stack are handed to the handler set with
+ *            \ref HostRadioSetTxHandler. Frames put on the air with
+ *            \ref HostRadioDeliver are received when the stack listens on the
+ *            same channel, data rate and IQ polarity early enough to detect
+ *            their preamble.
+ */
+#ifndef __RADIO_HOST_H__
+#define __RADIO_HOST_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "radio.h"
+
+/*!
+ * Frame on the air
+ */
+typedef struct sHostRadioFrame
+{
+    /*!
+     * Start of the preamble, virtual time in microseconds
+     */
+    uint64_t Time;
+    RadioModems_t Modem;
+    uint32_t Frequency;
+    /*!
+     * LoRa: 0: 125 kHz, 1: 250 kHz, 2: 500 kHz. FSK: bandwidth in Hz
+     */
+    uint32_t Bandwidth;
+    /*!
+     * LoRa: spreading factor. FSK: bit rate in bits/s
+     */
+    uint32_t Datarate;
+    uint8_t Coderate;
+    uint16_t PreambleLen;
+    bool CrcOn;
+    bool IqInverted;
+    /*!
+     * Transmit power in dBm, as set by the stack
+     */
+    int8_t Power;
+    /*!
+     * Reception quality reported to the stack
+     */
+    int16_t Rssi;
+    int8_t Snr;
+    uint8_t Size;
+    uint8_t Payload[255];
+}HostRadioFrame_t;
+
+/*!
+ * Injected faults, probabilities in 1/1000
+ */
+typedef struct sHostRadioFaults
+{
+    /*!
+     * Frames on the air the radio does not detect
+     */
+    uint16_t RxLoss;
+    /*!
+     * Received frames reported as RxError
+     */
+    uint16_t RxError;
+    /*!
+     * Transmissions reported as TxTimeout
+     */
+    uint16_t TxTimeout;
+    /*!
+     * Additional delay of the TxDone interrupt in microseconds
+     */
+    uint32_t TxDoneDelay;
+}HostRadioFaults_t;
+
+/*!
+ * Time spent in each radio state, for energy accounting
+ */
+typedef struct sHostRadioStats
+{
+    uint32_t TxCount;
+    uint32_t RxWindows;
+    uint32_t RxDoneCount;
+    uint32_t RxTimeoutCount;
+    uint32_t RxErrorCount;
+    uint64_t TxTime;
+    uint64_t RxTime;
+    /*!
+     * Integral of the transmit power over the TX time, in mW * us
+     */
+    uint64_t TxEnergy;
+    /*!
+     * Charge drawn from the supply in TX and RX, in uA * us
+     */
+    uint64_t TxCharge;
+    uint64_t RxCharge;
+}HostRadioStats_t;
+
+/*!
+ * \brief Sets the function called with each frame the stack transmits, at
+ *        the end of the transmission
+ *
+ * \param [IN] handler  Handler, NULL to drop the frames
+ */
+void HostRadioSetTxHandler( void ( *handler )( const HostRadioFrame_t* frame ) );
+
+/*!
+ * \brief Puts a frame on the air. The frame is copied.
+ *
+ * \param [IN] frame    Frame, Time is the start of its preamble
+ *
+ * \retval queued       False if too many frames are pending
+ */
+bool HostRadioDeliver( const HostRadioFrame_t* frame );
+
+/*!
+ * \brief Sets the injected faults
+ *
+ * \param [IN] faults   Faults
+ */
+void HostRadioSetFaults( const HostRadioFaults_t* faults );
+
+/*!
+ * \brief Returns the radio statistics
+ */
+const HostRadioStats_t* HostRadioGetStats( void );
+
+/*!
+ * \brief Computes the time on air of a frame
+ *
+ * \param [IN] frame    Frame
+ *
+ * \retval time         Time on air in microseconds
+ */
+uint32_t HostRadioFrameTimeOnAir( const HostRadioFrame_t* frame );
+
+#endif // __RADIO_HOST_H__
@@ -22,7 +22,6 @@
  *
  * \author    Wael Guibene ( Semtech )
  */
-#include <math.h>
 #include <string.h>
 #include "utilities.h"
 #include "timer.h"
@@ -95,6 +94,19 @@ void SX1276ReadFifo( uint8_t *buffer, uint8_t size );
  */
 void SX1276SetOpMode( uint8_t opMode );
 
+/*!
+ * \brief Forgets the shadowed register values, after the radio was reset
+ */
+static void SX1276ShadowInvalidate( void );
+
+/*!
+ * \brief Returns the index of a register in the shadow
+ *
+ * \param [IN] addr Register address
+ * \retval index    Shadow index, -1 if the register is not shadowed
+ */
+static int16_t SX1276ShadowIndex( uint16_t addr );
+
 /*
  * SX1276 DIO IRQ callback functions prototype
  */
@@ -194,6 +206,18 @@ static RadioEvents_t *RadioEvents;
  */
 static uint8_t RxTxBuffer[RX_BUFFER_SIZE];
 
+/*!
+ * Write-through shadow of the configuration registers. Addresses 0x0D to
+ * 0x3F have an FSK and a LoRa page, selected by the long range mode bit of
+ * RegOpMode, and are stored after the 128 common addresses.
+ */
+static uint8_t RegShadow[128 + 0x40 - 0x0D];
+
+/*!
+ * One bit per valid entry of RegShadow
+ */
+static uint8_t RegShadowValid[( sizeof( RegShadow ) + 7 ) / 8];
+
 /*
  * Public global variables
  */
@@ -227,12 +251,13 @@ void SX1276Init( RadioEvents_t *events )
 
     RadioEvents = events;
 
-    // Initialize driver timeout timers
+    // Initialize driver timeout timers, counted in TIMER_QUEUE_SIZE
     TimerInit( &TxTimeoutTimer, SX1276OnTimeoutIrq );
     TimerInit( &RxTimeoutTimer, SX1276OnTimeoutIrq );
     TimerInit( &RxTimeoutSyncWord, SX1276OnTimeoutIrq );
 
     SX1276Reset( );
+    SX1276ShadowInvalidate( );
 
     RxChainCalibration( );
 
@@ -708,18 +733,20 @@ uint32_t SX1276GetTimeOnAir( RadioModems_t modem, uint8_t pktLen )
     {
     case MODEM_FSK:
         {
-            airTime = round( ( 8 * ( SX1276.Settings.Fsk.PreambleLen +
-                                     ( ( SX1276Read( REG_SYNCCONFIG ) & ~RF_SYNCCONFIG_SYNCSIZE_MASK ) + 1 ) +
-                                     ( ( SX1276.Settings.Fsk.FixLen == 0x01 ) ? 0.0 : 1.0 ) +
-                                     ( ( ( SX1276Read( REG_PACKETCONFIG1 ) & ~RF_PACKETCONFIG1_ADDRSFILTERING_MASK ) != 0x00 ) ? 1.0 : 0 ) +
-                                     pktLen +
-                                     ( ( SX1276.Settings.Fsk.CrcOn == 0x01 ) ? 2.0 : 0 ) ) /
-                                     SX1276.Settings.Fsk.Datarate ) * 1000 );
+            uint32_t nBytes = SX1276.Settings.Fsk.PreambleLen +
+                              ( ( SX1276Read( REG_SYNCCONFIG ) & ~RF_SYNCCONFIG_SYNCSIZE_MASK ) + 1 ) +
+                              ( ( SX1276.Settings.Fsk.FixLen == 0x01 ) ? 0 : 1 ) +
+                              ( ( ( SX1276Read( REG_PACKETCONFIG1 ) & ~RF_PACKETCONFIG1_ADDRSFILTERING_MASK ) != 0x00 ) ? 1 : 0 ) +
+                              pktLen +
+                              ( ( SX1276.Settings.Fsk.CrcOn == 0x01 ) ? 2 : 0 );
+
+            // Rounded to the nearest ms
+            airTime = ( nBytes * 16000 + SX1276.Settings.Fsk.Datarate ) / ( 2 * SX1276.Settings.Fsk.Datarate );
         }
         break;
     case MODEM_LORA:
         {
-            double bw = 0.0;
+            uint32_t bw = 0;
             // REMARK: When using LoRa modem only bandwidths 125, 250 and 500 kHz are supported
             switch( SX1276.Settings.LoRa.Bandwidth )
             {
@@ -753,26 +780,29 @@ uint32_t SX1276GetTimeOnAir( RadioModems_t modem, uint8_t pktLen )
             case 9: // 500 kHz
                 bw = 500000;
                 break;
+            default:
+                return 0;
             }
 
-            // Symbol rate : time for one symbol (secs)
-            double rs = bw / ( 1 << SX1276.Settings.LoRa.Datarate );
-            double ts = 1 / rs;
-            // time of preamble
-            double tPreamble = ( SX1276.Settings.LoRa.PreambleLen + 4.25 ) * ts;
-            // Symbol length of payload and time
-            double tmp = ceil( ( 8 * pktLen - 4 * SX1276.Settings.LoRa.Datarate +
-                                 28 + 16 * SX1276.Settings.LoRa.CrcOn -
-                                 ( SX1276.Settings.LoRa.FixLen ? 20 : 0 ) ) /
-                                 ( double )( 4 * ( SX1276.Settings.LoRa.Datarate -
-                                 ( ( SX1276.Settings.LoRa.LowDatarateOptimize > 0 ) ? 2 : 0 ) ) ) ) *
-                                 ( SX1276.Settings.LoRa.Coderate + 4 );
-            double nPayload = 8 + ( ( tmp > 0 ) ? tmp : 0 );
-            double tPayload = nPayload * ts;
-            // Time on air
-            double tOnAir = tPreamble + tPayload;
+            // Symbol time in us, exact for the supported bandwidths and a
+            // multiple of 4 us
+            uint32_t ts = ( ( ( uint32_t )1 << SX1276.Settings.LoRa.Datarate ) * 1000000UL ) / bw;
+            // Symbol length of payload
+            int32_t num = 8 * pktLen - 4 * SX1276.Settings.LoRa.Datarate +
+                          28 + 16 * SX1276.Settings.LoRa.CrcOn -
+                          ( SX1276.Settings.LoRa.FixLen ? 20 : 0 );
+            int32_t den = 4 * ( SX1276.Settings.LoRa.Datarate -
+                          ( ( SX1276.Settings.LoRa.LowDatarateOptimize > 0 ) ? 2 : 0 ) );
+            uint32_t nPayload = 8;
+
+            if( num > 0 )
+            {
+                nPayload += ( ( num + den - 1 ) / den ) * ( SX1276.Settings.LoRa.Coderate + 4 );
+            }
+            // Time on air in us, the preamble lasts PreambleLen + 4.25 symbols
+            uint32_t tOnAir = SX1276.Settings.LoRa.PreambleLen * ts + ( 17 * ts ) / 4 + nPayload * ts;
             // return ms secs
-            airTime = floor( tOnAir * 1000 + 0.999 );
+            airTime = ( tOnAir + 999 ) / 1000;
         }
         break;
     }
@@ -1256,48 +1286,148 @@ void SX1276SetModem( RadioModems_t modem )
     }
 }
 
+static void SX1276ShadowInvalidate( void )
+{
+    memset1( RegShadowValid, 0, sizeof( RegShadowValid ) );
+}
+
+static int16_t SX1276ShadowIndex( uint16_t addr )
+{
+    bool lora;
+
+    switch( addr )
+    {
+    case REG_FIFO:
+    case REG_FORMERTEMP:
+        return -1;
+    case REG_OPMODE:
+        return addr;
+    default:
+        break;
+    }
+    if( ( addr < REG_RXCONFIG ) || ( addr > REG_IRQFLAGS2 ) )
+    {
+        return ( addr < 128 ) ? addr : -1;
+    }
+
+    // The page is known once RegOpMode was read or written
+    if( ( RegShadowValid[REG_OPMODE / 8] & ( 1 << ( REG_OPMODE % 8 ) ) ) == 0 )
+    {
+        SX1276Read( REG_OPMODE );
+    }
+    lora = ( RegShadow[REG_OPMODE] & RFLR_OPMODE_LONGRANGEMODE_ON ) != 0;
+
+    // Registers updated by the radio itself or holding trigger bits
+    if( lora == true )
+    {
+        switch( addr )
+        {
+        case REG_LR_FIFOADDRPTR:
+        case REG_LR_FIFORXCURRENTADDR:
+        case REG_LR_IRQFLAGS:
+        case REG_LR_RXNBBYTES:
+        case REG_LR_RXHEADERCNTVALUEMSB:
+        case REG_LR_RXHEADERCNTVALUELSB:
+        case REG_LR_RXPACKETCNTVALUEMSB:
+        case REG_LR_RXPACKETCNTVALUELSB:
+        case REG_LR_MODEMSTAT:
+        case REG_LR_PKTSNRVALUE:
+        case REG_LR_PKTRSSIVALUE:
+        case REG_LR_RSSIVALUE:
+        case REG_LR_HOPCHANNEL:
+        case REG_LR_FIFORXBYTEADDR:
+        case REG_LR_FEIMSB:
+        case REG_LR_FEIMID:
+        case REG_LR_FEILSB:
+        case REG_LR_RSSIWIDEBAND:
+            return -1;
+        default:
+            return 128 + addr - REG_RXCONFIG;
+        }
+    }
+    switch( addr )
+    {
+    case REG_RXCONFIG:
+    case REG_RSSIVALUE:
+    case REG_AFCFEI:
+    case REG_AFCMSB:
+    case REG_AFCLSB:
+    case REG_FEIMSB:
+    case REG_FEILSB:
+    case REG_OSC:
+    case REG_SEQCONFIG1:
+    case REG_IMAGECAL:
+    case REG_TEMP:
+    case REG_IRQFLAGS1:
+    case REG_IRQFLAGS2:
+        return -1;
+    default:
+        return addr;
+    }
+}
+
 void SX1276Write( uint16_t addr, uint8_t data )
 {
+    int16_t i = SX1276ShadowIndex( addr );
+
+    // RegOpMode is always written, the radio leaves Tx and Rx by itself
+    if( ( i >= 0 ) && ( addr != REG_OPMODE ) &&
+        ( ( RegShadowValid[i / 8] & ( 1 << ( i % 8 ) ) ) != 0 ) && ( RegShadow[i] == data ) )
+    {
+        return;
+    }
     SX1276WriteBuffer( addr, &data, 1 );
 }
 
 uint8_t SX1276Read( uint16_t addr )
 {
+    int16_t i = SX1276ShadowIndex( addr );
     uint8_t data;
+
+    if( ( i >= 0 ) && ( ( RegShadowValid[i / 8] & ( 1 << ( i % 8 ) ) ) != 0 ) )
+    {
+        return RegShadow[i];
+    }
     SX1276ReadBuffer( addr, &data, 1 );
+    if( i >= 0 )
+    {
+        RegShadow[i] = data;
+        RegShadowValid[i / 8] |= 1 << ( i % 8 );
+    }
     return data;
 }
 
 void SX1276WriteBuffer( uint16_t addr, uint8_t *buffer, uint8_t size )
 {
-    uint8_t i;
-
     //NSS = 0;
     GpioWrite( &SX1276.Spi.Nss, 0 );
 
     SpiInOut( &SX1276.Spi, addr | 0x80 );
-    for( i = 0; i < size; i++ )
-    {
-        SpiInOut( &SX1276.Spi, buffer[i] );
-    }
+    SpiTransfer( &SX1276.Spi, buffer, NULL, size );
 
     //NSS = 1;
     GpioWrite( &SX1276.Spi.Nss, 1 );
+
+    // Register bursts auto-increment the address, FIFO accesses do not
+    for( uint8_t n = 0; ( addr != REG_FIFO ) && ( n < size ); n++ )
+    {
+        int16_t i = SX1276ShadowIndex( addr + n );
+
+        if( i >= 0 )
+        {
+            RegShadow[i] = buffer[n];
+            RegShadowValid[i / 8] |= 1 << ( i % 8 );
+        }
+    }
 }
 
 void SX1276ReadBuffer( uint16_t addr, uint8_t *buffer, uint8_t size )
 {
-    uint8_t i;
-
     //NSS = 0;
     GpioWrite( &SX1276.Spi.Nss, 0 );
 
     SpiInOut( &SX1276.Spi, addr & 0x7F );
-
-    for( i = 0; i < size; i++ )
-    {
-        buffer[i] = SpiInOut( &SX1276.Spi, 0 );
-    }
+    SpiTransfer( &SX1276.Spi, NULL, buffer, size );
 
     //NSS = 1;
     GpioWrite( &SX1276.Spi.Nss, 1 );
@@ -1398,6 +1528,7 @@ void SX1276OnTimeoutIrq( void* context )
 
         // Reset the radio
         SX1276Reset( );
+        SX1276ShadowInvalidate( );
 
         // Calibrate Rx chain
         RxChainCalibration( );
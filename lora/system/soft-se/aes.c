@@ -197,8 +197,32 @@ static const uint8_t sbox[256]  =  sb_data(f1);
 static const uint8_t isbox[256] = isb_data(f1);
 #endif
 
+#if ( AES_BACKEND == AES_BACKEND_BYTES )
 static const uint8_t gfm2_sbox[256] = sb_data(f2);
 static const uint8_t gfm3_sbox[256] = sb_data(f3);
+#else
+
+/* MixColumns output column for an S-box value in row 0 of the input  */
+/* column, little endian (row 0 in the low byte). The tables for rows  */
+/* 1 to 3 are the same values rotated left by 8, 16 and 24 bits.      */
+
+#define te0_w(x)  ((uint32_t)f2(x) | ((uint32_t)(x) << 8) | \
+                   ((uint32_t)(x) << 16) | ((uint32_t)f3(x) << 24))
+#define te1_w(x)  ((uint32_t)f3(x) | ((uint32_t)f2(x) << 8) | \
+                   ((uint32_t)(x) << 16) | ((uint32_t)(x) << 24))
+#define te2_w(x)  ((uint32_t)(x) | ((uint32_t)f3(x) << 8) | \
+                   ((uint32_t)f2(x) << 16) | ((uint32_t)(x) << 24))
+#define te3_w(x)  ((uint32_t)(x) | ((uint32_t)(x) << 8) | \
+                   ((uint32_t)f3(x) << 16) | ((uint32_t)f2(x) << 24))
+
+static const uint32_t te0_tab[256] = sb_data(te0_w);
+#if ( AES_BACKEND == AES_BACKEND_TTABLE_4 )
+static const uint32_t te1_tab[256] = sb_data(te1_w);
+static const uint32_t te2_tab[256] = sb_data(te2_w);
+static const uint32_t te3_tab[256] = sb_data(te3_w);
+#endif
+
+#endif
 
 #if defined( AES_DEC_PREKEYED )
 static const uint8_t gfmul_9[256] = mm_data(f9);
@@ -211,8 +235,22 @@ static const uint8_t gfmul_e[256] = mm_data(fe);
 #if defined( AES_DEC_PREKEYED )
 #define is_box(x)    isbox[(x)]
 #endif
+#if ( AES_BACKEND == AES_BACKEND_BYTES )
 #define gfm2_sb(x)   gfm2_sbox[(x)]
 #define gfm3_sb(x)   gfm3_sbox[(x)]
+#else
+#define rotl_w(w, n) (((w) << (n)) | ((w) >> (32 - (n))))
+#define te_0(x)      te0_tab[(x)]
+#if ( AES_BACKEND == AES_BACKEND_TTABLE_4 )
+#define te_1(x)      te1_tab[(x)]
+#define te_2(x)      te2_tab[(x)]
+#define te_3(x)      te3_tab[(x)]
+#else
+#define te_1(x)      rotl_w(te0_tab[(x)], 8)
+#define te_2(x)      rotl_w(te0_tab[(x)], 16)
+#define te_3(x)      rotl_w(te0_tab[(x)], 24)
+#endif
+#endif
 #if defined( AES_DEC_PREKEYED )
 #define gfm_9(x)     gfmul_9[(x)]
 #define gfm_b(x)     gfmul_b[(x)]
@@ -226,6 +264,10 @@ static const uint8_t gfmul_e[256] = mm_data(fe);
 /* 9 bits (0x11b), this right shift keeps the   */
 /* values of all top bits within a byte         */
 
+#if ( AES_BACKEND != AES_BACKEND_BYTES )
+#  error "the T-table AES backends need USE_TABLES"
+#endif
+
 static uint8_t hibit(const uint8_t x)
 {   uint8_t r = (uint8_t)((x >> 1) | (x >> 2));
 
@@ -403,10 +445,7 @@ static void copy_and_key( void *d, const void *s, const void *k )
 #endif
 }
 
-static void add_round_key( uint8_t d[N_BLOCK], const uint8_t k[N_BLOCK] )
-{
-    xor_block(d, k);
-}
+#define add_round_key(d, k)     xor_block(d, k)
 
 static void shift_sub_rows( uint8_t st[N_BLOCK] )
 {   uint8_t tt;
@@ -444,6 +483,36 @@ static void inv_shift_sub_rows( uint8_t st[N_BLOCK] )
 
 #endif
 
+#if ( AES_BACKEND != AES_BACKEND_BYTES )
+
+static void word_out( uint8_t d[4], const uint32_t w )
+{
+    d[0] = (uint8_t)w;
+    d[1] = (uint8_t)(w >> 8);
+    d[2] = (uint8_t)(w >> 16);
+    d[3] = (uint8_t)(w >> 24);
+}
+
+#if defined( AES_ENC_128_OTFK ) || defined( AES_ENC_256_OTFK )
+
+#if defined( VERSION_1 )
+  static void mix_sub_columns( uint8_t dt[N_BLOCK] )
+  { uint8_t st[N_BLOCK];
+    block_copy(st, dt);
+#else
+  static void mix_sub_columns( uint8_t dt[N_BLOCK], uint8_t st[N_BLOCK] )
+  {
+#endif
+    word_out(dt +  0, te_0(st[ 0]) ^ te_1(st[ 5]) ^ te_2(st[10]) ^ te_3(st[15]));
+    word_out(dt +  4, te_0(st[ 4]) ^ te_1(st[ 9]) ^ te_2(st[14]) ^ te_3(st[ 3]));
+    word_out(dt +  8, te_0(st[ 8]) ^ te_1(st[13]) ^ te_2(st[ 2]) ^ te_3(st[ 7]));
+    word_out(dt + 12, te_0(st[12]) ^ te_1(st[ 1]) ^ te_2(st[ 6]) ^ te_3(st[11]));
+  }
+
+#endif
+
+#else
+
 #if defined( VERSION_1 )
   static void mix_sub_columns( uint8_t dt[N_BLOCK] )
   { uint8_t st[N_BLOCK];
@@ -473,6 +542,8 @@ static void inv_shift_sub_rows( uint8_t st[N_BLOCK] )
     dt[15] = gfm3_sb(st[12]) ^ s_box(st[1]) ^ s_box(st[6]) ^ gfm2_sb(st[11]);
   }
 
+#endif
+
 #if defined( AES_DEC_PREKEYED )
 
 #if defined( VERSION_1 )
@@ -565,6 +636,48 @@ return_type aes_set_key( const uint8_t key[], length_type keylen, aes_context ct
 
 /*  Encrypt a single block of 16 bytes */
 
+#if ( AES_BACKEND != AES_BACKEND_BYTES )
+
+#define word_in(p)  ((uint32_t)(p)[0] | ((uint32_t)(p)[1] << 8) | \
+                     ((uint32_t)(p)[2] << 16) | ((uint32_t)(p)[3] << 24))
+#define bval(w, n)  ((uint8_t)((w) >> (8 * (n))))
+
+return_type aes_encrypt( const uint8_t in[N_BLOCK], uint8_t  out[N_BLOCK], const aes_context ctx[1] )
+{
+    if( ctx->rnd )
+    {
+        const uint8_t *k = ctx->ksch;
+        uint32_t s0, s1, s2, s3, t0, t1, t2, t3;
+        uint8_t s[N_BLOCK], r;
+
+        s0 = word_in(in     ) ^ word_in(k     );
+        s1 = word_in(in +  4) ^ word_in(k +  4);
+        s2 = word_in(in +  8) ^ word_in(k +  8);
+        s3 = word_in(in + 12) ^ word_in(k + 12);
+
+        for( r = 1 ; r < ctx->rnd ; ++r )
+        {
+            k += N_BLOCK;
+            t0 = te_0(bval(s0, 0)) ^ te_1(bval(s1, 1)) ^ te_2(bval(s2, 2)) ^ te_3(bval(s3, 3)) ^ word_in(k     );
+            t1 = te_0(bval(s1, 0)) ^ te_1(bval(s2, 1)) ^ te_2(bval(s3, 2)) ^ te_3(bval(s0, 3)) ^ word_in(k +  4);
+            t2 = te_0(bval(s2, 0)) ^ te_1(bval(s3, 1)) ^ te_2(bval(s0, 2)) ^ te_3(bval(s1, 3)) ^ word_in(k +  8);
+            t3 = te_0(bval(s3, 0)) ^ te_1(bval(s0, 1)) ^ te_2(bval(s1, 2)) ^ te_3(bval(s2, 3)) ^ word_in(k + 12);
+            s0 = t0; s1 = t1; s2 = t2; s3 = t3;
+        }
+        word_out(s     , s0);
+        word_out(s +  4, s1);
+        word_out(s +  8, s2);
+        word_out(s + 12, s3);
+        shift_sub_rows( s );
+        copy_and_key( out, s, k + N_BLOCK );
+    }
+    else
+        return ( uint8_t )-1;
+    return 0;
+}
+
+#else
+
 return_type aes_encrypt( const uint8_t in[N_BLOCK], uint8_t  out[N_BLOCK], const aes_context ctx[1] )
 {
     if( ctx->rnd )
@@ -592,6 +705,8 @@ return_type aes_encrypt( const uint8_t in[N_BLOCK], uint8_t  out[N_BLOCK], const
     return 0;
 }
 
+#endif
+
 /* CBC encrypt a number of blocks (input and return an IV) */
 
 return_type aes_cbc_encrypt( const uint8_t *in, uint8_t *out,
@@ -52,6 +52,24 @@
 #  define AES_DEC_256_OTFK  /* AES decryption with 'on the fly' 256 bit keying */
 #endif
 
+/*  Encryption round implementation, selected at build time by defining
+    AES_BACKEND (e.g. -DAES_BACKEND=AES_BACKEND_TTABLE_1):
+
+    AES_BACKEND_BYTES       byte operations on the S-box and its GF(2^8)
+                            multiples (3 x 256 byte tables)
+    AES_BACKEND_TTABLE_1    combined SubBytes/MixColumns using one 32-bit
+                            table, rotated for each row (256 + 1 KB)
+    AES_BACKEND_TTABLE_4    combined SubBytes/MixColumns using four 32-bit
+                            tables (256 + 4 KB)
+*/
+#define AES_BACKEND_BYTES       0
+#define AES_BACKEND_TTABLE_1    1
+#define AES_BACKEND_TTABLE_4    2
+
+#if !defined( AES_BACKEND )
+#  define AES_BACKEND   AES_BACKEND_BYTES
+#endif
+
 #define N_ROW                   4
 #define N_COL                   4
 #define N_BLOCK   (N_ROW * N_COL)
@@ -59,7 +59,7 @@ void AES_CMAC_Init(AES_CMAC_CTX *ctx)
 {
             memset1(ctx->X, 0, sizeof ctx->X);
             ctx->M_n = 0;
-        memset1(ctx->rijndael.ksch, '\0', 240);
+        /* the key schedule is kept, so a keyed context can be reused */
 }
     
 void AES_CMAC_SetKey(AES_CMAC_CTX *ctx, const uint8_t key[AES_CMAC_KEY_LENGTH])
@@ -102,52 +102,57 @@ void AES_CMAC_Update(AES_CMAC_CTX *ctx, const uint8_t *data, uint32_t len)
             ctx->M_n = len;
 }
    
-void AES_CMAC_Final(uint8_t digest[AES_CMAC_DIGEST_LENGTH], AES_CMAC_CTX *ctx)
+void AES_CMAC_Subkeys(AES_CMAC_CTX *ctx, uint8_t K1[16], uint8_t K2[16])
 {
-            uint8_t K[16];
-        uint8_t in[16];
-            /* generate subkey K1 */
-            memset1(K, '\0', 16);
-
-            //rijndael_encrypt(&ctx->rijndael, K, K);
-
-            aes_encrypt( K, K, &ctx->rijndael);
-
-            if (K[0] & 0x80) {
-                    LSHIFT(K, K);
-                   K[15] ^= 0x87;
-            } else
-                    LSHIFT(K, K);
-
-
-            if (ctx->M_n == 16) {
-                    /* last block was a complete block */
-                    XOR(K, ctx->M_last);
-
-           } else {
-                   /* generate subkey K2 */
-                  if (K[0] & 0x80) {
-                          LSHIFT(K, K);
-                          K[15] ^= 0x87;
-                  } else
-                           LSHIFT(K, K);
-
-                   /* padding(M_last) */
-                   ctx->M_last[ctx->M_n] = 0x80;
-                   while (++ctx->M_n < 16)
-                         ctx->M_last[ctx->M_n] = 0;
-   
-                  XOR(K, ctx->M_last);
+        /* L = AES-128(K, 0^128) */
+        memset1(K1, '\0', 16);
+        aes_encrypt(K1, K1, &ctx->rijndael);
+
+        /* generate subkey K1 */
+        if (K1[0] & 0x80) {
+                LSHIFT(K1, K1);
+                K1[15] ^= 0x87;
+        } else
+                LSHIFT(K1, K1);
+
+        /* generate subkey K2 */
+        if (K1[0] & 0x80) {
+                LSHIFT(K1, K2);
+                K2[15] ^= 0x87;
+        } else
+                LSHIFT(K1, K2);
+}
 
+void AES_CMAC_FinalSubkeys(uint8_t digest[AES_CMAC_DIGEST_LENGTH], AES_CMAC_CTX *ctx,
+                           const uint8_t K1[16], const uint8_t K2[16])
+{
+        uint8_t in[16];
 
-           }
-           XOR(ctx->M_last, ctx->X);
+        if (ctx->M_n == 16) {
+                /* last block was a complete block */
+                XOR(K1, ctx->M_last);
+        } else {
+                /* padding(M_last) */
+                ctx->M_last[ctx->M_n] = 0x80;
+                while (++ctx->M_n < 16)
+                        ctx->M_last[ctx->M_n] = 0;
+
+                XOR(K2, ctx->M_last);
+        }
+        XOR(ctx->M_last, ctx->X);
+
+        memcpy1(in, &ctx->X[0], 16); //Bestela ez du ondo iten
+        aes_encrypt(in, digest, &ctx->rijndael);
+}
 
-           //rijndael_encrypt(&ctx->rijndael, ctx->X, digest);
+void AES_CMAC_Final(uint8_t digest[AES_CMAC_DIGEST_LENGTH], AES_CMAC_CTX *ctx)
+{
+        uint8_t K1[16];
+        uint8_t K2[16];
 
-       memcpy1(in, &ctx->X[0], 16); //Bestela ez du ondo iten
-       aes_encrypt(in, digest, &ctx->rijndael);
-           memset1(K, 0, sizeof K);
+        AES_CMAC_Subkeys(ctx, K1, K2);
+        AES_CMAC_FinalSubkeys(digest, ctx, K1, K2);
 
+        memset1(K1, 0, sizeof K1);
+        memset1(K2, 0, sizeof K2);
 }
-
@@ -22,6 +22,7 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ),
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <stdbool.h>
 
 #include "LoRaMacCrypto.h"
 #include "utilities.h"
@@ -32,6 +33,16 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ),
 #define NUM_OF_KEYS      24
 #define KEY_SIZE         16
 
+/*
+ * Number of expanded AES key schedules kept in RAM
+ */
+#define NUM_OF_KEY_SCHEDULES    4
+
+/*
+ * Number of keys with precomputed CMAC subkeys
+ */
+#define NUM_OF_CMAC_SUBKEYS     3
+
 /*!
  * Identifier value pair type for Keys
  */
@@ -47,6 +58,29 @@ typedef struct sKey
     uint8_t KeyValue[KEY_SIZE];
 } Key_t;
 
+/*!
+ * CMAC subkeys ( RFC 4493 K1/K2 ) of a network session key
+ */
+typedef struct sCmacSubkeys
+{
+    /*
+     * Key identifier
+     */
+    KeyIdentifier_t KeyID;
+    /*
+     * Set if K1 and K2 match the current key value
+     */
+    bool IsValid;
+    /*
+     * Subkey K1, used if the last message block is complete
+     */
+    uint8_t K1[KEY_SIZE];
+    /*
+     * Subkey K2, used if the last message block is padded
+     */
+    uint8_t K2[KEY_SIZE];
+} CmacSubkeys_t;
+
 /*
  * Secure Element Non Volatile Context structure
  */
@@ -61,24 +95,51 @@ typedef struct sSecureElementNvCtx
      */
     uint8_t JoinEui[SE_EUI_SIZE];
     /*
-     * AES computation context variable
+     * Key List
      */
-    aes_context AesContext;
+    Key_t KeyList[NUM_OF_KEYS];
     /*
-     * CMAC computation context variable
+     * CMAC subkeys of the keys used for the frame MIC
      */
-    AES_CMAC_CTX AesCmacCtx[1];
+    CmacSubkeys_t CmacSubkeyList[NUM_OF_CMAC_SUBKEYS];
+}SecureElementNvCtx_t;
+
+/*
+ * Expanded key schedule cache entry
+ */
+typedef struct sKeySchedule
+{
     /*
-     * Key List
+     * Identifier of the cached key, NO_KEY if the entry is unused
      */
-    Key_t KeyList[NUM_OF_KEYS];
-}SecureElementNvCtx_t;
+    KeyIdentifier_t KeyID;
+    /*
+     * Usage stamp of the last lookup, used to evict the least recently used entry
+     */
+    uint32_t LastUse;
+    /*
+     * CMAC computation context. Its rijndael member holds the expanded key
+     * schedule which is used for plain AES encryption as well.
+     */
+    AES_CMAC_CTX AesCmacCtx;
+}KeySchedule_t;
 
 /*
  * Module context
  */
 static SecureElementNvCtx_t SeNvmCtx;
 
+/*
+ * Expanded key schedules. Kept out of the non volatile context since they
+ * can always be recomputed from the key list.
+ */
+static KeySchedule_t KeySchedules[NUM_OF_KEY_SCHEDULES];
+
+/*
+ * Usage counter of the key schedule cache
+ */
+static uint32_t KeyScheduleUseCnt;
+
 static SecureElementNvmEvent SeNvmCtxChanged;
 
 /*
@@ -107,6 +168,102 @@ SecureElementStatus_t GetKeyByID( KeyIdentifier_t keyID, Key_t** keyItem )
     return SECURE_ELEMENT_ERROR_INVALID_KEY_ID;
 }
 
+/*
+ * Gets the CMAC subkeys item of a key.
+ *
+ * \param[IN]  keyID          - Key identifier
+ * \retval                    - Subkeys item, NULL if no subkeys are kept for the key
+ */
+static CmacSubkeys_t* GetCmacSubkeys( KeyIdentifier_t keyID )
+{
+    for( uint8_t i = 0; i < NUM_OF_CMAC_SUBKEYS; i++ )
+    {
+        if( SeNvmCtx.CmacSubkeyList[i].KeyID == keyID )
+        {
+            return &SeNvmCtx.CmacSubkeyList[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Computes and stores the CMAC subkeys of a key, if the key has subkeys
+ * kept in the list.
+ *
+ * \param[IN]  keyID          - Key identifier
+ * \param[IN]  cmacCtx        - CMAC context holding the key schedule of the key
+ */
+static void UpdateCmacSubkeys( KeyIdentifier_t keyID, AES_CMAC_CTX* cmacCtx )
+{
+    CmacSubkeys_t* subkeys = GetCmacSubkeys( keyID );
+
+    if( subkeys != NULL )
+    {
+        AES_CMAC_Subkeys( cmacCtx, subkeys->K1, subkeys->K2 );
+        subkeys->IsValid = true;
+    }
+}
+
+/*
+ * Drops the cached key schedule of the given key identifier.
+ *
+ * \param[IN]  keyID          - Key identifier, NO_KEY to drop all entries
+ */
+static void InvalidateKeySchedule( KeyIdentifier_t keyID )
+{
+    for( uint8_t i = 0; i < NUM_OF_KEY_SCHEDULES; i++ )
+    {
+        if( ( keyID == NO_KEY ) || ( KeySchedules[i].KeyID == keyID ) )
+        {
+            memset1( ( uint8_t* ) &KeySchedules[i], 0, sizeof( KeySchedule_t ) );
+            KeySchedules[i].KeyID = NO_KEY;
+        }
+    }
+}
+
+/*
+ * Gets the expanded key schedule of a key. On a cache miss the key is
+ * expanded into the least recently used entry.
+ *
+ * \param[IN]  keyID          - Key identifier
+ * \param[OUT] cmacCtx        - CMAC context holding the key schedule
+ * \retval                    - Status of the operation
+ */
+static SecureElementStatus_t GetKeySchedule( KeyIdentifier_t keyID, AES_CMAC_CTX** cmacCtx )
+{
+    Key_t* keyItem;
+    SecureElementStatus_t retval = GetKeyByID( keyID, &keyItem );
+
+    if( retval != SECURE_ELEMENT_SUCCESS )
+    {
+        return retval;
+    }
+
+    KeySchedule_t* entry = &KeySchedules[0];
+
+    for( uint8_t i = 0; i < NUM_OF_KEY_SCHEDULES; i++ )
+    {
+        if( KeySchedules[i].KeyID == keyID )
+        {
+            entry = &KeySchedules[i];
+            entry->LastUse = ++KeyScheduleUseCnt;
+            *cmacCtx = &entry->AesCmacCtx;
+            return SECURE_ELEMENT_SUCCESS;
+        }
+        if( KeySchedules[i].LastUse < entry->LastUse )
+        {
+            entry = &KeySchedules[i];
+        }
+    }
+
+    AES_CMAC_SetKey( &entry->AesCmacCtx, keyItem->KeyValue );
+    entry->KeyID = keyID;
+    entry->LastUse = ++KeyScheduleUseCnt;
+    *cmacCtx = &entry->AesCmacCtx;
+
+    return SECURE_ELEMENT_SUCCESS;
+}
+
 /*
  * Dummy callback in case if the user provides NULL function pointer
  */
@@ -115,6 +272,36 @@ static void DummyCB( void )
     return;
 }
 
+/*
+ * Finishes a CMAC computation, using the precomputed subkeys if the key has any
+ *
+ * \param[IN]  keyID          - Key identifier of the CMAC key
+ * \param[IN]  cmacCtx        - CMAC context
+ * \retval                    - Computed cmac
+ */
+static uint32_t FinalizeCmac( KeyIdentifier_t keyID, AES_CMAC_CTX* cmacCtx )
+{
+    uint8_t Cmac[16];
+    CmacSubkeys_t* subkeys = GetCmacSubkeys( keyID );
+
+    if( subkeys != NULL )
+    {
+        if( subkeys->IsValid == false )
+        {
+            // Key was not derived by SecureElementDeriveAndStoreKey, e.g. ABP
+            UpdateCmacSubkeys( keyID, cmacCtx );
+        }
+        AES_CMAC_FinalSubkeys( Cmac, cmacCtx, subkeys->K1, subkeys->K2 );
+    }
+    else
+    {
+        AES_CMAC_Final( Cmac, cmacCtx );
+    }
+
+    // Bring into the required format
+    return ( uint32_t )( ( uint32_t ) Cmac[3] << 24 | ( uint32_t ) Cmac[2] << 16 | ( uint32_t ) Cmac[1] << 8 | ( uint32_t ) Cmac[0] );
+}
+
 /*
  * Computes a CMAC of a message using provided initial Bx block
  *
@@ -134,28 +321,21 @@ static SecureElementStatus_t ComputeCmac( uint8_t *micBxBuffer, uint8_t *buffer,
         return SECURE_ELEMENT_ERROR_NPE;
     }
 
-    uint8_t Cmac[16];
-
-    AES_CMAC_Init( SeNvmCtx.AesCmacCtx );
-
-    Key_t* keyItem;
-    SecureElementStatus_t retval = GetKeyByID( keyID, &keyItem );
+    AES_CMAC_CTX* cmacCtx;
+    SecureElementStatus_t retval = GetKeySchedule( keyID, &cmacCtx );
 
     if( retval == SECURE_ELEMENT_SUCCESS )
     {
-        AES_CMAC_SetKey( SeNvmCtx.AesCmacCtx, keyItem->KeyValue );
+        AES_CMAC_Init( cmacCtx );
 
         if( micBxBuffer != NULL )
         {
-            AES_CMAC_Update( SeNvmCtx.AesCmacCtx, micBxBuffer, 16 );
+            AES_CMAC_Update( cmacCtx, micBxBuffer, 16 );
         }
 
-        AES_CMAC_Update( SeNvmCtx.AesCmacCtx, buffer, size );
-
-        AES_CMAC_Final( Cmac, SeNvmCtx.AesCmacCtx );
+        AES_CMAC_Update( cmacCtx, buffer, size );
 
-        // Bring into the required format
-        *cmac = ( uint32_t )( ( uint32_t ) Cmac[3] << 24 | ( uint32_t ) Cmac[2] << 16 | ( uint32_t ) Cmac[1] << 8 | ( uint32_t ) Cmac[0] );
+        *cmac = FinalizeCmac( keyID, cmacCtx );
     }
 
     return retval;
@@ -199,9 +379,20 @@ SecureElementStatus_t SecureElementInit( SecureElementNvmEvent seNvmCtxChanged )
     // Set standard keys
     memcpy1( SeNvmCtx.KeyList[itr].KeyValue, zeroKey, KEY_SIZE );
 
+    itr = 0;
+    SeNvmCtx.CmacSubkeyList[itr++].KeyID = F_NWK_S_INT_KEY;
+    SeNvmCtx.CmacSubkeyList[itr++].KeyID = S_NWK_S_INT_KEY;
+    SeNvmCtx.CmacSubkeyList[itr].KeyID = NWK_S_ENC_KEY;
+    for( itr = 0; itr < NUM_OF_CMAC_SUBKEYS; itr++ )
+    {
+        SeNvmCtx.CmacSubkeyList[itr].IsValid = false;
+    }
+
     memset1( SeNvmCtx.DevEui, 0, SE_EUI_SIZE );
     memset1( SeNvmCtx.JoinEui, 0, SE_EUI_SIZE );
 
+    InvalidateKeySchedule( NO_KEY );
+
     // Assign callback
     if( seNvmCtxChanged != 0 )
     {
@@ -221,6 +412,7 @@ SecureElementStatus_t SecureElementRestoreNvmCtx( void* seNvmCtx )
     if( seNvmCtx != 0 )
     {
         memcpy1( ( uint8_t* ) &SeNvmCtx, ( uint8_t* ) seNvmCtx, sizeof( SeNvmCtx ) );
+        InvalidateKeySchedule( NO_KEY );
         return SECURE_ELEMENT_SUCCESS;
     }
     else
@@ -246,6 +438,14 @@ SecureElementStatus_t SecureElementSetKey( KeyIdentifier_t keyID, uint8_t* key )
     {
         if( SeNvmCtx.KeyList[i].KeyID == keyID )
         {
+            InvalidateKeySchedule( keyID );
+
+            CmacSubkeys_t* subkeys = GetCmacSubkeys( keyID );
+            if( subkeys != NULL )
+            {
+                subkeys->IsValid = false;
+            }
+
             if( ( keyID == MC_KEY_0 ) || ( keyID == MC_KEY_1 ) || ( keyID == MC_KEY_2 ) || ( keyID == MC_KEY_3 ) )
             {  // Decrypt the key if its a Mckey
                 SecureElementStatus_t retval = SECURE_ELEMENT_ERROR;
@@ -317,20 +517,16 @@ SecureElementStatus_t SecureElementAesEncrypt( uint8_t* buffer, uint16_t size, K
         return SECURE_ELEMENT_ERROR_BUF_SIZE;
     }
 
-    memset1( SeNvmCtx.AesContext.ksch, '\0', 240 );
-
-    Key_t* pItem;
-    SecureElementStatus_t retval = GetKeyByID( keyID, &pItem );
+    AES_CMAC_CTX* cmacCtx;
+    SecureElementStatus_t retval = GetKeySchedule( keyID, &cmacCtx );
 
     if( retval == SECURE_ELEMENT_SUCCESS )
     {
-        aes_set_key( pItem->KeyValue, 16, &SeNvmCtx.AesContext );
-
         uint8_t block = 0;
 
         while( size != 0 )
         {
-            aes_encrypt( &buffer[block], &encBuffer[block], &SeNvmCtx.AesContext );
+            aes_encrypt( &buffer[block], &encBuffer[block], &cmacCtx->rijndael );
             block = block + 16;
             size = size - 16;
         }
@@ -338,6 +534,67 @@ SecureElementStatus_t SecureElementAesEncrypt( uint8_t* buffer, uint16_t size, K
     return retval;
 }
 
+SecureElementStatus_t SecureElementAesCtrEncryptCmac( uint8_t* micBxBuffer, uint8_t* hdr, uint16_t hdrSize, uint8_t* aBlock,
+                                                      uint8_t* buffer, uint16_t size, KeyIdentifier_t encKeyID,
+                                                      KeyIdentifier_t micKeyID, uint8_t* encBuffer, uint32_t* cmac )
+{
+    if( ( micBxBuffer == NULL ) || ( hdr == NULL ) || ( aBlock == NULL ) ||
+        ( buffer == NULL ) || ( encBuffer == NULL ) || ( cmac == NULL ) )
+    {
+        return SECURE_ELEMENT_ERROR_NPE;
+    }
+
+    if( micKeyID >= LORAMAC_CRYPTO_MULTICAST_KEYS )
+    {
+        //Never accept multicast key identifier for cmac computation
+        return SECURE_ELEMENT_ERROR_INVALID_KEY_ID;
+    }
+
+    // The cmac key schedule is looked up first. Being the most recently used
+    // entry it can't be evicted by the lookup of the encryption key.
+    AES_CMAC_CTX* cmacCtx;
+    AES_CMAC_CTX* encCtx;
+    SecureElementStatus_t retval = GetKeySchedule( micKeyID, &cmacCtx );
+
+    if( retval != SECURE_ELEMENT_SUCCESS )
+    {
+        return retval;
+    }
+    retval = GetKeySchedule( encKeyID, &encCtx );
+    if( retval != SECURE_ELEMENT_SUCCESS )
+    {
+        return retval;
+    }
+
+    AES_CMAC_Init( cmacCtx );
+    AES_CMAC_Update( cmacCtx, micBxBuffer, 16 );
+    AES_CMAC_Update( cmacCtx, hdr, hdrSize );
+
+    uint8_t sBlock[16];
+    uint16_t bufferIndex = 0;
+
+    while( size > 0 )
+    {
+        uint8_t blockSize = ( size > 16 ) ? 16 : size;
+
+        aes_encrypt( aBlock, sBlock, &encCtx->rijndael );
+        aBlock[15]++;
+
+        for( uint8_t i = 0; i < blockSize; i++ )
+        {
+            encBuffer[bufferIndex + i] = buffer[bufferIndex + i] ^ sBlock[i];
+        }
+        AES_CMAC_Update( cmacCtx, &encBuffer[bufferIndex], blockSize );
+
+        size -= blockSize;
+        bufferIndex += blockSize;
+    }
+
+    *cmac = FinalizeCmac( micKeyID, cmacCtx );
+
+    return SECURE_ELEMENT_SUCCESS;
+}
+
 SecureElementStatus_t SecureElementDeriveAndStoreKey( Version_t version, uint8_t* input, KeyIdentifier_t rootKeyID, KeyIdentifier_t targetKeyID )
 {
     if( input == NULL )
@@ -371,6 +628,20 @@ SecureElementStatus_t SecureElementDeriveAndStoreKey( Version_t version, uint8_t
         return retval;
     }
 
+    // Precompute the CMAC subkeys of the session keys used for the frame MIC
+    if( GetCmacSubkeys( targetKeyID ) != NULL )
+    {
+        AES_CMAC_CTX* cmacCtx;
+
+        retval = GetKeySchedule( targetKeyID, &cmacCtx );
+        if( retval != SECURE_ELEMENT_SUCCESS )
+        {
+            return retval;
+        }
+        UpdateCmacSubkeys( targetKeyID, cmacCtx );
+        SeNvmCtxChanged( );
+    }
+
     return SECURE_ELEMENT_SUCCESS;
 }
 
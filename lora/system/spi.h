@@ -97,4 +97,18 @@ void SpiFrequency( Spi_t *obj, uint32_t hz );
  */
 uint16_t SpiInOut( Spi_t *obj, uint16_t outData );
 
+/*!
+ * \brief Sends and receives a block of bytes in a single burst, returns
+ *        once the transfer is complete
+ *
+ * \remark NSS is left to the caller, as for \ref SpiInOut.
+ *
+ * \param [IN] obj      SPI object
+ * \param [IN] out      Bytes to be sent, NULL to send zeros
+ * \param [OUT] in      Received bytes, NULL to drop them. One of out and in
+ *                      must be set.
+ * \param [IN] size     Number of bytes
+ */
+void SpiTransfer( Spi_t *obj, const uint8_t *out, uint8_t *in, uint16_t size );
+
 #endif // __SPI_H__
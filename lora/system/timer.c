@@ -42,56 +42,87 @@
     }while( 0 );
 
 /*!
- * Timers list head pointer
+ * Timers queue, a binary min-heap ordered by expiry time. The head always
+ * contains the next timer to expire.
  */
-static TimerEvent_t *TimerListHead = NULL;
+static TimerEvent_t *TimerQueue[TIMER_QUEUE_SIZE];
 
 /*!
- * \brief Adds or replace the head timer of the list.
+ * Number of timers in the queue
+ */
+static uint8_t TimerQueueLength = 0;
+
+/*!
+ * Timer the RTC alarm was last set for
+ */
+static TimerEvent_t *TimerArmed = NULL;
+
+/*!
+ * RTC time of the last capture
+ */
+static uint32_t TimerCaptureTime = 0;
+
+/*!
+ * Is there a capture not read yet
+ */
+static bool TimerCapturePending = false;
+
+/*!
+ * \brief Checks if a timer expires before another one
  *
- * \remark The list is automatically sorted. The list head always contains the
- *         next timer to expire.
+ * \remark Timestamps are absolute and wrap around, so they are compared
+ *         through their difference.
  *
- * \param [IN]  obj Timer object to be become the new head
- * \param [IN]  remainingTime Remaining time of the previous head to be replaced
+ * \param [IN] a Timer object
+ * \param [IN] b Timer object
+ * \retval true if a expires before b
  */
-static void TimerInsertNewHeadTimer( TimerEvent_t *obj );
+static bool TimerIsBefore( const TimerEvent_t *a, const TimerEvent_t *b );
 
 /*!
- * \brief Adds a timer to the list.
+ * \brief Places a timer at a position of the queue
  *
- * \remark The list is automatically sorted. The list head always contains the
- *         next timer to expire.
+ * \param [IN] obj   Timer object
+ * \param [IN] index Position in the queue
+ */
+static void TimerQueueSet( TimerEvent_t *obj, uint8_t index );
+
+/*!
+ * \brief Moves a timer towards the head until the queue is ordered
  *
- * \param [IN]  obj Timer object to be added to the list
- * \param [IN]  remainingTime Remaining time of the running head after which the object may be added
+ * \param [IN] index Position of the timer in the queue
  */
-static void TimerInsertTimer( TimerEvent_t *obj );
+static void TimerQueueSiftUp( uint8_t index );
 
 /*!
- * \brief Sets a timeout with the duration "timestamp"
+ * \brief Moves a timer away from the head until the queue is ordered
  *
- * \param [IN] timestamp Delay duration
+ * \param [IN] index Position of the timer in the queue
  */
-static void TimerSetTimeout( TimerEvent_t *obj );
+static void TimerQueueSiftDown( uint8_t index );
+
+/*!
+ * \brief Removes a timer from the queue
+ *
+ * \param [IN] obj Timer object to be removed, it must be in the queue
+ */
+static void TimerQueueRemove( TimerEvent_t *obj );
 
 /*!
- * \brief Check if the Object to be added is not already in the list
+ * \brief Sets the RTC alarm for the expiry of a timer
  *
- * \param [IN] timestamp Delay duration
- * \retval true (the object is already in the list) or false
+ * \param [IN] obj Timer object, the head of the queue
  */
-static bool TimerExists( TimerEvent_t *obj );
+static void TimerSetTimeout( TimerEvent_t *obj );
 
 void TimerInit( TimerEvent_t *obj, void ( *callback )( void *context ) )
 {
     obj->Timestamp = 0;
     obj->ReloadValue = 0;
     obj->IsStarted = false;
-    obj->IsNext2Expire = false;
+    obj->Index = 0;
     obj->Callback = callback;
     obj->Context = NULL;
-    obj->Next = NULL;
 }
 
 void TimerSetContext( TimerEvent_t *obj, void* context )
@@ -101,78 +132,111 @@ void TimerSetContext( TimerEvent_t *obj, void* context )
 
 void TimerStart( TimerEvent_t *obj )
 {
-    uint32_t elapsedTime = 0;
-
     CRITICAL_SECTION_BEGIN( );
 
-    if( ( obj == NULL ) || ( TimerExists( obj ) == true ) )
+    if( ( obj == NULL ) || ( obj->IsStarted == true ) )
     {
         CRITICAL_SECTION_END( );
         return;
     }
 
-    obj->Timestamp = obj->ReloadValue;
+    if( TimerQueueLength >= TIMER_QUEUE_SIZE )
+    {
+        // More timers than TimerInit call sites, see TIMER_QUEUE_SIZE
+        while( 1 );
+    }
+
+    obj->Timestamp = RtcGetTimerValue( ) + obj->ReloadValue;
     obj->IsStarted = true;
-    obj->IsNext2Expire = false;
 
-    if( TimerListHead == NULL )
+    TimerQueueSet( obj, TimerQueueLength++ );
+    TimerQueueSiftUp( obj->Index );
+
+    if( obj->Index == 0 )
     {
-        RtcSetTimerContext( );
-        // Inserts a timer at time now + obj->Timestamp
-        TimerInsertNewHeadTimer( obj );
+        TimerSetTimeout( obj );
     }
-    else
-    {
-        elapsedTime = RtcGetTimerElapsedTime( );
-        obj->Timestamp += elapsedTime;
+    CRITICAL_SECTION_END( );
+}
 
-        if( obj->Timestamp < TimerListHead->Timestamp )
-        {
-            TimerInsertNewHeadTimer( obj );
-        }
-        else
+static bool TimerIsBefore( const TimerEvent_t *a, const TimerEvent_t *b )
+{
+    // Intentional wrap around
+    return ( int32_t )( a->Timestamp - b->Timestamp ) < 0;
+}
+
+static void TimerQueueSet( TimerEvent_t *obj, uint8_t index )
+{
+    TimerQueue[index] = obj;
+    obj->Index = index;
+}
+
+static void TimerQueueSiftUp( uint8_t index )
+{
+    TimerEvent_t* obj = TimerQueue[index];
+    uint8_t parent;
+
+    while( index > 0 )
+    {
+        parent = ( index - 1 ) / 2;
+        if( TimerIsBefore( obj, TimerQueue[parent] ) == false )
         {
-            TimerInsertTimer( obj );
+            break;
         }
+        TimerQueueSet( TimerQueue[parent], index );
+        index = parent;
     }
-    CRITICAL_SECTION_END( );
+    TimerQueueSet( obj, index );
 }
 
-static void TimerInsertTimer( TimerEvent_t *obj )
+static void TimerQueueSiftDown( uint8_t index )
 {
-    TimerEvent_t* cur = TimerListHead;
-    TimerEvent_t* next = TimerListHead->Next;
+    TimerEvent_t* obj = TimerQueue[index];
+    uint8_t child;
 
-    while( cur->Next != NULL )
+    while( ( child = 2 * index + 1 ) < TimerQueueLength )
     {
-        if( obj->Timestamp > next->Timestamp )
+        if( ( ( child + 1 ) < TimerQueueLength ) &&
+            ( TimerIsBefore( TimerQueue[child + 1], TimerQueue[child] ) == true ) )
         {
-            cur = next;
-            next = next->Next;
+            child++;
         }
-        else
+        if( TimerIsBefore( TimerQueue[child], obj ) == false )
         {
-            cur->Next = obj;
-            obj->Next = next;
-            return;
+            break;
         }
+        TimerQueueSet( TimerQueue[child], index );
+        index = child;
     }
-    cur->Next = obj;
-    obj->Next = NULL;
+    TimerQueueSet( obj, index );
 }
 
-static void TimerInsertNewHeadTimer( TimerEvent_t *obj )
+static void TimerQueueRemove( TimerEvent_t *obj )
 {
-    TimerEvent_t* cur = TimerListHead;
+    uint8_t index = obj->Index;
 
-    if( cur != NULL )
+    obj->IsStarted = false;
+    if( obj == TimerArmed )
+    {
+        TimerArmed = NULL;
+    }
+
+    TimerQueueLength--;
+    if( index == TimerQueueLength )
     {
-        cur->IsNext2Expire = false;
+        return;
     }
 
-    obj->Next = cur;
-    TimerListHead = obj;
-    TimerSetTimeout( TimerListHead );
+    // Fill the hole with the last timer and restore the order around it
+    TimerQueueSet( TimerQueue[TimerQueueLength], index );
+    if( ( index > 0 ) && ( TimerIsBefore( TimerQueue[index], TimerQueue[( index - 1 ) / 2] ) == true ) )
+    {
+        TimerQueueSiftUp( index );
+    }
+    else
+    {
+        TimerQueueSiftDown( index );
+    }
 }
 
 bool TimerIsStarted( TimerEvent_t *obj )
@@ -183,52 +247,28 @@ bool TimerIsStarted( TimerEvent_t *obj )
 void TimerIrqHandler( void )
 {
     TimerEvent_t* cur;
-    TimerEvent_t* next;
-
-    uint32_t old =  RtcGetTimerContext( );
-    uint32_t now =  RtcSetTimerContext( );
-    uint32_t deltaContext = now - old; // intentional wrap around
-
-    // Update timeStamp based upon new Time Reference
-    // because delta context should never exceed 2^32
-    if( TimerListHead != NULL )
-    {
-        for( cur = TimerListHead; cur->Next != NULL; cur = cur->Next )
-        {
-            next = cur->Next;
-            if( next->Timestamp > deltaContext )
-            {
-                next->Timestamp -= deltaContext;
-            }
-            else
-            {
-                next->Timestamp = 0;
-            }
-        }
-    }
 
     // Execute immediately the alarm callback
-    if ( TimerListHead != NULL )
+    if( TimerQueueLength > 0 )
     {
-        cur = TimerListHead;
-        TimerListHead = TimerListHead->Next;
-        cur->IsStarted = false;
+        cur = TimerQueue[0];
+        TimerQueueRemove( cur );
         ExecuteCallBack( cur->Callback, cur->Context );
     }
 
-    // Remove all the expired object from the list
-    while( ( TimerListHead != NULL ) && ( TimerListHead->Timestamp < RtcGetTimerElapsedTime( ) ) )
+    // Remove all the expired object from the queue
+    while( ( TimerQueueLength > 0 ) &&
+           ( ( int32_t )( RtcGetTimerValue( ) - TimerQueue[0]->Timestamp ) > 0 ) )
     {
-        cur = TimerListHead;
-        TimerListHead = TimerListHead->Next;
-        cur->IsStarted = false;
+        cur = TimerQueue[0];
+        TimerQueueRemove( cur );
         ExecuteCallBack( cur->Callback, cur->Context );
     }
 
-    // Start the next TimerListHead if it exists AND NOT running
-    if( ( TimerListHead != NULL ) && ( TimerListHead->IsNext2Expire == false ) )
+    // Start the next head if the callbacks did not already
+    if( ( TimerQueueLength > 0 ) && ( TimerQueue[0] != TimerArmed ) )
     {
-        TimerSetTimeout( TimerListHead );
+        TimerSetTimeout( TimerQueue[0] );
     }
 }
 
@@ -236,89 +276,32 @@ void TimerStop( TimerEvent_t *obj )
 {
     CRITICAL_SECTION_BEGIN( );
 
-    TimerEvent_t* prev = TimerListHead;
-    TimerEvent_t* cur = TimerListHead;
-
-    // List is empty or the obj to stop does not exist
-    if( ( TimerListHead == NULL ) || ( obj == NULL ) )
+    // The obj to stop is not in the queue
+    if( ( obj == NULL ) || ( obj->IsStarted == false ) )
     {
         CRITICAL_SECTION_END( );
         return;
     }
 
-    obj->IsStarted = false;
-
-    if( TimerListHead == obj ) // Stop the Head
+    if( obj == TimerArmed ) // Stop the running head
     {
-        if( TimerListHead->IsNext2Expire == true ) // The head is already running
+        TimerQueueRemove( obj );
+        if( TimerQueueLength > 0 )
         {
-            TimerListHead->IsNext2Expire = false;
-            if( TimerListHead->Next != NULL )
-            {
-                TimerListHead = TimerListHead->Next;
-                TimerSetTimeout( TimerListHead );
-            }
-            else
-            {
-                RtcStopAlarm( );
-                TimerListHead = NULL;
-            }
+            TimerSetTimeout( TimerQueue[0] );
         }
-        else // Stop the head before it is started
+        else
         {
-            if( TimerListHead->Next != NULL )
-            {
-                TimerListHead = TimerListHead->Next;
-            }
-            else
-            {
-                TimerListHead = NULL;
-            }
+            RtcStopAlarm( );
         }
     }
-    else // Stop an object within the list
+    else
     {
-        while( cur != NULL )
-        {
-            if( cur == obj )
-            {
-                if( cur->Next != NULL )
-                {
-                    cur = cur->Next;
-                    prev->Next = cur;
-                }
-                else
-                {
-                    cur = NULL;
-                    prev->Next = cur;
-                }
-                break;
-            }
-            else
-            {
-                prev = cur;
-                cur = cur->Next;
-            }
-        }
+        TimerQueueRemove( obj );
     }
     CRITICAL_SECTION_END( );
 }
 
-static bool TimerExists( TimerEvent_t *obj )
-{
-    TimerEvent_t* cur = TimerListHead;
-
-    while( cur != NULL )
-    {
-        if( cur == obj )
-        {
-            return true;
-        }
-        cur = cur->Next;
-    }
-    return false;
-}
-
 void TimerReset( TimerEvent_t *obj )
 {
     TimerStop( obj );
@@ -343,6 +326,22 @@ void TimerSetValue( TimerEvent_t *obj, uint32_t value )
     obj->ReloadValue = ticks;
 }
 
+void TimerSetValueUs( TimerEvent_t *obj, uint32_t value )
+{
+    uint32_t hz = RtcMs2Tick( 1000 );
+    uint32_t ticks = ( uint32_t )( ( ( uint64_t )value * hz + 500000 ) / 1000000 );
+
+    TimerStop( obj );
+
+    if( ticks < RtcGetMinimumTimeout( ) )
+    {
+        ticks = RtcGetMinimumTimeout( );
+    }
+
+    obj->Timestamp = ticks;
+    obj->ReloadValue = ticks;
+}
+
 TimerTime_t TimerGetCurrentTime( void )
 {
     uint32_t now = RtcGetTimerValue( );
@@ -362,17 +361,43 @@ TimerTime_t TimerGetElapsedTime( TimerTime_t past )
     return RtcTick2Ms( nowInTicks - pastInTicks );
 }
 
+uint32_t TimerGetCurrentTimeUs( void )
+{
+    return ( uint32_t )( ( uint64_t )RtcGetTimerValue( ) * 1000000 / RtcMs2Tick( 1000 ) );
+}
+
+void TimerCapture( void )
+{
+    TimerCaptureTime = RtcGetTimerValue( );
+    TimerCapturePending = true;
+}
+
+bool TimerGetCapture( uint32_t *time )
+{
+    bool pending;
+
+    CRITICAL_SECTION_BEGIN( );
+    pending = TimerCapturePending;
+    TimerCapturePending = false;
+    *time = ( uint32_t )( ( uint64_t )TimerCaptureTime * 1000000 / RtcMs2Tick( 1000 ) );
+    CRITICAL_SECTION_END( );
+    return pending;
+}
+
 static void TimerSetTimeout( TimerEvent_t *obj )
 {
-    int32_t minTicks= RtcGetMinimumTimeout( );
-    obj->IsNext2Expire = true;
+    uint32_t minTicks = RtcGetMinimumTimeout( );
+    // The alarm is relative to the timer context
+    int32_t timeout = ( int32_t )( obj->Timestamp - RtcSetTimerContext( ) );
+
+    TimerArmed = obj;
 
     // In case deadline too soon
-    if( obj->Timestamp  < ( RtcGetTimerElapsedTime( ) + minTicks ) )
+    if( timeout < ( int32_t )minTicks )
     {
-        obj->Timestamp = RtcGetTimerElapsedTime( ) + minTicks;
+        timeout = minTicks;
     }
-    RtcSetAlarm( obj->Timestamp );
+    RtcSetAlarm( timeout );
 }
 
 TimerTime_t TimerTempCompensation( TimerTime_t period, float temperature )
@@ -32,15 +32,27 @@
  */
 typedef struct TimerEvent_s
 {
-    uint32_t Timestamp;                  //! Current timer value
+    uint32_t Timestamp;                  //! RTC time of expiry while started
     uint32_t ReloadValue;                //! Timer delay value
-    bool IsStarted;                      //! Is the timer currently running
-    bool IsNext2Expire;                  //! Is the next timer to expire
+    bool IsStarted;                      //! Is the timer currently in the queue
+    uint8_t Index;                       //! Position in the timer queue while started
     void ( *Callback )( void* context ); //! Timer IRQ callback function
     void *Context;                       //! User defined data object pointer to pass back
-    struct TimerEvent_s *Next;           //! Pointer to the next Timer object.
 }TimerEvent_t;
 
+/*!
+ * \brief Maximum number of timers started at the same time
+ *
+ * \remark A timer is queued at most once, so the bound is the number of
+ *         timers initialized with TimerInit. The stack has 10: 4 in
+ *         LoRaMacInitialization, 3 in LoRaMacClassBInit and 3 in SX1276Init.
+ *         Raise it with any new timer beyond 16, TimerStart halts on
+ *         overflow.
+ */
+#ifndef TIMER_QUEUE_SIZE
+#define TIMER_QUEUE_SIZE                            16
+#endif
+
 /*!
  * \brief Timer time variable definition
  */
@@ -107,11 +119,24 @@ void TimerReset( TimerEvent_t *obj );
 /*!
  * \brief Set timer new timeout value
  *
+ * \remark Timers expire at absolute RTC times, so the timeout must stay
+ *         below 2^31 RTC ticks.
+ *
  * \param [IN] obj   Structure containing the timer object parameters
  * \param [IN] value New timer timeout value
  */
 void TimerSetValue( TimerEvent_t *obj, uint32_t value );
 
+/*!
+ * \brief Set timer new timeout value in microseconds
+ *
+ * \remark The timeout is rounded to the nearest RTC tick.
+ *
+ * \param [IN] obj   Structure containing the timer object parameters
+ * \param [IN] value New timer timeout value in us
+ */
+void TimerSetValueUs( TimerEvent_t *obj, uint32_t value );
+
 /*!
  * \brief Read the current time
  *
@@ -119,6 +144,34 @@ void TimerSetValue( TimerEvent_t *obj, uint32_t value );
  */
 TimerTime_t TimerGetCurrentTime( void );
 
+/*!
+ * \brief Read the current time in microseconds
+ *
+ * \remark The time wraps around and is meant for differences below 35
+ *         minutes. It has the resolution of the RTC and jumps once each
+ *         time the RTC counter wraps around.
+ *
+ * \retval time returns current time in us
+ */
+uint32_t TimerGetCurrentTimeUs( void );
+
+/*!
+ * \brief Captures the current time
+ *
+ * \remark Called by the board in the interrupt handler of an event to be
+ *         timestamped, ahead of the task latency.
+ */
+void TimerCapture( void );
+
+/*!
+ * \brief Returns the time of the last capture
+ *
+ * \param [OUT] time Time of the capture in us, see \ref TimerGetCurrentTimeUs
+ *
+ * \retval status true if there was a capture since the previous call
+ */
+bool TimerGetCapture( uint32_t *time );
+
 /*!
  * \brief Return the Time elapsed since a fix moment in Time
  *
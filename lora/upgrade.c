@@ -6,6 +6,8 @@
 
 #include "hw/led.h"
 #include "ble/ble.h"
+#include "lora/lora.h"
+#include "lora/nvmctx.h"
 #include "lora/param.h"
 #include "lora/util.h"
 
@@ -38,6 +40,16 @@ do_reboot(OS_TIMER timer)
     OS_TIMER_START(timer, OS_TIMER_FOREVER);
     return;
   }
+  /* The LoRa task owns the contexts being written */
+  lora_task_notify_event(EVENT_NOTIF_REBOOT, NULL);
+}
+
+/* Write what is pending to flash and reboot, from the LoRa task */
+void
+upgrade_reboot_now(void)
+{
+  nvmctx_flush();
+  param_commit();
   hw_cpm_reboot_system();
 }
 
@@ -4,6 +4,7 @@
 #define UPGRADE_DEFAULT	0x81
 
 void	upgrade_reboot(uint8_t flags);
+void	upgrade_reboot_now(void);
 void	upgrade_init(void);
 
 #endif /* __UPGRADE_H__ */
@@ -1,5 +1,7 @@
+#include <stdio.h>
 #include <string.h>
 #include <limits.h>
+#include <time.h>
 
 #include <hw_gpio.h>
 #include <hw_uart.h>
@@ -9,8 +11,12 @@
 #include "hw/hw.h"
 #include "hw/power.h"
 #include "lora/lora.h"
+#include "lora/param.h"
 #include "lora/util.h"
+#include "lora/system/systime.h"
 #include "gps.h"
+#include "motion.h"
+#include "nmea.h"
 
 #ifdef FEATURE_SENSOR_GPS
 
@@ -18,13 +24,20 @@
 
 #ifdef DEBUG
 //#define DEBUG_GSV
-#include <stdio.h>
-#include <unistd.h>
 #endif
 
-PRIVILEGED_DATA static char	rxbuf[128];
-PRIVILEGED_DATA static int	rxlen;
-PRIVILEGED_DATA static OS_TIMER gps_rx_timer;
+/*
+ * The UART interrupt feeds the received characters to the NMEA parser,
+ * which fills one sentence while the task reads the one before. A
+ * complete sentence of interest is handed over by swapping the two, and
+ * the task is woken once per sentence. One completed while the task
+ * still holds the previous one is dropped.
+ */
+PRIVILEGED_DATA static struct nmea		nmea;
+PRIVILEGED_DATA static struct nmea_sentence	sentences[2];
+PRIVILEGED_DATA static struct nmea_sentence	*rx_sentence;
+PRIVILEGED_DATA static volatile uint8_t		rx_ready;
+PRIVILEGED_DATA static uint32_t			rx_dropped;
 
 /* $GPGGA,155058.000,,,,,0,0,,,M,,M,,*44 */
 /* $GPGGA,135704.000,5231.1618,N,01324.2888,E,1,3,5.64,105.3,M,44.7,M,,*59 */
@@ -83,21 +96,8 @@ PRIVILEGED_DATA uint8_t   sats;
 #define SATS_DONE 2
 PRIVILEGED_DATA static uint8_t  sats_status;
 
-static const char gpgsv[] = "$GPGSV";
-
-#define MAX_FIELDS  (GPGSV_SAT_BASE + GPGSV_SAT_FIELDS * GPGSV_MAX_SAT)
-
-#else
-
-#define MAX_FIELDS	(GPGGA_STATION_ID + 1)
-
 #endif
 
-struct datapart {
-  char	*s;
-  int	len;
-};
-
 struct gps_fix {
   uint8_t	fix;
   int32_t	lat;	/* Positive: North */
@@ -110,41 +110,76 @@ PRIVILEGED_DATA static struct gps_fix	last_fix;
 #define STATUS_CONNECTED          0x01
 #define STATUS_GPS_INFO_RECEIVED  0x02
 #define STATUS_GPS_FIX_FOUND      0x04
+#define STATUS_GPS_FIX_GOOD       0x08	/* of the quality asked for */
+#define STATUS_GPS_DONE           0x10	/* acquisition over */
+#define STATUS_GPS_SKIPPED        0x20	/* node stationary */
+#define STATUS_GPS_AIDED          0x40	/* aiding data sent */
 PRIVILEGED_DATA static uint8_t	status;
 
-static const char	hex[] = {
-  '0', '1', '2', '3', '4', '5', '6', '7',
-  '8', '9', 'A', 'B', 'C', 'D', 'E', 'F',
-};
-static const char	crlf[] = { '\r', '\n', };
-static const char	gpgga[] = "$GPGGA";
-
-static bool
-valid_crc(char *msg, int len)
-{
-  char	*p;
-  int	 ccrc, icrc; /* computed and indicated CRCs */
-
-  if (*msg != '$')
-    return false;
-  /* String must end with "*XX\r\n", where XX are two hex digits. */
-  p = memchr(msg, '*', len);
-  if (p != msg + len - 5)
-    return false;
-  if (memcmp(msg + len - sizeof(crlf), crlf, sizeof(crlf)) != 0)
-    return false;
-  if ((p = memchr(hex, msg[len - 4], sizeof(hex))) == NULL)
-    return false;
-  icrc = (p - hex) << 4;
-  if ((p = memchr(hex, msg[len - 3], sizeof(hex))) == NULL)
-    return false;
-  icrc |= p - hex;
-  ccrc = 0;
-  for (p = msg + 1; p < msg + len - 5; p++) {
-    ccrc ^= *p;
-  }
-  return ccrc == icrc;
-}
+/*
+ * An acquisition ends with the first fix of the quality of the GPS
+ * quality parameter, or once its time budget is spent. The fix read is
+ * the one with the lowest HDOP so far. The parameter holds the minimum
+ * satellites in use, the maximum HDOP and the budget in seconds, a byte
+ * of 0 takes the default.
+ */
+#define GPS_MIN_SATS	4
+#define GPS_MAX_HDOP	50	/* 1/10 */
+#define GPS_BUDGET	2	/* s */
+#define HDOP_UNKNOWN	UINT8_MAX
+
+PRIVILEGED_DATA static uint8_t		fix_sats, fix_hdop;	/* of last_fix */
+PRIVILEGED_DATA static uint8_t		min_sats, max_hdop;
+PRIVILEGED_DATA static TickType_t	acq_since, acq_budget;
+PRIVILEGED_DATA static struct gps_stats	stats;
+
+/*
+ * The node is stationary once GPS_STILL_FIXES fixes in a row are within
+ * the motion threshold of the reference fix. It then skips the
+ * acquisitions and reports it is stable, a GPS sample of the 1 byte
+ * value 0, until the accelerometer tells it moved, and at least every
+ * recheck periods to catch the moves an accelerometer missed or cannot
+ * see. The motion parameter holds the threshold in metres and the
+ * recheck periods, a byte of 0 takes the default.
+ */
+#define GPS_MOTION_THS	50	/* m */
+#define GPS_RECHECK	16	/* periods */
+#define GPS_STILL_FIXES	2
+
+PRIVILEGED_DATA static struct gps_fix	ref_fix;
+PRIVILEGED_DATA static uint8_t		still_fixes;	/* near ref_fix */
+PRIVILEGED_DATA static uint8_t		skipped;	/* periods in a row */
+
+/*
+ * Aiding. The sensor supply is off between the acquisitions, so the
+ * receiver starts cold every time. Once it is up, that is with its
+ * first sentence, it is sent the last good fix and the UTC time
+ * (PMTK741, or PMTK740 for the time alone). The time is the network
+ * time of DeviceTimeAns, which SysTime keeps, corrected by the UTC time
+ * of the GGA sentence of each good fix. GGA has no date, so without a
+ * network time the receiver is not aided.
+ */
+#define GPS_LEAP_SECONDS	18	/* GPS time ahead of UTC */
+#define GPS_TIME_RESYNC		(24 * 60 * 60)	/* s without a new time */
+#define GPS_TIME_RETRY		(60 * 60)	/* s between DeviceTimeReq */
+#define GPS_DAY			(24 * 60 * 60)
+#define TOD_UNKNOWN		-1
+
+PRIVILEGED_DATA static struct gps_fix	aid_fix;	/* last good fix */
+PRIVILEGED_DATA static int32_t		fix_tod;	/* UTC s of last_fix */
+PRIVILEGED_DATA static uint32_t		fix_systime;	/* when received */
+PRIVILEGED_DATA static int32_t		utc_offset;	/* to SysTime */
+PRIVILEGED_DATA static uint32_t		time_synced;	/* SysTime s, 0 never */
+PRIVILEGED_DATA static uint32_t		time_asked;
+
+/*
+ * The aiding sentence is sent by the UART interrupt, which refills the
+ * TX FIFO each time it empties, so the LoRa task does not wait the 70 ms
+ * it takes at 9600 baud.
+ */
+PRIVILEGED_DATA static char		tx_buf[NMEA_LEN + 5];	/* "$", "*XX\r\n" and NUL */
+PRIVILEGED_DATA static uint8_t		tx_len;
+PRIVILEGED_DATA static volatile uint8_t	tx_pos;
 
 #define MAXLAT	9000
 #define MAXLON	18000
@@ -196,23 +231,67 @@ parse_alt(char *s)
   return (m * 10 + dm) * (negate ? -1 : 1);
 }
 
+/* UTC time of day in s, TOD_UNKNOWN if absent */
+static int32_t
+parse_tod(char *s)
+{
+  const char	*errstr;
+  int32_t	 hhmmss;
+
+  if (strlen(s) < 6)
+    return TOD_UNKNOWN;
+  s[6] = '\0';
+  hhmmss = strtonum(s, 0, 235959, &errstr);
+  if (errstr || hhmmss / 100 % 100 > 59 || hhmmss % 100 > 60)
+    return TOD_UNKNOWN;
+  return hhmmss / 10000 * 3600 + hhmmss / 100 % 100 * 60 + hhmmss % 100;
+}
+
+/* HDOP in 1/10, HDOP_UNKNOWN if absent */
+static uint8_t
+parse_hdop(char *s)
+{
+  const char	*errstr;
+  char		*frac;
+  int		 i, f = 0;
+
+  if ((frac = strchr(s, '.')) != NULL) {
+    *frac++ = '\0';
+    if (*frac >= '0' && *frac <= '9')
+      f = *frac - '0';
+  }
+  i = strtonum(s, 0, (HDOP_UNKNOWN - 1) / 10, &errstr);
+  if (errstr)
+    return HDOP_UNKNOWN;
+  return i * 10 + f;
+}
+
 static void
-proc_gpgga(char *data[])
+proc_gpgga(struct nmea_sentence *s)
 {
   struct gps_fix	 fix = {};
   const char	*errstr;
+  uint8_t	 sats, hdop;
 
 #ifdef DEBUG
   printf("gga\r\n");
 #endif
-  fix.fix = strtonum(data[GPGGA_FIX], 0, 6, &errstr);
+  fix.fix = strtonum(nmea_field(s, GPGGA_FIX), 0, 6, &errstr);
   if (fix.fix) {
-    fix.lat = parse_latlon(data[GPGGA_LAT], MAXLAT,
-        data[GPGGA_NS][0] == 'S');
-    fix.lon = parse_latlon(data[GPGGA_LON], MAXLON,
-        data[GPGGA_EW][0] == 'W');
-    fix.alt = parse_alt(data[GPGGA_MSL_ALT]);
-    memcpy(&last_fix, &fix, sizeof(fix));
+    fix.lat = parse_latlon(nmea_field(s, GPGGA_LAT), MAXLAT,
+        nmea_field(s, GPGGA_NS)[0] == 'S');
+    fix.lon = parse_latlon(nmea_field(s, GPGGA_LON), MAXLON,
+        nmea_field(s, GPGGA_EW)[0] == 'W');
+    fix.alt = parse_alt(nmea_field(s, GPGGA_MSL_ALT));
+    sats = strtonum(nmea_field(s, GPGGA_SAT), 0, UINT8_MAX, &errstr);
+    hdop = parse_hdop(nmea_field(s, GPGGA_HDOP));
+    if (last_fix.fix == 0 || hdop <= fix_hdop) {
+      memcpy(&last_fix, &fix, sizeof(fix));
+      fix_sats = sats;
+      fix_hdop = hdop;
+      fix_tod = parse_tod(nmea_field(s, GPGGA_TIME));
+      fix_systime = SysTimeGet().Seconds;
+    }
   }
 }
 
@@ -227,21 +306,21 @@ gps_print_sats()
 }
 
 static void
-proc_gpgsv(char *data[], int fields)
+proc_gpgsv(struct nmea_sentence *s)
 {
   const char  *errstr;
-  int    i, msgs, msgno, tots;
+  int    i, msgs, msgno, tots, fields = s->fields;
 
 #ifdef DEBUG
   printf("gsv\r\n");
 #endif
-  msgs = strtonum(data[GPGSV_MSGS], 0, 16, &errstr);
+  msgs = strtonum(nmea_field(s, GPGSV_MSGS), 0, 16, &errstr);
   if (errstr)
     return;
-  msgno = strtonum(data[GPGSV_MSGNO], 0, 16, &errstr);
+  msgno = strtonum(nmea_field(s, GPGSV_MSGNO), 0, 16, &errstr);
   if (errstr)
     return;
-  tots = strtonum(data[GPGSV_SAT], 0, MAX_SATS, &errstr);
+  tots = strtonum(nmea_field(s, GPGSV_SAT), 0, MAX_SATS, &errstr);
   if (errstr)
     return;
   if (msgno == 1 && sats_status != SATS_DONE) {
@@ -252,15 +331,15 @@ proc_gpgsv(char *data[], int fields)
   for (i = GPGSV_SAT_BASE;
       i + GPGSV_SAT_FIELDS - 1 <= fields && sats < tots;
       i += GPGSV_SAT_FIELDS, sats++) {
-    sat[sats].id = strtonum(data[i + GPGSV_SAT_ID], 1, MAX_SATS,
+    sat[sats].id = strtonum(nmea_field(s, i + GPGSV_SAT_ID), 1, MAX_SATS,
         &errstr);
     if (errstr)
       return;
     if (fields <= i + GPGSV_SAT_SNR ||
-        *data[i + GPGSV_SAT_SNR] == '\0') {
+        *nmea_field(s, i + GPGSV_SAT_SNR) == '\0') {
       sat[sats].snr = -1; // XXX
     } else {
-      sat[sats].snr = strtonum(data[i + GPGSV_SAT_SNR], 1, 99,
+      sat[sats].snr = strtonum(nmea_field(s, i + GPGSV_SAT_SNR), 1, 99,
           &errstr);
       if (errstr)
         return;
@@ -274,89 +353,314 @@ proc_gpgsv(char *data[], int fields)
 
 #endif
 
+/* The sentences the task is woken for */
 static bool
-msgproc(char *msg, int len)
+wanted(uint8_t type)
 {
-  char	*data[MAX_FIELDS];
-  char	*s, *p;
-  int	 i;
+#ifdef DEBUG_GSV
+  if (type == NMEA_GSV)
+    return true;
+#endif
+  return type == NMEA_GGA;
+}
 
+static bool
+msgproc(struct nmea_sentence *s)
+{
 #ifdef DEBUG
-  write(1, msg, len);
+  printf("gps rx %s, %d fields\r\n", s->data, s->fields);
 #endif
-  if (!valid_crc(msg, len))
+  switch (s->type) {
+  case NMEA_GGA:
+    proc_gpgga(s);
+    return true;
+#ifdef DEBUG_GSV
+  case NMEA_GSV:
+    proc_gpgsv(s);
+    return false;
+#endif
+  default:
     return false;
-  msg[len - 5] = '\0';
-  i = 0;
-  for (s = msg; *s != '\0'; s = p + 1) {
-    data[i++] = s;
-    if (i == ARRAY_SIZE(data) || (p = strchr(s, ',')) == NULL)
-      break;
-    *p = '\0';
   }
-  if (i) {
-    if (strcmp(data[0], gpgga) == 0) {
-      proc_gpgga(data);
-      return true;
-    }
-#ifdef DEBUG_GSV
-    else if (strcmp(data[0], gpgsv) == 0) {
-      proc_gpgsv(data, i);
-      return false;
+}
+
+static void
+gps_uart_isr(void)
+{
+  struct nmea_sentence	*s;
+  uint8_t		 type;
+
+  switch (hw_uart_get_interrupt_id(HW_UART2)) {
+  case HW_UART_INT_RECEIVED_AVAILABLE:
+  case HW_UART_INT_TIMEOUT:
+    while (hw_uart_is_data_ready(HW_UART2)) {
+      type = nmea_feed(&nmea, hw_uart_rxdata_getf(HW_UART2));
+      if (!wanted(type))
+        continue;
+      if (rx_ready) {
+        rx_dropped++;
+        continue;
+      }
+      s = rx_sentence;
+      rx_sentence = nmea.s;
+      nmea.s = s;
+      BARRIER();
+      rx_ready = 1;
+      lora_task_notify_event(EVENT_NOTIF_GPS_RX, NULL);
     }
-#endif
+    break;
+  case HW_UART_INT_THR_EMPTY:
+    while (tx_pos < tx_len && hw_uart_tx_fifo_not_full(HW_UART2))
+      hw_uart_txdata_setf(HW_UART2, tx_buf[tx_pos++]);
+    if (tx_pos == tx_len)
+      HW_UART_REG_SETF(HW_UART2, IER_DLH, ETBEI_dlh1, 0);
+    break;
+  default:
+    break;
   }
-  return false;
 }
 
+/*
+ * The TX pin drives the UART only while the acquisition lasts, not to
+ * power the receiver through it while its supply is off.
+ */
 static void
-gps_uart_rx(OS_TIMER timer)
+gps_tx_pin(bool enable)
 {
-  (void)(timer);
-  lora_task_notify_event(EVENT_NOTIF_GPS_RX, NULL);
+  if (enable)
+    hw_gpio_set_pin_function(HW_SENSOR_UART_TX_PORT, HW_SENSOR_UART_TX_PIN,
+        HW_GPIO_MODE_OUTPUT, HW_GPIO_FUNC_UART2_TX);
+  else
+    hw_gpio_set_pin_function(HW_SENSOR_UART_TX_PORT, HW_SENSOR_UART_TX_PIN,
+        HW_GPIO_MODE_INPUT, HW_GPIO_FUNC_GPIO);
 }
 
-void gps_rx(void)
+static void
+gps_rx_int(bool enable)
 {
-#ifdef DEBUG
-  if((!hw_uart_read_buf_empty(HW_UART2)) \
-    && (rxlen == 0)){
-    printf("gps rx:\r\n");
+  NVIC_DisableIRQ(UART2_IRQn);
+  HW_UART_REG_SETF(HW_UART2, IER_DLH, ERBFI_dlh0, enable);
+  NVIC_EnableIRQ(UART2_IRQn);
+}
+
+/* The interrupt sends tx_buf from its start, at once as the FIFO is empty */
+static void
+gps_tx_int(bool enable)
+{
+  NVIC_DisableIRQ(UART2_IRQn);
+  tx_pos = 0;
+  HW_UART_REG_SETF(HW_UART2, IER_DLH, ETBEI_dlh1, enable);
+  NVIC_EnableIRQ(UART2_IRQn);
+}
+
+static void
+gps_motion(uint8_t *ths, uint8_t *recheck)
+{
+  uint8_t	m[2] = {};
+
+  param_get(PARAM_GPS_MOTION, m, sizeof(m));
+  *ths = m[0] != 0 ? m[0] : GPS_MOTION_THS;
+  *recheck = m[1] != 0 ? m[1] : GPS_RECHECK;
+}
+
+/* Follows the fixes of the acquisitions to tell a stationary node */
+static void
+gps_track(void)
+{
+  uint8_t	ths, recheck;
+
+  if (last_fix.fix == 0)
+    return;
+  gps_motion(&ths, &recheck);
+  if (ref_fix.fix != 0 && nmea_near(last_fix.lat, last_fix.lon,
+      ref_fix.lat, ref_fix.lon, ths)) {
+    if (still_fixes < UINT8_MAX)
+      still_fixes++;
+  } else {
+    memcpy(&ref_fix, &last_fix, sizeof(ref_fix));
+    still_fixes = 0;
   }
-#endif
-  while (!hw_uart_read_buf_empty(HW_UART2)) {
-    uint8_t	c;
+}
 
-    if (rxlen >= (int)sizeof(rxbuf)) {
-      rxlen = 0;
-      continue;
-    }
-    c = hw_uart_read(HW_UART2);
-    if ((rxbuf[rxlen++] = c) == '\n') {
-      if (msgproc(rxbuf, rxlen)){
-        if(last_fix.fix != 0){
-          status |= STATUS_GPS_FIX_FOUND;
-        }
-        status |= STATUS_GPS_INFO_RECEIVED;
-      }
-      rxlen = 0;
-    }
+/* Whether a stationary node skips this acquisition */
+static bool
+gps_skip(void)
+{
+  uint8_t	ths, recheck;
+
+  gps_motion(&ths, &recheck);
+  if (motion_moved() == 1)
+    still_fixes = 0;
+  if (still_fixes < GPS_STILL_FIXES || skipped >= recheck) {
+    skipped = 0;
+    return false;
   }
-  if (!(status & STATUS_GPS_INFO_RECEIVED))
-  {
-    OS_TIMER_START(gps_rx_timer, OS_TIMER_FOREVER);
+  skipped++;
+  return true;
+}
+
+/* The network time was set, by DeviceTimeAns */
+void
+gps_time_sync(void)
+{
+  utc_offset = -GPS_LEAP_SECONDS;
+  time_synced = SysTimeGet().Seconds;
+}
+
+/*
+ * Whether a DeviceTimeReq is due to keep the aiding time. A network
+ * server that does not answer is asked again after GPS_TIME_RETRY.
+ */
+bool
+gps_time_wanted(void)
+{
+  uint32_t	now = SysTimeGet().Seconds;
+
+  if (time_synced != 0 && now - time_synced < GPS_TIME_RESYNC)
+    return false;
+  if (time_asked != 0 && now - time_asked < GPS_TIME_RETRY)
+    return false;
+  time_asked = now;
+  return true;
+}
+
+/*
+ * Keeps a good fix for the next acquisitions. Its UTC time of day
+ * corrects the drift of the time, as long as it is under half a day.
+ */
+static void
+gps_aid_keep(void)
+{
+  int32_t	utc, diff;
+
+  memcpy(&aid_fix, &last_fix, sizeof(aid_fix));
+  if (time_synced == 0 || fix_tod == TOD_UNKNOWN)
+    return;
+  utc = fix_systime + utc_offset;
+  diff = fix_tod - utc % GPS_DAY;
+  if (diff > GPS_DAY / 2)
+    diff -= GPS_DAY;
+  else if (diff < -GPS_DAY / 2)
+    diff += GPS_DAY;
+  utc_offset += diff;
+  time_synced = fix_systime;
+}
+
+/* Latitude or longitude in 1/10000 minute as degrees with 6 decimals */
+static int
+fmt_deg(char *buf, size_t len, int32_t v)
+{
+  uint32_t	udeg = (v < 0 ? -v : v) * 5 / 3;
+
+  return snprintf(buf, len, "%s%lu.%06lu", v < 0 ? "-" : "",
+      (unsigned long)(udeg / 1000000), (unsigned long)(udeg % 1000000));
+}
+
+/* Sends the receiver the last good fix and the time */
+static void
+gps_aid(void)
+{
+  char		*buf = tx_buf;
+  size_t	 size = sizeof(tx_buf);
+  struct tm	 tm;
+  time_t	 utc;
+  uint8_t	 crc = 0;
+  int		 i, len;
+
+  if (time_synced == 0)
+    return;
+  status |= STATUS_GPS_AIDED;
+  utc = SysTimeGet().Seconds + utc_offset;
+  gmtime_r(&utc, &tm);
+  if (aid_fix.fix != 0) {
+    len = snprintf(buf, size, "$PMTK741,");
+    len += fmt_deg(buf + len, size - len, aid_fix.lat);
+    len += snprintf(buf + len, size - len, ",");
+    len += fmt_deg(buf + len, size - len, aid_fix.lon);
+    len += snprintf(buf + len, size - len, ",%d,", aid_fix.alt / 10);
+  } else
+    len = snprintf(buf, size, "$PMTK740,");
+  len += snprintf(buf + len, size - len,
+      "%04d,%02d,%02d,%02d,%02d,%02d", tm.tm_year + 1900, tm.tm_mon + 1,
+      tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec);
+  for (i = 1; i < len; i++)
+    crc ^= buf[i];
+  len += snprintf(buf + len, size - len, "*%02X\r\n", crc);
+  tx_len = len;
+  gps_tx_pin(true);
+  gps_tx_int(true);
+  stats.aided++;
+#ifdef DEBUG
+  printf("gps aid %.*s\r\n", len - 2, buf);
+#endif
+}
+
+/* Ends the acquisition, the receiver is powered down after the read */
+static void
+gps_done(void)
+{
+  uint32_t	ms = OS_TICKS_2_MS(OS_GET_TICK_COUNT() - acq_since);
+
+  status |= STATUS_GPS_DONE;
+  stats.on += ms;
+  gps_track();
+  if (!(status & STATUS_GPS_FIX_GOOD)) {
+    stats.timeouts++;
+    return;
   }
-#ifdef DEBUG_GSV
-  if (sats_status != SATS_DONE)
-  {
-    OS_TIMER_START(gps_rx_timer, OS_TIMER_FOREVER);
+  stats.fixes++;
+  gps_aid_keep();
+  if (status & STATUS_GPS_AIDED) {
+    stats.fixes_aided++;
+    stats.ttff_aided_sum += ms;
   }
-#endif
+  stats.ttff = ms;
+  if (stats.fixes == 1 || ms < stats.ttff_min)
+    stats.ttff_min = ms;
+  if (ms > stats.ttff_max)
+    stats.ttff_max = ms;
+  stats.ttff_sum += ms;
 #ifdef DEBUG
-  else
-  {
-    printf("gps rx end.\r\n");
+  printf("gps fix in %lu ms, %d satellites, hdop %d\r\n", ms, fix_sats,
+      fix_hdop);
+#endif
+}
+
+/* Whether the time budget of the acquisition is spent */
+static bool
+gps_spent(void)
+{
+  return OS_GET_TICK_COUNT() - acq_since >= acq_budget;
+}
+
+/*
+ * The acquisition ends in the LoRa task, here or at the read, never in
+ * the timer task that polls gps_data_ready().
+ */
+void gps_rx(void)
+{
+  if (!rx_ready)
+    return;
+  if (gps_spent() && !(status & STATUS_GPS_DONE))
+    gps_done();
+  if (!(status & STATUS_GPS_AIDED))
+    gps_aid();
+  if (msgproc(rx_sentence)) {
+    if (last_fix.fix != 0)
+      status |= STATUS_GPS_FIX_FOUND;
+    status |= STATUS_GPS_INFO_RECEIVED;
+    if (last_fix.fix != 0 && fix_sats >= min_sats &&
+        fix_hdop <= max_hdop && !(status & STATUS_GPS_DONE)) {
+      status |= STATUS_GPS_FIX_GOOD;
+      gps_done();
+    }
   }
+  BARRIER();
+  rx_ready = 0;
+#ifdef DEBUG
+  if (status & STATUS_GPS_INFO_RECEIVED)
+    printf("gps rx end, %lu sentences, %lu errors, %lu dropped\r\n",
+        nmea.sentences, nmea.errors, rx_dropped);
 #endif
 }
 
@@ -373,22 +677,23 @@ gps_init()
     .use_fifo		= 1,
   };
 
-  hw_gpio_set_pin_function(HW_SENSOR_UART_TX_PORT, HW_SENSOR_UART_TX_PIN,
-      HW_GPIO_MODE_INPUT,  HW_GPIO_FUNC_GPIO);
-#if 0
-  hw_gpio_set_pin_function(HW_SENSOR_UART_TX_PORT, HW_SENSOR_UART_TX_PIN,
-      HW_GPIO_MODE_OUTPUT, HW_GPIO_FUNC_UART2_TX);
-#endif
+  gps_tx_pin(false);
   hw_gpio_set_pin_function(HW_SENSOR_UART_RX_PORT, HW_SENSOR_UART_RX_PIN,
       HW_GPIO_MODE_INPUT,  HW_GPIO_FUNC_UART2_RX);
   hw_uart_init(HW_UART2, &uart2_cfg);
+  hw_uart_set_isr(HW_UART2, gps_uart_isr);
+  motion_init();
+}
 
-  if(gps_rx_timer == NULL){
-    gps_rx_timer = OS_TIMER_CREATE("gpsuartrx", OS_MS_2_TICKS(10), \
-      OS_TIMER_FAIL, (void *) OS_GET_CURRENT_TASK(), gps_uart_rx);
+static void
+gps_quality(void)
+{
+  uint8_t	q[3] = {};
 
-    OS_ASSERT(gps_rx_timer);
-  }
+  param_get(PARAM_GPS_QUALITY, q, sizeof(q));
+  min_sats = q[0] != 0 ? q[0] : GPS_MIN_SATS;
+  max_hdop = q[1] != 0 ? q[1] : GPS_MAX_HDOP;
+  acq_budget = OS_MS_2_TICKS((q[2] != 0 ? q[2] : GPS_BUDGET) * 1000);
 }
 
 void
@@ -401,35 +706,59 @@ gps_prepare()
 #ifdef DEBUG
   printf("gps status %02x\r\n", status);
 #endif
-  rxlen = 0;
   memset(&last_fix, 0, sizeof(last_fix));
   status &= ~STATUS_GPS_INFO_RECEIVED;
   status &= ~STATUS_GPS_FIX_FOUND;
+  status &= ~(STATUS_GPS_FIX_GOOD | STATUS_GPS_DONE | STATUS_GPS_SKIPPED |
+      STATUS_GPS_AIDED);
+  if (gps_skip()) {
+    status |= STATUS_GPS_SKIPPED | STATUS_GPS_DONE;
+    stats.skipped++;
+    return;
+  }
+  gps_quality();
+  acq_since = OS_GET_TICK_COUNT();
+  stats.acquisitions++;
   while (!hw_uart_read_buf_empty(HW_UART2))
     hw_uart_read(HW_UART2);
-  OS_TIMER_START(gps_rx_timer, OS_TIMER_FOREVER);
+  nmea_init(&nmea, &sentences[0]);
+  rx_sentence = &sentences[1];
+  rx_ready = 0;
+  gps_rx_int(true);
 }
 
 TickType_t
 gps_data_ready()
 {
+  bool	spent = gps_spent();
+
 #ifdef DEBUG_GSV
-  return (status & (STATUS_GPS_FIX_FOUND | STATUS_GPS_INFO_RECEIVED)) && \
-    sats_status == SATS_DONE ? 0 : OS_MS_2_TICKS(100);
-#else
-  return status & (STATUS_GPS_FIX_FOUND | STATUS_GPS_INFO_RECEIVED) ? \
-    0 : OS_MS_2_TICKS(100);
+  if (sats_status != SATS_DONE && !spent)
+    return OS_MS_2_TICKS(100);
 #endif
+  return spent || (status & STATUS_GPS_DONE) ? 0 : OS_MS_2_TICKS(100);
+}
+
+const struct gps_stats *
+gps_stats(void)
+{
+  return &stats;
 }
 
 int
 gps_read(char *buf, int len)
 {
-  OS_TIMER_STOP(gps_rx_timer, OS_TIMER_FOREVER);
+  gps_rx_int(false);
+  gps_tx_int(false);
+  gps_tx_pin(false);
+  /* Out of budget, or the sampling guard of the LoRa task ended it */
+  if ((status & STATUS_CONNECTED) && !(status & STATUS_GPS_DONE))
+    gps_done();
   if (len < (int)sizeof(last_fix) || last_fix.fix == 0) {
     if (len < 1 || !(status & STATUS_CONNECTED))
       return 0;
-    buf[0] = !(status & STATUS_GPS_FIX_FOUND);
+    /* Stable since the last fix, or moved and waiting for one */
+    buf[0] = !(status & (STATUS_GPS_FIX_FOUND | STATUS_GPS_SKIPPED));
     return 1;
   }
   memcpy(buf, &last_fix, sizeof(last_fix));
@@ -1,11 +1,30 @@
 #ifndef __GPS_H__
 #define __GPS_H__
 
+/* Acquisitions since boot, times in ms */
+struct gps_stats {
+  uint32_t	acquisitions;
+  uint32_t	fixes;		/* of the quality asked for */
+  uint32_t	timeouts;	/* time budget spent */
+  uint32_t	skipped;	/* node stationary */
+  uint32_t	aided;		/* receiver sent the last fix and time */
+  uint32_t	fixes_aided;
+  uint32_t	ttff;		/* of the last fix */
+  uint32_t	ttff_min;
+  uint32_t	ttff_max;
+  uint32_t	ttff_sum;
+  uint32_t	ttff_aided_sum;	/* of the fixes_aided */
+  uint32_t	on;		/* receiver on for the acquisitions */
+};
+
 void gps_init(void);
 void gps_prepare(void);
 uint32_t gps_data_ready(void);
 int	gps_read(char *, int);
 void gps_txstart(void);
 void gps_rx(void);
+const struct gps_stats *gps_stats(void);
+void gps_time_sync(void);
+bool gps_time_wanted(void);
 
 #endif /* __GPS_H__ */
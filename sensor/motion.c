@@ -0,0 +1,81 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "osal.h"
+
+#include "hw/hw.h"
+#include "hw/i2c.h"
+#include "motion.h"
+
+#ifdef FEATURE_SENSOR_MOTION
+
+/*
+ * An LIS3DH accelerometer on the I2C bus, on a supply that stays on,
+ * with its motion detection latched between two checks. It samples at
+ * 10 Hz in low power mode, and the high-pass filter takes out gravity.
+ */
+#define REG_WHO_AM_I	0x0f
+#define REG_CTRL1	0x20
+#define REG_CTRL2	0x21
+#define REG_CTRL5	0x24
+#define REG_REFERENCE	0x26
+#define REG_INT1_CFG	0x30
+#define REG_INT1_SRC	0x31
+#define REG_INT1_THS	0x32
+#define REG_INT1_DUR	0x33
+
+#define WHO_AM_I	0x33
+#define CTRL1_10HZ_LP	0x2f	/* 10 Hz, low power, X, Y and Z */
+#define CTRL2_HP_INT1	0x01	/* high-pass filter on interrupt 1 */
+#define CTRL5_LIR_INT1	0x08	/* latch interrupt 1 */
+#define INT1_CFG_HIGH	0x2a	/* X, Y or Z above the threshold */
+#define INT1_SRC_IA	0x40
+#define MOTION_THS	4	/* 64 mg at 2 g full scale */
+
+PRIVILEGED_DATA static bool	configured;
+
+static int
+motion_write_reg(uint8_t reg, uint8_t val)
+{
+	return i2c_write(HW_SENSOR_MOTION_I2C_ADDR, reg, &val, 1);
+}
+
+/* Configures the accelerometer once, its settings outlive the sleeps */
+void
+motion_init()
+{
+	uint8_t	val;
+
+	if (configured)
+		return;
+	if (i2c_read(HW_SENSOR_MOTION_I2C_ADDR, REG_WHO_AM_I, &val, 1) == -1 ||
+	    val != WHO_AM_I)
+		return;
+	if (motion_write_reg(REG_CTRL1, CTRL1_10HZ_LP) == -1 ||
+	    motion_write_reg(REG_CTRL2, CTRL2_HP_INT1) == -1 ||
+	    motion_write_reg(REG_CTRL5, CTRL5_LIR_INT1) == -1 ||
+	    motion_write_reg(REG_INT1_THS, MOTION_THS) == -1 ||
+	    motion_write_reg(REG_INT1_DUR, 0) == -1 ||
+	    motion_write_reg(REG_INT1_CFG, INT1_CFG_HIGH) == -1 ||
+	    i2c_read(HW_SENSOR_MOTION_I2C_ADDR, REG_REFERENCE, &val, 1) == -1)
+		return;
+	configured = true;
+}
+
+/*
+ * Returns 1 if the node moved since the last call, 0 if not, -1 when the
+ * accelerometer cannot tell. Reading the source clears the latch.
+ */
+int
+motion_moved()
+{
+	uint8_t	src;
+
+	if (!configured ||
+	    i2c_read(HW_SENSOR_MOTION_I2C_ADDR, REG_INT1_SRC, &src, 1) == -1)
+		return -1;
+	return (src & INT1_SRC_IA) != 0;
+}
+
+#endif /* FEATURE_SENSOR_MOTION */
@@ -0,0 +1,16 @@
+#ifndef __MOTION_H__
+#define __MOTION_H__
+
+#ifdef FEATURE_SENSOR_MOTION
+
+void	motion_init(void);
+int	motion_moved(void);
+
+#else
+
+#define motion_init()
+#define motion_moved()	(-1)
+
+#endif
+
+#endif /* __MOTION_H__ */
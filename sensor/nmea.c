@@ -0,0 +1,176 @@
+/* Incremental NMEA 0183 parser */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "nmea.h"
+
+/*
+ * The parser takes the bytes from the UART one at a time, checks the
+ * message ID, splits the fields and computes the checksum as they
+ * arrive, so each byte is seen once and the sentences it is not
+ * interested in are skipped from their message ID on. A "$" starts a
+ * new sentence wherever it comes. A sentence is valid once it ends with
+ * "*XX\r\n" and the checksum matches, XX in upper case hex, with no
+ * character outside printable ASCII before.
+ */
+enum {
+  NMEA_IDLE,		/* waiting for "$" */
+  NMEA_BODY,
+  NMEA_CRC_HI,
+  NMEA_CRC_LO,
+  NMEA_CR,
+  NMEA_LF,
+};
+
+#define NMEA_ID_LEN	5
+
+static const char	ids[][NMEA_ID_LEN + 1] = {
+  [NMEA_GGA]	= "GPGGA",
+  [NMEA_GSV]	= "GPGSV",
+};
+#define NMEA_TYPES	(sizeof(ids) / sizeof(ids[0]))
+#define NMEA_ALL	((1 << NMEA_TYPES) - 1 - (1 << NMEA_NONE))
+
+static int
+hexval(char c)
+{
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+void
+nmea_init(struct nmea *n, struct nmea_sentence *s)
+{
+  memset(n, 0, sizeof(*n));
+  n->s = s;
+}
+
+/* Narrows the message IDs down with the character at pos of field 0 */
+static uint8_t
+match_id(uint8_t match, uint8_t pos, char c)
+{
+  uint8_t	t;
+
+  if (pos >= NMEA_ID_LEN)
+    return 0;
+  for (t = 0; t < NMEA_TYPES; t++) {
+    if (ids[t][pos] != c)
+      match &= ~(1 << t);
+  }
+  return match;
+}
+
+/*
+ * Adds a received character. Returns the type of the sentence in n->s
+ * when it completes a valid one, NMEA_NONE otherwise.
+ */
+uint8_t
+nmea_feed(struct nmea *n, char c)
+{
+  struct nmea_sentence	*s = n->s;
+  int			 x;
+
+  if (c == '$') {
+    if (n->state != NMEA_IDLE)
+      n->errors++;
+    n->state = NMEA_BODY;
+    n->len = 0;
+    n->crc = 0;
+    n->match = NMEA_ALL;
+    s->fields = 1;
+    s->field[0] = 0;
+    return NMEA_NONE;
+  }
+  switch (n->state) {
+  case NMEA_IDLE:
+    return NMEA_NONE;
+  case NMEA_BODY:
+    if (c == '*') {
+      s->data[n->len] = '\0';
+      s->len = n->len;
+      n->state = NMEA_CRC_HI;
+      return NMEA_NONE;
+    }
+    if (c < ' ' || c > '~' || n->len == NMEA_LEN - 1)
+      break;
+    n->crc ^= c;
+    if (s->fields == 1 && c != ',' &&
+        (n->match = match_id(n->match, n->len, c)) == 0) {
+      /* Not a sentence of interest, skip it */
+      n->state = NMEA_IDLE;
+      return NMEA_NONE;
+    }
+    if (c != ',' || s->fields == NMEA_FIELDS) {
+      s->data[n->len++] = c;
+      return NMEA_NONE;
+    }
+    if (s->fields == 1 && n->len != NMEA_ID_LEN) {
+      n->state = NMEA_IDLE;
+      return NMEA_NONE;
+    }
+    s->data[n->len++] = '\0';
+    s->field[s->fields++] = n->len;
+    return NMEA_NONE;
+  case NMEA_CRC_HI:
+  case NMEA_CRC_LO:
+    if ((x = hexval(c)) < 0)
+      break;
+    n->icrc = (n->state == NMEA_CRC_HI ? 0 : n->icrc << 4) | x;
+    n->state++;
+    return NMEA_NONE;
+  case NMEA_CR:
+    if (c != '\r')
+      break;
+    n->state = NMEA_LF;
+    return NMEA_NONE;
+  case NMEA_LF:
+    if (c != '\n' || n->icrc != n->crc ||
+        (s->fields == 1 && s->len != NMEA_ID_LEN))
+      break;
+    n->state = NMEA_IDLE;
+    n->sentences++;
+    for (s->type = 0; !(n->match & 1 << s->type); s->type++)
+      ;
+    return s->type;
+  }
+  n->errors++;
+  n->state = NMEA_IDLE;
+  return NMEA_NONE;
+}
+
+/* Field i of a sentence, empty when it has fewer */
+char *
+nmea_field(struct nmea_sentence *s, int i)
+{
+  return s->data + (i < s->fields ? s->field[i] : s->len);
+}
+
+/*
+ * Whether two positions, in 1/10000 minute as parsed from the latitude
+ * and longitude fields, are within ths metres north-south and east-west
+ */
+bool
+nmea_near(int32_t lat1, int32_t lon1, int32_t lat2, int32_t lon2,
+    uint8_t ths)
+{
+  /* cos() of every 10 degrees of latitude, in 1/256 */
+  static const uint8_t	cos10[] = {
+    255, 252, 241, 222, 196, 165, 128, 88, 44, 0,
+  };
+  int32_t	units = ths * 54 / 10;	/* 1/10000 minute is 0.1852 m */
+  int32_t	dlat = lat1 - lat2, dlon = lon1 - lon2;
+  int32_t	i = (lat1 < 0 ? -lat1 : lat1) / 600000 / 10;
+
+  if (dlat < 0)
+    dlat = -dlat;
+  if (dlon < 0)
+    dlon = -dlon;
+  if (i >= (int32_t)(sizeof(cos10) / sizeof(*cos10)))
+    i = sizeof(cos10) / sizeof(*cos10) - 1;
+  return dlat <= units && (int64_t)dlon * cos10[i] / 256 <= units;
+}
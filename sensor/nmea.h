@@ -0,0 +1,42 @@
+#ifndef __NMEA_H__
+#define __NMEA_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define NMEA_LEN	83	/* longest sentence with its NUL */
+#define NMEA_FIELDS	20	/* a GSV sentence with 4 satellites */
+
+enum {
+  NMEA_NONE,
+  NMEA_GGA,
+  NMEA_GSV,
+};
+
+/* The fields of a sentence between "$" and "*", NUL terminated */
+struct nmea_sentence {
+  char		data[NMEA_LEN];
+  uint8_t	field[NMEA_FIELDS];	/* offset of each field */
+  uint8_t	fields;
+  uint8_t	len;
+  uint8_t	type;
+};
+
+struct nmea {
+  struct nmea_sentence	*s;	/* sentence being received */
+  uint8_t	state;
+  uint8_t	len;
+  uint8_t	crc;		/* computed */
+  uint8_t	icrc;		/* indicated */
+  uint8_t	match;		/* message IDs the first field can still be */
+  uint32_t	sentences;	/* valid GGA and GSV sentences */
+  uint32_t	errors;		/* bad checksums and malformed sentences */
+};
+
+void	nmea_init(struct nmea *n, struct nmea_sentence *s);
+uint8_t	nmea_feed(struct nmea *n, char c);
+char	*nmea_field(struct nmea_sentence *s, int i);
+bool	nmea_near(int32_t lat1, int32_t lon1, int32_t lat2, int32_t lon2,
+	    uint8_t ths);
+
+#endif /* __NMEA_H__ */
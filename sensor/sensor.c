@@ -5,6 +5,7 @@
 #include "osal.h"
 
 #include "hw/hw.h"
+#include "lora/batch.h"
 #include "lora/param.h"
 #include "lora/util.h"
 #include "gps.h"
@@ -45,6 +46,7 @@ struct sensor_callbacks {
 	TickType_t	(*data_ready)(void);
 	int		(*read)(char *, int);
 	void		(*txstart)(void);
+	uint16_t	fields;		/* BATCH_FIELDS of the data read */
 };
 
 const struct sensor_callbacks	sensor_cb[] = {
@@ -56,17 +58,25 @@ const struct sensor_callbacks	sensor_cb[] = {
 		.prepare	= gps_prepare,
 		.data_ready	= gps_data_ready,
 		.read		= gps_read,
+		/* fix, latitude, longitude, altitude */
+		.fields		= BATCH_FIELDS(1, 4, 4, 2),
 	},
 #endif
 #ifdef FEATURE_SENSOR_TEMP
 	[SENSOR_TYPE_TEMP]	= {
 		.read		= temp_read,
+#ifdef FEATURE_SENSOR_TEMP_PCT2075
+		.fields		= BATCH_FIELDS(BATCH_BE | 2, 0, 0, 0),
+#else
+		.fields		= BATCH_FIELDS(1, 0, 0, 0),
+#endif
 	},
 #endif
 #ifdef FEATURE_SENSOR_LIGHT
 	[SENSOR_TYPE_LIGHT]	= {
 		.init		= light_init,
 		.read		= light_read,
+		.fields		= BATCH_FIELDS(3, 0, 0, 0),
 	},
 #endif
 };
@@ -135,6 +145,12 @@ sensor_get_data(int idx, char *buf, int len)
 	return 1 + sensor_cb[sensor_type[idx]].read(buf + 1, len - 1);
 }
 
+uint16_t
+sensor_get_fields(int idx)
+{
+	return sensor_cb[sensor_type[idx]].fields;
+}
+
 void
 sensor_txstart(void)
 {
@@ -13,6 +13,7 @@ void sensor_init(void);
 void sensor_prepare(void);
 uint32_t sensor_data_ready(void);
 size_t sensor_get_data(int idx, char *buf, int len);
+uint16_t sensor_get_fields(int idx);
 void sensor_txstart(void);
 
 #else /* !FEATURE_SENSOR */
@@ -23,6 +24,7 @@ void sensor_txstart(void);
 #define sensor_prepare()
 #define sensor_data_ready()		((uint32_t)0)
 #define sensor_get_data(idx, buf, len)	((size_t)0)
+#define sensor_get_fields(idx)		((uint16_t)0)
 #define sensor_txstart()
 
 #endif /* FEATURE_SENSOR */
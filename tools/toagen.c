@@ -0,0 +1,174 @@
+/* Generates the time-on-air tables of the LoRaMac regions */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "LoRaMac.h"
+#include "RegionAS923.h"
+#include "RegionAU915.h"
+#include "RegionCN470.h"
+#include "RegionCN779.h"
+#include "RegionEU433.h"
+#include "RegionEU868.h"
+#include "RegionIN865.h"
+#include "RegionKR920.h"
+#include "RegionRU864.h"
+#include "RegionUS915.h"
+
+/*
+ * Each table holds the time on air of every PHY payload length up to
+ * the largest the MAC accepts at each data rate, for the radio
+ * settings of the region TxConfig functions: LoRa with an 8 symbol
+ * preamble, explicit header, CRC and coding rate 4/5; FSK at 50 kbps
+ * with a 5 byte preamble, the 3 byte sync word of the register
+ * defaults, a length byte and CRC. The arithmetic is the one of
+ * SX1276GetTimeOnAir.
+ */
+#define TOA_LORA_PREAMBLE	8
+#define TOA_LORA_CODERATE	1	/* 4/5 */
+#define TOA_FSK_PREAMBLE	5
+#define TOA_FSK_SYNCWORD	3
+#define TOA_FSK			50	/* datarate table entry of FSK */
+#define TOA_PER_LINE		12
+
+struct region {
+	const char	*name;
+	const uint8_t	*datarates;
+	const uint32_t	*bandwidths;
+	size_t		 ndatarates;
+	const uint8_t	*maxpayload[3];
+	size_t		 nmaxpayload[3];
+};
+
+#define REGION(n, ...)	{ #n, Datarates##n, Bandwidths##n,		\
+	    sizeof(Datarates##n), __VA_ARGS__ }
+
+static const struct region regions[] = {
+	REGION(AS923, { MaxPayloadOfDatarateDwell0AS923,
+	    MaxPayloadOfDatarateDwell1UpAS923,
+	    MaxPayloadOfDatarateDwell1DownAS923 },
+	    { sizeof(MaxPayloadOfDatarateDwell0AS923),
+	    sizeof(MaxPayloadOfDatarateDwell1UpAS923),
+	    sizeof(MaxPayloadOfDatarateDwell1DownAS923) }),
+	REGION(AU915, { MaxPayloadOfDatarateDwell0AU915,
+	    MaxPayloadOfDatarateDwell1AU915 },
+	    { sizeof(MaxPayloadOfDatarateDwell0AU915),
+	    sizeof(MaxPayloadOfDatarateDwell1AU915) }),
+	REGION(CN470, { MaxPayloadOfDatarateCN470 },
+	    { sizeof(MaxPayloadOfDatarateCN470) }),
+	REGION(CN779, { MaxPayloadOfDatarateCN779 },
+	    { sizeof(MaxPayloadOfDatarateCN779) }),
+	REGION(EU433, { MaxPayloadOfDatarateEU433 },
+	    { sizeof(MaxPayloadOfDatarateEU433) }),
+	REGION(EU868, { MaxPayloadOfDatarateEU868 },
+	    { sizeof(MaxPayloadOfDatarateEU868) }),
+	REGION(IN865, { MaxPayloadOfDatarateIN865 },
+	    { sizeof(MaxPayloadOfDatarateIN865) }),
+	REGION(KR920, { MaxPayloadOfDatarateKR920 },
+	    { sizeof(MaxPayloadOfDatarateKR920) }),
+	REGION(RU864, { MaxPayloadOfDatarateRU864 },
+	    { sizeof(MaxPayloadOfDatarateRU864) }),
+	REGION(US915, { MaxPayloadOfDatarateUS915 },
+	    { sizeof(MaxPayloadOfDatarateUS915) }),
+};
+
+static uint32_t
+toa_lora(uint32_t sf, uint32_t bw, unsigned int len)
+{
+	uint32_t ts, npayload, t;
+	int32_t num, den;
+	int ldro;
+
+	ldro = (bw == 125000 && sf >= 11) || (bw == 250000 && sf == 12);
+	ts = ((uint32_t)1 << sf) * 1000000UL / bw;
+	num = 8 * len - 4 * sf + 28 + 16;
+	den = 4 * (sf - (ldro ? 2 : 0));
+	npayload = 8;
+	if (num > 0)
+		npayload += (num + den - 1) / den * (TOA_LORA_CODERATE + 4);
+	t = TOA_LORA_PREAMBLE * ts + 17 * ts / 4 + npayload * ts;
+	return (t + 999) / 1000;
+}
+
+static uint32_t
+toa_fsk(uint32_t kbps, unsigned int len)
+{
+	uint32_t nbytes, bps;
+
+	nbytes = TOA_FSK_PREAMBLE + TOA_FSK_SYNCWORD + 1 + len + 2;
+	bps = kbps * 1000;
+	return (nbytes * 16000 + bps) / (2 * bps);
+}
+
+/* Largest PHY payload the MAC sends or receives at a data rate */
+static unsigned int
+maxlen(const struct region *r, size_t dr)
+{
+	unsigned int max = 0;
+	size_t i;
+
+	if (r->datarates[dr] == 0)
+		return 0;
+	for (i = 0; i < 3 && r->maxpayload[i] != NULL; i++)
+		if (dr < r->nmaxpayload[i] && r->maxpayload[i][dr] > max)
+			max = r->maxpayload[i][dr];
+	if (max == 0)
+		return 0;
+	max += LORA_MAC_FRMPAYLOAD_OVERHEAD;
+	return max > 255 ? 255 : max;
+}
+
+static void
+gen(const struct region *r)
+{
+	unsigned int len, offset;
+	uint32_t toa;
+	size_t dr;
+
+	printf("\n#ifdef REGION_%s\n", r->name);
+	printf("static const uint16_t Offset%s[] = {", r->name);
+	for (dr = 0, offset = 0; dr < r->ndatarates; dr++) {
+		printf("%s%u,", dr % TOA_PER_LINE ? " " : "\n\t", offset);
+		offset += maxlen(r, dr) > 0 ? maxlen(r, dr) + 1 : 0;
+	}
+	printf(" %u\n};\n", offset);
+
+	printf("static const uint16_t Airtime%s[] = {", r->name);
+	for (dr = 0; dr < r->ndatarates; dr++) {
+		if (maxlen(r, dr) == 0)
+			continue;
+		printf("\n\t/* DR_%zu */", dr);
+		for (len = 0; len <= maxlen(r, dr); len++) {
+			if (r->datarates[dr] == TOA_FSK)
+				toa = toa_fsk(r->datarates[dr], len);
+			else
+				toa = toa_lora(r->datarates[dr],
+				    r->bandwidths[dr], len);
+			if (toa > UINT16_MAX) {
+				fprintf(stderr, "toagen: %s DR_%zu: %u bytes "
+				    "take %u ms\n", r->name, dr, len, toa);
+				exit(1);
+			}
+			printf("%s%u,", len % TOA_PER_LINE ? " " : "\n\t", toa);
+		}
+	}
+	printf("\n};\n");
+
+	printf("const RegionCommonTimeOnAir_t TimeOnAir%s = {\n"
+	    "\t%zu, Offset%s, Airtime%s\n};\n", r->name, r->ndatarates,
+	    r->name, r->name);
+	printf("#endif /* REGION_%s */\n", r->name);
+}
+
+int
+main(void)
+{
+	size_t i;
+
+	printf("/* Generated by tools/toagen.c, do not edit */\n\n"
+	    "#include \"region/RegionCommon.h\"\n");
+	for (i = 0; i < sizeof(regions) / sizeof(regions[0]); i++)
+		gen(&regions[i]);
+	return 0;
+}